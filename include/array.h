@@ -150,11 +150,47 @@ array_add_item_with_cached_index_info(struct array *array,
 enum array_result
 array_copy(struct array *__notnull array, struct array *__notnull array_out);
 
+/*
+ * Arrays of many items are sorted on several threads, in runs that are then
+ * merged together.
+ */
+
 void
 array_sort_with_comparator(struct array *__notnull array,
                            size_t item_size,
                            __notnull array_item_sort_comparator comparator);
 
+/*
+ * Called with an item kept in the array, and an equal item dropped from the
+ * merge, so that the dropped item can be folded into the kept item.
+ *
+ * The callback may be called from several threads at once, but never twice
+ * at once for the same kept item.
+ */
+
+typedef void
+(*array_item_duplicate_callback)(void *__notnull kept,
+                                 void *__notnull dropped,
+                                 void *cb_info);
+
+/*
+ * Merge the sorted items of src into the sorted items of array, dropping any
+ * item equal to the item before it. Unlike
+ * array_add_and_unique_items_from_array(), this takes linear time, and large
+ * merges are split across several threads.
+ *
+ * If duplicate isn't NULL, it's called for every item dropped.
+ */
+
+enum array_result
+array_add_and_unique_items_from_sorted_array(
+    struct array *__notnull array,
+    size_t item_size,
+    const struct array *__notnull src,
+    __notnull array_item_sort_comparator comparator,
+    array_item_duplicate_callback duplicate,
+    void *cb_info);
+
 void
 array_trim_to_item_count(struct array *__notnull array,
                          size_t item_size,
@@ -0,0 +1,67 @@
+//
+//  include/dir_cache.h
+//  tbd
+//
+//  Created by inoahdev on 2/7/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef DIR_CACHE_H
+#define DIR_CACHE_H
+
+#include <sys/types.h>
+
+#include "array.h"
+#include "notnull.h"
+
+/*
+ * A least-recently-used cache of output directories known to exist, keyed by
+ * their path, so that writing many files into the same hierarchy doesn't
+ * repeatedly probe and create every path-component with full paths.
+ *
+ * A directory is opened once a second file is written into its hierarchy, and
+ * files are then created with openat() relative to it, while missing
+ * directories are created with mkdirat() relative to it.
+ */
+
+struct dir_cache_entry {
+    char *path;
+    uint64_t path_length;
+
+    /*
+     * fd is -1 if the directory has not yet been opened.
+     */
+
+    int fd;
+    uint64_t last_used;
+};
+
+struct dir_cache {
+    struct array entries;
+
+    uint64_t max_count;
+    uint64_t clock;
+};
+
+static const uint64_t DIR_CACHE_DEFAULT_MAX_COUNT = 128;
+
+/*
+ * Open (creating if necessary) the file at path, creating the directory
+ * hierarchy leading up to it, with the same semantics as open_r().
+ *
+ * path is temporarily modified while opening, but is restored before
+ * returning.
+ */
+
+int
+dir_cache_open_file(struct dir_cache *__notnull cache,
+                    char *__notnull path,
+                    uint64_t path_length,
+                    int flags,
+                    mode_t mode,
+                    mode_t dir_mode,
+                    char **first_terminator_out);
+
+void dir_cache_destroy(struct dir_cache *__notnull cache);
+
+#endif /* DIR_CACHE_H */
@@ -0,0 +1,75 @@
+//
+//  include/dsc_cache.h
+//  tbd
+//
+//  Created by inoahdev on 2/6/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef DSC_CACHE_H
+#define DSC_CACHE_H
+
+#include <sys/types.h>
+#include <time.h>
+
+#include "array.h"
+#include "dyld_shared_cache.h"
+#include "notnull.h"
+
+/*
+ * A least-recently-used cache of mapped and validated dyld_shared_cache files,
+ * to allow multiple requests in a single run to parse a dyld_shared_cache file
+ * only once.
+ *
+ * dyld_shared_cache files are identified by their device, inode, size, and
+ * modification time, so a file that was replaced on disk is parsed again.
+ */
+
+struct dsc_cache_entry {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+
+    uint64_t last_used;
+    bool in_use : 1;
+
+    struct dyld_shared_cache_parse_options options;
+    struct dyld_shared_cache_info info;
+};
+
+struct dsc_cache {
+    struct array entries;
+
+    uint64_t max_count;
+    uint64_t clock;
+};
+
+static const uint64_t DSC_CACHE_DEFAULT_MAX_COUNT = 4;
+
+/*
+ * Get the dyld_shared_cache at fd, whose first 16 bytes (magic) have already
+ * been read, parsing and adding it to the cache if not already present.
+ *
+ * The returned dyld_shared_cache_info is owned by the cache, and must not be
+ * destroyed by the caller. It remains valid until the next call to
+ * dsc_cache_get_for_fd(), dsc_cache_evict_path(), or dsc_cache_destroy().
+ *
+ * If options.zero_image_pads is set, the image pads are zeroed again when the
+ * dyld_shared_cache is returned from the cache.
+ */
+
+enum dyld_shared_cache_parse_result
+dsc_cache_get_for_fd(struct dsc_cache *__notnull cache,
+                     int fd,
+                     const char magic[16],
+                     struct dyld_shared_cache_parse_options options,
+                     struct dyld_shared_cache_info **__notnull info_out);
+
+void
+dsc_cache_evict_path(struct dsc_cache *__notnull cache,
+                     const char *__notnull path);
+
+void dsc_cache_destroy(struct dsc_cache *__notnull cache);
+
+#endif /* DSC_CACHE_H */
@@ -0,0 +1,76 @@
+//
+//  include/dsc_closure.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef DSC_CLOSURE_H
+#define DSC_CLOSURE_H
+
+#include <stdint.h>
+
+#include "dyld_shared_cache.h"
+#include "notnull.h"
+
+/*
+ * A dsc_closure finds the images that an image of a dyld_shared_cache depends
+ * on, directly or through other images, marking each with pad_flag.
+ *
+ * Dependencies are found through a hash-table of the install-names of every
+ * image, built once, and only the load-commands of images are read.
+ * Install-names that don't belong to an image of the dyld_shared_cache are
+ * skipped.
+ */
+
+struct dsc_closure {
+    struct dyld_shared_cache_info *dsc_info;
+
+    /*
+     * An open-addressing hash-table of the images, keyed by their
+     * install-names, storing the index of each image plus one, so that zero
+     * marks an empty slot.
+     */
+
+    uint64_t *slots;
+    uint64_t mask;
+
+    uint64_t *path_lengths;
+
+    /*
+     * The indices of the images newly marked by the last call to
+     * dsc_closure_mark_dependencies(), in the order they were found.
+     */
+
+    uint32_t *queue;
+    uint32_t queue_count;
+
+    uint32_t pad_flag;
+};
+
+enum dsc_closure_result {
+    E_DSC_CLOSURE_OK,
+    E_DSC_CLOSURE_ALLOC_FAIL
+};
+
+enum dsc_closure_result
+dsc_closure_create(struct dsc_closure *__notnull closure,
+                   struct dyld_shared_cache_info *__notnull dsc_info,
+                   uint32_t pad_flag);
+
+/*
+ * Mark every image the image at index depends on with pad_flag, stopping at
+ * images already marked, and storing the images newly marked in the queue.
+ *
+ * The image at index should already be marked, so that it's never found as a
+ * dependency of itself.
+ */
+
+void
+dsc_closure_mark_dependencies(struct dsc_closure *__notnull closure,
+                              uint32_t index);
+
+void dsc_closure_destroy(struct dsc_closure *__notnull closure);
+
+#endif /* DSC_CLOSURE_H */
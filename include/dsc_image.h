@@ -57,7 +57,8 @@ enum dsc_image_parse_result {
     E_DSC_IMAGE_PARSE_CREATE_SYMBOLS_FAIL,
     E_DSC_IMAGE_PARSE_CREATE_TARGET_LIST_FAIL,
 
-    E_DSC_IMAGE_PARSE_SIMULATOR_TYPE_MISMATCH
+    E_DSC_IMAGE_PARSE_SIMULATOR_TYPE_MISMATCH,
+    E_DSC_IMAGE_PARSE_BUDGET_EXCEEDED
 };
 
 struct dsc_image_parse_options {
@@ -75,4 +76,39 @@ dsc_image_parse(struct tbd_create_info *__notnull info_in,
                 struct tbd_parse_options tbd_options,
                 struct dsc_image_parse_options options);
 
+/*
+ * Find the range of an image's export-trie, from either its LC_DYLD_INFO,
+ * LC_DYLD_INFO_ONLY, or LC_DYLD_EXPORTS_TRIE load-command, reading only the
+ * image's mach-o header and load-commands.
+ *
+ * The range is relative to the start of the dyld_shared_cache's map.
+ */
+
+enum dsc_image_parse_result
+dsc_image_find_export_trie(struct dyld_shared_cache_info *__notnull dsc_info,
+                           struct dyld_cache_image_info *__notnull image,
+                           struct range *__notnull range_out);
+
+/*
+ * Called with the install-name of every dylib an image depends on.
+ */
+
+typedef void
+(*dsc_image_dependency_callback)(const char *__notnull name,
+                                 uint64_t length,
+                                 void *cb_info);
+
+/*
+ * Call callback for every LC_LOAD_DYLIB, LC_LOAD_WEAK_DYLIB,
+ * LC_LOAD_UPWARD_DYLIB, and LC_REEXPORT_DYLIB load-command of an image,
+ * reading only the image's mach-o header and load-commands.
+ */
+
+enum dsc_image_parse_result
+dsc_image_iterate_dependencies(
+    struct dyld_shared_cache_info *__notnull dsc_info,
+    const struct dyld_cache_image_info *__notnull image,
+    dsc_image_dependency_callback callback,
+    void *cb_info);
+
 #endif /* DSC_IMAGE_H */
@@ -0,0 +1,31 @@
+//
+//  include/dsc_merge.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef DSC_MERGE_H
+#define DSC_MERGE_H
+
+#include <stdint.h>
+#include "notnull.h"
+
+/*
+ * --merge-dsc pairs the images of several dyld_shared_cache files (such as the
+ * arm64 and arm64e caches of a release, or its device and simulator caches) by
+ * their install-names, and writes out a single tbd-version v4 .tbd for each
+ * install-name, with the targets of every cache it was found in.
+ *
+ * Each .tbd is written to <write-dir>/<install-name>.tbd.
+ *
+ * Every image is parsed exactly once.
+ */
+
+int
+dsc_merge_for_main(const char *__notnull write_dir,
+                   const char *const *__notnull dsc_paths,
+                   uint64_t dsc_count);
+
+#endif /* DSC_MERGE_H */
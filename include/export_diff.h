@@ -0,0 +1,35 @@
+//
+//  include/export_diff.h
+//  tbd
+//
+//  Created by inoahdev on 2/9/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef EXPORT_DIFF_H
+#define EXPORT_DIFF_H
+
+#include "notnull.h"
+
+/*
+ * --diff compares the exported symbols and metadata of two inputs, each of
+ * which may either be a mach-o file or a dyld_shared_cache file, and prints
+ * every difference, grouped by image:
+ *
+ *     image: <install-name>
+ *         <field>: <old-value> -> <new-value>
+ *         + <added symbol or metadata> [ <targets> ]
+ *         - <removed symbol or metadata> [ <targets> ]
+ *         ~ <symbol or metadata> [ <old-targets> ] -> [ <new-targets> ]
+ *     added image: <install-name>
+ *     removed image: <install-name>
+ *
+ * Images are paired by their install-name, except when both inputs are single
+ * mach-o files, which are always paired with each other.
+ */
+
+int
+export_diff_for_main(const char *__notnull old_path,
+                     const char *__notnull new_path);
+
+#endif /* EXPORT_DIFF_H */
@@ -0,0 +1,41 @@
+//
+//  include/export_dump.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef EXPORT_DUMP_H
+#define EXPORT_DUMP_H
+
+#include <stdint.h>
+#include "notnull.h"
+
+enum export_dump_format {
+    EXPORT_DUMP_FORMAT_NONE,
+
+    EXPORT_DUMP_FORMAT_NDJSON,
+    EXPORT_DUMP_FORMAT_TSV
+};
+
+enum export_dump_format
+export_dump_format_from_string(const char *__notnull string);
+
+/*
+ * --dump-exports writes one record for every export of every image of the
+ * provided mach-o and dyld_shared_cache files to stdout, in the form of:
+ *
+ *     image, symbol, kind, target
+ *
+ * Records are written as soon as the symbols are found while parsing, in the
+ * order they are found, and so are neither sorted nor deduplicated, and no
+ * memory is used to store the symbols of an image.
+ */
+
+int
+export_dump_for_main(enum export_dump_format format,
+                     const char *const *__notnull paths,
+                     uint64_t path_count);
+
+#endif /* EXPORT_DUMP_H */
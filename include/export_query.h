@@ -0,0 +1,31 @@
+//
+//  include/export_query.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef EXPORT_QUERY_H
+#define EXPORT_QUERY_H
+
+#include <stdint.h>
+#include "notnull.h"
+
+/*
+ * --query-symbol looks up each of the provided symbols in the export-trie of
+ * every image of a dyld_shared_cache file, and prints one line for every image
+ * exporting the symbol, in the form of:
+ *
+ *     symbol, image, flags, targets
+ *
+ * Only each image's load-commands, and the tree-nodes on the path to the
+ * symbol, are read, so no image's symbols are ever fully parsed.
+ */
+
+int
+export_query_for_main(const char *__notnull path,
+                      const char *const *__notnull symbols,
+                      uint64_t symbol_count);
+
+#endif /* EXPORT_QUERY_H */
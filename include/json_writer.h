@@ -0,0 +1,70 @@
+//
+//  include/json_writer.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "notnull.h"
+
+/*
+ * A json-writer streams a json document straight to a file, keeping only the
+ * state needed to place commas, newlines, and indentation.
+ *
+ * Like the other writers, every function returns 0 on success, and 1 once
+ * writing to the file has failed.
+ */
+
+struct json_writer {
+    FILE *file;
+    uint64_t depth;
+
+    /*
+     * Whether a value was already written in the current object or array, so
+     * that the next one has to be preceded by a comma.
+     */
+
+    bool needs_comma : 1;
+
+    /*
+     * Whether a key was just written, so that the next value goes on the same
+     * line.
+     */
+
+    bool after_key : 1;
+};
+
+int json_writer_begin_object(struct json_writer *__notnull writer);
+int json_writer_end_object(struct json_writer *__notnull writer);
+
+int json_writer_begin_array(struct json_writer *__notnull writer);
+int json_writer_end_array(struct json_writer *__notnull writer);
+
+int
+json_writer_write_key(struct json_writer *__notnull writer,
+                      const char *__notnull key,
+                      uint64_t length);
+
+int
+json_writer_write_string(struct json_writer *__notnull writer,
+                         const char *__notnull string,
+                         uint64_t length);
+
+int
+json_writer_write_uint(struct json_writer *__notnull writer, uint64_t value);
+
+/*
+ * Write the newline that ends the document.
+ */
+
+int json_writer_end(struct json_writer *__notnull writer);
+
+#endif /* JSON_WRITER_H */
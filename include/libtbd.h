@@ -0,0 +1,184 @@
+//
+//  include/libtbd.h
+//  tbd
+//
+//  Created by inoahdev on 2/1/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef LIBTBD_H
+#define LIBTBD_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "dsc_image.h"
+#include "dyld_shared_cache.h"
+#include "macho_file.h"
+#include "notnull.h"
+#include "string_buffer.h"
+#include "tbd.h"
+
+/*
+ * libtbd is the embeddable interface to tbd's mach-o, dyld_shared_cache, and
+ * .tbd writing code.
+ *
+ * libtbd keeps no process-global state. All state that is reused across calls
+ * is stored in a libtbd_context, which is owned by the caller.
+ *
+ * A context may only be used by one thread at a time, but any number of
+ * contexts may be used concurrently.
+ */
+
+struct libtbd_context {
+    /*
+     * The export-trie's symbol-buffer is reused across parses to avoid
+     * reallocating it for every mach-o file.
+     */
+
+    struct string_buffer export_trie_sb;
+
+    /*
+     * An optional callback to handle any warnings or errors that can be
+     * ignored during parsing.
+     *
+     * If no callback is provided, all such errors stop the parse.
+     */
+
+    macho_file_parse_error_callback callback;
+    void *cb_info;
+};
+
+struct libtbd_options {
+    enum tbd_version version;
+
+    struct macho_file_parse_options macho_options;
+    struct dyld_shared_cache_parse_options dsc_options;
+
+    struct tbd_parse_options parse_options;
+    struct tbd_create_options write_options;
+};
+
+enum libtbd_result {
+    E_LIBTBD_OK,
+    E_LIBTBD_ALLOC_FAIL,
+
+    E_LIBTBD_OPEN_FAIL,
+    E_LIBTBD_READ_FAIL,
+
+    E_LIBTBD_NOT_A_MACHO,
+    E_LIBTBD_NOT_A_CACHE,
+
+    E_LIBTBD_MACHO_PARSE_FAIL,
+    E_LIBTBD_DSC_PARSE_FAIL,
+    E_LIBTBD_DSC_IMAGE_PARSE_FAIL,
+    E_LIBTBD_DSC_IMAGE_NOT_FOUND,
+
+    E_LIBTBD_WRITE_FAIL,
+    E_LIBTBD_BUFFER_TOO_SMALL
+};
+
+/*
+ * Contexts are valid when zero-initialized, so libtbd_context_init() is only
+ * needed to reset a context.
+ */
+
+void libtbd_context_init(struct libtbd_context *__notnull ctx);
+void libtbd_context_destroy(struct libtbd_context *__notnull ctx);
+
+/*
+ * Parse the mach-o file at fd into info_out.
+ *
+ * info_out should either be zero-initialized, or destroyed/cleared from a
+ * previous call. The more detailed macho_file_parse_result is stored in
+ * result_out, if provided.
+ */
+
+enum libtbd_result
+libtbd_parse_macho_fd(struct libtbd_context *__notnull ctx,
+                      struct tbd_create_info *__notnull info_out,
+                      int fd,
+                      struct libtbd_options options,
+                      enum macho_file_parse_result *result_out);
+
+enum libtbd_result
+libtbd_parse_macho_path(struct libtbd_context *__notnull ctx,
+                        struct tbd_create_info *__notnull info_out,
+                        const char *__notnull path,
+                        struct libtbd_options options,
+                        enum macho_file_parse_result *result_out);
+
+/*
+ * Open, validate, and map the dyld_shared_cache file at path.
+ *
+ * The returned dyld_shared_cache_info is only read by the libtbd_parse_dsc_*
+ * functions, and so can be shared across contexts and threads.
+ */
+
+enum libtbd_result
+libtbd_open_dsc(struct dyld_shared_cache_info *__notnull dsc_info_out,
+                const char *__notnull path,
+                struct libtbd_options options,
+                enum dyld_shared_cache_parse_result *result_out);
+
+/*
+ * Parse a dyld_shared_cache image into info_out.
+ *
+ * Unless options.macho_options.copy_strings_in_map is set, info_out may store
+ * pointers into the dyld_shared_cache's map, and so must be destroyed before
+ * dsc_info is.
+ */
+
+enum libtbd_result
+libtbd_parse_dsc_image(struct libtbd_context *__notnull ctx,
+                       struct tbd_create_info *__notnull info_out,
+                       struct dyld_shared_cache_info *__notnull dsc_info,
+                       struct dyld_cache_image_info *__notnull image,
+                       struct libtbd_options options,
+                       enum dsc_image_parse_result *result_out);
+
+enum libtbd_result
+libtbd_parse_dsc_image_with_path(
+    struct libtbd_context *__notnull ctx,
+    struct tbd_create_info *__notnull info_out,
+    struct dyld_shared_cache_info *__notnull dsc_info,
+    const char *__notnull image_path,
+    struct libtbd_options options,
+    enum dsc_image_parse_result *result_out);
+
+struct dyld_cache_image_info *
+libtbd_dsc_find_image_with_path(
+    const struct dyld_shared_cache_info *__notnull dsc_info,
+    const char *__notnull image_path);
+
+enum libtbd_result
+libtbd_write_to_file(const struct tbd_create_info *__notnull info,
+                     FILE *__notnull file,
+                     struct libtbd_options options);
+
+/*
+ * Write info out to the caller-provided buffer.
+ *
+ * The written .tbd is null-terminated, so capacity must include room for the
+ * terminator. If the buffer is too small, E_LIBTBD_BUFFER_TOO_SMALL is
+ * returned, and the buffer's contents are unspecified.
+ */
+
+enum libtbd_result
+libtbd_write_to_buffer(const struct tbd_create_info *__notnull info,
+                       char *__notnull buffer,
+                       uint64_t capacity,
+                       struct libtbd_options options,
+                       uint64_t *length_out);
+
+/*
+ * Write info out to a newly allocated buffer, which the caller must free().
+ */
+
+enum libtbd_result
+libtbd_write_to_alloc_buffer(const struct tbd_create_info *__notnull info,
+                             struct libtbd_options options,
+                             char **__notnull buffer_out,
+                             uint64_t *length_out);
+
+#endif /* LIBTBD_H */
@@ -53,6 +53,13 @@ struct macho_file_parse_options {
      */
 
     bool use_symbol_table : 1;
+
+    /*
+     * Split large export-tries into sub-trees that are parsed on several
+     * threads.
+     */
+
+    bool parallel_export_trie : 1;
 };
 
 struct macho_file {
@@ -127,7 +134,9 @@ enum macho_file_parse_result {
     E_MACHO_FILE_PARSE_NO_SYMBOL_TABLE,
 
     E_MACHO_FILE_PARSE_CREATE_SYMBOL_LIST_FAIL,
-    E_MACHO_FILE_PARSE_CREATE_TARGET_LIST_FAIL
+    E_MACHO_FILE_PARSE_CREATE_TARGET_LIST_FAIL,
+
+    E_MACHO_FILE_PARSE_BUDGET_EXCEEDED
 };
 
 enum macho_file_parse_callback_type {
@@ -177,6 +186,21 @@ macho_file_parse_from_file(struct tbd_create_info *__notnull info_in,
                            struct tbd_parse_options tbd_options,
                            struct macho_file_parse_options options);
 
+/*
+ * Parse a thin or fat mach-o file that has been mapped or read into memory.
+ * Strings are not copied out of map unless options.copy_strings_in_map is set,
+ * so map must outlive info_in's use of them.
+ */
+
+enum macho_file_parse_result
+macho_file_parse_from_map(struct tbd_create_info *__notnull info_in,
+                          const uint8_t *__notnull map,
+                          uint64_t size,
+                          struct macho_file_parse_extra_args extra,
+                          struct tbd_parse_options tbd_options,
+                          struct macho_file_parse_options options);
+
+bool macho_file_magic_is_valid(uint32_t magic);
 void macho_file_print_archs(int fd);
 
 #endif /* MACHO_FILE_H */
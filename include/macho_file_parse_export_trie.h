@@ -20,6 +20,7 @@ struct macho_file_parse_export_trie_args {
 
     bool is_64 : 1;
     bool is_big_endian : 1;
+    bool parallel : 1;
 
     uint32_t export_off;
     uint32_t export_size;
@@ -39,4 +40,25 @@ macho_file_parse_export_trie_from_map(
     struct macho_file_parse_export_trie_args args,
     const uint8_t *__notnull map);
 
+struct macho_file_export_trie_lookup {
+    uint64_t flags;
+    bool found : 1;
+};
+
+/*
+ * Look up a single symbol in the export-trie by descending from the root along
+ * the symbol's characters, so that only the tree-nodes on the path to the
+ * symbol's export-node are ever read.
+ *
+ * The export-node's flags are stored in lookup_out if the symbol is found.
+ */
+
+enum macho_file_parse_result
+macho_file_lookup_in_export_trie(
+    const uint8_t *__notnull export_trie,
+    uint32_t export_size,
+    const char *__notnull symbol,
+    uint64_t length,
+    struct macho_file_export_trie_lookup *__notnull lookup_out);
+
 #endif /* MACHO_FILE_PARSE_EXPORT_TRIE_H */
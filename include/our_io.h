@@ -16,14 +16,30 @@
 #include <stdio.h>
 
 int our_open(const char *path, int flags, int mode);
-int our_openat(int dirfd, const char *pathname, int flags);
+int our_openat(int dirfd, const char *pathname, int flags, int mode);
 
 int our_mkdir(const char *path, mode_t mode);
+int our_mkdirat(int dirfd, const char *path, mode_t mode);
 int our_unlink(const char *path);
 int our_rmdir(const char *path);
 
 off_t our_lseek(int fd, off_t offset, int whence);
 ssize_t our_read(int fd, void *buf, size_t size);
+ssize_t our_write(int fd, const void *buf, size_t size);
+
+/*
+ * Create a file with no path, backed by memory where supported, that's removed
+ * once its last file-descriptor is closed.
+ */
+
+int our_create_anonymous_file(void);
+
+/*
+ * Ask the kernel to start reading the given range of a file into its cache, so
+ * that a later read doesn't block on the storage.
+ */
+
+void our_read_ahead(int fd, off_t offset, size_t size);
 
 DIR *our_fdopendir(int fd);
 struct dirent *our_readdir(DIR *dir);
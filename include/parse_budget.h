@@ -0,0 +1,82 @@
+//
+//  include/parse_budget.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef PARSE_BUDGET_H
+#define PARSE_BUDGET_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "notnull.h"
+
+/*
+ * Limits on the work done while parsing a single image, so that a malformed
+ * image fails quickly, instead of stalling the parsing of every image after it.
+ *
+ * A limit of zero is no limit.
+ */
+
+struct parse_budget_limits {
+    uint64_t max_trie_nodes;
+    uint64_t max_symbols;
+
+    /*
+     * Bytes of symbol-info and symbol-strings stored for the image.
+     */
+
+    uint64_t max_bytes;
+    uint64_t max_milliseconds;
+};
+
+/*
+ * Usage is atomic, as every thread parsing the same export-trie shares the
+ * same parse-budget.
+ */
+
+struct parse_budget {
+    struct parse_budget_limits limits;
+
+    atomic_uint_fast64_t trie_nodes;
+    atomic_uint_fast64_t symbols;
+    atomic_uint_fast64_t bytes;
+
+    /*
+     * The monotonic-clock time, in nanoseconds, that parsing the image must
+     * finish by, or zero if there is no deadline.
+     */
+
+    uint64_t deadline;
+};
+
+static inline bool
+parse_budget_has_limits(const struct parse_budget_limits limits) {
+    return (limits.max_trie_nodes != 0 ||
+            limits.max_symbols != 0 ||
+            limits.max_bytes != 0 ||
+            limits.max_milliseconds != 0);
+}
+
+/*
+ * Reset the usage of budget, and start its deadline, before an image is
+ * parsed.
+ */
+
+void parse_budget_start(struct parse_budget *__notnull budget);
+
+/*
+ * Account for visiting a tree-node of an export-trie, or for adding a symbol
+ * whose name is length bytes long, returning false once any limit has been
+ * exceeded.
+ */
+
+bool parse_budget_use_trie_node(struct parse_budget *__notnull budget);
+bool
+parse_budget_use_symbol(struct parse_budget *__notnull budget, uint64_t length);
+
+#endif /* PARSE_BUDGET_H */
@@ -9,6 +9,7 @@
 #ifndef PARSE_DSC_FOR_MAIN_H
 #define PARSE_DSC_FOR_MAIN_H
 
+#include "dsc_cache.h"
 #include "magic_buffer.h"
 #include "string_buffer.h"
 #include "tbd_for_main.h"
@@ -42,6 +43,19 @@ struct parse_dsc_for_main_args {
     bool print_paths : 1;
 
     struct string_buffer *export_trie_sb;
+
+    /*
+     * If provided, the dyld_shared_cache is retrieved from, and kept in, the
+     * cache instead of being unmapped after parsing. Not used while recursing.
+     */
+
+    struct dsc_cache *dsc_cache;
+
+    /*
+     * If provided, write-files are created relative to cached directories.
+     */
+
+    struct dir_cache *dir_cache;
     struct parse_dsc_for_main_options options;
 };
 
@@ -47,6 +47,12 @@ struct parse_macho_for_main_args {
     bool print_paths : 1;
 
     struct string_buffer *export_trie_sb;
+
+    /*
+     * If provided, write-files are created relative to cached directories.
+     */
+
+    struct dir_cache *dir_cache;
     struct parse_macho_for_main_options options;
 };
 
@@ -63,4 +69,15 @@ enum parse_macho_for_main_result
 parse_macho_file_for_main_while_recursing(
     struct parse_macho_for_main_args *__notnull args_ptr);
 
+/*
+ * Parse a mach-o file that is a member of an archive, and has been mapped or
+ * read into memory, with args_ptr->name storing the member's path.
+ */
+
+enum parse_macho_for_main_result
+parse_macho_map_for_main_while_recursing(
+    struct parse_macho_for_main_args *__notnull args_ptr,
+    const uint8_t *__notnull map,
+    uint64_t map_size);
+
 #endif /* PARSE_MACHO_FOR_MAIN_H */
@@ -0,0 +1,64 @@
+//
+//  include/parse_tbd_for_main.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef PARSE_TBD_FOR_MAIN_H
+#define PARSE_TBD_FOR_MAIN_H
+
+#include "magic_buffer.h"
+#include "tbd_for_main.h"
+
+struct parse_tbd_for_main_args {
+    int fd;
+
+    struct magic_buffer *magic_buffer;
+
+    struct tbd_for_main *tbd;
+    struct tbd_for_main *orig;
+
+    /*
+     * When not recursing, name will be NULL and dir_path will store the entire
+     * path.
+     */
+
+    const char *dir_path;
+    uint64_t dir_path_length;
+
+    const char *name;
+    uint64_t name_length;
+
+    FILE *combine_file;
+
+    bool dont_handle_non_tbd_error : 1;
+    bool print_paths : 1;
+
+    /*
+     * If provided, write-files are created relative to cached directories.
+     */
+
+    struct dir_cache *dir_cache;
+};
+
+enum parse_tbd_for_main_result {
+    E_PARSE_TBD_FOR_MAIN_OK,
+    E_PARSE_TBD_FOR_MAIN_NOT_A_TBD,
+    E_PARSE_TBD_FOR_MAIN_OTHER_ERROR
+};
+
+/*
+ * Read the first document of a .tbd file, and write it out again with the
+ * provided options, converting it to the provided tbd-version, if any.
+ */
+
+enum parse_tbd_for_main_result
+parse_tbd_file_for_main(struct parse_tbd_for_main_args args);
+
+enum parse_tbd_for_main_result
+parse_tbd_file_for_main_while_recursing(
+    struct parse_tbd_for_main_args *__notnull args_ptr);
+
+#endif /* PARSE_TBD_FOR_MAIN_H */
@@ -0,0 +1,56 @@
+//
+//  include/parse_zip_for_main.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef PARSE_ZIP_FOR_MAIN_H
+#define PARSE_ZIP_FOR_MAIN_H
+
+#include "dir_cache.h"
+#include "magic_buffer.h"
+#include "string_buffer.h"
+#include "tbd_for_main.h"
+
+struct parse_zip_for_main_args {
+    int fd;
+
+    struct magic_buffer *magic_buffer;
+    struct retained_user_info *retained;
+
+    struct tbd_for_main *tbd;
+    struct tbd_for_main *orig;
+
+    const char *path;
+    uint64_t path_length;
+
+    bool dont_handle_non_zip_error : 1;
+    bool print_paths : 1;
+
+    struct string_buffer *export_trie_sb;
+
+    /*
+     * If provided, write-files are created relative to cached directories.
+     */
+
+    struct dir_cache *dir_cache;
+};
+
+enum parse_zip_for_main_result {
+    E_PARSE_ZIP_FOR_MAIN_OK,
+    E_PARSE_ZIP_FOR_MAIN_NOT_A_ZIP,
+    E_PARSE_ZIP_FOR_MAIN_OTHER_ERROR
+};
+
+/*
+ * Parse every mach-o member of a zip archive (such as an .ipa file) directly
+ * from the archive, without extracting it. Each member's .tbd file is written
+ * to the member's path under the write-path.
+ */
+
+enum parse_zip_for_main_result
+parse_zip_for_main(const struct parse_zip_for_main_args *__notnull args);
+
+#endif /* PARSE_ZIP_FOR_MAIN_H */
@@ -0,0 +1,49 @@
+//
+//  include/serve.h
+//  tbd
+//
+//  Created by inoahdev on 2/4/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdint.h>
+
+/*
+ * --serve keeps tbd running and answers requests on either stdin/stdout or a
+ * unix domain socket, one request per line. Recently used dyld_shared_cache
+ * files are kept mapped and validated between requests in an LRU cache, so
+ * only the first request for a dyld_shared_cache pays to open it.
+ *
+ * Requests are made up of fields separated by tabs, or by spaces if the line
+ * contains no tabs:
+ *
+ *     extract <dsc-path> <image-path> [version] [output-path]
+ *     evict <dsc-path>
+ *     quit
+ *
+ * Every request is answered with a single line, either "ok", or "error"
+ * followed by a description. For "extract" requests without an output-path,
+ * "ok" is followed by the length of the .tbd, and the line is followed by
+ * exactly that many bytes of the .tbd.
+ */
+
+struct serve_options {
+    /*
+     * If NULL, requests are read from stdin, and replies written to stdout.
+     */
+
+    const char *socket_path;
+
+    /*
+     * If 0, DSC_CACHE_DEFAULT_MAX_COUNT is used.
+     */
+
+    uint64_t max_cache_count;
+};
+
+int serve_for_main(struct serve_options options);
+
+#endif /* SERVE_H */
@@ -0,0 +1,79 @@
+//
+//  include/string_pool.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "notnull.h"
+
+/*
+ * A string-pool interns strings for a whole run, so that equal strings found in
+ * different images (such as install-names, or symbols that many images
+ * reference) share the same storage, and can be compared by their pointers.
+ *
+ * Strings are stored in append-only blocks, and are only freed once the
+ * string-pool is destroyed.
+ *
+ * The string-pool is split into shards, each with its own lock and
+ * hash-table, so that threads interning different strings rarely wait on each
+ * other.
+ */
+
+#define STRING_POOL_SHARD_COUNT 64
+
+struct string_pool_entry {
+    const char *string;
+    uint64_t length;
+    uint64_t hash;
+};
+
+struct string_pool_block;
+struct string_pool_shard {
+    pthread_mutex_t lock;
+
+    /*
+     * An open-addressing hash-table of the shard's strings, where empty slots
+     * have a NULL string.
+     */
+
+    struct string_pool_entry *entries;
+    uint64_t entry_count;
+    uint64_t mask;
+
+    struct string_pool_block *blocks;
+};
+
+struct string_pool {
+    struct string_pool_shard shards[STRING_POOL_SHARD_COUNT];
+};
+
+enum string_pool_result {
+    E_STRING_POOL_OK,
+    E_STRING_POOL_ALLOC_FAIL
+};
+
+enum string_pool_result string_pool_create(struct string_pool *__notnull pool);
+
+/*
+ * Get the pooled, null-terminated copy of string, adding one if none exists
+ * yet.
+ *
+ * Returns NULL on allocation failure.
+ */
+
+const char *
+string_pool_intern(struct string_pool *__notnull pool,
+                   const char *__notnull string,
+                   uint64_t length);
+
+void string_pool_destroy(struct string_pool *__notnull pool);
+
+#endif /* STRING_POOL_H */
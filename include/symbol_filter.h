@@ -0,0 +1,75 @@
+//
+//  include/symbol_filter.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef SYMBOL_FILTER_H
+#define SYMBOL_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "array.h"
+#include "notnull.h"
+
+/*
+ * A symbol-pattern-set stores glob patterns (where '*' matches any run of
+ * characters, and '?' matches a single character) in a trie, keyed by each
+ * pattern's literal prefix, the part of the pattern before its first wildcard.
+ *
+ * Patterns of the form "<prefix>*" are marked on the prefix's node, so that
+ * they are matched without any glob matching. The remaining part of any other
+ * pattern with a wildcard is stored as a tail on its prefix's node, and is only
+ * glob-matched when a symbol reaches that node.
+ */
+
+struct symbol_pattern_set {
+    struct array nodes;
+    struct array tails;
+
+    uint64_t pattern_count;
+};
+
+/*
+ * A symbol passes a symbol-filter if it matches any include pattern (or no
+ * include patterns were provided), and doesn't match any exclude pattern.
+ */
+
+struct symbol_filter {
+    struct symbol_pattern_set include;
+    struct symbol_pattern_set exclude;
+};
+
+enum symbol_filter_result {
+    E_SYMBOL_FILTER_OK,
+    E_SYMBOL_FILTER_ALLOC_FAIL,
+    E_SYMBOL_FILTER_ARRAY_FAIL,
+    E_SYMBOL_FILTER_EMPTY_PATTERN
+};
+
+enum symbol_filter_result
+symbol_pattern_set_add(struct symbol_pattern_set *__notnull set,
+                       const char *__notnull pattern,
+                       uint64_t length);
+
+bool
+symbol_filter_matches(const struct symbol_filter *__notnull filter,
+                      const char *__notnull string,
+                      uint64_t length);
+
+/*
+ * Return whether any symbol starting with prefix (including prefix itself)
+ * could pass filter, so that export-trie walks can skip whole sub-trees.
+ */
+
+bool
+symbol_filter_may_match_prefix(const struct symbol_filter *__notnull filter,
+                               const char *__notnull prefix,
+                               uint64_t length);
+
+void symbol_filter_destroy(struct symbol_filter *__notnull filter);
+
+#endif /* SYMBOL_FILTER_H */
@@ -0,0 +1,113 @@
+//
+//  include/symbol_index.h
+//  tbd
+//
+//  Created by inoahdev on 2/9/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef SYMBOL_INDEX_H
+#define SYMBOL_INDEX_H
+
+#include <stdint.h>
+#include "notnull.h"
+
+/*
+ * A symbol-index maps every symbol exported by the images of one or more
+ * dyld_shared_cache files back to the images exporting it, so that a symbol
+ * can be looked up without parsing the dyld_shared_cache files again.
+ *
+ * The file is meant to be mapped and searched in place, and is laid out as:
+ *
+ *     struct symbol_index_header
+ *     struct symbol_index_image[image_count]
+ *     struct symbol_index_entry[entry_count]
+ *     char strings[strings_size]
+ *
+ * All integers are stored in the byte-order of the machine that created the
+ * index, and all offsets are relative to the start of the file, except for the
+ * string offsets, which are relative to the start of the string-pool. Every
+ * string in the string-pool is null-terminated.
+ *
+ * The entries are sorted by symbol-name, and then by image-index, and entries
+ * with the same symbol-name share a single string.
+ */
+
+#define SYMBOL_INDEX_MAGIC "tbdsymix"
+
+static const uint32_t SYMBOL_INDEX_VERSION = 1;
+
+struct symbol_index_header {
+    char magic[8];
+
+    uint32_t version;
+    uint32_t image_count;
+
+    uint64_t entry_count;
+
+    uint64_t images_offset;
+    uint64_t entries_offset;
+
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct symbol_index_image {
+    uint64_t path_offset;
+    uint32_t path_length;
+
+    /*
+     * The image's targets (in the form "<arch>-<platform>") are stored
+     * consecutively in the string-pool, starting at targets_offset.
+     */
+
+    uint32_t targets_count;
+    uint64_t targets_offset;
+};
+
+/*
+ * Images can have at most 64 targets recorded, as every entry describes the
+ * targets it is exported for with a bitmask of the indices of its image's
+ * targets.
+ */
+
+#define SYMBOL_INDEX_MAX_TARGET_COUNT 64
+
+struct symbol_index_entry {
+    uint64_t name_offset;
+    uint32_t name_length;
+    uint32_t image_index;
+
+    uint64_t targets;
+
+    /*
+     * type is an enum tbd_symbol_type, and meta_type an enum
+     * tbd_symbol_meta_type.
+     */
+
+    uint8_t type;
+    uint8_t meta_type;
+    uint8_t pad[6];
+};
+
+/*
+ * Parse every image of the dyld_shared_cache files at dsc_paths and write a
+ * symbol-index of their exports to index_path.
+ */
+
+int
+symbol_index_build_for_main(const char *__notnull index_path,
+                            const char *const *__notnull dsc_paths,
+                            uint64_t dsc_count);
+
+/*
+ * Print every image, along with the symbol's type and targets, exporting each
+ * of the provided symbols in the symbol-index at index_path.
+ */
+
+int
+symbol_index_lookup_for_main(const char *__notnull index_path,
+                             const char *const *__notnull symbols,
+                             uint64_t symbol_count);
+
+#endif /* SYMBOL_INDEX_H */
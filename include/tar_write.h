@@ -0,0 +1,40 @@
+//
+//  include/tar_write.h
+//  tbd
+//
+//  Created by inoahdev on 2/8/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef TAR_WRITE_H
+#define TAR_WRITE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "notnull.h"
+
+/*
+ * Write a regular-file member, named name, with the contents of data, to an
+ * uncompressed ustar archive.
+ *
+ * Names too long for the ustar header are stored in a preceding pax extended
+ * header.
+ */
+
+int
+tar_write_member(FILE *__notnull file,
+                 const char *__notnull name,
+                 uint64_t name_length,
+                 const void *data,
+                 uint64_t size,
+                 time_t mtime);
+
+/*
+ * Write the two empty blocks that mark the end of the archive.
+ */
+
+int tar_write_end(FILE *__notnull file);
+
+#endif /* TAR_WRITE_H */
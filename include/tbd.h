@@ -114,7 +114,14 @@ enum tbd_version {
     TBD_VERSION_V1,
     TBD_VERSION_V2,
     TBD_VERSION_V3,
-    TBD_VERSION_V4
+    TBD_VERSION_V4,
+
+    /*
+     * tbd-version v5 is JSON-based, but otherwise stores the same information
+     * as tbd-version v4, and so is parsed the same way.
+     */
+
+    TBD_VERSION_V5
 };
 
 const char *tbd_version_to_string(enum tbd_version version);
@@ -196,6 +203,20 @@ tbd_should_parse_flags(struct tbd_parse_options options,
 
 bool tbd_uses_archs(enum tbd_version version);
 
+struct tbd_create_options;
+
+/*
+ * Create a parse-plan from options, where any information that can't appear in
+ * a .tbd file of the provided version, or that write_options ignores, is also
+ * ignored, so that the parts of a mach-o file storing that information are
+ * skipped entirely instead of being parsed and then thrown away.
+ */
+
+struct tbd_parse_options
+tbd_create_parse_plan(struct tbd_parse_options options,
+                      struct tbd_create_options write_options,
+                      enum tbd_version version);
+
 struct tbd_create_info_flags {
     bool install_name_needs_quotes : 1;
     bool install_name_was_allocated : 1;
@@ -208,6 +229,25 @@ struct tbd_create_info_flags {
      */
 
     bool uses_full_targets : 1;
+
+    /*
+     * Indicate that the strings of symbols and metadata are not owned by the
+     * create-info, but borrowed from a buffer that outlives it (such as a
+     * mapped .tbd file), and should neither be copied when added, nor freed.
+     */
+
+    bool borrows_strings : 1;
+
+    /*
+     * Indicate that the create-info is version-neutral, storing everything
+     * needed to write out a .tbd of any tbd-version.
+     *
+     * Symbols and metadata are stored as they are for tbd-version v4, which
+     * loses no information, and are converted to the forms of older versions
+     * when written out with tbd_create_with_info_for_version().
+     */
+
+    bool version_neutral : 1;
 };
 
 struct tbd_create_info_fields {
@@ -231,13 +271,69 @@ struct tbd_create_info_fields {
     struct array uuids;
 };
 
+struct symbol_filter;
+struct parse_budget;
+struct string_pool;
+struct tbd_create_info;
+
+/*
+ * A symbol-sink is called with every symbol that passes the parse-options, as
+ * soon as the symbol is found.
+ *
+ * Symbols passed to a symbol-sink are not stored in fields.symbols, and so are
+ * neither sorted, deduplicated, nor copied. The string is only valid for the
+ * duration of the call.
+ */
+
+typedef bool
+(*tbd_ci_symbol_sink)(const struct tbd_create_info *__notnull info,
+                      const char *__notnull string,
+                      uint64_t length,
+                      uint64_t arch_index,
+                      enum tbd_symbol_type type,
+                      enum tbd_symbol_meta_type meta_type,
+                      void *sink_info);
+
 struct tbd_create_info {
     enum tbd_version version;
 
     struct tbd_create_info_fields fields;
     struct tbd_create_info_flags flags;
+
+    tbd_ci_symbol_sink symbol_sink;
+    void *sink_info;
+
+    /*
+     * If set, symbols found while parsing mach-o files are only added if their
+     * names pass the symbol-filter.
+     */
+
+    const struct symbol_filter *symbol_filter;
+
+    /*
+     * If set, parsing a mach-o file or dyld_shared_cache image fails once it
+     * uses up the parse-budget, which is restarted for every image.
+     */
+
+    struct parse_budget *budget;
+
+    /*
+     * If set, the strings of symbols and metadata are interned in the
+     * string-pool, which owns them, instead of being copied for this
+     * create-info alone. This is ignored if the create-info borrows its
+     * strings.
+     */
+
+    struct string_pool *string_pool;
 };
 
+/*
+ * Return whether info's symbol and metadata strings were allocated for info
+ * alone, and so should be freed along with it.
+ */
+
+bool tbd_ci_owns_strings(const struct tbd_create_info *__notnull info);
+
 enum tbd_ci_set_target_count_result {
     E_TBD_CI_SET_TARGET_COUNT_OK,
     E_TBD_CI_SET_TARGET_COUNT_ALLOC_FAIL
@@ -279,7 +375,6 @@ tbd_ci_add_metadata(struct tbd_create_info *__notnull info_in,
                     uint64_t length,
                     uint64_t arch_index,
                     enum tbd_metadata_type type,
-                    bool copy_string,
                     struct tbd_parse_options options);
 
 enum tbd_ci_add_data_result
@@ -311,6 +406,26 @@ tbd_ci_add_symbol_with_info_and_len(struct tbd_create_info *__notnull info_in,
                                     bool is_exported,
                                     struct tbd_parse_options options);
 
+/*
+ * Move symbols, which must be sorted the same way symbols are sorted while
+ * parsing, into info_in's symbols, combining the targets of any symbol found in
+ * both. symbols is left empty.
+ */
+
+enum tbd_ci_add_data_result
+tbd_ci_merge_sorted_symbols(struct tbd_create_info *__notnull info_in,
+                            struct array *__notnull symbols);
+
+/*
+ * Get the tbd-version whose rules should be followed while parsing into info.
+ *
+ * Version-neutral create-infos may be written out as any tbd-version, so
+ * TBD_VERSION_NONE is returned for them, under which everything is parsed and
+ * every check is carried out.
+ */
+
+enum tbd_version
+tbd_ci_get_parse_version(const struct tbd_create_info *__notnull info);
 
 enum tbd_platform
 tbd_ci_get_single_platform(const struct tbd_create_info *__notnull info);
@@ -335,6 +450,7 @@ tbd_ci_add_uuid(struct tbd_create_info *__notnull info_in,
 
 enum tbd_create_result {
     E_TBD_CREATE_OK,
+    E_TBD_CREATE_ALLOC_FAIL,
     E_TBD_CREATE_WRITE_FAIL
 };
 
@@ -374,6 +490,17 @@ tbd_create_with_info(const struct tbd_create_info *__notnull info,
                      FILE *__notnull file,
                      struct tbd_create_options options);
 
+/*
+ * Write out info as a .tbd of the provided tbd-version, which, unless info is
+ * version-neutral, must be info's own version.
+ */
+
+enum tbd_create_result
+tbd_create_with_info_for_version(const struct tbd_create_info *__notnull info,
+                                 enum tbd_version version,
+                                 FILE *__notnull file,
+                                 struct tbd_create_options options);
+
 void
 tbd_create_info_clear_fields_and_create_from(
     struct tbd_create_info *__notnull dst,
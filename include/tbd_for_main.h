@@ -11,10 +11,12 @@
 
 #include <stdint.h>
 
+#include "dir_cache.h"
 #include "dsc_image.h"
 #include "macho_file.h"
 #include "notnull.h"
 #include "request_user_input.h"
+#include "symbol_filter.h"
 #include "tbd.h"
 
 enum tbd_for_main_dsc_image_filter_type {
@@ -67,9 +69,19 @@ struct tbd_for_main_options {
 
     bool no_overwrite : 1;
     bool combine_tbds : 1;
+    bool archive_tbds : 1;
+
+    bool write_if_changed : 1;
 
     bool no_requests     : 1;
     bool ignore_warnings : 1;
+
+    /*
+     * Also extract every image the requested images of a dyld_shared_cache
+     * load or re-export, directly or indirectly.
+     */
+
+    bool dsc_with_dependencies : 1;
 };
 
 struct tbd_for_main_flags {
@@ -108,6 +120,8 @@ struct tbd_for_main_filetypes {
         struct {
             bool macho : 1;
             bool dyld_shared_cache : 1;
+            bool tbd : 1;
+            bool zip : 1;
             bool user_provided : 1;
         };
     };
@@ -143,6 +157,26 @@ struct tbd_for_main {
     struct array dsc_image_filters;
     struct array dsc_image_numbers;
 
+    /*
+     * Owned by tbd, and shared with info, which only reads it.
+     */
+
+    struct symbol_filter *symbol_filter;
+
+    /*
+     * Owned by tbd, and shared with info, which restarts it for every image.
+     */
+
+    struct parse_budget *budget;
+
+    /*
+     * When multiple tbd-versions are provided, info is version-neutral, and a
+     * .tbd is written out for every version whose bit, (1 << version), is set
+     * in versions.
+     */
+
+    uint32_t versions;
+
     enum tbd_platform platform;
     uint64_t dsc_filter_paths_count;
 
@@ -160,6 +194,14 @@ tbd_for_main_parse_option(int *__notnull const index_in,
 
 void tbd_for_main_handle_post_parse(struct tbd_for_main *__notnull tbd);
 
+/*
+ * Create the parse-plan for tbd, which, when multiple tbd-versions were
+ * provided, parses everything needed by any of the versions.
+ */
+
+struct tbd_parse_options
+tbd_for_main_create_parse_plan(const struct tbd_for_main *__notnull tbd);
+
 char *__notnull
 tbd_for_main_create_write_path(const struct tbd_for_main *__notnull tbd,
                                const char *__notnull file_name,
@@ -206,13 +248,24 @@ enum tbd_for_main_open_write_file_result {
     E_TBD_FOR_MAIN_OPEN_WRITE_FILE_PATH_ALREADY_EXISTS,
 };
 
+/*
+ * If dir_cache is provided, the file is created relative to a cached
+ * file-descriptor of its directory.
+ */
+
 enum tbd_for_main_open_write_file_result
 tbd_for_main_open_write_file_for_path(const struct tbd_for_main *__notnull tbd,
+                                      struct dir_cache *dir_cache,
                                       char *__notnull path,
                                       uint64_t path_length,
                                       FILE **__notnull file_out,
                                       char **__notnull terminator_out);
 
+/*
+ * When tbd->options.archive_tbds is set, the .tbd is written into the archive
+ * at file as a member named after write_path, relative to tbd->write_path.
+ */
+
 void
 tbd_for_main_write_to_file(const struct tbd_for_main *__notnull tbd,
                            char *__notnull write_path,
@@ -221,6 +274,14 @@ tbd_for_main_write_to_file(const struct tbd_for_main *__notnull tbd,
                            FILE *__notnull file,
                            bool print_paths);
 
+/*
+ * Finish the archive or combined .tbd file that all .tbds were written to.
+ */
+
+int
+tbd_for_main_write_combine_end(const struct tbd_for_main *__notnull tbd,
+                               FILE *__notnull file);
+
 void
 tbd_for_main_write_to_stdout(const struct tbd_for_main *__notnull tbd,
                              const char *__notnull input_path,
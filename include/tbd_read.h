@@ -0,0 +1,108 @@
+//
+//  include/tbd_read.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef TBD_READ_H
+#define TBD_READ_H
+
+#include "array.h"
+#include "magic_buffer.h"
+#include "notnull.h"
+#include "tbd.h"
+
+/*
+ * A .tbd file is read in a single pass over a private (and writable) mapping
+ * of the file, with every string tokenized in place, and terminated by a
+ * null-byte written over the character following it.
+ *
+ * Unless copy_strings is set, the symbols and metadata of a create-info read
+ * from a tbd_file borrow their strings from the mapping, and so the tbd_file
+ * must only be closed after the create-info has been cleared or destroyed.
+ */
+
+struct tbd_file {
+    char *map;
+    uint64_t size;
+
+    char *iter;
+    uint64_t line;
+
+    /*
+     * Strings created by the reader (such as objc class-names needing an
+     * underscore prefix) are owned by the tbd_file.
+     */
+
+    struct array strings;
+
+    /*
+     * The indices of the targets of the export-group being read.
+     */
+
+    struct array item_targets;
+
+    bool was_alloced : 1;
+    bool copy_strings : 1;
+};
+
+enum tbd_file_open_result {
+    E_TBD_FILE_OPEN_OK,
+
+    E_TBD_FILE_OPEN_ALLOC_FAIL,
+    E_TBD_FILE_OPEN_READ_FAIL,
+    E_TBD_FILE_OPEN_FSTAT_FAIL,
+    E_TBD_FILE_OPEN_MMAP_FAIL,
+
+    E_TBD_FILE_OPEN_NOT_A_TBD
+};
+
+enum tbd_file_open_result
+tbd_file_open(struct tbd_file *__notnull file,
+              struct magic_buffer *__notnull buffer,
+              int fd);
+
+enum tbd_file_read_result {
+    E_TBD_FILE_READ_OK,
+    E_TBD_FILE_READ_NO_MORE_DOCUMENTS,
+
+    E_TBD_FILE_READ_ALLOC_FAIL,
+    E_TBD_FILE_READ_ARRAY_FAIL,
+
+    E_TBD_FILE_READ_UNSUPPORTED_VERSION,
+    E_TBD_FILE_READ_INVALID_SYNTAX,
+
+    E_TBD_FILE_READ_INVALID_ARCH,
+    E_TBD_FILE_READ_INVALID_PLATFORM,
+    E_TBD_FILE_READ_INVALID_TARGET,
+    E_TBD_FILE_READ_INVALID_VERSION,
+    E_TBD_FILE_READ_INVALID_UUID,
+
+    E_TBD_FILE_READ_MISSING_TARGETS,
+    E_TBD_FILE_READ_MISSING_INSTALL_NAME,
+    E_TBD_FILE_READ_MISSING_PLATFORM,
+
+    E_TBD_FILE_READ_NON_UNIQUE_UUID,
+    E_TBD_FILE_READ_PARENT_UMBRELLA_CONFLICT
+};
+
+/*
+ * Read the next document of the .tbd file into info_in, which should not have
+ * any symbols or metadata.
+ *
+ * The information is converted to info_in's version, which, if not set, is
+ * set to the version of the document.
+ *
+ * On failure, file->line holds the line the failure was found on.
+ */
+
+enum tbd_file_read_result
+tbd_file_read_next(struct tbd_file *__notnull file,
+                   struct tbd_create_info *__notnull info_in,
+                   struct tbd_parse_options options);
+
+void tbd_file_close(struct tbd_file *__notnull file);
+
+#endif /* TBD_READ_H */
@@ -0,0 +1,24 @@
+//
+//  include/tbd_write_json.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef TBD_WRITE_JSON_H
+#define TBD_WRITE_JSON_H
+
+#include "notnull.h"
+#include "tbd.h"
+
+/*
+ * Write out info as a json-based tbd-version v5 document.
+ */
+
+int
+tbd_write_json(FILE *__notnull file,
+               const struct tbd_create_info *__notnull info,
+               struct tbd_create_options options);
+
+#endif /* TBD_WRITE_JSON_H */
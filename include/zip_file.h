@@ -0,0 +1,128 @@
+//
+//  include/zip_file.h
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#ifndef ZIP_FILE_H
+#define ZIP_FILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "notnull.h"
+
+/*
+ * A zip_file is a mapped zip archive (such as an .ipa file), whose members are
+ * found through its central-directory, without reading the rest of the file.
+ */
+
+struct zip_file {
+    const uint8_t *map;
+    uint64_t size;
+
+    uint64_t central_directory_offset;
+    uint64_t central_directory_size;
+
+    uint64_t member_count;
+};
+
+enum zip_file_open_result {
+    E_ZIP_FILE_OPEN_OK,
+    E_ZIP_FILE_OPEN_FSTAT_FAIL,
+    E_ZIP_FILE_OPEN_MMAP_FAIL,
+
+    E_ZIP_FILE_OPEN_NOT_A_ZIP,
+    E_ZIP_FILE_OPEN_MULTIPLE_DISKS,
+    E_ZIP_FILE_OPEN_INVALID_CENTRAL_DIRECTORY
+};
+
+enum zip_file_open_result zip_file_open(struct zip_file *__notnull zip, int fd);
+
+enum zip_file_compression {
+    ZIP_FILE_COMPRESSION_STORED = 0,
+    ZIP_FILE_COMPRESSION_DEFLATED = 8
+};
+
+struct zip_file_member {
+    const char *name;
+    uint64_t name_length;
+
+    uint16_t flags;
+    uint16_t compression;
+    uint32_t crc32;
+
+    uint64_t compressed_size;
+    uint64_t size;
+
+    uint64_t local_header_offset;
+};
+
+enum zip_file_member_result {
+    E_ZIP_FILE_MEMBER_OK,
+    E_ZIP_FILE_MEMBER_NO_MORE_MEMBERS,
+
+    E_ZIP_FILE_MEMBER_INVALID_ENTRY
+};
+
+/*
+ * Get the member of the central-directory entry at *offset_in, and advance
+ * *offset_in to the next entry. *offset_in should start at zero.
+ */
+
+enum zip_file_member_result
+zip_file_get_next_member(const struct zip_file *__notnull zip,
+                         uint64_t *__notnull offset_in,
+                         struct zip_file_member *__notnull member_out);
+
+static inline bool
+zip_file_member_is_directory(const struct zip_file_member *__notnull member) {
+    return (member->name_length != 0 &&
+            member->name[member->name_length - 1] == '/');
+}
+
+/*
+ * Stored members are provided in place within the zip-file's map, while
+ * deflated members are inflated into an allocated buffer.
+ */
+
+struct zip_file_data {
+    const uint8_t *data;
+    uint64_t size;
+
+    bool is_allocated : 1;
+};
+
+enum zip_file_read_result {
+    E_ZIP_FILE_READ_OK,
+    E_ZIP_FILE_READ_ALLOC_FAIL,
+
+    E_ZIP_FILE_READ_ENCRYPTED,
+    E_ZIP_FILE_READ_UNSUPPORTED_COMPRESSION,
+
+    E_ZIP_FILE_READ_INVALID_LOCAL_HEADER,
+    E_ZIP_FILE_READ_INVALID_DATA
+};
+
+/*
+ * Read the first size bytes of a member's data into buffer, inflating only
+ * as much as is needed, so a member's magic can be checked cheaply.
+ */
+
+enum zip_file_read_result
+zip_file_read_member_front(const struct zip_file *__notnull zip,
+                           const struct zip_file_member *__notnull member,
+                           void *__notnull buffer,
+                           uint64_t size);
+
+enum zip_file_read_result
+zip_file_read_member(const struct zip_file *__notnull zip,
+                     const struct zip_file_member *__notnull member,
+                     struct zip_file_data *__notnull data_out);
+
+void zip_file_data_destroy(struct zip_file_data *__notnull data);
+void zip_file_close(struct zip_file *__notnull zip);
+
+#endif /* ZIP_FILE_H */
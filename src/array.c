@@ -6,8 +6,11 @@
 //  Copyright © 2018 - 2020 inoahdev. All rights reserved.
 //
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "array.h"
 #include "likely.h"
@@ -542,15 +545,599 @@ array_copy(struct array *__notnull const array,
     return E_ARRAY_OK;
 }
 
+/*
+ * Arrays with less items than this are sorted and merged quickly enough on a
+ * single thread that splitting them up would only add overhead.
+ */
+
+#define PARALLEL_ARRAY_MIN_COUNT (1ull << 15)
+#define PARALLEL_ARRAY_MAX_THREADS 64
+
+/*
+ * Split every merge into at least this many segments for every thread, so
+ * that threads finishing early have more segments left to take.
+ */
+
+#define PARALLEL_ARRAY_SEGMENTS_PER_THREAD 4
+
+/*
+ * A merge-segment merges a run of left-items and a run of right-items into
+ * out. When uniquing, prev is the item merged right before this segment, if
+ * any, and out_count is the number of items left after dropping duplicates.
+ *
+ * Items at the front of a segment that are equal to prev are kept in out, and
+ * counted in dup_count, as prev is written out by another segment, and may
+ * only be passed to the duplicate-callback once every segment is merged.
+ */
+
+struct merge_segment {
+    const void *left;
+    uint64_t left_count;
+
+    const void *right;
+    uint64_t right_count;
+
+    const void *prev;
+
+    void *out;
+    uint64_t out_count;
+    uint64_t dup_count;
+};
+
+struct sort_run {
+    void *data;
+    uint64_t count;
+};
+
+struct array_job {
+    size_t item_size;
+    array_item_sort_comparator comparator;
+
+    void (*run_task)(const struct array_job *__notnull job, uint64_t index);
+
+    void *tasks;
+    uint64_t task_count;
+
+    bool unique : 1;
+
+    array_item_duplicate_callback duplicate;
+    void *cb_info;
+
+    /*
+     * The index of the next task no thread has taken yet.
+     */
+
+    atomic_uint_fast64_t next_task;
+};
+
+static uint64_t get_thread_count(void) {
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1) {
+        return 1;
+    }
+
+    if (count > PARALLEL_ARRAY_MAX_THREADS) {
+        return PARALLEL_ARRAY_MAX_THREADS;
+    }
+
+    return (uint64_t)count;
+}
+
+static void *run_tasks_on_thread(void *__notnull const arg) {
+    struct array_job *const job = (struct array_job *)arg;
+    do {
+        const uint64_t index = atomic_fetch_add(&job->next_task, 1);
+        if (index >= job->task_count) {
+            break;
+        }
+
+        job->run_task(job, index);
+    } while (true);
+
+    return NULL;
+}
+
+/*
+ * Run every task of job on up to thread_count threads, including the current
+ * one, so that a failure to create a thread only means less tasks are run at
+ * once.
+ */
+
+static void
+run_job(struct array_job *__notnull const job, const uint64_t thread_count) {
+    atomic_init(&job->next_task, 0);
+
+    uint64_t threads_count = thread_count - 1;
+    if (threads_count > job->task_count) {
+        threads_count = job->task_count;
+    }
+
+    pthread_t threads[PARALLEL_ARRAY_MAX_THREADS];
+    uint64_t created_count = 0;
+
+    for (; created_count != threads_count; created_count++) {
+        pthread_t *const thread = threads + created_count;
+        if (pthread_create(thread, NULL, run_tasks_on_thread, job) != 0) {
+            break;
+        }
+    }
+
+    run_tasks_on_thread(job);
+    for (uint64_t i = 0; i != created_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+static void
+sort_run(const struct array_job *__notnull const job, const uint64_t index) {
+    const struct sort_run *const run =
+        (const struct sort_run *)job->tasks + index;
+
+    qsort(run->data, run->count, job->item_size, job->comparator);
+}
+
+/*
+ * Merge a segment, taking left-items before right-items that are equal to
+ * them, so that merges are stable.
+ */
+
+static void
+merge_segment(const struct array_job *__notnull const job, const uint64_t index)
+{
+    struct merge_segment *const segment =
+        (struct merge_segment *)job->tasks + index;
+
+    const size_t item_size = job->item_size;
+    const array_item_sort_comparator comparator = job->comparator;
+
+    const void *left = segment->left;
+    const void *right = segment->right;
+
+    const void *const left_end = left + (segment->left_count * item_size);
+    const void *const right_end = right + (segment->right_count * item_size);
+
+    const void *prev = segment->prev;
+    void *out = segment->out;
+
+    uint64_t dup_count = 0;
+    bool at_front = true;
+
+    while (left != left_end || right != right_end) {
+        const void *item = NULL;
+        if (right == right_end) {
+            item = left;
+            left += item_size;
+        } else if (left == left_end || comparator(left, right) > 0) {
+            item = right;
+            right += item_size;
+        } else {
+            item = left;
+            left += item_size;
+        }
+
+        if (job->unique) {
+            if (prev != NULL && comparator(prev, item) == 0) {
+                if (at_front) {
+                    dup_count++;
+                } else {
+                    if (job->duplicate != NULL) {
+                        job->duplicate(out - item_size,
+                                       (void *)item,
+                                       job->cb_info);
+                    }
+
+                    continue;
+                }
+            } else {
+                at_front = false;
+            }
+
+            prev = item;
+        }
+
+        memcpy(out, item, item_size);
+        out += item_size;
+    }
+
+    segment->out_count = (uint64_t)(out - segment->out) / item_size;
+    segment->dup_count = dup_count;
+}
+
+/*
+ * Find how many left-items come before the item at merge_index of the stable
+ * merge of left and right.
+ */
+
+static uint64_t
+find_merge_split(const void *__notnull const left,
+                 const uint64_t left_count,
+                 const void *__notnull const right,
+                 const uint64_t right_count,
+                 const uint64_t merge_index,
+                 const size_t item_size,
+                 __notnull const array_item_sort_comparator comparator)
+{
+    uint64_t front = 0;
+    if (merge_index > right_count) {
+        front = merge_index - right_count;
+    }
+
+    uint64_t back = merge_index;
+    if (back > left_count) {
+        back = left_count;
+    }
+
+    while (front != back) {
+        const uint64_t middle = front + (back - front) / 2;
+
+        const void *const left_item = left + (middle * item_size);
+        const void *const right_item =
+            right + ((merge_index - middle - 1) * item_size);
+
+        if (comparator(left_item, right_item) <= 0) {
+            front = middle + 1;
+        } else {
+            back = middle;
+        }
+    }
+
+    return front;
+}
+
+/*
+ * Add the segments needed to merge left and right into out, each of about
+ * segment_size items.
+ */
+
+static void
+add_merge_segments(struct merge_segment *__notnull const segments,
+                   uint64_t *__notnull const count_in,
+                   const struct sort_run left,
+                   const struct sort_run right,
+                   void *__notnull const out,
+                   const uint64_t segment_size,
+                   const size_t item_size,
+                   __notnull const array_item_sort_comparator comparator)
+{
+    const uint64_t total = left.count + right.count;
+
+    uint64_t count = *count_in;
+    uint64_t left_index = 0;
+    uint64_t merge_index = 0;
+
+    while (merge_index != total) {
+        uint64_t next_merge_index = merge_index + segment_size;
+        if (next_merge_index > total) {
+            next_merge_index = total;
+        }
+
+        const uint64_t next_left_index =
+            find_merge_split(left.data,
+                             left.count,
+                             right.data,
+                             right.count,
+                             next_merge_index,
+                             item_size,
+                             comparator);
+
+        const uint64_t right_index = merge_index - left_index;
+        const uint64_t next_right_index = next_merge_index - next_left_index;
+
+        const void *const left_item = left.data + (left_index * item_size);
+        const void *const right_item = right.data + (right_index * item_size);
+
+        /*
+         * The item merged right before this segment is the later of the items
+         * before left_item and right_item, which is right's item for equal
+         * items.
+         */
+
+        const void *prev = NULL;
+        if (right_index == 0) {
+            if (left_index != 0) {
+                prev = left_item - item_size;
+            }
+        } else if (left_index == 0) {
+            prev = right_item - item_size;
+        } else if (comparator(left_item - item_size,
+                              right_item - item_size) <= 0)
+        {
+            prev = right_item - item_size;
+        } else {
+            prev = left_item - item_size;
+        }
+
+        segments[count] = (struct merge_segment){
+            .left = left_item,
+            .left_count = next_left_index - left_index,
+            .right = right_item,
+            .right_count = next_right_index - right_index,
+            .prev = prev,
+            .out = out + (merge_index * item_size)
+        };
+
+        count++;
+
+        left_index = next_left_index;
+        merge_index = next_merge_index;
+    }
+
+    *count_in = count;
+}
+
+static uint64_t
+get_segment_size(const uint64_t item_count, const uint64_t thread_count) {
+    const uint64_t segment_count =
+        thread_count * PARALLEL_ARRAY_SEGMENTS_PER_THREAD;
+
+    return (item_count + segment_count - 1) / segment_count;
+}
+
+/*
+ * Sort each of thread_count runs of the array on its own thread, and then merge
+ * pairs of runs, with each merge split into segments across threads, until
+ * only one run is left.
+ */
+
+static bool
+sort_in_parallel(struct array *__notnull const array,
+                 const size_t item_size,
+                 __notnull const array_item_sort_comparator comparator,
+                 const uint64_t thread_count)
+{
+    const uint64_t item_count = array->item_count;
+    const uint64_t segment_size = get_segment_size(item_count, thread_count);
+
+    /*
+     * Every pair of runs has at most one segment smaller than segment_size.
+     */
+
+    const uint64_t max_segment_count =
+        thread_count * (PARALLEL_ARRAY_SEGMENTS_PER_THREAD + 1);
+
+    void *const buffer = malloc(item_count * item_size);
+    if (buffer == NULL) {
+        return false;
+    }
+
+    struct merge_segment *const segments =
+        calloc(max_segment_count, sizeof(struct merge_segment));
+
+    if (segments == NULL) {
+        free(buffer);
+        return false;
+    }
+
+    struct sort_run runs[PARALLEL_ARRAY_MAX_THREADS] = {};
+
+    void *data = array->data;
+    void *other = buffer;
+
+    const uint64_t run_size = (item_count + thread_count - 1) / thread_count;
+    uint64_t run_count = 0;
+
+    for (uint64_t index = 0; index < item_count; index += run_size) {
+        uint64_t count = run_size;
+        if (count > item_count - index) {
+            count = item_count - index;
+        }
+
+        runs[run_count] = (struct sort_run){
+            .data = data + (index * item_size),
+            .count = count
+        };
+
+        run_count++;
+    }
+
+    struct array_job job = {
+        .item_size = item_size,
+        .comparator = comparator,
+        .run_task = sort_run,
+        .tasks = runs,
+        .task_count = run_count
+    };
+
+    run_job(&job, thread_count);
+
+    job.run_task = merge_segment;
+    job.tasks = segments;
+
+    while (run_count != 1) {
+        uint64_t segment_count = 0;
+        uint64_t merged_count = 0;
+
+        for (uint64_t i = 0; i < run_count; i += 2) {
+            const struct sort_run left = runs[i];
+            const uint64_t offset = (uint64_t)(left.data - data);
+
+            struct sort_run right = {
+                .data = left.data
+            };
+
+            if (i + 1 != run_count) {
+                right = runs[i + 1];
+            }
+
+            add_merge_segments(segments,
+                               &segment_count,
+                               left,
+                               right,
+                               other + offset,
+                               segment_size,
+                               item_size,
+                               comparator);
+
+            runs[merged_count] = (struct sort_run){
+                .data = other + offset,
+                .count = left.count + right.count
+            };
+
+            merged_count++;
+        }
+
+        job.task_count = segment_count;
+        run_job(&job, thread_count);
+
+        void *const tmp = data;
+
+        data = other;
+        other = tmp;
+
+        run_count = merged_count;
+    }
+
+    free(segments);
+
+    /*
+     * Keep whichever buffer ended up with the sorted items, trimming the
+     * array's capacity if it's the new buffer.
+     */
+
+    if (data == buffer) {
+        free(array->data);
+
+        array->data = buffer;
+        array->data_end = buffer + (item_count * item_size);
+        array->alloc_end = array->data_end;
+    } else {
+        free(buffer);
+    }
+
+    return true;
+}
+
 void
 array_sort_with_comparator(
     struct array *__notnull const array,
     const size_t item_size,
     __notnull const array_item_sort_comparator comparator)
 {
+    /*
+     * Fall back to sorting on a single thread if the parallel sort fails to
+     * allocate its buffers.
+     */
+
+    if (array->item_count >= PARALLEL_ARRAY_MIN_COUNT) {
+        const uint64_t thread_count = get_thread_count();
+        if (thread_count > 1 &&
+            sort_in_parallel(array, item_size, comparator, thread_count))
+        {
+            return;
+        }
+    }
+
     qsort(array->data, array->item_count, item_size, comparator);
 }
 
+enum array_result
+array_add_and_unique_items_from_sorted_array(
+    struct array *__notnull const array,
+    const size_t item_size,
+    const struct array *__notnull const src,
+    __notnull const array_item_sort_comparator comparator,
+    const array_item_duplicate_callback duplicate,
+    void *const cb_info)
+{
+    if (src->item_count == 0) {
+        return E_ARRAY_OK;
+    }
+
+    const uint64_t item_count = array->item_count + src->item_count;
+    const uint64_t byte_size = item_count * item_size;
+
+    uint64_t thread_count = 1;
+    if (item_count >= PARALLEL_ARRAY_MIN_COUNT) {
+        thread_count = get_thread_count();
+    }
+
+    void *const buffer = malloc(byte_size);
+    if (unlikely(buffer == NULL)) {
+        return E_ARRAY_ALLOC_FAIL;
+    }
+
+    struct merge_segment *const segments =
+        calloc(thread_count * PARALLEL_ARRAY_SEGMENTS_PER_THREAD + 1,
+               sizeof(struct merge_segment));
+
+    if (unlikely(segments == NULL)) {
+        free(buffer);
+        return E_ARRAY_ALLOC_FAIL;
+    }
+
+    const struct sort_run left = {
+        .data = array->data,
+        .count = array->item_count
+    };
+
+    const struct sort_run right = {
+        .data = src->data,
+        .count = src->item_count
+    };
+
+    uint64_t segment_count = 0;
+    add_merge_segments(segments,
+                       &segment_count,
+                       left,
+                       right,
+                       buffer,
+                       get_segment_size(item_count, thread_count),
+                       item_size,
+                       comparator);
+
+    struct array_job job = {
+        .item_size = item_size,
+        .comparator = comparator,
+        .run_task = merge_segment,
+        .tasks = segments,
+        .task_count = segment_count,
+        .unique = true,
+        .duplicate = duplicate,
+        .cb_info = cb_info
+    };
+
+    run_job(&job, thread_count);
+
+    /*
+     * Move every segment's unique items up against the previous segment's.
+     * Segments are in order, so no segment is moved over one not yet moved.
+     *
+     * The items at the front of a segment that are equal to the last item
+     * of the previous segment are dropped here, where that item is written.
+     */
+
+    void *end = buffer;
+    for (uint64_t i = 0; i != segment_count; i++) {
+        const struct merge_segment *const segment = segments + i;
+
+        void *out = segment->out;
+        const uint64_t dup_count = segment->dup_count;
+
+        if (duplicate != NULL) {
+            for (uint64_t j = 0; j != dup_count; j++) {
+                duplicate(end - item_size, out + (j * item_size), cb_info);
+            }
+        }
+
+        out += dup_count * item_size;
+
+        const uint64_t size = (segment->out_count - dup_count) * item_size;
+
+        memmove(end, out, size);
+        end += size;
+    }
+
+    free(segments);
+    free(array->data);
+
+    array->data = buffer;
+    array->data_end = end;
+    array->alloc_end = buffer + byte_size;
+    array->item_count = (uint64_t)(end - buffer) / item_size;
+
+    return E_ARRAY_OK;
+}
+
 void array_clear(struct array *__notnull const array) {
     array->data_end = array->data;
     array->item_count = 0;
@@ -0,0 +1,404 @@
+//
+//  src/dir_cache.c
+//  tbd
+//
+//  Created by inoahdev on 2/7/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "copy.h"
+#include "dir_cache.h"
+#include "likely.h"
+#include "our_io.h"
+#include "recursive.h"
+#include "util.h"
+
+static struct dir_cache_entry *
+find_entry(const struct dir_cache *__notnull const cache,
+           const char *__notnull const path,
+           const uint64_t path_length)
+{
+    struct dir_cache_entry *entry = cache->entries.data;
+    const struct dir_cache_entry *const end = cache->entries.data_end;
+
+    for (; entry != end; entry++) {
+        if (entry->path == NULL || entry->path_length != path_length) {
+            continue;
+        }
+
+        if (memcmp(entry->path, path, path_length) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void destroy_entry(struct dir_cache_entry *__notnull const entry) {
+    if (entry->path == NULL) {
+        return;
+    }
+
+    if (entry->fd >= 0) {
+        close(entry->fd);
+    }
+
+    free(entry->path);
+
+    entry->path = NULL;
+    entry->path_length = 0;
+
+    entry->fd = -1;
+    entry->last_used = 0;
+}
+
+/*
+ * Get an unused entry, evicting the least recently used entry if the cache is
+ * full.
+ */
+
+static struct dir_cache_entry *
+get_free_entry(struct dir_cache *__notnull const cache) {
+    struct dir_cache_entry *lru = cache->entries.data;
+    struct dir_cache_entry *entry = lru;
+
+    const struct dir_cache_entry *const end = cache->entries.data_end;
+    for (; entry != end; entry++) {
+        if (entry->path == NULL) {
+            return entry;
+        }
+
+        if (entry->last_used < lru->last_used) {
+            lru = entry;
+        }
+    }
+
+    if (cache->entries.item_count < cache->max_count) {
+        const struct dir_cache_entry empty = { .fd = -1 };
+        const enum array_result add_result =
+            array_add_item(&cache->entries, sizeof(empty), &empty, NULL);
+
+        if (add_result != E_ARRAY_OK) {
+            return NULL;
+        }
+
+        return array_get_back(&cache->entries, sizeof(empty));
+    }
+
+    destroy_entry(lru);
+    return lru;
+}
+
+/*
+ * Add the directory at path to the cache, taking ownership of fd (which may be
+ * -1 if the directory is only known to exist) even on failure.
+ */
+
+static struct dir_cache_entry *
+add_entry(struct dir_cache *__notnull const cache,
+          const char *__notnull const path,
+          const uint64_t path_length,
+          const int fd)
+{
+    struct dir_cache_entry *const entry = get_free_entry(cache);
+    if (entry == NULL) {
+        if (fd >= 0) {
+            close(fd);
+        }
+
+        return NULL;
+    }
+
+    char *const path_copy = alloc_and_copy(path, path_length);
+    if (path_copy == NULL) {
+        if (fd >= 0) {
+            close(fd);
+        }
+
+        return NULL;
+    }
+
+    entry->path = path_copy;
+    entry->path_length = path_length;
+
+    entry->fd = fd;
+    entry->last_used = cache->clock;
+
+    return entry;
+}
+
+/*
+ * Remember that the directory at path, up to end, exists, without opening it
+ * until a later file is written to it.
+ */
+
+static void
+add_known_dir(struct dir_cache *__notnull const cache,
+              const char *__notnull const path,
+              const char *__notnull const end)
+{
+    const uint64_t length = (uint64_t)(end - path);
+    struct dir_cache_entry *const entry = find_entry(cache, path, length);
+
+    if (entry != NULL) {
+        entry->last_used = cache->clock;
+        return;
+    }
+
+    add_entry(cache, path, length, -1);
+}
+
+static char *
+find_next_slash(char *__notnull const iter, const char *__notnull const end) {
+    char *slash = iter;
+    for (; slash != end; slash++) {
+        if (*slash == '/') {
+            break;
+        }
+    }
+
+    return slash;
+}
+
+/*
+ * Create every path-component of rel, up to end, relative to dir_fd, moving
+ * forwards from the first path-component.
+ *
+ * first_terminator_out is set to the end of the first directory created, to
+ * allow remove_file_r() to clean up afterwards.
+ */
+
+static int
+mkdirat_forward(const int dir_fd,
+                char *__notnull const rel,
+                char *__notnull const end,
+                const mode_t mode,
+                char **__notnull const first_terminator_out)
+{
+    bool created_dir = false;
+    char *slash = find_next_slash(rel, end);
+
+    do {
+        const char ch = *slash;
+        *slash = '\0';
+
+        const int ret = our_mkdirat(dir_fd, rel, mode);
+        *slash = ch;
+
+        if (ret != 0) {
+            if (errno != EEXIST) {
+                return 1;
+            }
+        } else if (!created_dir) {
+            *first_terminator_out = slash;
+            created_dir = true;
+        }
+
+        if (slash == end) {
+            break;
+        }
+
+        char *const next = (char *)get_end_of_slashes_with_end(slash, end);
+        slash = find_next_slash(next, end);
+    } while (true);
+
+    return 0;
+}
+
+/*
+ * Get the deepest directory in the hierarchy of path, up to and including the
+ * directory ending at dir_end, that we have cached, opening it if it was
+ * previously only known to exist.
+ */
+
+static struct dir_cache_entry *
+get_base_entry(struct dir_cache *__notnull const cache,
+               char *__notnull const path,
+               char *__notnull const dir_end,
+               char **__notnull const base_end_out)
+{
+    char *base_end = dir_end;
+    do {
+        const uint64_t base_length = (uint64_t)(base_end - path);
+        struct dir_cache_entry *const entry =
+            find_entry(cache, path, base_length);
+
+        if (entry != NULL) {
+            if (entry->fd >= 0) {
+                entry->last_used = cache->clock;
+                *base_end_out = base_end;
+
+                return entry;
+            }
+
+            const char ch = *base_end;
+            *base_end = '\0';
+
+            const int fd = our_open(path, O_RDONLY | O_DIRECTORY, 0);
+            *base_end = ch;
+
+            if (fd >= 0) {
+                entry->fd = fd;
+                entry->last_used = cache->clock;
+
+                *base_end_out = base_end;
+                return entry;
+            }
+
+            /*
+             * The directory is likely no longer there, so stop remembering it.
+             */
+
+            destroy_entry(entry);
+        }
+
+        base_end = (char *)find_last_row_of_slashes(path, base_end);
+    } while (base_end != NULL && base_end != path);
+
+    return NULL;
+}
+
+int
+dir_cache_open_file(struct dir_cache *__notnull const cache,
+                    char *__notnull const path,
+                    const uint64_t path_length,
+                    const int flags,
+                    const mode_t mode,
+                    const mode_t dir_mode,
+                    char **const first_terminator_out)
+{
+    const char *const end = path + path_length;
+    char *const last_slash = (char *)find_last_slash(path, end);
+
+    /*
+     * Files directly in the current or root directory have no directory worth
+     * caching.
+     */
+
+    if (last_slash == NULL) {
+        return our_open(path, O_CREAT | flags, mode);
+    }
+
+    char *const dir_end = (char *)get_front_of_slashes(path, last_slash);
+    if (dir_end == path) {
+        return our_open(path, O_CREAT | flags, mode);
+    }
+
+    if (cache->max_count == 0) {
+        cache->max_count = DIR_CACHE_DEFAULT_MAX_COUNT;
+    }
+
+    cache->clock += 1;
+
+    do {
+        char *base_end = NULL;
+        struct dir_cache_entry *const base =
+            get_base_entry(cache, path, dir_end, &base_end);
+
+        int base_fd = AT_FDCWD;
+        char *rel = path;
+
+        if (base != NULL) {
+            base_fd = base->fd;
+            rel = (char *)get_end_of_slashes_with_end(base_end, end);
+        }
+
+        int fd = our_openat(base_fd, rel, O_CREAT | flags, mode);
+        if (likely(fd >= 0)) {
+            add_known_dir(cache, path, dir_end);
+            return fd;
+        }
+
+        if (errno != ENOENT) {
+            return -1;
+        }
+
+        char *first_terminator = NULL;
+        if (base != NULL) {
+            /*
+             * If our cached directory is the file's directory, or if creating
+             * a directory in it fails with ENOENT, the cached directory was
+             * removed from under us (for example, by remove_file_r() after a
+             * failed write), so forget it and try again.
+             */
+
+            if (base_end == dir_end) {
+                destroy_entry(base);
+                continue;
+            }
+
+            if (mkdirat_forward(base_fd,
+                                rel,
+                                dir_end,
+                                dir_mode,
+                                &first_terminator))
+            {
+                if (errno == ENOENT) {
+                    destroy_entry(base);
+                    continue;
+                }
+
+                return -1;
+            }
+        } else {
+            const uint64_t dir_length = (uint64_t)(dir_end - path);
+            const char ch = *dir_end;
+
+            *dir_end = '\0';
+
+            const int ret =
+                mkdir_r(path, dir_length, dir_mode, &first_terminator);
+
+            *dir_end = ch;
+            if (ret != 0) {
+                return -1;
+            }
+        }
+
+        if (first_terminator_out != NULL) {
+            *first_terminator_out = first_terminator;
+        }
+
+        fd = our_openat(base_fd, rel, O_CREAT | flags, mode);
+        if (fd < 0) {
+            return -1;
+        }
+
+        /*
+         * The directory holding the first directory we created is likely to
+         * be shared with the next files written, so remember it as well.
+         */
+
+        if (first_terminator != NULL) {
+            const char *const parent_end =
+                find_last_row_of_slashes(path, first_terminator);
+
+            if (parent_end != NULL && parent_end > rel) {
+                add_known_dir(cache, path, parent_end);
+            }
+        }
+
+        add_known_dir(cache, path, dir_end);
+        return fd;
+    } while (true);
+}
+
+void dir_cache_destroy(struct dir_cache *__notnull const cache) {
+    struct dir_cache_entry *entry = cache->entries.data;
+    const struct dir_cache_entry *const end = cache->entries.data_end;
+
+    for (; entry != end; entry++) {
+        destroy_entry(entry);
+    }
+
+    array_destroy(&cache->entries);
+
+    cache->max_count = 0;
+    cache->clock = 0;
+}
@@ -10,10 +10,12 @@
 #include <errno.h>
 #include <fcntl.h>
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "copy.h"
 #include "dir_recurse.h"
 #include "our_io.h"
 #include "path.h"
@@ -30,6 +32,191 @@ get_name_length(struct dirent *__unused __notnull const entry,
 #endif
 }
 
+/*
+ * Regular files are opened, and their first pages are read ahead, up to
+ * READ_AHEAD_COUNT files before they're handed to the callback, so that parsing
+ * one file overlaps with reading in the next ones from slow storage.
+ *
+ * Files (and failures to open them) are still handed to the callbacks in the
+ * order they were found.
+ */
+
+#define READ_AHEAD_COUNT 8
+static const size_t READ_AHEAD_SIZE = 64 * 1024;
+
+struct pending_file {
+    char *dir_path;
+    uint64_t dir_path_length;
+
+    /*
+     * fd is -1 if the file couldn't be opened, with open_errno holding why.
+     */
+
+    int fd;
+    int open_errno;
+
+    uint64_t name_length;
+    struct dirent entry;
+};
+
+struct read_ahead {
+    struct pending_file files[READ_AHEAD_COUNT];
+
+    uint32_t front;
+    uint32_t count;
+
+    int file_open_flags;
+    void *callback_info;
+
+    dir_recurse_callback callback;
+    dir_recurse_fail_callback fail_callback;
+
+    bool should_exit : 1;
+};
+
+static void handle_front_file(struct read_ahead *__notnull const read_ahead) {
+    struct pending_file *const file = read_ahead->files + read_ahead->front;
+
+    read_ahead->front = (read_ahead->front + 1) % READ_AHEAD_COUNT;
+    read_ahead->count -= 1;
+
+    if (read_ahead->should_exit) {
+        if (file->fd >= 0) {
+            close(file->fd);
+        }
+
+        free(file->dir_path);
+        return;
+    }
+
+    bool should_continue = false;
+    if (file->fd < 0) {
+        errno = file->open_errno;
+        should_continue =
+            read_ahead->fail_callback(file->dir_path,
+                                      file->dir_path_length,
+                                      E_DIR_RECURSE_FAILED_TO_OPEN_FILE,
+                                      &file->entry,
+                                      read_ahead->callback_info);
+    } else {
+        should_continue =
+            read_ahead->callback(file->dir_path,
+                                 file->dir_path_length,
+                                 file->fd,
+                                 &file->entry,
+                                 file->name_length,
+                                 read_ahead->callback_info);
+    }
+
+    if (!should_continue) {
+        read_ahead->should_exit = true;
+    }
+
+    free(file->dir_path);
+}
+
+/*
+ * Hand all pending files to the callbacks, which is done before any failure
+ * found while walking is handed to the fail-callback, to keep the order.
+ *
+ * Once the walk has been stopped, pending files are closed instead.
+ */
+
+static bool handle_all_files(struct read_ahead *__notnull const read_ahead) {
+    while (read_ahead->count != 0) {
+        handle_front_file(read_ahead);
+    }
+
+    return !read_ahead->should_exit;
+}
+
+static bool
+call_fail_callback(struct read_ahead *__notnull const read_ahead,
+                   const char *__notnull const dir_path,
+                   const uint64_t dir_path_length,
+                   const enum dir_recurse_fail_result result,
+                   struct dirent *const entry)
+{
+    const int fail_errno = errno;
+    if (!handle_all_files(read_ahead)) {
+        return false;
+    }
+
+    errno = fail_errno;
+
+    const bool should_continue =
+        read_ahead->fail_callback(dir_path,
+                                  dir_path_length,
+                                  result,
+                                  entry,
+                                  read_ahead->callback_info);
+
+    if (!should_continue) {
+        read_ahead->should_exit = true;
+    }
+
+    return should_continue;
+}
+
+static bool
+add_file(struct read_ahead *__notnull const read_ahead,
+         const char *__notnull const dir_path,
+         const uint64_t dir_path_length,
+         const int dir_fd,
+         struct dirent *__notnull const entry)
+{
+    if (read_ahead->count == READ_AHEAD_COUNT) {
+        handle_front_file(read_ahead);
+        if (read_ahead->should_exit) {
+            return false;
+        }
+    }
+
+    /*
+     * The directory's path may be freed before the file is handed to the
+     * callback, so each file keeps its own copy.
+     */
+
+    char *const path_copy = alloc_and_copy(dir_path, dir_path_length);
+    if (path_copy == NULL) {
+        return call_fail_callback(read_ahead,
+                                  dir_path,
+                                  dir_path_length,
+                                  E_DIR_RECURSE_FAILED_TO_ALLOC_PATH,
+                                  entry);
+    }
+
+    const uint32_t index =
+        (read_ahead->front + read_ahead->count) % READ_AHEAD_COUNT;
+
+    struct pending_file *const file = read_ahead->files + index;
+    const char *const name = entry->d_name;
+
+    file->dir_path = path_copy;
+    file->dir_path_length = dir_path_length;
+    file->name_length = get_name_length(entry, name);
+
+    /*
+     * The dirent returned by readdir() may be shorter than a struct dirent, so
+     * only copy up to the end of its name.
+     */
+
+    const size_t entry_size =
+        offsetof(struct dirent, d_name) + file->name_length + 1;
+
+    memcpy(&file->entry, entry, entry_size);
+
+    file->fd = our_openat(dir_fd, name, read_ahead->file_open_flags, 0);
+    file->open_errno = errno;
+
+    if (file->fd >= 0) {
+        our_read_ahead(file->fd, 0, READ_AHEAD_SIZE);
+    }
+
+    read_ahead->count += 1;
+    return true;
+}
+
 enum dir_recurse_result
 dir_recurse(const char *__notnull const path,
             const uint64_t path_length,
@@ -49,76 +236,54 @@ dir_recurse(const char *__notnull const path,
         return E_DIR_RECURSE_FAILED_TO_OPEN;
     }
 
-    /*
-     * Set errno to zero so we can distinguish later when readdir() has failed,
-     * and when there are no more files and sub-directories left.
-     */
-
-    errno = 0;
+    struct read_ahead read_ahead = {
+        .file_open_flags = open_flags,
+        .callback_info = callback_info,
+        .callback = callback,
+        .fail_callback = fail_callback
+    };
 
     do {
-        struct dirent *entry = our_readdir(dir);
-        if (entry == NULL) {
-            closedir(dir);
+        /*
+         * Set errno to zero so we can distinguish later when readdir() has
+         * failed, and when there are no more files and sub-directories left.
+         */
+
+        errno = 0;
 
+        struct dirent *const entry = our_readdir(dir);
+        if (entry == NULL) {
             if (errno != 0) {
-                fail_callback(path,
-                              path_length,
-                              E_DIR_RECURSE_FAILED_TO_READ_ENTRY,
-                              entry,
-                              callback_info);
+                call_fail_callback(&read_ahead,
+                                   path,
+                                   path_length,
+                                   E_DIR_RECURSE_FAILED_TO_READ_ENTRY,
+                                   entry);
             }
 
-            return E_DIR_RECURSE_OK;
+            break;
         }
 
         if (entry->d_type != DT_REG) {
             continue;
         }
 
-        const char *const entry_name = entry->d_name;
-        const int fd = our_openat(dir_fd, entry_name, open_flags);
-
-        if (fd < 0) {
-            const bool should_continue =
-                fail_callback(path,
-                              path_length,
-                              E_DIR_RECURSE_FAILED_TO_OPEN_FILE,
-                              entry,
-                              callback_info);
-
-            if (!should_continue) {
-                break;
-            }
-
-            break;
-        }
-
-        const uint64_t name_len = get_name_length(entry, entry_name);
-        if (!callback(path, path_length, fd, entry, name_len, callback_info)) {
+        if (!add_file(&read_ahead, path, path_length, dir_fd, entry)) {
             break;
         }
-
-        /*
-         * We need to reset errno as we don't know what happened while in
-         * callback().
-         */
-
-        errno = 0;
     } while (true);
 
+    handle_all_files(&read_ahead);
+
     closedir(dir);
     return E_DIR_RECURSE_OK;
 }
 
 static enum dir_recurse_result
-recurse_dir_fd(const int dir_fd,
+recurse_dir_fd(struct read_ahead *__notnull const read_ahead,
+               const int dir_fd,
                const char *__notnull const dir_path,
-               const uint64_t dir_path_length,
-               const int file_open_flags,
-               void *const callback_info,
-               __notnull const dir_recurse_callback callback,
-               __notnull const dir_recurse_fail_callback fail_callback)
+               const uint64_t dir_path_length)
 {
     DIR *const dir = our_fdopendir(dir_fd);
     if (dir == NULL) {
@@ -129,22 +294,20 @@ recurse_dir_fd(const int dir_fd,
     bool found_dot = false;
     bool found_two_dot = false;
 
-    errno = 0;
-
     do {
-        struct dirent *entry = our_readdir(dir);
-        if (entry == NULL) {
-            closedir(dir);
+        errno = 0;
 
+        struct dirent *const entry = our_readdir(dir);
+        if (entry == NULL) {
             if (errno != 0) {
-                fail_callback(dir_path,
-                              dir_path_length,
-                              E_DIR_RECURSE_FAILED_TO_READ_ENTRY,
-                              entry,
-                              callback_info);
+                call_fail_callback(read_ahead,
+                                   dir_path,
+                                   dir_path_length,
+                                   E_DIR_RECURSE_FAILED_TO_READ_ENTRY,
+                                   entry);
             }
 
-            return E_DIR_RECURSE_OK;
+            break;
         }
 
         bool should_exit = false;
@@ -177,11 +340,11 @@ recurse_dir_fd(const int dir_fd,
 
                 if (subdir_path == NULL) {
                     const bool should_continue =
-                        fail_callback(dir_path,
-                                      dir_path_length,
-                                      E_DIR_RECURSE_FAILED_TO_ALLOC_PATH,
-                                      entry,
-                                      callback_info);
+                        call_fail_callback(read_ahead,
+                                           dir_path,
+                                           dir_path_length,
+                                           E_DIR_RECURSE_FAILED_TO_ALLOC_PATH,
+                                           entry);
 
                     if (!should_continue) {
                         should_exit = true;
@@ -191,15 +354,15 @@ recurse_dir_fd(const int dir_fd,
                 }
 
                 const int subdir_fd =
-                    our_openat(dir_fd, name, O_RDONLY | O_DIRECTORY);
+                    our_openat(dir_fd, name, O_RDONLY | O_DIRECTORY, 0);
 
                 if (subdir_fd < 0) {
                     const bool should_continue =
-                        fail_callback(subdir_path,
-                                      subdir_path_length,
-                                      E_DIR_RECURSE_FAILED_TO_OPEN_SUBDIR,
-                                      entry,
-                                      callback_info);
+                        call_fail_callback(read_ahead,
+                                           subdir_path,
+                                           subdir_path_length,
+                                           E_DIR_RECURSE_FAILED_TO_OPEN_SUBDIR,
+                                           entry);
 
                     if (!should_continue) {
                         should_exit = true;
@@ -210,63 +373,36 @@ recurse_dir_fd(const int dir_fd,
                 }
 
                 const enum dir_recurse_result recurse_subdir_result =
-                    recurse_dir_fd(subdir_fd,
+                    recurse_dir_fd(read_ahead,
+                                   subdir_fd,
                                    subdir_path,
-                                   subdir_path_length,
-                                   file_open_flags,
-                                   callback_info,
-                                   callback,
-                                   fail_callback);
+                                   subdir_path_length);
 
                 free(subdir_path);
 
                 if (recurse_subdir_result != E_DIR_RECURSE_OK) {
+                    closedir(dir);
                     return recurse_subdir_result;
                 }
 
+                if (read_ahead->should_exit) {
+                    should_exit = true;
+                }
+
                 break;
             }
 
-            case DT_REG: {
-                const char *const name = entry->d_name;
-                const int fd = our_openat(dir_fd, name, file_open_flags);
-
-                if (fd < 0) {
-                    const bool should_continue =
-                        fail_callback(dir_path,
-                                      dir_path_length,
-                                      E_DIR_RECURSE_FAILED_TO_OPEN_FILE,
-                                      entry,
-                                      callback_info);
-
-                    if (!should_continue) {
-                        should_exit = true;
-                    }
-
-                    break;
-                }
-
-                const uint64_t name_length = get_name_length(entry, name);
-                const bool callback_result =
-                    callback(dir_path,
-                             dir_path_length,
-                             fd,
-                             entry,
-                             name_length,
-                             callback_info);
-
-                if (!callback_result) {
+            case DT_REG:
+                if (!add_file(read_ahead,
+                              dir_path,
+                              dir_path_length,
+                              dir_fd,
+                              entry))
+                {
                     should_exit = true;
                 }
 
-                /*
-                 * We need to reset errno as we don't know what happened while
-                 * in callback().
-                 */
-
-                errno = 0;
                 break;
-            }
 
             default:
                 continue;
@@ -277,6 +413,7 @@ recurse_dir_fd(const int dir_fd,
         }
     } while (true);
 
+    closedir(dir);
     return E_DIR_RECURSE_OK;
 }
 
@@ -294,14 +431,17 @@ dir_recurse_with_subdirs(
         return E_DIR_RECURSE_FAILED_TO_OPEN;
     }
 
+    struct read_ahead read_ahead = {
+        .file_open_flags = file_open_flags,
+        .callback_info = callback_info,
+        .callback = callback,
+        .fail_callback = fail_callback
+    };
+
     const enum dir_recurse_result recurse_dir_result =
-        recurse_dir_fd(dir_fd,
-                       dir_path,
-                       dir_path_length,
-                       file_open_flags,
-                       callback_info,
-                       callback,
-                       fail_callback);
+        recurse_dir_fd(&read_ahead, dir_fd, dir_path, dir_path_length);
+
+    handle_all_files(&read_ahead);
 
     if (recurse_dir_result != E_DIR_RECURSE_OK) {
         return recurse_dir_result;
@@ -309,4 +449,3 @@ dir_recurse_with_subdirs(
 
     return E_DIR_RECURSE_OK;
 }
-
@@ -0,0 +1,217 @@
+//
+//  src/dsc_cache.c
+//  tbd
+//
+//  Created by inoahdev on 2/6/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <sys/stat.h>
+#include "dsc_cache.h"
+
+static bool
+entry_matches(const struct dsc_cache_entry *__notnull const entry,
+              const struct stat *__notnull const sbuf)
+{
+    if (!entry->in_use) {
+        return false;
+    }
+
+    if (entry->dev != sbuf->st_dev || entry->ino != sbuf->st_ino) {
+        return false;
+    }
+
+    if (entry->size != sbuf->st_size || entry->mtime != sbuf->st_mtime) {
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+options_match(const struct dyld_shared_cache_parse_options lhs,
+              const struct dyld_shared_cache_parse_options rhs)
+{
+    if (lhs.zero_image_pads != rhs.zero_image_pads) {
+        return false;
+    }
+
+    if (lhs.verify_image_path_offsets != rhs.verify_image_path_offsets) {
+        return false;
+    }
+
+    return true;
+}
+
+static void destroy_entry(struct dsc_cache_entry *__notnull const entry) {
+    if (!entry->in_use) {
+        return;
+    }
+
+    dyld_shared_cache_info_destroy(&entry->info);
+
+    entry->in_use = false;
+    entry->last_used = 0;
+}
+
+static void
+zero_image_pads(struct dyld_shared_cache_info *__notnull const info) {
+    struct dyld_cache_image_info *image = info->images;
+    const struct dyld_cache_image_info *const end = image + info->images_count;
+
+    for (; image != end; image++) {
+        image->pad = 0;
+    }
+}
+
+/*
+ * Get an unused entry, evicting the least recently used entry if the cache is
+ * full.
+ */
+
+static struct dsc_cache_entry *
+get_free_entry(struct dsc_cache *__notnull const cache) {
+    const uint64_t count = cache->entries.item_count;
+    if (count < cache->max_count) {
+        const struct dsc_cache_entry empty = {};
+        const enum array_result add_result =
+            array_add_item(&cache->entries, sizeof(empty), &empty, NULL);
+
+        if (add_result != E_ARRAY_OK) {
+            return NULL;
+        }
+
+        return array_get_back(&cache->entries, sizeof(empty));
+    }
+
+    struct dsc_cache_entry *lru = cache->entries.data;
+    struct dsc_cache_entry *entry = lru + 1;
+
+    const struct dsc_cache_entry *const end = cache->entries.data_end;
+    for (; entry != end; entry++) {
+        if (entry->last_used < lru->last_used) {
+            lru = entry;
+        }
+    }
+
+    destroy_entry(lru);
+    return lru;
+}
+
+enum dyld_shared_cache_parse_result
+dsc_cache_get_for_fd(struct dsc_cache *__notnull const cache,
+                     const int fd,
+                     const char magic[16],
+                     const struct dyld_shared_cache_parse_options options,
+                     struct dyld_shared_cache_info **__notnull const info_out)
+{
+    struct stat sbuf = {};
+    if (fstat(fd, &sbuf) != 0) {
+        return E_DYLD_SHARED_CACHE_PARSE_FSTAT_FAIL;
+    }
+
+    if (cache->max_count == 0) {
+        cache->max_count = DSC_CACHE_DEFAULT_MAX_COUNT;
+    }
+
+    cache->clock += 1;
+
+    struct dsc_cache_entry *slot = NULL;
+    struct dsc_cache_entry *entry = cache->entries.data;
+
+    const struct dsc_cache_entry *const end = cache->entries.data_end;
+    for (; entry != end; entry++) {
+        if (!entry_matches(entry, &sbuf)) {
+            continue;
+        }
+
+        if (options_match(entry->options, options)) {
+            if (options.zero_image_pads) {
+                zero_image_pads(&entry->info);
+            }
+
+            entry->last_used = cache->clock;
+            *info_out = &entry->info;
+
+            return E_DYLD_SHARED_CACHE_PARSE_OK;
+        }
+
+        /*
+         * The dyld_shared_cache was parsed with different options, so parse
+         * it again in its own slot.
+         */
+
+        destroy_entry(entry);
+        slot = entry;
+
+        break;
+    }
+
+    /*
+     * Parse the dyld_shared_cache before evicting another one, so a file that
+     * fails to parse doesn't throw out a useful mapping.
+     */
+
+    struct dyld_shared_cache_info info = {};
+    const enum dyld_shared_cache_parse_result parse_result =
+        dyld_shared_cache_parse_from_file(&info, fd, magic, options);
+
+    if (parse_result != E_DYLD_SHARED_CACHE_PARSE_OK) {
+        return parse_result;
+    }
+
+    if (slot == NULL) {
+        slot = get_free_entry(cache);
+        if (slot == NULL) {
+            dyld_shared_cache_info_destroy(&info);
+            return E_DYLD_SHARED_CACHE_PARSE_ALLOC_FAIL;
+        }
+    }
+
+    slot->dev = sbuf.st_dev;
+    slot->ino = sbuf.st_ino;
+    slot->size = sbuf.st_size;
+    slot->mtime = sbuf.st_mtime;
+
+    slot->last_used = cache->clock;
+    slot->in_use = true;
+
+    slot->options = options;
+    slot->info = info;
+
+    *info_out = &slot->info;
+    return E_DYLD_SHARED_CACHE_PARSE_OK;
+}
+
+void
+dsc_cache_evict_path(struct dsc_cache *__notnull const cache,
+                     const char *__notnull const path)
+{
+    struct stat sbuf = {};
+    if (stat(path, &sbuf) != 0) {
+        return;
+    }
+
+    struct dsc_cache_entry *entry = cache->entries.data;
+    const struct dsc_cache_entry *const end = cache->entries.data_end;
+
+    for (; entry != end; entry++) {
+        if (entry_matches(entry, &sbuf)) {
+            destroy_entry(entry);
+        }
+    }
+}
+
+void dsc_cache_destroy(struct dsc_cache *__notnull const cache) {
+    struct dsc_cache_entry *entry = cache->entries.data;
+    const struct dsc_cache_entry *const end = cache->entries.data_end;
+
+    for (; entry != end; entry++) {
+        destroy_entry(entry);
+    }
+
+    array_destroy(&cache->entries);
+
+    cache->max_count = 0;
+    cache->clock = 0;
+}
@@ -0,0 +1,214 @@
+//
+//  src/dsc_closure.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsc_closure.h"
+#include "dsc_image.h"
+
+static uint64_t hash_string(const char *__notnull string, uint64_t length) {
+    /*
+     * FNV-1a
+     */
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint64_t i = 0; i != length; i++) {
+        hash ^= (uint8_t)string[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static inline const char *
+get_image_path(const struct dyld_shared_cache_info *__notnull const dsc_info,
+               const struct dyld_cache_image_info *__notnull const image)
+{
+    return (const char *)(dsc_info->map + image->pathFileOffset);
+}
+
+static bool create_slots(struct dsc_closure *__notnull const closure) {
+    const struct dyld_shared_cache_info *const dsc_info = closure->dsc_info;
+    const uint32_t images_count = dsc_info->images_count;
+
+    /*
+     * The table is kept at most half full to keep probe-sequences short.
+     */
+
+    uint64_t capacity = 16;
+    while (capacity < (uint64_t)images_count * 2) {
+        capacity *= 2;
+    }
+
+    closure->slots = calloc(capacity, sizeof(uint64_t));
+    if (closure->slots == NULL) {
+        return false;
+    }
+
+    closure->path_lengths = calloc(images_count, sizeof(uint64_t));
+    if (closure->path_lengths == NULL) {
+        return false;
+    }
+
+    closure->mask = capacity - 1;
+
+    for (uint32_t i = 0; i != images_count; i++) {
+        const char *const path = get_image_path(dsc_info, dsc_info->images + i);
+        const uint64_t length = strlen(path);
+
+        closure->path_lengths[i] = length;
+
+        /*
+         * Only the first image with a given install-name is kept.
+         */
+
+        uint64_t slot = hash_string(path, length) & closure->mask;
+        bool is_duplicate = false;
+
+        for (; closure->slots[slot] != 0; slot = (slot + 1) & closure->mask) {
+            const uint64_t index = closure->slots[slot] - 1;
+            if (closure->path_lengths[index] != length) {
+                continue;
+            }
+
+            const char *const other =
+                get_image_path(dsc_info, dsc_info->images + index);
+
+            if (memcmp(other, path, length) == 0) {
+                is_duplicate = true;
+                break;
+            }
+        }
+
+        if (!is_duplicate) {
+            closure->slots[slot] = (uint64_t)i + 1;
+        }
+    }
+
+    return true;
+}
+
+static bool
+find_image(const struct dsc_closure *__notnull const closure,
+           const char *__notnull const install_name,
+           const uint64_t length,
+           uint32_t *__notnull const index_out)
+{
+    const struct dyld_shared_cache_info *const dsc_info = closure->dsc_info;
+
+    uint64_t slot = hash_string(install_name, length) & closure->mask;
+    for (; closure->slots[slot] != 0; slot = (slot + 1) & closure->mask) {
+        const uint64_t index = closure->slots[slot] - 1;
+        if (closure->path_lengths[index] != length) {
+            continue;
+        }
+
+        const char *const path =
+            get_image_path(dsc_info, dsc_info->images + index);
+
+        if (memcmp(path, install_name, length) == 0) {
+            *index_out = (uint32_t)index;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void
+mark_image(struct dsc_closure *__notnull const closure, const uint32_t index) {
+    struct dyld_cache_image_info *const image =
+        closure->dsc_info->images + index;
+
+    if (image->pad & closure->pad_flag) {
+        return;
+    }
+
+    image->pad |= closure->pad_flag;
+
+    closure->queue[closure->queue_count] = index;
+    closure->queue_count += 1;
+}
+
+static void
+mark_dependency(const char *__notnull const name,
+                const uint64_t length,
+                void *const cb_info)
+{
+    struct dsc_closure *const closure = (struct dsc_closure *)cb_info;
+
+    uint32_t index = 0;
+    if (find_image(closure, name, length, &index)) {
+        mark_image(closure, index);
+    }
+}
+
+enum dsc_closure_result
+dsc_closure_create(struct dsc_closure *__notnull const closure,
+                   struct dyld_shared_cache_info *__notnull const dsc_info,
+                   const uint32_t pad_flag)
+{
+    *closure = (struct dsc_closure){
+        .dsc_info = dsc_info,
+        .pad_flag = pad_flag
+    };
+
+    /*
+     * Every image is added to the queue at most once, so the queue never holds
+     * more than every image.
+     */
+
+    closure->queue = calloc(dsc_info->images_count + 1, sizeof(uint32_t));
+    if (closure->queue == NULL || !create_slots(closure)) {
+        dsc_closure_destroy(closure);
+        return E_DSC_CLOSURE_ALLOC_FAIL;
+    }
+
+    return E_DSC_CLOSURE_OK;
+}
+
+void
+dsc_closure_mark_dependencies(struct dsc_closure *__notnull const closure,
+                              const uint32_t index)
+{
+    struct dyld_shared_cache_info *const dsc_info = closure->dsc_info;
+    closure->queue_count = 0;
+
+    /*
+     * Images whose load-commands can't be read are still kept in the closure,
+     * and have their errors printed once they're parsed.
+     */
+
+    dsc_image_iterate_dependencies(dsc_info,
+                                   dsc_info->images + index,
+                                   mark_dependency,
+                                   closure);
+
+    for (uint32_t i = 0; i != closure->queue_count; i++) {
+        const struct dyld_cache_image_info *const image =
+            dsc_info->images + closure->queue[i];
+
+        dsc_image_iterate_dependencies(dsc_info,
+                                       image,
+                                       mark_dependency,
+                                       closure);
+    }
+}
+
+void dsc_closure_destroy(struct dsc_closure *__notnull const closure) {
+    free(closure->slots);
+    free(closure->path_lengths);
+    free(closure->queue);
+
+    closure->slots = NULL;
+    closure->path_lengths = NULL;
+    closure->queue = NULL;
+    closure->queue_count = 0;
+}
@@ -6,6 +6,7 @@
 //  Copyright © 2018 - 2020 inoahdev. All rights reserved.
 //
 
+#include <string.h>
 #include <unistd.h>
 
 #include "mach-o/loader.h"
@@ -15,6 +16,8 @@
 #include "macho_file_parse_load_commands.h"
 #include "macho_file_parse_export_trie.h"
 #include "macho_file_parse_symtab.h"
+#include "parse_budget.h"
+#include "swap.h"
 #include "tbd.h"
 #include "unused.h"
 
@@ -134,6 +137,9 @@ translate_macho_file_parse_result(const enum macho_file_parse_result result) {
 
         case E_MACHO_FILE_PARSE_CREATE_TARGET_LIST_FAIL:
             return E_DSC_IMAGE_PARSE_CREATE_TARGET_LIST_FAIL;
+
+        case E_MACHO_FILE_PARSE_BUDGET_EXCEEDED:
+            return E_DSC_IMAGE_PARSE_BUDGET_EXCEEDED;
     }
 
     return E_DSC_IMAGE_PARSE_OK;
@@ -213,6 +219,10 @@ dsc_image_parse(struct tbd_create_info *__notnull const info_in,
                 const struct tbd_parse_options tbd_options,
                 __unused const struct dsc_image_parse_options options)
 {
+    if (info_in->budget != NULL) {
+        parse_budget_start(info_in->budget);
+    }
+
     uint64_t max_image_size = 0;
     const uint64_t file_offset =
         get_offset_from_addr(dsc_info, image->address, &max_image_size);
@@ -340,6 +350,10 @@ dsc_image_parse(struct tbd_create_info *__notnull const info_in,
         return translate_macho_file_parse_result(parse_load_commands_result);
     }
 
+    if (tbd_options.ignore_exports && tbd_options.ignore_undefineds) {
+        return E_DSC_IMAGE_PARSE_OK;
+    }
+
     bool parsed_dyld_info = false;
     bool parse_symtab = true;
 
@@ -357,6 +371,7 @@ dsc_image_parse(struct tbd_create_info *__notnull const info_in,
 
                 .is_64 = is_64,
                 .is_big_endian = is_big_endian,
+                .parallel = macho_options.parallel_export_trie,
 
                 .export_off = lc_info.export_off,
                 .export_size = lc_info.export_size,
@@ -423,3 +438,286 @@ dsc_image_parse(struct tbd_create_info *__notnull const info_in,
 
     return E_DSC_IMAGE_PARSE_OK;
 }
+
+/*
+ * Locate the load-commands of an image, reading only its mach-o header.
+ */
+
+struct dsc_image_load_commands {
+    const uint8_t *begin;
+
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+
+    bool is_big_endian : 1;
+};
+
+static enum dsc_image_parse_result
+find_load_commands(struct dyld_shared_cache_info *__notnull const dsc_info,
+                   const struct dyld_cache_image_info *__notnull const image,
+                   struct dsc_image_load_commands *__notnull const lcs_out)
+{
+    uint64_t max_image_size = 0;
+    const uint64_t file_offset =
+        get_offset_from_addr(dsc_info, image->address, &max_image_size);
+
+    if (file_offset == 0) {
+        return E_DSC_IMAGE_PARSE_NO_MAPPING;
+    }
+
+    if (max_image_size < sizeof(struct mach_header)) {
+        return E_DSC_IMAGE_PARSE_SIZE_TOO_SMALL;
+    }
+
+    const uint8_t *const map = dsc_info->map;
+    const struct mach_header *const header =
+        (const struct mach_header *)(map + file_offset);
+
+    const uint32_t magic = header->magic;
+
+    const bool is_64 = (magic == MH_MAGIC_64 || magic == MH_CIGAM_64);
+    const bool is_big_endian = (magic == MH_CIGAM || magic == MH_CIGAM_64);
+
+    if (!is_64 && magic != MH_MAGIC && magic != MH_CIGAM) {
+        const bool is_fat =
+            magic == FAT_MAGIC || magic == FAT_MAGIC_64 ||
+            magic == FAT_CIGAM || magic == FAT_CIGAM_64;
+
+        if (is_fat) {
+            return E_DSC_IMAGE_PARSE_FAT_NOT_SUPPORTED;
+        }
+
+        return E_DSC_IMAGE_PARSE_NOT_A_MACHO;
+    }
+
+    const uint32_t header_size =
+        (is_64) ? sizeof(struct mach_header_64) : sizeof(struct mach_header);
+
+    if (max_image_size < header_size) {
+        return E_DSC_IMAGE_PARSE_SIZE_TOO_SMALL;
+    }
+
+    uint32_t ncmds = header->ncmds;
+    uint32_t sizeofcmds = header->sizeofcmds;
+
+    if (is_big_endian) {
+        ncmds = swap_uint32(ncmds);
+        sizeofcmds = swap_uint32(sizeofcmds);
+    }
+
+    if (ncmds == 0) {
+        return E_DSC_IMAGE_PARSE_NO_LOAD_COMMANDS;
+    }
+
+    if (sizeofcmds > max_image_size - header_size) {
+        return E_DSC_IMAGE_PARSE_LOAD_COMMANDS_AREA_TOO_SMALL;
+    }
+
+    lcs_out->begin = (const uint8_t *)header + header_size;
+    lcs_out->ncmds = ncmds;
+    lcs_out->sizeofcmds = sizeofcmds;
+    lcs_out->is_big_endian = is_big_endian;
+
+    return E_DSC_IMAGE_PARSE_OK;
+}
+
+/*
+ * Read the load-command at lc_iter, verifying that it fits in the space left.
+ */
+
+static enum dsc_image_parse_result
+get_load_command(const uint8_t *__notnull const lc_iter,
+                 const uint32_t size_left,
+                 const bool is_big_endian,
+                 struct load_command *__notnull const load_cmd_out)
+{
+    if (size_left < sizeof(struct load_command)) {
+        return E_DSC_IMAGE_PARSE_INVALID_LOAD_COMMAND;
+    }
+
+    struct load_command load_cmd = *(const struct load_command *)lc_iter;
+    if (is_big_endian) {
+        load_cmd.cmd = swap_uint32(load_cmd.cmd);
+        load_cmd.cmdsize = swap_uint32(load_cmd.cmdsize);
+    }
+
+    if (load_cmd.cmdsize < sizeof(struct load_command)) {
+        return E_DSC_IMAGE_PARSE_INVALID_LOAD_COMMAND;
+    }
+
+    if (size_left < load_cmd.cmdsize) {
+        return E_DSC_IMAGE_PARSE_INVALID_LOAD_COMMAND;
+    }
+
+    *load_cmd_out = load_cmd;
+    return E_DSC_IMAGE_PARSE_OK;
+}
+
+enum dsc_image_parse_result
+dsc_image_find_export_trie(
+    struct dyld_shared_cache_info *__notnull const dsc_info,
+    struct dyld_cache_image_info *__notnull const image,
+    struct range *__notnull const range_out)
+{
+    struct dsc_image_load_commands lcs = {};
+    const enum dsc_image_parse_result find_lcs_result =
+        find_load_commands(dsc_info, image, &lcs);
+
+    if (find_lcs_result != E_DSC_IMAGE_PARSE_OK) {
+        return find_lcs_result;
+    }
+
+    const bool is_big_endian = lcs.is_big_endian;
+
+    const uint8_t *lc_iter = lcs.begin;
+    uint32_t size_left = lcs.sizeofcmds;
+
+    uint32_t export_off = 0;
+    uint32_t export_size = 0;
+
+    for (uint32_t i = 0; i != lcs.ncmds; i++) {
+        struct load_command load_cmd = {};
+        const enum dsc_image_parse_result get_lc_result =
+            get_load_command(lc_iter, size_left, is_big_endian, &load_cmd);
+
+        if (get_lc_result != E_DSC_IMAGE_PARSE_OK) {
+            return get_lc_result;
+        }
+
+        switch (load_cmd.cmd) {
+            case LC_DYLD_INFO:
+            case LC_DYLD_INFO_ONLY: {
+                if (load_cmd.cmdsize < sizeof(struct dyld_info_command)) {
+                    return E_DSC_IMAGE_PARSE_INVALID_LOAD_COMMAND;
+                }
+
+                const struct dyld_info_command *const dyld_info =
+                    (const struct dyld_info_command *)lc_iter;
+
+                export_off = dyld_info->export_off;
+                export_size = dyld_info->export_size;
+
+                break;
+            }
+
+            case LC_DYLD_EXPORTS_TRIE: {
+                if (load_cmd.cmdsize < sizeof(struct linkedit_data_command)) {
+                    return E_DSC_IMAGE_PARSE_INVALID_LOAD_COMMAND;
+                }
+
+                const struct linkedit_data_command *const linkedit_data =
+                    (const struct linkedit_data_command *)lc_iter;
+
+                export_off = linkedit_data->dataoff;
+                export_size = linkedit_data->datasize;
+
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        if (export_size != 0) {
+            break;
+        }
+
+        lc_iter += load_cmd.cmdsize;
+        size_left -= load_cmd.cmdsize;
+    }
+
+    if (is_big_endian) {
+        export_off = swap_uint32(export_off);
+        export_size = swap_uint32(export_size);
+    }
+
+    if (export_off == 0 || export_size == 0) {
+        return E_DSC_IMAGE_PARSE_NO_EXPORT_TRIE;
+    }
+
+    const struct range export_range = {
+        .begin = export_off,
+        .end = (uint64_t)export_off + export_size
+    };
+
+    if (!range_contains_other(dsc_info->available_range, export_range)) {
+        return E_DSC_IMAGE_PARSE_INVALID_EXPORTS_TRIE;
+    }
+
+    *range_out = export_range;
+    return E_DSC_IMAGE_PARSE_OK;
+}
+
+enum dsc_image_parse_result
+dsc_image_iterate_dependencies(
+    struct dyld_shared_cache_info *__notnull const dsc_info,
+    const struct dyld_cache_image_info *__notnull const image,
+    const dsc_image_dependency_callback callback,
+    void *const cb_info)
+{
+    struct dsc_image_load_commands lcs = {};
+    const enum dsc_image_parse_result find_lcs_result =
+        find_load_commands(dsc_info, image, &lcs);
+
+    if (find_lcs_result != E_DSC_IMAGE_PARSE_OK) {
+        return find_lcs_result;
+    }
+
+    const bool is_big_endian = lcs.is_big_endian;
+
+    const uint8_t *lc_iter = lcs.begin;
+    uint32_t size_left = lcs.sizeofcmds;
+
+    for (uint32_t i = 0; i != lcs.ncmds; i++) {
+        struct load_command load_cmd = {};
+        const enum dsc_image_parse_result get_lc_result =
+            get_load_command(lc_iter, size_left, is_big_endian, &load_cmd);
+
+        if (get_lc_result != E_DSC_IMAGE_PARSE_OK) {
+            return get_lc_result;
+        }
+
+        switch (load_cmd.cmd) {
+            case LC_LOAD_DYLIB:
+            case LC_LOAD_WEAK_DYLIB:
+            case LC_LOAD_UPWARD_DYLIB:
+            case LC_REEXPORT_DYLIB: {
+                if (load_cmd.cmdsize < sizeof(struct dylib_command)) {
+                    return E_DSC_IMAGE_PARSE_INVALID_LOAD_COMMAND;
+                }
+
+                const struct dylib_command *const dylib_cmd =
+                    (const struct dylib_command *)lc_iter;
+
+                uint32_t name_offset = dylib_cmd->dylib.name.offset;
+                if (is_big_endian) {
+                    name_offset = swap_uint32(name_offset);
+                }
+
+                if (name_offset < sizeof(struct dylib_command) ||
+                    name_offset >= load_cmd.cmdsize)
+                {
+                    return E_DSC_IMAGE_PARSE_INVALID_LOAD_COMMAND;
+                }
+
+                const char *const name = (const char *)lc_iter + name_offset;
+                const uint64_t max_length = load_cmd.cmdsize - name_offset;
+                const uint64_t length = strnlen(name, max_length);
+
+                if (length != 0) {
+                    callback(name, length, cb_info);
+                }
+
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        lc_iter += load_cmd.cmdsize;
+        size_left -= load_cmd.cmdsize;
+    }
+
+    return E_DSC_IMAGE_PARSE_OK;
+}
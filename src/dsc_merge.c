@@ -0,0 +1,730 @@
+//
+//  src/dsc_merge.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "copy.h"
+#include "dsc_merge.h"
+#include "libtbd.h"
+#include "path.h"
+#include "recursive.h"
+#include "yaml.h"
+
+/*
+ * Every input stays mapped until all images have been merged, as the parsed
+ * create-infos may point into its map.
+ */
+
+struct merge_input {
+    struct dyld_shared_cache_info dsc_info;
+    const char *path;
+};
+
+/*
+ * A group is every image (at most one per input) with the same install-name.
+ * Its images are stored in merge_state's members array, at the group's index
+ * times the input-count, with NULL for the inputs the image isn't found in.
+ */
+
+struct merge_group {
+    const char *install_name;
+    uint64_t length;
+};
+
+struct merge_state {
+    struct libtbd_context ctx;
+    struct libtbd_options options;
+
+    struct merge_input *inputs;
+    uint64_t input_count;
+
+    struct array groups;
+    struct array members;
+
+    /*
+     * An open-addressing hash-table of the groups, keyed by their
+     * install-names, storing the index of each group plus one, so that zero
+     * marks an empty slot.
+     */
+
+    uint64_t *slots;
+    uint64_t mask;
+
+    /*
+     * The create-infos each image of a group is parsed into, one per input,
+     * before being merged into a single create-info.
+     */
+
+    struct tbd_create_info *parsed;
+    struct tbd_create_info merged;
+};
+
+static uint64_t hash_string(const char *__notnull string, uint64_t length) {
+    /*
+     * FNV-1a
+     */
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint64_t i = 0; i != length; i++) {
+        hash ^= (uint8_t)string[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static bool
+create_slots(struct merge_state *__notnull const state,
+             const uint64_t image_count)
+{
+    /*
+     * Every image may end up in its own group, and the table is kept at most
+     * half full to keep probe-sequences short.
+     */
+
+    uint64_t capacity = 16;
+    while (capacity < image_count * 2) {
+        capacity *= 2;
+    }
+
+    state->slots = calloc(capacity, sizeof(uint64_t));
+    if (state->slots == NULL) {
+        return false;
+    }
+
+    state->mask = capacity - 1;
+    return true;
+}
+
+/*
+ * Return the index of the group for install_name, adding a new group if none
+ * exists yet, or UINT64_MAX on allocation failure.
+ */
+
+static uint64_t
+find_or_add_group(struct merge_state *__notnull const state,
+                  const char *__notnull const install_name,
+                  const uint64_t length)
+{
+    const struct merge_group *const groups = state->groups.data;
+
+    uint64_t slot = hash_string(install_name, length) & state->mask;
+    for (; state->slots[slot] != 0; slot = (slot + 1) & state->mask) {
+        const uint64_t index = state->slots[slot] - 1;
+        const struct merge_group *const group = groups + index;
+
+        if (group->length != length) {
+            continue;
+        }
+
+        if (memcmp(group->install_name, install_name, length) == 0) {
+            return index;
+        }
+    }
+
+    const struct merge_group group = {
+        .install_name = install_name,
+        .length = length
+    };
+
+    const enum array_result add_group_result =
+        array_add_item(&state->groups, sizeof(group), &group, NULL);
+
+    if (add_group_result != E_ARRAY_OK) {
+        return UINT64_MAX;
+    }
+
+    for (uint64_t i = 0; i != state->input_count; i++) {
+        const struct dyld_cache_image_info *const image = NULL;
+        const enum array_result add_member_result =
+            array_add_item(&state->members, sizeof(image), &image, NULL);
+
+        if (add_member_result != E_ARRAY_OK) {
+            return UINT64_MAX;
+        }
+    }
+
+    const uint64_t index = state->groups.item_count - 1;
+    state->slots[slot] = index + 1;
+
+    return index;
+}
+
+static bool
+open_inputs(struct merge_state *__notnull const state,
+            const char *const *__notnull const dsc_paths)
+{
+    uint64_t image_count = 0;
+    for (uint64_t i = 0; i != state->input_count; i++) {
+        struct merge_input *const input = state->inputs + i;
+        const enum libtbd_result open_result =
+            libtbd_open_dsc(&input->dsc_info,
+                            dsc_paths[i],
+                            state->options,
+                            NULL);
+
+        if (open_result != E_LIBTBD_OK) {
+            fprintf(stderr,
+                    "Failed to open dyld_shared_cache file at path: %s\n",
+                    dsc_paths[i]);
+
+            return false;
+        }
+
+        input->path = dsc_paths[i];
+        image_count += input->dsc_info.images_count;
+    }
+
+    if (!create_slots(state, image_count)) {
+        fputs("Failed to allocate memory\n", stderr);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Pair the images of every input by their install-names, without parsing any
+ * of them.
+ */
+
+static bool group_images(struct merge_state *__notnull const state) {
+    for (uint64_t i = 0; i != state->input_count; i++) {
+        struct merge_input *const input = state->inputs + i;
+        const struct dyld_shared_cache_info *const dsc_info = &input->dsc_info;
+
+        for (uint32_t j = 0; j != dsc_info->images_count; j++) {
+            struct dyld_cache_image_info *const image = dsc_info->images + j;
+            const char *const install_name =
+                (const char *)(dsc_info->map + image->pathFileOffset);
+
+            const uint64_t length = strlen(install_name);
+            const uint64_t index =
+                find_or_add_group(state, install_name, length);
+
+            if (index == UINT64_MAX) {
+                fputs("Failed to allocate memory\n", stderr);
+                return false;
+            }
+
+            struct dyld_cache_image_info **const members = state->members.data;
+            struct dyld_cache_image_info **const member =
+                members + (index * state->input_count) + i;
+
+            /*
+             * Only the first of any images sharing an install-name within a
+             * single dyld_shared_cache is used.
+             */
+
+            if (*member == NULL) {
+                *member = image;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool
+has_target_at_index(const struct tbd_create_info *__notnull const info,
+                    const struct bit_list targets,
+                    const uint64_t index)
+{
+    if (info->flags.uses_full_targets) {
+        return true;
+    }
+
+    return bit_list_get_for_index(targets, index) != 0;
+}
+
+static uint64_t
+find_target_index(const struct target_list *__notnull const list,
+                  const struct arch_info *__notnull const arch,
+                  const enum tbd_platform platform)
+{
+    for (uint64_t i = 0; i != list->set_count; i++) {
+        const struct arch_info *list_arch = NULL;
+        enum tbd_platform list_platform = TBD_PLATFORM_NONE;
+
+        target_list_get_target(list, i, &list_arch, &list_platform);
+        if (list_arch == arch && list_platform == platform) {
+            return i;
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+static enum tbd_ci_add_data_result
+merge_metadata(struct tbd_create_info *__notnull const merged,
+               const struct tbd_metadata_info *__notnull const info,
+               const uint64_t index,
+               const struct tbd_parse_options options)
+{
+    switch (info->type) {
+        case TBD_METADATA_TYPE_NONE:
+            break;
+
+        case TBD_METADATA_TYPE_PARENT_UMBRELLA: {
+            const enum tbd_ci_add_parent_umbrella_result add_umbrella_result =
+                tbd_ci_add_parent_umbrella(merged,
+                                           info->string,
+                                           info->length,
+                                           index,
+                                           options);
+
+            switch (add_umbrella_result) {
+                case E_TBD_CI_ADD_PARENT_UMBRELLA_OK:
+                case E_TBD_CI_ADD_PARENT_UMBRELLA_INFO_CONFLICT:
+                    break;
+
+                case E_TBD_CI_ADD_PARENT_UMBRELLA_ALLOC_FAIL:
+                    return E_TBD_CI_ADD_DATA_ALLOC_FAIL;
+
+                case E_TBD_CI_ADD_PARENT_UMBRELLA_ARRAY_FAIL:
+                    return E_TBD_CI_ADD_DATA_ARRAY_FAIL;
+            }
+
+            break;
+        }
+
+        /*
+         * Clients and re-exports are stored as metadata on tbd-version v4, and
+         * are added back as such through their symbol-types.
+         */
+
+        case TBD_METADATA_TYPE_CLIENT:
+            return tbd_ci_add_symbol_with_type(merged,
+                                               info->string,
+                                               info->length,
+                                               index,
+                                               TBD_SYMBOL_TYPE_CLIENT,
+                                               TBD_SYMBOL_META_TYPE_EXPORT,
+                                               options);
+
+        case TBD_METADATA_TYPE_REEXPORTED_LIBRARY:
+            return tbd_ci_add_symbol_with_type(merged,
+                                               info->string,
+                                               info->length,
+                                               index,
+                                               TBD_SYMBOL_TYPE_REEXPORT,
+                                               TBD_SYMBOL_META_TYPE_EXPORT,
+                                               options);
+    }
+
+    return E_TBD_CI_ADD_DATA_OK;
+}
+
+/*
+ * Merge the symbols, metadata, and uuids of a parsed image into merged, which
+ * must already have every target of the image.
+ */
+
+static enum tbd_ci_add_data_result
+merge_image(struct tbd_create_info *__notnull const merged,
+            const struct tbd_create_info *__notnull const info,
+            const struct tbd_parse_options options)
+{
+    const struct target_list *const targets = &info->fields.targets;
+    for (uint64_t i = 0; i != targets->set_count; i++) {
+        const struct arch_info *arch = NULL;
+        enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+        target_list_get_target(targets, i, &arch, &platform);
+
+        const uint64_t index =
+            find_target_index(&merged->fields.targets, arch, platform);
+
+        const struct tbd_symbol_info *symbol = info->fields.symbols.data;
+        const struct tbd_symbol_info *const symbols_end =
+            info->fields.symbols.data_end;
+
+        for (; symbol != symbols_end; symbol++) {
+            if (!has_target_at_index(info, symbol->targets, i)) {
+                continue;
+            }
+
+            const enum tbd_ci_add_data_result add_symbol_result =
+                tbd_ci_add_symbol_with_type(merged,
+                                            symbol->string,
+                                            symbol->length,
+                                            index,
+                                            symbol->type,
+                                            symbol->meta_type,
+                                            options);
+
+            if (add_symbol_result != E_TBD_CI_ADD_DATA_OK) {
+                return add_symbol_result;
+            }
+        }
+
+        const struct tbd_metadata_info *metadata = info->fields.metadata.data;
+        const struct tbd_metadata_info *const metadata_end =
+            info->fields.metadata.data_end;
+
+        for (; metadata != metadata_end; metadata++) {
+            if (!has_target_at_index(info, metadata->targets, i)) {
+                continue;
+            }
+
+            const enum tbd_ci_add_data_result add_metadata_result =
+                merge_metadata(merged, metadata, index, options);
+
+            if (add_metadata_result != E_TBD_CI_ADD_DATA_OK) {
+                return add_metadata_result;
+            }
+        }
+    }
+
+    const struct tbd_uuid_info *uuid = info->fields.uuids.data;
+    const struct tbd_uuid_info *const uuids_end = info->fields.uuids.data_end;
+
+    for (; uuid != uuids_end; uuid++) {
+        const struct arch_info *const arch =
+            (const struct arch_info *)(uuid->target & TARGET_ARCH_INFO_MASK);
+
+        const enum tbd_platform platform =
+            (const enum tbd_platform)(uuid->target & TARGET_PLATFORM_MASK);
+
+        /*
+         * Different images sharing a target (and so a uuid-slot) are allowed,
+         * with only the first image's uuid being kept.
+         */
+
+        const enum tbd_ci_add_uuid_result add_uuid_result =
+            tbd_ci_add_uuid(merged, arch, platform, uuid->uuid);
+
+        if (add_uuid_result == E_TBD_CI_ADD_UUID_ARRAY_FAIL) {
+            return E_TBD_CI_ADD_DATA_ARRAY_FAIL;
+        }
+    }
+
+    return E_TBD_CI_ADD_DATA_OK;
+}
+
+/*
+ * Add every target of the group's images, and take the remaining fields from
+ * the group's first image, before any symbols or metadata are added, as their
+ * target bit-lists are created with the target-count at the time.
+ */
+
+static bool
+setup_merged_info(struct tbd_create_info *__notnull const merged,
+                  const struct tbd_create_info *__notnull const first,
+                  const struct tbd_create_info *__notnull const parsed,
+                  const uint64_t count,
+                  const bool *__notnull const was_parsed)
+{
+    struct target_list *const merged_targets = &merged->fields.targets;
+    for (uint64_t i = 0; i != count; i++) {
+        if (!was_parsed[i]) {
+            continue;
+        }
+
+        const struct target_list *const targets = &parsed[i].fields.targets;
+        for (uint64_t j = 0; j != targets->set_count; j++) {
+            const struct arch_info *arch = NULL;
+            enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+            target_list_get_target(targets, j, &arch, &platform);
+            if (target_list_has_target(merged_targets, arch, platform)) {
+                continue;
+            }
+
+            const enum target_list_result add_target_result =
+                target_list_add_target(merged_targets, arch, platform);
+
+            if (add_target_result != E_TARGET_LIST_OK) {
+                return false;
+            }
+        }
+    }
+
+    const struct tbd_create_info_fields *const fields = &first->fields;
+    if (fields->install_name != NULL) {
+        const uint64_t length = fields->install_name_length;
+        char *const install_name = alloc_and_copy(fields->install_name, length);
+
+        if (install_name == NULL) {
+            return false;
+        }
+
+        merged->fields.install_name = install_name;
+        merged->fields.install_name_length = length;
+
+        merged->flags.install_name_was_allocated = true;
+        merged->flags.install_name_needs_quotes =
+            first->flags.install_name_needs_quotes;
+    }
+
+    merged->fields.archs = fields->archs;
+    merged->fields.flags = fields->flags;
+
+    merged->fields.current_version = fields->current_version;
+    merged->fields.compatibility_version = fields->compatibility_version;
+    merged->fields.swift_version = fields->swift_version;
+
+    return true;
+}
+
+static bool
+write_merged_info(const struct merge_state *__notnull const state,
+                  const char *__notnull const write_dir,
+                  const struct merge_group *__notnull const group)
+{
+    uint64_t write_path_length = 0;
+    char *const write_path =
+        path_append_comp_and_ext(write_dir,
+                                 strlen(write_dir),
+                                 group->install_name,
+                                 group->length,
+                                 "tbd",
+                                 3,
+                                 &write_path_length);
+
+    if (write_path == NULL) {
+        fputs("Failed to allocate memory\n", stderr);
+        return false;
+    }
+
+    const int fd =
+        open_r(write_path,
+               write_path_length,
+               O_WRONLY | O_TRUNC,
+               0644,
+               0755,
+               NULL);
+
+    if (fd < 0) {
+        fprintf(stderr,
+                "Failed to open write-file (at path: %s), error: %s\n",
+                write_path,
+                strerror(errno));
+
+        free(write_path);
+        return true;
+    }
+
+    FILE *const file = fdopen(fd, "w");
+    if (file == NULL) {
+        fprintf(stderr,
+                "Failed to open write-file (at path: %s), error: %s\n",
+                write_path,
+                strerror(errno));
+
+        close(fd);
+        free(write_path);
+
+        return true;
+    }
+
+    const enum tbd_create_result create_result =
+        tbd_create_with_info(&state->merged,
+                             file,
+                             state->options.write_options);
+
+    if (fclose(file) != 0 || create_result != E_TBD_CREATE_OK) {
+        fprintf(stderr,
+                "Failed to write to write-file (at path %s)\n",
+                write_path);
+    }
+
+    free(write_path);
+    return true;
+}
+
+static bool
+merge_group(struct merge_state *__notnull const state,
+            const char *__notnull const write_dir,
+            const uint64_t group_index,
+            bool *__notnull const was_parsed)
+{
+    const struct merge_group *const group =
+        (const struct merge_group *)state->groups.data + group_index;
+
+    struct dyld_cache_image_info **const members =
+        (struct dyld_cache_image_info **)state->members.data +
+        (group_index * state->input_count);
+
+    /*
+     * Parse each image of the group exactly once, and only merge once every
+     * image's targets are known.
+     */
+
+    const struct tbd_create_info empty = {};
+    const struct tbd_create_info *first = NULL;
+
+    for (uint64_t i = 0; i != state->input_count; i++) {
+        was_parsed[i] = false;
+        if (members[i] == NULL) {
+            continue;
+        }
+
+        struct merge_input *const input = state->inputs + i;
+        struct tbd_create_info *const info = state->parsed + i;
+
+        const enum libtbd_result parse_result =
+            libtbd_parse_dsc_image(&state->ctx,
+                                   info,
+                                   &input->dsc_info,
+                                   members[i],
+                                   state->options,
+                                   NULL);
+
+        if (parse_result != E_LIBTBD_OK) {
+            fprintf(stderr,
+                    "Warning: Failed to parse image (at path %s) of "
+                    "dyld_shared_cache file at path: %s, skipping\n",
+                    group->install_name,
+                    input->path);
+
+            tbd_create_info_clear_fields_and_create_from(info, &empty);
+            continue;
+        }
+
+        if (first == NULL) {
+            first = info;
+        }
+
+        was_parsed[i] = true;
+    }
+
+    if (first == NULL) {
+        return true;
+    }
+
+    struct tbd_create_info *const merged = &state->merged;
+    const struct tbd_parse_options options = state->options.parse_options;
+
+    bool result =
+        setup_merged_info(merged,
+                          first,
+                          state->parsed,
+                          state->input_count,
+                          was_parsed);
+
+    for (uint64_t i = 0; result && i != state->input_count; i++) {
+        if (!was_parsed[i]) {
+            continue;
+        }
+
+        const enum tbd_ci_add_data_result merge_result =
+            merge_image(merged, state->parsed + i, options);
+
+        if (merge_result != E_TBD_CI_ADD_DATA_OK) {
+            result = false;
+        }
+    }
+
+    if (result) {
+        tbd_ci_sort_info(merged);
+        result = write_merged_info(state, write_dir, group);
+    } else {
+        fputs("Failed to allocate memory\n", stderr);
+    }
+
+    for (uint64_t i = 0; i != state->input_count; i++) {
+        if (was_parsed[i]) {
+            tbd_create_info_clear_fields_and_create_from(state->parsed + i,
+                                                         &empty);
+        }
+    }
+
+    const struct tbd_create_info merged_base = {
+        .version = TBD_VERSION_V4
+    };
+
+    target_list_destroy(&merged->fields.targets);
+    tbd_create_info_clear_fields_and_create_from(merged, &merged_base);
+
+    return result;
+}
+
+static void destroy_state(struct merge_state *__notnull const state) {
+    if (state->parsed != NULL) {
+        for (uint64_t i = 0; i != state->input_count; i++) {
+            tbd_create_info_destroy(state->parsed + i);
+        }
+
+        free(state->parsed);
+    }
+
+    tbd_create_info_destroy(&state->merged);
+    libtbd_context_destroy(&state->ctx);
+
+    if (state->inputs != NULL) {
+        for (uint64_t i = 0; i != state->input_count; i++) {
+            dyld_shared_cache_info_destroy(&state->inputs[i].dsc_info);
+        }
+
+        free(state->inputs);
+    }
+
+    array_destroy(&state->groups);
+    array_destroy(&state->members);
+
+    free(state->slots);
+}
+
+int
+dsc_merge_for_main(const char *__notnull const write_dir,
+                   const char *const *__notnull const dsc_paths,
+                   const uint64_t dsc_count)
+{
+    struct merge_state state = {
+        .input_count = dsc_count,
+        .merged.version = TBD_VERSION_V4
+    };
+
+    state.options.version = TBD_VERSION_V4;
+    state.options.parse_options.ignore_missing_uuids = true;
+    state.options.parse_options.ignore_missing_exports = true;
+    state.options.parse_options.ignore_non_unique_uuids = true;
+
+    state.inputs = calloc(dsc_count, sizeof(*state.inputs));
+    state.parsed = calloc(dsc_count, sizeof(*state.parsed));
+
+    bool *const was_parsed = calloc(dsc_count, sizeof(bool));
+    if (state.inputs == NULL || state.parsed == NULL || was_parsed == NULL) {
+        fputs("Failed to allocate memory\n", stderr);
+
+        free(was_parsed);
+        destroy_state(&state);
+
+        return 1;
+    }
+
+    int result = 1;
+    if (!open_inputs(&state, dsc_paths)) {
+        goto done;
+    }
+
+    if (!group_images(&state)) {
+        goto done;
+    }
+
+    for (uint64_t i = 0; i != state.groups.item_count; i++) {
+        if (!merge_group(&state, write_dir, i, was_parsed)) {
+            goto done;
+        }
+    }
+
+    result = 0;
+
+done:
+    free(was_parsed);
+    destroy_state(&state);
+
+    return result;
+}
@@ -0,0 +1,891 @@
+//
+//  src/export_diff.c
+//  tbd
+//
+//  Created by inoahdev on 2/9/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "export_diff.h"
+#include "libtbd.h"
+
+struct diff_image {
+    struct tbd_create_info info;
+    const char *path;
+
+    bool paired : 1;
+};
+
+/*
+ * An input is either a single mach-o file, or a dyld_shared_cache file, which
+ * stays mapped for as long as its images are kept, as their create-infos may
+ * point into its map.
+ */
+
+struct diff_input {
+    struct dyld_shared_cache_info dsc_info;
+    bool is_dsc : 1;
+};
+
+/*
+ * An open-addressing hash-table of the old input's images, keyed by their
+ * install-names, storing the index of each image plus one, so that zero marks
+ * an empty slot.
+ */
+
+struct image_map {
+    uint64_t *slots;
+    uint64_t mask;
+};
+
+struct diff_state {
+    struct libtbd_context ctx;
+    struct libtbd_options options;
+
+    struct diff_input old_input;
+    struct diff_input new_input;
+
+    struct array old_images;
+    struct image_map old_map;
+};
+
+typedef bool
+(*diff_image_callback)(struct diff_state *__notnull state,
+                       struct tbd_create_info *__notnull info,
+                       const char *__notnull path);
+
+static const char *
+get_install_name(const struct tbd_create_info *__notnull const info,
+                 const char *__notnull const path,
+                 uint64_t *__notnull const length_out)
+{
+    if (info->fields.install_name == NULL) {
+        *length_out = strlen(path);
+        return path;
+    }
+
+    *length_out = info->fields.install_name_length;
+    return info->fields.install_name;
+}
+
+static uint64_t hash_string(const char *__notnull string, uint64_t length) {
+    /*
+     * FNV-1a
+     */
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint64_t i = 0; i != length; i++) {
+        hash ^= (uint8_t)string[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static bool
+image_map_create(struct image_map *__notnull const map,
+                 const struct array *__notnull const images)
+{
+    /*
+     * Keep the table at most half full to keep probe-sequences short.
+     */
+
+    uint64_t capacity = 16;
+    while (capacity < images->item_count * 2) {
+        capacity *= 2;
+    }
+
+    map->slots = calloc(capacity, sizeof(uint64_t));
+    if (map->slots == NULL) {
+        return false;
+    }
+
+    map->mask = capacity - 1;
+
+    const struct diff_image *const front = images->data;
+    for (uint64_t i = 0; i != images->item_count; i++) {
+        const struct diff_image *const image = front + i;
+
+        uint64_t length = 0;
+        const char *const name =
+            get_install_name(&image->info, image->path, &length);
+
+        uint64_t slot = hash_string(name, length) & map->mask;
+        while (map->slots[slot] != 0) {
+            slot = (slot + 1) & map->mask;
+        }
+
+        map->slots[slot] = i + 1;
+    }
+
+    return true;
+}
+
+static struct diff_image *
+image_map_find(const struct image_map *__notnull const map,
+               const struct array *__notnull const images,
+               const char *__notnull const name,
+               const uint64_t length)
+{
+    struct diff_image *const front = images->data;
+
+    uint64_t slot = hash_string(name, length) & map->mask;
+    for (; map->slots[slot] != 0; slot = (slot + 1) & map->mask) {
+        struct diff_image *const image = front + (map->slots[slot] - 1);
+
+        uint64_t image_length = 0;
+        const char *const image_name =
+            get_install_name(&image->info, image->path, &image_length);
+
+        if (image_length != length) {
+            continue;
+        }
+
+        /*
+         * Images with the same install-name are paired in order.
+         */
+
+        if (!image->paired && memcmp(image_name, name, length) == 0) {
+            return image;
+        }
+    }
+
+    return NULL;
+}
+
+static int
+compare_strings(const char *__notnull const left,
+                const uint64_t left_length,
+                const char *__notnull const right,
+                const uint64_t right_length)
+{
+    /*
+     * Add one to also compare the null-terminator.
+     */
+
+    if (left_length > right_length) {
+        return memcmp(left, right, right_length + 1);
+    }
+
+    return memcmp(left, right, left_length + 1);
+}
+
+/*
+ * Sort symbols by their meta-type, type, and name, ignoring their targets, so
+ * that a symbol exported for different targets in the two images still lines
+ * up in the merge-join.
+ */
+
+static int
+symbol_comparator(const void *__notnull const array_item,
+                  const void *__notnull const item)
+{
+    const struct tbd_symbol_info *const left = array_item;
+    const struct tbd_symbol_info *const right = item;
+
+    if (left->meta_type != right->meta_type) {
+        return (int)(left->meta_type - right->meta_type);
+    }
+
+    if (left->type != right->type) {
+        return (int)(left->type - right->type);
+    }
+
+    return compare_strings(left->string,
+                           left->length,
+                           right->string,
+                           right->length);
+}
+
+static int
+metadata_comparator(const void *__notnull const array_item,
+                    const void *__notnull const item)
+{
+    const struct tbd_metadata_info *const left = array_item;
+    const struct tbd_metadata_info *const right = item;
+
+    if (left->type != right->type) {
+        return (int)(left->type - right->type);
+    }
+
+    return compare_strings(left->string,
+                           left->length,
+                           right->string,
+                           right->length);
+}
+
+static bool
+has_target_at_index(const struct tbd_create_info *__notnull const info,
+                    const struct bit_list targets,
+                    const uint64_t index)
+{
+    if (info->flags.uses_full_targets) {
+        return true;
+    }
+
+    return bit_list_get_for_index(targets, index) != 0;
+}
+
+static bool
+has_target(const struct tbd_create_info *__notnull const info,
+           const struct bit_list targets,
+           const struct arch_info *__notnull const arch,
+           const enum tbd_platform platform)
+{
+    const uint64_t count = info->fields.targets.set_count;
+    for (uint64_t i = 0; i != count; i++) {
+        const struct arch_info *target_arch = NULL;
+        enum tbd_platform target_platform = TBD_PLATFORM_NONE;
+
+        target_list_get_target(&info->fields.targets,
+                               i,
+                               &target_arch,
+                               &target_platform);
+
+        if (target_arch == arch && target_platform == platform) {
+            return has_target_at_index(info, targets, i);
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Check whether every target in left's set is also in right's set.
+ */
+
+static bool
+targets_are_subset(const struct tbd_create_info *__notnull const left_info,
+                   const struct bit_list left,
+                   const struct tbd_create_info *__notnull const right_info,
+                   const struct bit_list right)
+{
+    const uint64_t count = left_info->fields.targets.set_count;
+    for (uint64_t i = 0; i != count; i++) {
+        if (!has_target_at_index(left_info, left, i)) {
+            continue;
+        }
+
+        const struct arch_info *arch = NULL;
+        enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+        target_list_get_target(&left_info->fields.targets,
+                               i,
+                               &arch,
+                               &platform);
+
+        if (!has_target(right_info, right, arch, platform)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+print_targets(const struct tbd_create_info *__notnull const info,
+              const struct bit_list targets)
+{
+    fputs("[ ", stdout);
+
+    bool printed_target = false;
+
+    const uint64_t count = info->fields.targets.set_count;
+    for (uint64_t i = 0; i != count; i++) {
+        if (!has_target_at_index(info, targets, i)) {
+            continue;
+        }
+
+        const struct arch_info *arch = NULL;
+        enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+        target_list_get_target(&info->fields.targets, i, &arch, &platform);
+        const char *const platform_string =
+            tbd_platform_to_string(platform, TBD_VERSION_V4);
+
+        fprintf(stdout,
+                "%s%s-%s",
+                printed_target ? ", " : "",
+                arch->name,
+                platform_string != NULL ? platform_string : "unknown");
+
+        printed_target = true;
+    }
+
+    fputs(" ]", stdout);
+}
+
+static void
+print_image_targets(const struct tbd_create_info *__notnull const info) {
+    const struct bit_list empty = {};
+    const struct tbd_create_info full = {
+        .fields.targets = info->fields.targets,
+        .flags.uses_full_targets = true
+    };
+
+    print_targets(&full, empty);
+}
+
+static const char *get_symbol_type_desc(const enum tbd_symbol_type type) {
+    switch (type) {
+        case TBD_SYMBOL_TYPE_NONE:
+        case TBD_SYMBOL_TYPE_NORMAL:
+            return NULL;
+
+        case TBD_SYMBOL_TYPE_CLIENT:
+            return "client";
+
+        case TBD_SYMBOL_TYPE_REEXPORT:
+            return "reexport";
+
+        case TBD_SYMBOL_TYPE_OBJC_CLASS:
+            return "objc-class";
+
+        case TBD_SYMBOL_TYPE_OBJC_EHTYPE:
+            return "objc-eh-type";
+
+        case TBD_SYMBOL_TYPE_OBJC_IVAR:
+            return "objc-ivar";
+
+        case TBD_SYMBOL_TYPE_WEAK_DEF:
+            return "weak-def";
+
+        case TBD_SYMBOL_TYPE_THREAD_LOCAL:
+            return "thread-local";
+    }
+
+    return NULL;
+}
+
+static const char *
+get_metadata_type_desc(const enum tbd_metadata_type type) {
+    switch (type) {
+        case TBD_METADATA_TYPE_NONE:
+            return "metadata";
+
+        case TBD_METADATA_TYPE_PARENT_UMBRELLA:
+            return "parent-umbrella";
+
+        case TBD_METADATA_TYPE_CLIENT:
+            return "allowable-client";
+
+        case TBD_METADATA_TYPE_REEXPORTED_LIBRARY:
+            return "reexported-library";
+    }
+
+    return "metadata";
+}
+
+struct image_diff {
+    const char *name;
+
+    bool printed_header : 1;
+};
+
+static void print_header_once(struct image_diff *__notnull const diff) {
+    if (diff->printed_header) {
+        return;
+    }
+
+    fprintf(stdout, "image: %s\n", diff->name);
+    diff->printed_header = true;
+}
+
+static void
+print_symbol(const char prefix,
+             const struct tbd_create_info *__notnull const info,
+             const void *__notnull const item)
+{
+    const struct tbd_symbol_info *const symbol = item;
+    fprintf(stdout, "    %c %s", prefix, symbol->string);
+
+    const char *const type = get_symbol_type_desc(symbol->type);
+    if (symbol->meta_type == TBD_SYMBOL_META_TYPE_REEXPORT) {
+        fputs(" (reexport)", stdout);
+    } else if (type != NULL) {
+        fprintf(stdout, " (%s)", type);
+    }
+
+    fputc(' ', stdout);
+    print_targets(info, symbol->targets);
+}
+
+static void
+print_metadata(const char prefix,
+               const struct tbd_create_info *__notnull const info,
+               const void *__notnull const item)
+{
+    const struct tbd_metadata_info *const metadata = item;
+    fprintf(stdout,
+            "    %c %s: %s ",
+            prefix,
+            get_metadata_type_desc(metadata->type),
+            metadata->string);
+
+    print_targets(info, metadata->targets);
+}
+
+typedef void
+(*print_item_func)(char prefix,
+                   const struct tbd_create_info *__notnull info,
+                   const void *__notnull item);
+
+/*
+ * Walk through the two sorted arrays, of either symbols or metadata, together,
+ * printing items only found in one array, or found in both but with different
+ * targets.
+ *
+ * Both struct tbd_symbol_info and struct tbd_metadata_info begin with their
+ * targets, which is relied upon here.
+ */
+
+static void
+merge_join(struct image_diff *__notnull const diff,
+           const struct tbd_create_info *__notnull const old_info,
+           const struct array *__notnull const old_array,
+           const struct tbd_create_info *__notnull const new_info,
+           const struct array *__notnull const new_array,
+           const size_t item_size,
+           __notnull const array_item_sort_comparator comparator,
+           __notnull const print_item_func print_item)
+{
+    const uint8_t *old_iter = old_array->data;
+    const uint8_t *const old_end = old_array->data_end;
+
+    const uint8_t *new_iter = new_array->data;
+    const uint8_t *const new_end = new_array->data_end;
+
+    while (old_iter != old_end || new_iter != new_end) {
+        int compare = 0;
+        if (old_iter == old_end) {
+            compare = 1;
+        } else if (new_iter == new_end) {
+            compare = -1;
+        } else {
+            compare = comparator(old_iter, new_iter);
+        }
+
+        if (compare < 0) {
+            print_header_once(diff);
+            print_item('-', old_info, old_iter);
+            fputc('\n', stdout);
+
+            old_iter += item_size;
+            continue;
+        }
+
+        if (compare > 0) {
+            print_header_once(diff);
+            print_item('+', new_info, new_iter);
+            fputc('\n', stdout);
+
+            new_iter += item_size;
+            continue;
+        }
+
+        const struct bit_list old_targets = *(const struct bit_list *)old_iter;
+        const struct bit_list new_targets = *(const struct bit_list *)new_iter;
+
+        const bool targets_match =
+            targets_are_subset(old_info, old_targets, new_info, new_targets) &&
+            targets_are_subset(new_info, new_targets, old_info, old_targets);
+
+        if (!targets_match) {
+            print_header_once(diff);
+            print_item('~', old_info, old_iter);
+
+            fputs(" -> ", stdout);
+            print_targets(new_info, new_targets);
+            fputc('\n', stdout);
+        }
+
+        old_iter += item_size;
+        new_iter += item_size;
+    }
+}
+
+static void print_packed_version(const uint32_t version) {
+    fprintf(stdout,
+            "%" PRIu32 ".%" PRIu32 ".%" PRIu32,
+            version >> 16,
+            (version >> 8) & 0xff,
+            version & 0xff);
+}
+
+static void print_flags(const struct tbd_flags flags) {
+    fputs("[ ", stdout);
+    if (flags.flat_namespace) {
+        fputs("flat_namespace", stdout);
+        if (flags.not_app_extension_safe) {
+            fputs(", ", stdout);
+        }
+    }
+
+    if (flags.not_app_extension_safe) {
+        fputs("not_app_extension_safe", stdout);
+    }
+
+    fputs(" ]", stdout);
+}
+
+static void
+diff_fields(struct image_diff *__notnull const diff,
+            const struct tbd_create_info *__notnull const old_info,
+            const struct tbd_create_info *__notnull const new_info)
+{
+    const struct tbd_create_info_fields *const old = &old_info->fields;
+    const struct tbd_create_info_fields *const new = &new_info->fields;
+
+    const bool install_names_match =
+        old->install_name != NULL &&
+        new->install_name != NULL &&
+        compare_strings(old->install_name,
+                        old->install_name_length,
+                        new->install_name,
+                        new->install_name_length) == 0;
+
+    if (!install_names_match &&
+        (old->install_name != NULL || new->install_name != NULL))
+    {
+        print_header_once(diff);
+        fprintf(stdout,
+                "    install-name: %s -> %s\n",
+                old->install_name != NULL ? old->install_name : "(none)",
+                new->install_name != NULL ? new->install_name : "(none)");
+    }
+
+    const struct bit_list empty = {};
+    const struct tbd_create_info old_full = {
+        .fields.targets = old->targets,
+        .flags.uses_full_targets = true
+    };
+
+    const struct tbd_create_info new_full = {
+        .fields.targets = new->targets,
+        .flags.uses_full_targets = true
+    };
+
+    const bool targets_match =
+        targets_are_subset(&old_full, empty, &new_full, empty) &&
+        targets_are_subset(&new_full, empty, &old_full, empty);
+
+    if (!targets_match) {
+        print_header_once(diff);
+        fputs("    targets: ", stdout);
+
+        print_image_targets(old_info);
+        fputs(" -> ", stdout);
+
+        print_image_targets(new_info);
+        fputc('\n', stdout);
+    }
+
+    if (old->current_version != new->current_version) {
+        print_header_once(diff);
+        fputs("    current-version: ", stdout);
+
+        print_packed_version(old->current_version);
+        fputs(" -> ", stdout);
+
+        print_packed_version(new->current_version);
+        fputc('\n', stdout);
+    }
+
+    if (old->compatibility_version != new->compatibility_version) {
+        print_header_once(diff);
+        fputs("    compatibility-version: ", stdout);
+
+        print_packed_version(old->compatibility_version);
+        fputs(" -> ", stdout);
+
+        print_packed_version(new->compatibility_version);
+        fputc('\n', stdout);
+    }
+
+    if (old->swift_version != new->swift_version) {
+        print_header_once(diff);
+        fprintf(stdout,
+                "    swift-abi-version: %" PRIu32 " -> %" PRIu32 "\n",
+                old->swift_version,
+                new->swift_version);
+    }
+
+    if (old->flags.value != new->flags.value) {
+        print_header_once(diff);
+        fputs("    flags: ", stdout);
+
+        print_flags(old->flags);
+        fputs(" -> ", stdout);
+
+        print_flags(new->flags);
+        fputc('\n', stdout);
+    }
+}
+
+static void
+sort_for_diff(struct tbd_create_info *__notnull const info) {
+    array_sort_with_comparator(&info->fields.metadata,
+                               sizeof(struct tbd_metadata_info),
+                               metadata_comparator);
+
+    array_sort_with_comparator(&info->fields.symbols,
+                               sizeof(struct tbd_symbol_info),
+                               symbol_comparator);
+}
+
+static void
+diff_images(const struct diff_image *__notnull const old,
+            struct tbd_create_info *__notnull const new_info,
+            const char *__notnull const name)
+{
+    struct image_diff diff = {
+        .name = name
+    };
+
+    const struct tbd_create_info *const old_info = &old->info;
+
+    diff_fields(&diff, old_info, new_info);
+    sort_for_diff(new_info);
+
+    merge_join(&diff,
+               old_info,
+               &old_info->fields.metadata,
+               new_info,
+               &new_info->fields.metadata,
+               sizeof(struct tbd_metadata_info),
+               metadata_comparator,
+               print_metadata);
+
+    merge_join(&diff,
+               old_info,
+               &old_info->fields.symbols,
+               new_info,
+               &new_info->fields.symbols,
+               sizeof(struct tbd_symbol_info),
+               symbol_comparator,
+               print_symbol);
+}
+
+/*
+ * Parse every image of the input at path, calling callback with each image.
+ * For dyld_shared_cache files, images that fail to parse are skipped.
+ */
+
+static bool
+for_each_image(struct diff_state *__notnull const state,
+               struct diff_input *__notnull const input,
+               const char *__notnull const path,
+               __notnull const diff_image_callback callback)
+{
+    const enum libtbd_result open_result =
+        libtbd_open_dsc(&input->dsc_info, path, state->options, NULL);
+
+    struct tbd_create_info info = {};
+    if (open_result == E_LIBTBD_NOT_A_CACHE) {
+        const enum libtbd_result parse_result =
+            libtbd_parse_macho_path(&state->ctx,
+                                    &info,
+                                    path,
+                                    state->options,
+                                    NULL);
+
+        if (parse_result != E_LIBTBD_OK) {
+            fprintf(stderr,
+                    "File at path %s is neither a valid mach-o file nor a "
+                    "valid dyld_shared_cache file\n",
+                    path);
+
+            tbd_create_info_destroy(&info);
+            return false;
+        }
+
+        const bool result = callback(state, &info, path);
+        tbd_create_info_destroy(&info);
+
+        return result;
+    }
+
+    if (open_result != E_LIBTBD_OK) {
+        fprintf(stderr,
+                "Failed to open dyld_shared_cache file at path: %s\n",
+                path);
+
+        return false;
+    }
+
+    input->is_dsc = true;
+
+    const struct dyld_shared_cache_info *const dsc_info = &input->dsc_info;
+    const struct tbd_create_info empty = {};
+
+    for (uint32_t i = 0; i != dsc_info->images_count; i++) {
+        struct dyld_cache_image_info *const image = dsc_info->images + i;
+        const char *const image_path =
+            (const char *)(dsc_info->map + image->pathFileOffset);
+
+        const enum libtbd_result parse_result =
+            libtbd_parse_dsc_image(&state->ctx,
+                                   &info,
+                                   &input->dsc_info,
+                                   image,
+                                   state->options,
+                                   NULL);
+
+        if (parse_result != E_LIBTBD_OK) {
+            fprintf(stderr,
+                    "Warning: Failed to parse image (at path %s) of "
+                    "dyld_shared_cache file at path: %s, skipping\n",
+                    image_path,
+                    path);
+
+            tbd_create_info_clear_fields_and_create_from(&info, &empty);
+            continue;
+        }
+
+        if (!callback(state, &info, image_path)) {
+            tbd_create_info_destroy(&info);
+            return false;
+        }
+
+        tbd_create_info_clear_fields_and_create_from(&info, &empty);
+    }
+
+    tbd_create_info_destroy(&info);
+    return true;
+}
+
+static bool
+add_old_image(struct diff_state *__notnull const state,
+              struct tbd_create_info *__notnull const info,
+              const char *__notnull const path)
+{
+    struct diff_image image = {
+        .info = *info,
+        .path = path
+    };
+
+    sort_for_diff(&image.info);
+
+    const enum array_result add_result =
+        array_add_item(&state->old_images, sizeof(image), &image, NULL);
+
+    if (add_result != E_ARRAY_OK) {
+        fputs("Failed to allocate memory\n", stderr);
+        return false;
+    }
+
+    /*
+     * The image now owns the create-info's fields.
+     */
+
+    const struct tbd_create_info empty = {};
+    *info = empty;
+
+    return true;
+}
+
+static bool
+diff_new_image(struct diff_state *__notnull const state,
+               struct tbd_create_info *__notnull const info,
+               const char *__notnull const path)
+{
+    uint64_t length = 0;
+    const char *const name = get_install_name(info, path, &length);
+
+    /*
+     * Two single mach-o files are always compared, even if their install-names
+     * differ.
+     */
+
+    struct diff_image *old = NULL;
+    if (!state->old_input.is_dsc && !state->new_input.is_dsc) {
+        old = state->old_images.data;
+    } else {
+        old = image_map_find(&state->old_map, &state->old_images, name, length);
+    }
+
+    if (old == NULL) {
+        fprintf(stdout, "added image: %s\n", name);
+        return true;
+    }
+
+    old->paired = true;
+    diff_images(old, info, name);
+
+    return true;
+}
+
+static void destroy_old_images(struct array *__notnull const images) {
+    struct diff_image *image = images->data;
+    const struct diff_image *const end = images->data_end;
+
+    for (; image != end; image++) {
+        tbd_create_info_destroy(&image->info);
+    }
+
+    array_destroy(images);
+}
+
+int
+export_diff_for_main(const char *__notnull const old_path,
+                     const char *__notnull const new_path)
+{
+    struct diff_state state = {};
+
+    state.options.version = TBD_VERSION_V4;
+    state.options.parse_options.ignore_undefineds = true;
+    state.options.parse_options.ignore_uuids = true;
+    state.options.parse_options.ignore_missing_uuids = true;
+    state.options.parse_options.ignore_missing_exports = true;
+
+    int result = 1;
+    if (!for_each_image(&state, &state.old_input, old_path, add_old_image)) {
+        goto done;
+    }
+
+    if (!image_map_create(&state.old_map, &state.old_images)) {
+        fputs("Failed to allocate memory\n", stderr);
+        goto done;
+    }
+
+    if (!for_each_image(&state, &state.new_input, new_path, diff_new_image)) {
+        goto done;
+    }
+
+    const struct diff_image *image = state.old_images.data;
+    const struct diff_image *const end = state.old_images.data_end;
+
+    for (; image != end; image++) {
+        if (image->paired) {
+            continue;
+        }
+
+        uint64_t length = 0;
+        fprintf(stdout,
+                "removed image: %s\n",
+                get_install_name(&image->info, image->path, &length));
+    }
+
+    result = 0;
+
+done:
+    free(state.old_map.slots);
+
+    destroy_old_images(&state.old_images);
+    libtbd_context_destroy(&state.ctx);
+
+    if (state.old_input.is_dsc) {
+        dyld_shared_cache_info_destroy(&state.old_input.dsc_info);
+    }
+
+    if (state.new_input.is_dsc) {
+        dyld_shared_cache_info_destroy(&state.new_input.dsc_info);
+    }
+
+    return result;
+}
@@ -0,0 +1,438 @@
+//
+//  src/export_dump.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "export_dump.h"
+#include "libtbd.h"
+
+/*
+ * Records are formatted into a single fixed-size buffer, which is written out
+ * whenever it fills up, so that memory-use stays the same no matter how many
+ * symbols an image has.
+ */
+
+#define DUMP_BUFFER_SIZE (1ull << 20)
+
+/*
+ * The longest escape-sequence written for a single byte, in the form of
+ * "\u00XX".
+ */
+
+#define DUMP_MAX_ESCAPE_LENGTH 6
+
+struct dump_buffer {
+    char *data;
+    uint64_t length;
+
+    bool failed : 1;
+};
+
+struct dump_state {
+    struct dump_buffer buffer;
+    enum export_dump_format format;
+
+    const char *image_path;
+    uint64_t image_path_length;
+};
+
+enum export_dump_format
+export_dump_format_from_string(const char *__notnull const string) {
+    if (strcmp(string, "ndjson") == 0) {
+        return EXPORT_DUMP_FORMAT_NDJSON;
+    }
+
+    if (strcmp(string, "tsv") == 0) {
+        return EXPORT_DUMP_FORMAT_TSV;
+    }
+
+    return EXPORT_DUMP_FORMAT_NONE;
+}
+
+static void flush_buffer(struct dump_buffer *__notnull const buffer) {
+    if (buffer->length == 0) {
+        return;
+    }
+
+    const size_t written = fwrite(buffer->data, 1, buffer->length, stdout);
+    if (written != buffer->length) {
+        buffer->failed = true;
+    }
+
+    buffer->length = 0;
+}
+
+static inline void
+reserve(struct dump_buffer *__notnull const buffer, const uint64_t length) {
+    if (DUMP_BUFFER_SIZE - buffer->length < length) {
+        flush_buffer(buffer);
+    }
+}
+
+static void
+put_raw(struct dump_buffer *__notnull const buffer,
+        const char *__notnull const string,
+        const uint64_t length)
+{
+    reserve(buffer, length);
+    memcpy(buffer->data + buffer->length, string, length);
+
+    buffer->length += length;
+}
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static void
+put_json_escaped(struct dump_buffer *__notnull const buffer,
+                 const char *__notnull const string,
+                 const uint64_t length)
+{
+    for (uint64_t i = 0; i != length; i++) {
+        reserve(buffer, DUMP_MAX_ESCAPE_LENGTH);
+
+        const unsigned char ch = (unsigned char)string[i];
+        char *const iter = buffer->data + buffer->length;
+
+        if (ch == '"' || ch == '\\') {
+            iter[0] = '\\';
+            iter[1] = (char)ch;
+
+            buffer->length += 2;
+        } else if (ch < 0x20) {
+            memcpy(iter, "\\u00", 4);
+
+            iter[4] = hex_digits[ch >> 4];
+            iter[5] = hex_digits[ch & 0xf];
+
+            buffer->length += 6;
+        } else {
+            iter[0] = (char)ch;
+            buffer->length += 1;
+        }
+    }
+}
+
+static void
+put_tsv_escaped(struct dump_buffer *__notnull const buffer,
+                const char *__notnull const string,
+                const uint64_t length)
+{
+    for (uint64_t i = 0; i != length; i++) {
+        reserve(buffer, 2);
+
+        const char ch = string[i];
+        char *const iter = buffer->data + buffer->length;
+
+        char escape = '\0';
+        switch (ch) {
+            case '\t':
+                escape = 't';
+                break;
+
+            case '\n':
+                escape = 'n';
+                break;
+
+            case '\r':
+                escape = 'r';
+                break;
+
+            case '\\':
+                escape = '\\';
+                break;
+
+            default:
+                break;
+        }
+
+        if (escape != '\0') {
+            iter[0] = '\\';
+            iter[1] = escape;
+
+            buffer->length += 2;
+        } else {
+            iter[0] = ch;
+            buffer->length += 1;
+        }
+    }
+}
+
+static const char *
+get_kind(const enum tbd_symbol_type type,
+         const enum tbd_symbol_meta_type meta_type)
+{
+    const bool is_reexport = (meta_type == TBD_SYMBOL_META_TYPE_REEXPORT);
+    switch (type) {
+        case TBD_SYMBOL_TYPE_NONE:
+        case TBD_SYMBOL_TYPE_NORMAL:
+            return is_reexport ? "reexported-symbol" : "symbol";
+
+        case TBD_SYMBOL_TYPE_CLIENT:
+            return "client";
+
+        case TBD_SYMBOL_TYPE_REEXPORT:
+            return "reexport";
+
+        case TBD_SYMBOL_TYPE_OBJC_CLASS:
+            return is_reexport ? "reexported-objc-class" : "objc-class";
+
+        case TBD_SYMBOL_TYPE_OBJC_EHTYPE:
+            return is_reexport ? "reexported-objc-eh-type" : "objc-eh-type";
+
+        case TBD_SYMBOL_TYPE_OBJC_IVAR:
+            return is_reexport ? "reexported-objc-ivar" : "objc-ivar";
+
+        case TBD_SYMBOL_TYPE_WEAK_DEF:
+            return is_reexport ? "reexported-weak-def" : "weak-def";
+
+        case TBD_SYMBOL_TYPE_THREAD_LOCAL:
+            return is_reexport ? "reexported-thread-local" : "thread-local";
+    }
+
+    return "symbol";
+}
+
+/*
+ * Write out the target at arch_index in the form "<arch>-<platform>". Targets
+ * that haven't been parsed yet are written out as "unknown".
+ */
+
+static void
+put_target(struct dump_buffer *__notnull const buffer,
+           const struct tbd_create_info *__notnull const info,
+           const uint64_t arch_index)
+{
+    if (arch_index >= info->fields.targets.set_count) {
+        put_raw(buffer, "unknown", 7);
+        return;
+    }
+
+    const struct arch_info *arch = NULL;
+    enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+    target_list_get_target(&info->fields.targets, arch_index, &arch, &platform);
+
+    const char *platform_string =
+        tbd_platform_to_string(platform, TBD_VERSION_V4);
+
+    if (platform_string == NULL) {
+        platform_string = "unknown";
+    }
+
+    const char *const arch_name = (arch != NULL) ? arch->name : "unknown";
+
+    put_raw(buffer, arch_name, strlen(arch_name));
+    put_raw(buffer, "-", 1);
+    put_raw(buffer, platform_string, strlen(platform_string));
+}
+
+static bool
+dump_symbol(const struct tbd_create_info *__notnull const info,
+            const char *__notnull const string,
+            const uint64_t length,
+            const uint64_t arch_index,
+            const enum tbd_symbol_type type,
+            const enum tbd_symbol_meta_type meta_type,
+            void *const sink_info)
+{
+    struct dump_state *const state = (struct dump_state *)sink_info;
+    struct dump_buffer *const buffer = &state->buffer;
+
+    const char *const kind = get_kind(type, meta_type);
+    switch (state->format) {
+        case EXPORT_DUMP_FORMAT_NONE:
+            break;
+
+        case EXPORT_DUMP_FORMAT_NDJSON:
+            put_raw(buffer, "{\"image\":\"", 10);
+            put_json_escaped(buffer,
+                             state->image_path,
+                             state->image_path_length);
+
+            put_raw(buffer, "\",\"symbol\":\"", 12);
+            put_json_escaped(buffer, string, length);
+
+            put_raw(buffer, "\",\"kind\":\"", 10);
+            put_raw(buffer, kind, strlen(kind));
+
+            put_raw(buffer, "\",\"target\":\"", 12);
+            put_target(buffer, info, arch_index);
+            put_raw(buffer, "\"}\n", 3);
+
+            break;
+
+        case EXPORT_DUMP_FORMAT_TSV:
+            put_tsv_escaped(buffer,
+                            state->image_path,
+                            state->image_path_length);
+
+            put_raw(buffer, "\t", 1);
+            put_tsv_escaped(buffer, string, length);
+
+            put_raw(buffer, "\t", 1);
+            put_raw(buffer, kind, strlen(kind));
+
+            put_raw(buffer, "\t", 1);
+            put_target(buffer, info, arch_index);
+            put_raw(buffer, "\n", 1);
+
+            break;
+    }
+
+    return !buffer->failed;
+}
+
+static void
+set_image_path(struct dump_state *__notnull const state,
+               const char *__notnull const path)
+{
+    state->image_path = path;
+    state->image_path_length = strlen(path);
+}
+
+/*
+ * Dump every image of the dyld_shared_cache at path, or the mach-o file at path
+ * if it isn't a dyld_shared_cache file. Images that fail to parse are skipped.
+ */
+
+static bool
+dump_path(struct dump_state *__notnull const state,
+          struct libtbd_context *__notnull const ctx,
+          struct tbd_create_info *__notnull const info,
+          const struct libtbd_options options,
+          const char *__notnull const path)
+{
+    struct dyld_shared_cache_info dsc_info = {};
+    const enum libtbd_result open_result =
+        libtbd_open_dsc(&dsc_info, path, options, NULL);
+
+    if (open_result == E_LIBTBD_NOT_A_CACHE) {
+        set_image_path(state, path);
+
+        const enum libtbd_result parse_result =
+            libtbd_parse_macho_path(ctx, info, path, options, NULL);
+
+        const struct tbd_create_info empty = {};
+        tbd_create_info_clear_fields_and_create_from(info, &empty);
+
+        if (state->buffer.failed) {
+            return false;
+        }
+
+        if (parse_result != E_LIBTBD_OK) {
+            fprintf(stderr,
+                    "File at path %s is neither a valid mach-o file nor a "
+                    "valid dyld_shared_cache file\n",
+                    path);
+
+            return false;
+        }
+
+        return true;
+    }
+
+    if (open_result != E_LIBTBD_OK) {
+        fprintf(stderr,
+                "Failed to open dyld_shared_cache file at path: %s\n",
+                path);
+
+        return false;
+    }
+
+    const struct tbd_create_info empty = {};
+    for (uint32_t i = 0; i != dsc_info.images_count; i++) {
+        struct dyld_cache_image_info *const image = dsc_info.images + i;
+        const char *const image_path =
+            (const char *)(dsc_info.map + image->pathFileOffset);
+
+        set_image_path(state, image_path);
+
+        const enum libtbd_result parse_result =
+            libtbd_parse_dsc_image(ctx, info, &dsc_info, image, options, NULL);
+
+        tbd_create_info_clear_fields_and_create_from(info, &empty);
+        if (state->buffer.failed) {
+            dyld_shared_cache_info_destroy(&dsc_info);
+            return false;
+        }
+
+        if (parse_result != E_LIBTBD_OK) {
+            fprintf(stderr,
+                    "Warning: Failed to parse image (at path %s) of "
+                    "dyld_shared_cache file at path: %s, skipping\n",
+                    image_path,
+                    path);
+        }
+    }
+
+    dyld_shared_cache_info_destroy(&dsc_info);
+    return true;
+}
+
+int
+export_dump_for_main(const enum export_dump_format format,
+                     const char *const *__notnull const paths,
+                     const uint64_t path_count)
+{
+    struct dump_state state = {
+        .format = format
+    };
+
+    state.buffer.data = malloc(DUMP_BUFFER_SIZE);
+    if (state.buffer.data == NULL) {
+        fputs("Failed to allocate memory\n", stderr);
+        return 1;
+    }
+
+    /*
+     * Only exports are dumped, so clients, re-exports, and undefineds, which
+     * are found outside of the export-trie and symbol-table exports, are
+     * ignored.
+     */
+
+    struct libtbd_options options = {
+        .version = TBD_VERSION_V4
+    };
+
+    options.parse_options.ignore_clients = true;
+    options.parse_options.ignore_reexports = true;
+    options.parse_options.ignore_undefineds = true;
+    options.parse_options.ignore_uuids = true;
+    options.parse_options.ignore_missing_uuids = true;
+    options.parse_options.ignore_missing_exports = true;
+
+    struct libtbd_context ctx = {};
+    struct tbd_create_info info = {
+        .symbol_sink = dump_symbol,
+        .sink_info = &state
+    };
+
+    int result = 0;
+    for (uint64_t i = 0; i != path_count; i++) {
+        if (!dump_path(&state, &ctx, &info, options, paths[i])) {
+            result = 1;
+            if (state.buffer.failed) {
+                break;
+            }
+        }
+    }
+
+    flush_buffer(&state.buffer);
+    if (state.buffer.failed || fflush(stdout) != 0) {
+        fputs("Failed to write to stdout\n", stderr);
+        result = 1;
+    }
+
+    tbd_create_info_destroy(&info);
+    libtbd_context_destroy(&ctx);
+
+    free(state.buffer.data);
+    return result;
+}
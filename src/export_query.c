@@ -0,0 +1,287 @@
+//
+//  src/export_query.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "export_query.h"
+#include "libtbd.h"
+#include "macho_file_parse_export_trie.h"
+
+struct query {
+    const char *symbol;
+    uint64_t length;
+
+    bool found : 1;
+};
+
+struct image_state {
+    const char *path;
+    bool parsed_targets : 1;
+};
+
+/*
+ * Print the flags of an export-node as a comma-separated list, starting with
+ * the export's kind.
+ */
+
+static void print_flags(const uint64_t flags) {
+    switch (flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) {
+        case EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL:
+            fputs("thread-local", stdout);
+            break;
+
+        case EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE:
+            fputs("absolute", stdout);
+            break;
+
+        default:
+            fputs("regular", stdout);
+            break;
+    }
+
+    if (flags & EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION) {
+        fputs(",weak-def", stdout);
+    }
+
+    if (flags & EXPORT_SYMBOL_FLAGS_REEXPORT) {
+        fputs(",reexport", stdout);
+    }
+
+    if (flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER) {
+        fputs(",stub-resolver", stdout);
+    }
+}
+
+static void print_targets(const struct tbd_create_info *__notnull const info) {
+    const uint64_t count = info->fields.targets.set_count;
+    if (count == 0) {
+        fputs("unknown", stdout);
+        return;
+    }
+
+    for (uint64_t i = 0; i != count; i++) {
+        const struct arch_info *arch = NULL;
+        enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+        target_list_get_target(&info->fields.targets, i, &arch, &platform);
+
+        const char *platform_string =
+            tbd_platform_to_string(platform, TBD_VERSION_V4);
+
+        if (platform_string == NULL) {
+            platform_string = "unknown";
+        }
+
+        if (i != 0) {
+            fputc(',', stdout);
+        }
+
+        const char *const arch_name = (arch != NULL) ? arch->name : "unknown";
+        fprintf(stdout, "%s-%s", arch_name, platform_string);
+    }
+}
+
+/*
+ * An image's targets are only needed once one of its exports is found, so the
+ * image's load-commands are only parsed then, and at most once.
+ */
+
+static void
+parse_targets(struct libtbd_context *__notnull const ctx,
+              struct tbd_create_info *__notnull const info,
+              struct dyld_shared_cache_info *__notnull const dsc_info,
+              struct dyld_cache_image_info *__notnull const image,
+              struct image_state *__notnull const state,
+              const struct libtbd_options options)
+{
+    if (state->parsed_targets) {
+        return;
+    }
+
+    const enum libtbd_result parse_result =
+        libtbd_parse_dsc_image(ctx, info, dsc_info, image, options, NULL);
+
+    if (parse_result != E_LIBTBD_OK) {
+        fprintf(stderr,
+                "Warning: Failed to parse the targets of image (at path %s)\n",
+                state->path);
+    }
+
+    state->parsed_targets = true;
+}
+
+static bool
+query_image(struct libtbd_context *__notnull const ctx,
+            struct tbd_create_info *__notnull const info,
+            struct dyld_shared_cache_info *__notnull const dsc_info,
+            struct dyld_cache_image_info *__notnull const image,
+            struct query *__notnull const queries,
+            const uint64_t query_count,
+            const struct libtbd_options options)
+{
+    struct image_state state = {
+        .path = (const char *)(dsc_info->map + image->pathFileOffset)
+    };
+
+    struct range export_range = {};
+    const enum dsc_image_parse_result find_result =
+        dsc_image_find_export_trie(dsc_info, image, &export_range);
+
+    if (find_result == E_DSC_IMAGE_PARSE_NO_EXPORT_TRIE) {
+        return true;
+    }
+
+    if (find_result != E_DSC_IMAGE_PARSE_OK) {
+        fprintf(stderr,
+                "Warning: Failed to find the export-trie of image (at path "
+                "%s), skipping\n",
+                state.path);
+
+        return false;
+    }
+
+    const uint8_t *const export_trie = dsc_info->map + export_range.begin;
+    const uint32_t export_size =
+        (uint32_t)(export_range.end - export_range.begin);
+
+    for (uint64_t i = 0; i != query_count; i++) {
+        struct query *const query = queries + i;
+        struct macho_file_export_trie_lookup lookup = {};
+
+        const enum macho_file_parse_result lookup_result =
+            macho_file_lookup_in_export_trie(export_trie,
+                                             export_size,
+                                             query->symbol,
+                                             query->length,
+                                             &lookup);
+
+        if (lookup_result != E_MACHO_FILE_PARSE_OK) {
+            fprintf(stderr,
+                    "Warning: Image (at path %s) has an invalid export-trie, "
+                    "skipping\n",
+                    state.path);
+
+            break;
+        }
+
+        if (!lookup.found) {
+            continue;
+        }
+
+        parse_targets(ctx, info, dsc_info, image, &state, options);
+        fprintf(stdout, "%s\t%s\t", query->symbol, state.path);
+
+        print_flags(lookup.flags);
+        fputc('\t', stdout);
+
+        print_targets(info);
+        fputc('\n', stdout);
+
+        query->found = true;
+    }
+
+    const struct tbd_create_info empty = {};
+    tbd_create_info_clear_fields_and_create_from(info, &empty);
+
+    return true;
+}
+
+int
+export_query_for_main(const char *__notnull const path,
+                      const char *const *__notnull const symbols,
+                      const uint64_t symbol_count)
+{
+    /*
+     * Only the targets of an image are parsed, everything else is found by
+     * looking into the export-trie directly.
+     */
+
+    struct libtbd_options options = {
+        .version = TBD_VERSION_V4
+    };
+
+    options.parse_options.ignore_clients = true;
+    options.parse_options.ignore_exports = true;
+    options.parse_options.ignore_reexports = true;
+    options.parse_options.ignore_undefineds = true;
+    options.parse_options.ignore_uuids = true;
+    options.parse_options.ignore_missing_uuids = true;
+
+    struct dyld_shared_cache_info dsc_info = {};
+    const enum libtbd_result open_result =
+        libtbd_open_dsc(&dsc_info, path, options, NULL);
+
+    if (open_result == E_LIBTBD_NOT_A_CACHE) {
+        fprintf(stderr,
+                "File at path %s is not a dyld_shared_cache file\n",
+                path);
+
+        return 1;
+    }
+
+    if (open_result != E_LIBTBD_OK) {
+        fprintf(stderr,
+                "Failed to open dyld_shared_cache file at path: %s\n",
+                path);
+
+        return 1;
+    }
+
+    struct query *const queries = calloc(symbol_count, sizeof(*queries));
+    if (queries == NULL) {
+        fputs("Failed to allocate memory\n", stderr);
+        exit(1);
+    }
+
+    for (uint64_t i = 0; i != symbol_count; i++) {
+        queries[i].symbol = symbols[i];
+        queries[i].length = strlen(symbols[i]);
+    }
+
+    struct libtbd_context ctx = {};
+    struct tbd_create_info info = {};
+
+    int result = 0;
+    for (uint32_t i = 0; i != dsc_info.images_count; i++) {
+        struct dyld_cache_image_info *const image = dsc_info.images + i;
+        const bool query_result =
+            query_image(&ctx,
+                        &info,
+                        &dsc_info,
+                        image,
+                        queries,
+                        symbol_count,
+                        options);
+
+        if (!query_result) {
+            result = 1;
+        }
+    }
+
+    for (uint64_t i = 0; i != symbol_count; i++) {
+        if (!queries[i].found) {
+            fprintf(stderr, "No images export symbol: %s\n", queries[i].symbol);
+            result = 1;
+        }
+    }
+
+    if (fflush(stdout) != 0) {
+        fputs("Failed to write to stdout\n", stderr);
+        result = 1;
+    }
+
+    tbd_create_info_destroy(&info);
+    libtbd_context_destroy(&ctx);
+
+    dyld_shared_cache_info_destroy(&dsc_info);
+    free(queries);
+
+    return result;
+}
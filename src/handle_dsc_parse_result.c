@@ -769,5 +769,13 @@ print_dsc_image_parse_error(const char *__notnull const image_path,
                     image_path);
 
             break;
+
+        case E_DSC_IMAGE_PARSE_BUDGET_EXCEEDED:
+            fprintf(stderr,
+                    "Image (with path %s) took more work to parse than its "
+                    "budget allows, skipping\r\n",
+                    image_path);
+
+            break;
     }
 }
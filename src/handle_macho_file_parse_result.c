@@ -1315,6 +1315,26 @@ handle_macho_file_parse_result(const char *__notnull const dir_path,
                       stderr);
             }
 
+            break;
+
+        case E_MACHO_FILE_PARSE_BUDGET_EXCEEDED:
+            if (is_recursing) {
+                fprintf(stderr,
+                        "Mach-o file (at path %s/%s) took more work to parse "
+                        "than its budget allows, skipping\n",
+                        dir_path,
+                        name);
+            } else if (print_paths) {
+                fprintf(stderr,
+                        "Mach-o file (at path %s) took more work to parse "
+                        "than its budget allows, skipping\n",
+                        dir_path);
+            } else {
+                fputs("The provided mach-o file took more work to parse than "
+                      "its budget allows\n",
+                      stderr);
+            }
+
             break;
     }
 }
@@ -0,0 +1,283 @@
+//
+//  src/json_writer.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include "json_writer.h"
+
+static const uint64_t indent_width = 2;
+
+static int
+write_bytes(FILE *__notnull const file,
+            const char *__notnull const bytes,
+            const uint64_t length)
+{
+    if (length == 0) {
+        return 0;
+    }
+
+    if (fwrite(bytes, length, 1, file) != 1) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static int
+write_newline_and_indent(FILE *__notnull const file, const uint64_t depth) {
+    static const char spaces[] = "                                ";
+    static const uint64_t spaces_length = sizeof(spaces) - 1;
+
+    if (fputc('\n', file) == EOF) {
+        return 1;
+    }
+
+    uint64_t length = depth * indent_width;
+    while (length > spaces_length) {
+        if (write_bytes(file, spaces, spaces_length)) {
+            return 1;
+        }
+
+        length -= spaces_length;
+    }
+
+    return write_bytes(file, spaces, length);
+}
+
+/*
+ * Write the comma and newline that come before a value or key, unless the value
+ * directly follows its key.
+ */
+
+static int write_value_prefix(struct json_writer *__notnull const writer) {
+    if (writer->after_key) {
+        writer->after_key = false;
+        return 0;
+    }
+
+    if (writer->needs_comma) {
+        if (fputc(',', writer->file) == EOF) {
+            return 1;
+        }
+    }
+
+    if (writer->depth == 0) {
+        return 0;
+    }
+
+    return write_newline_and_indent(writer->file, writer->depth);
+}
+
+static int
+begin_container(struct json_writer *__notnull const writer, const char ch) {
+    if (write_value_prefix(writer)) {
+        return 1;
+    }
+
+    if (fputc(ch, writer->file) == EOF) {
+        return 1;
+    }
+
+    writer->depth += 1;
+    writer->needs_comma = false;
+
+    return 0;
+}
+
+static int
+end_container(struct json_writer *__notnull const writer, const char ch) {
+    writer->depth -= 1;
+
+    /*
+     * Empty objects and arrays are closed on the same line they're opened on.
+     */
+
+    if (writer->needs_comma) {
+        if (write_newline_and_indent(writer->file, writer->depth)) {
+            return 1;
+        }
+    }
+
+    if (fputc(ch, writer->file) == EOF) {
+        return 1;
+    }
+
+    writer->needs_comma = true;
+    return 0;
+}
+
+int json_writer_begin_object(struct json_writer *__notnull const writer) {
+    return begin_container(writer, '{');
+}
+
+int json_writer_end_object(struct json_writer *__notnull const writer) {
+    return end_container(writer, '}');
+}
+
+int json_writer_begin_array(struct json_writer *__notnull const writer) {
+    return begin_container(writer, '[');
+}
+
+int json_writer_end_array(struct json_writer *__notnull const writer) {
+    return end_container(writer, ']');
+}
+
+/*
+ * Write string in quotes, writing the spans between characters that need to be
+ * escaped with a single fwrite() each.
+ */
+
+static int
+write_escaped_string(FILE *__notnull const file,
+                     const char *__notnull const string,
+                     const uint64_t length)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    if (fputc('"', file) == EOF) {
+        return 1;
+    }
+
+    const char *span = string;
+    const char *const end = string + length;
+
+    for (const char *iter = string; iter != end; iter++) {
+        const unsigned char ch = (unsigned char)*iter;
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            continue;
+        }
+
+        if (write_bytes(file, span, (uint64_t)(iter - span))) {
+            return 1;
+        }
+
+        char escape[6] = { '\\', (char)ch };
+        uint64_t escape_length = 2;
+
+        switch (ch) {
+            case '"':
+            case '\\':
+                break;
+
+            case '\n':
+                escape[1] = 'n';
+                break;
+
+            case '\r':
+                escape[1] = 'r';
+                break;
+
+            case '\t':
+                escape[1] = 't';
+                break;
+
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = hex[ch >> 4];
+                escape[5] = hex[ch & 0xf];
+
+                escape_length = 6;
+                break;
+        }
+
+        if (write_bytes(file, escape, escape_length)) {
+            return 1;
+        }
+
+        span = iter + 1;
+    }
+
+    if (write_bytes(file, span, (uint64_t)(end - span))) {
+        return 1;
+    }
+
+    if (fputc('"', file) == EOF) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int
+json_writer_write_key(struct json_writer *__notnull const writer,
+                      const char *__notnull const key,
+                      const uint64_t length)
+{
+    if (write_value_prefix(writer)) {
+        return 1;
+    }
+
+    if (write_escaped_string(writer->file, key, length)) {
+        return 1;
+    }
+
+    if (write_bytes(writer->file, ": ", 2)) {
+        return 1;
+    }
+
+    writer->after_key = true;
+    return 0;
+}
+
+int
+json_writer_write_string(struct json_writer *__notnull const writer,
+                         const char *__notnull const string,
+                         const uint64_t length)
+{
+    if (write_value_prefix(writer)) {
+        return 1;
+    }
+
+    if (write_escaped_string(writer->file, string, length)) {
+        return 1;
+    }
+
+    writer->needs_comma = true;
+    return 0;
+}
+
+int
+json_writer_write_uint(struct json_writer *__notnull const writer,
+                       uint64_t value)
+{
+    if (write_value_prefix(writer)) {
+        return 1;
+    }
+
+    /*
+     * Write the digits from the end of the buffer backwards, as they're found
+     * from the least-significant digit up.
+     */
+
+    char buffer[20];
+    char *const end = buffer + sizeof(buffer);
+    char *iter = end;
+
+    do {
+        iter--;
+        *iter = (char)('0' + (value % 10));
+
+        value /= 10;
+    } while (value != 0);
+
+    if (write_bytes(writer->file, iter, (uint64_t)(end - iter))) {
+        return 1;
+    }
+
+    writer->needs_comma = true;
+    return 0;
+}
+
+int json_writer_end(struct json_writer *__notnull const writer) {
+    if (fputc('\n', writer->file) == EOF) {
+        return 1;
+    }
+
+    writer->needs_comma = false;
+    return 0;
+}
@@ -0,0 +1,368 @@
+//
+//  src/libtbd.c
+//  tbd
+//
+//  Created by inoahdev on 2/1/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libtbd.h"
+#include "magic_buffer.h"
+#include "our_io.h"
+
+void libtbd_context_init(struct libtbd_context *__notnull const ctx) {
+    const struct libtbd_context empty = {};
+    *ctx = empty;
+}
+
+void libtbd_context_destroy(struct libtbd_context *__notnull const ctx) {
+    sb_destroy(&ctx->export_trie_sb);
+
+    ctx->callback = NULL;
+    ctx->cb_info = NULL;
+}
+
+enum libtbd_result
+libtbd_parse_macho_fd(struct libtbd_context *__notnull const ctx,
+                      struct tbd_create_info *__notnull const info_out,
+                      const int fd,
+                      const struct libtbd_options options,
+                      enum macho_file_parse_result *const result_out)
+{
+    struct magic_buffer magic_buffer = {};
+    struct macho_file macho = {};
+
+    const struct range range = {};
+    const enum macho_file_open_result open_result =
+        macho_file_open(&macho, &magic_buffer, fd, range);
+
+    switch (open_result) {
+        case E_MACHO_FILE_OPEN_OK:
+            break;
+
+        case E_MACHO_FILE_OPEN_READ_FAIL:
+        case E_MACHO_FILE_OPEN_FSTAT_FAIL:
+            return E_LIBTBD_READ_FAIL;
+
+        case E_MACHO_FILE_OPEN_NOT_A_MACHO:
+            return E_LIBTBD_NOT_A_MACHO;
+    }
+
+    const struct macho_file_parse_extra_args extra = {
+        .callback = ctx->callback,
+        .cb_info = ctx->cb_info,
+        .export_trie_sb = &ctx->export_trie_sb
+    };
+
+    info_out->version = options.version;
+
+    const struct tbd_parse_options parse_options =
+        tbd_create_parse_plan(options.parse_options,
+                              options.write_options,
+                              options.version);
+
+    const enum macho_file_parse_result parse_result =
+        macho_file_parse_from_file(info_out,
+                                   &macho,
+                                   extra,
+                                   parse_options,
+                                   options.macho_options);
+
+    if (result_out != NULL) {
+        *result_out = parse_result;
+    }
+
+    if (parse_result != E_MACHO_FILE_PARSE_OK) {
+        return E_LIBTBD_MACHO_PARSE_FAIL;
+    }
+
+    return E_LIBTBD_OK;
+}
+
+enum libtbd_result
+libtbd_parse_macho_path(struct libtbd_context *__notnull const ctx,
+                        struct tbd_create_info *__notnull const info_out,
+                        const char *__notnull const path,
+                        const struct libtbd_options options,
+                        enum macho_file_parse_result *const result_out)
+{
+    const int fd = our_open(path, O_RDONLY, 0);
+    if (fd < 0) {
+        return E_LIBTBD_OPEN_FAIL;
+    }
+
+    const enum libtbd_result result =
+        libtbd_parse_macho_fd(ctx, info_out, fd, options, result_out);
+
+    close(fd);
+    return result;
+}
+
+enum libtbd_result
+libtbd_open_dsc(struct dyld_shared_cache_info *__notnull const dsc_info_out,
+                const char *__notnull const path,
+                const struct libtbd_options options,
+                enum dyld_shared_cache_parse_result *const result_out)
+{
+    const int fd = our_open(path, O_RDONLY, 0);
+    if (fd < 0) {
+        return E_LIBTBD_OPEN_FAIL;
+    }
+
+    struct magic_buffer magic_buffer = {};
+    const enum magic_buffer_result read_magic_result =
+        magic_buffer_read_n(&magic_buffer, fd, 16);
+
+    if (read_magic_result != E_MAGIC_BUFFER_OK) {
+        close(fd);
+        return E_LIBTBD_READ_FAIL;
+    }
+
+    /*
+     * The file can be closed after parsing, as the cache remains mapped until
+     * dyld_shared_cache_info_destroy() is called.
+     */
+
+    const enum dyld_shared_cache_parse_result parse_result =
+        dyld_shared_cache_parse_from_file(dsc_info_out,
+                                          fd,
+                                          (const char *)magic_buffer.buff,
+                                          options.dsc_options);
+
+    close(fd);
+    if (result_out != NULL) {
+        *result_out = parse_result;
+    }
+
+    switch (parse_result) {
+        case E_DYLD_SHARED_CACHE_PARSE_OK:
+            break;
+
+        case E_DYLD_SHARED_CACHE_PARSE_ALLOC_FAIL:
+            return E_LIBTBD_ALLOC_FAIL;
+
+        case E_DYLD_SHARED_CACHE_PARSE_FSTAT_FAIL:
+        case E_DYLD_SHARED_CACHE_PARSE_READ_FAIL:
+        case E_DYLD_SHARED_CACHE_PARSE_MMAP_FAIL:
+            return E_LIBTBD_READ_FAIL;
+
+        case E_DYLD_SHARED_CACHE_PARSE_NOT_A_CACHE:
+            return E_LIBTBD_NOT_A_CACHE;
+
+        case E_DYLD_SHARED_CACHE_PARSE_INVALID_IMAGES:
+        case E_DYLD_SHARED_CACHE_PARSE_INVALID_MAPPINGS:
+        case E_DYLD_SHARED_CACHE_PARSE_OVERLAPPING_RANGES:
+        case E_DYLD_SHARED_CACHE_PARSE_OVERLAPPING_IMAGES:
+        case E_DYLD_SHARED_CACHE_PARSE_OVERLAPPING_MAPPINGS:
+            return E_LIBTBD_DSC_PARSE_FAIL;
+    }
+
+    return E_LIBTBD_OK;
+}
+
+enum libtbd_result
+libtbd_parse_dsc_image(struct libtbd_context *__notnull const ctx,
+                       struct tbd_create_info *__notnull const info_out,
+                       struct dyld_shared_cache_info *__notnull const dsc_info,
+                       struct dyld_cache_image_info *__notnull const image,
+                       const struct libtbd_options options,
+                       enum dsc_image_parse_result *const result_out)
+{
+    info_out->version = options.version;
+
+    const struct tbd_parse_options parse_options =
+        tbd_create_parse_plan(options.parse_options,
+                              options.write_options,
+                              options.version);
+
+    const struct dsc_image_parse_options dsc_image_options = {};
+    const enum dsc_image_parse_result parse_result =
+        dsc_image_parse(info_out,
+                        dsc_info,
+                        image,
+                        ctx->callback,
+                        ctx->cb_info,
+                        &ctx->export_trie_sb,
+                        options.macho_options,
+                        parse_options,
+                        dsc_image_options);
+
+    if (result_out != NULL) {
+        *result_out = parse_result;
+    }
+
+    if (parse_result != E_DSC_IMAGE_PARSE_OK) {
+        return E_LIBTBD_DSC_IMAGE_PARSE_FAIL;
+    }
+
+    return E_LIBTBD_OK;
+}
+
+struct dyld_cache_image_info *
+libtbd_dsc_find_image_with_path(
+    const struct dyld_shared_cache_info *__notnull const dsc_info,
+    const char *__notnull const image_path)
+{
+    const uint8_t *const map = dsc_info->map;
+    const uint64_t map_size = dsc_info->size;
+    const uint64_t image_path_length = strlen(image_path);
+
+    struct dyld_cache_image_info *image = dsc_info->images;
+    const struct dyld_cache_image_info *const end =
+        image + dsc_info->images_count;
+
+    for (; image != end; image++) {
+        const uint32_t location = image->pathFileOffset;
+        if (location >= map_size) {
+            continue;
+        }
+
+        /*
+         * Compare one extra byte to also compare the null-terminator.
+         */
+
+        const uint64_t max_length = map_size - location;
+        if (image_path_length >= max_length) {
+            continue;
+        }
+
+        const char *const path = (const char *)(map + location);
+        if (memcmp(path, image_path, image_path_length + 1) == 0) {
+            return image;
+        }
+    }
+
+    return NULL;
+}
+
+enum libtbd_result
+libtbd_parse_dsc_image_with_path(
+    struct libtbd_context *__notnull const ctx,
+    struct tbd_create_info *__notnull const info_out,
+    struct dyld_shared_cache_info *__notnull const dsc_info,
+    const char *__notnull const image_path,
+    const struct libtbd_options options,
+    enum dsc_image_parse_result *const result_out)
+{
+    struct dyld_cache_image_info *const image =
+        libtbd_dsc_find_image_with_path(dsc_info, image_path);
+
+    if (image == NULL) {
+        return E_LIBTBD_DSC_IMAGE_NOT_FOUND;
+    }
+
+    return libtbd_parse_dsc_image(ctx,
+                                  info_out,
+                                  dsc_info,
+                                  image,
+                                  options,
+                                  result_out);
+}
+
+enum libtbd_result
+libtbd_write_to_file(const struct tbd_create_info *__notnull const info,
+                     FILE *__notnull const file,
+                     const struct libtbd_options options)
+{
+    const enum tbd_create_result create_result =
+        tbd_create_with_info(info, file, options.write_options);
+
+    if (create_result != E_TBD_CREATE_OK) {
+        return E_LIBTBD_WRITE_FAIL;
+    }
+
+    return E_LIBTBD_OK;
+}
+
+enum libtbd_result
+libtbd_write_to_buffer(const struct tbd_create_info *__notnull const info,
+                       char *__notnull const buffer,
+                       const uint64_t capacity,
+                       const struct libtbd_options options,
+                       uint64_t *const length_out)
+{
+    if (capacity == 0) {
+        return E_LIBTBD_BUFFER_TOO_SMALL;
+    }
+
+    FILE *const file = fmemopen(buffer, capacity, "w");
+    if (file == NULL) {
+        return E_LIBTBD_ALLOC_FAIL;
+    }
+
+    const enum tbd_create_result create_result =
+        tbd_create_with_info(info, file, options.write_options);
+
+    /*
+     * A memory-stream can only fail to be written to when the buffer is full,
+     * which may only be found out when the stream's own buffer is flushed.
+     *
+     * As the null-terminator always needs to be written, a stream whose
+     * position reached the capacity has been truncated.
+     */
+
+    const int flush_result = fflush(file);
+    const long position = ftell(file);
+
+    fclose(file);
+
+    if (create_result != E_TBD_CREATE_OK || flush_result != 0) {
+        return E_LIBTBD_BUFFER_TOO_SMALL;
+    }
+
+    if (position < 0 || (uint64_t)position >= capacity) {
+        return E_LIBTBD_BUFFER_TOO_SMALL;
+    }
+
+    if (length_out != NULL) {
+        *length_out = (uint64_t)position;
+    }
+
+    return E_LIBTBD_OK;
+}
+
+enum libtbd_result
+libtbd_write_to_alloc_buffer(const struct tbd_create_info *__notnull const info,
+                             const struct libtbd_options options,
+                             char **__notnull const buffer_out,
+                             uint64_t *const length_out)
+{
+    char *buffer = NULL;
+    size_t size = 0;
+
+    FILE *const file = open_memstream(&buffer, &size);
+    if (file == NULL) {
+        return E_LIBTBD_ALLOC_FAIL;
+    }
+
+    const enum tbd_create_result create_result =
+        tbd_create_with_info(info, file, options.write_options);
+
+    /*
+     * The buffer and size are only updated on fflush() or fclose().
+     */
+
+    if (fclose(file) != 0) {
+        free(buffer);
+        return E_LIBTBD_ALLOC_FAIL;
+    }
+
+    if (create_result != E_TBD_CREATE_OK) {
+        free(buffer);
+        return E_LIBTBD_WRITE_FAIL;
+    }
+
+    *buffer_out = buffer;
+    if (length_out != NULL) {
+        *length_out = size;
+    }
+
+    return E_LIBTBD_OK;
+}
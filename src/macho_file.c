@@ -23,6 +23,7 @@
 #include "macho_file_parse_load_commands.h"
 
 #include "our_io.h"
+#include "parse_budget.h"
 #include "swap.h"
 #include "target_list.h"
 #include "tbd.h"
@@ -176,51 +177,17 @@ call_callback(struct tbd_create_info *__notnull const info_in,
     return false;
 }
 
+/*
+ * Verify the mach_header's flags against those of info_in, or set info_in's
+ * flags if none have been set yet.
+ */
+
 static enum macho_file_parse_result
-parse_thin_file(struct tbd_create_info *__notnull const info_in,
-                const int fd,
-                const struct range container_range,
-                const struct mach_header *const header,
-                const struct arch_info *const arch,
-                struct macho_file_parse_extra_args extra,
-                const bool is_big_endian,
-                const uint64_t arch_index,
-                const struct tbd_parse_options tbd_options,
-                const struct macho_file_parse_options options)
+check_header_flags(struct tbd_create_info *__notnull const info_in,
+                   const struct mach_header *__notnull const header,
+                   const struct macho_file_parse_extra_args extra,
+                   const struct macho_file_parse_options options)
 {
-    const uint32_t magic = header->magic;
-    const bool is_64 = magic_is_64_bit(magic);
-
-    struct macho_file_parse_lc_flags lc_flags = {};
-    uint32_t header_size = sizeof(struct mach_header);
-
-    if (is_64) {
-        const uint64_t container_size = range_get_size(container_range);
-        if (container_size < sizeof(struct mach_header_64)) {
-            return E_MACHO_FILE_PARSE_SIZE_TOO_SMALL;
-        }
-
-        /*
-         * 64-bit mach-o files have a different header (struct mach_header_64),
-         * which only adds an extra uint32_t field to the end of struct
-         * mach_header.
-         */
-
-        const uint64_t offset =
-            container_range.begin + sizeof(struct mach_header_64);
-
-        if (our_lseek(fd, offset, SEEK_SET) < 0) {
-            return E_MACHO_FILE_PARSE_SEEK_FAIL;
-        }
-
-        lc_flags.is_64 = true;
-        header_size = sizeof(struct mach_header_64);
-    }
-
-    if (is_big_endian) {
-        lc_flags.is_big_endian = true;
-    }
-
     const struct tbd_flags info_flags = info_in->fields.flags;
     const uint64_t mh_flags = header->flags;
 
@@ -276,6 +243,61 @@ parse_thin_file(struct tbd_create_info *__notnull const info_in,
         }
     }
 
+    return E_MACHO_FILE_PARSE_OK;
+}
+
+static enum macho_file_parse_result
+parse_thin_file(struct tbd_create_info *__notnull const info_in,
+                const int fd,
+                const struct range container_range,
+                const struct mach_header *const header,
+                const struct arch_info *const arch,
+                struct macho_file_parse_extra_args extra,
+                const bool is_big_endian,
+                const uint64_t arch_index,
+                const struct tbd_parse_options tbd_options,
+                const struct macho_file_parse_options options)
+{
+    const uint32_t magic = header->magic;
+    const bool is_64 = magic_is_64_bit(magic);
+
+    struct macho_file_parse_lc_flags lc_flags = {};
+    uint32_t header_size = sizeof(struct mach_header);
+
+    if (is_64) {
+        const uint64_t container_size = range_get_size(container_range);
+        if (container_size < sizeof(struct mach_header_64)) {
+            return E_MACHO_FILE_PARSE_SIZE_TOO_SMALL;
+        }
+
+        /*
+         * 64-bit mach-o files have a different header (struct mach_header_64),
+         * which only adds an extra uint32_t field to the end of struct
+         * mach_header.
+         */
+
+        const uint64_t offset =
+            container_range.begin + sizeof(struct mach_header_64);
+
+        if (our_lseek(fd, offset, SEEK_SET) < 0) {
+            return E_MACHO_FILE_PARSE_SEEK_FAIL;
+        }
+
+        lc_flags.is_64 = true;
+        header_size = sizeof(struct mach_header_64);
+    }
+
+    if (is_big_endian) {
+        lc_flags.is_big_endian = true;
+    }
+
+    const enum macho_file_parse_result check_flags_result =
+        check_header_flags(info_in, header, extra, options);
+
+    if (check_flags_result != E_MACHO_FILE_PARSE_OK) {
+        return check_flags_result;
+    }
+
     const struct range lc_available_range = {
         .begin = container_range.begin + header_size,
         .end = container_range.end,
@@ -985,6 +1007,10 @@ macho_file_parse_from_file(struct tbd_create_info *__notnull const info_in,
                            const struct tbd_parse_options tbd_options,
                            const struct macho_file_parse_options options)
 {
+    if (info_in->budget != NULL) {
+        parse_budget_start(info_in->budget);
+    }
+
     enum macho_file_parse_result ret = E_MACHO_FILE_PARSE_OK;
 
     const int fd = macho->fd;
@@ -1102,6 +1128,463 @@ macho_file_parse_from_file(struct tbd_create_info *__notnull const info_in,
     return E_MACHO_FILE_PARSE_OK;
 }
 
+bool macho_file_magic_is_valid(const uint32_t magic) {
+    return (magic_is_thin(magic) || magic_is_fat(magic));
+}
+
+static void swap_mach_header(struct mach_header *__notnull const header) {
+    header->cputype = swap_int32(header->cputype);
+    header->cpusubtype = swap_int32(header->cpusubtype);
+
+    header->ncmds = swap_uint32(header->ncmds);
+    header->sizeofcmds = swap_uint32(header->sizeofcmds);
+
+    header->filetype = swap_uint32(header->filetype);
+    header->flags = swap_uint32(header->flags);
+}
+
+/*
+ * The map-based counterpart of parse_thin_file(), where macho points to the
+ * mach_header of the (thin) mach-o file or architecture, and all offsets are
+ * relative to macho.
+ */
+
+static enum macho_file_parse_result
+parse_thin_map(struct tbd_create_info *__notnull const info_in,
+               const uint8_t *__notnull const macho,
+               const uint64_t macho_size,
+               const struct mach_header *__notnull const header,
+               const struct arch_info *const arch,
+               struct macho_file_parse_extra_args extra,
+               const bool is_big_endian,
+               const uint64_t arch_index,
+               const struct tbd_parse_options tbd_options,
+               const struct macho_file_parse_options options)
+{
+    struct macho_file_parse_lc_flags lc_flags = {
+        .is_big_endian = is_big_endian
+    };
+
+    uint32_t header_size = sizeof(struct mach_header);
+    if (magic_is_64_bit(header->magic)) {
+        lc_flags.is_64 = true;
+        header_size = sizeof(struct mach_header_64);
+    }
+
+    if (macho_size < header_size) {
+        return E_MACHO_FILE_PARSE_SIZE_TOO_SMALL;
+    }
+
+    const enum macho_file_parse_result check_flags_result =
+        check_header_flags(info_in, header, extra, options);
+
+    if (check_flags_result != E_MACHO_FILE_PARSE_OK) {
+        return check_flags_result;
+    }
+
+    const struct mf_parse_lc_from_map_info info = {
+        .map = macho,
+        .map_size = macho_size,
+
+        .macho = macho,
+        .macho_size = macho_size,
+
+        .arch = arch,
+        .arch_index = arch_index,
+
+        .available_map_range = {
+            .begin = header_size,
+            .end = macho_size
+        },
+
+        .ncmds = header->ncmds,
+        .sizeofcmds = header->sizeofcmds,
+        .header_size = header_size,
+
+        .tbd_options = tbd_options,
+        .options = options,
+
+        .flags = lc_flags
+    };
+
+    const enum macho_file_parse_result parse_load_commands_result =
+        macho_file_parse_load_commands_from_map(info_in, &info, extra, NULL);
+
+    if (parse_load_commands_result != E_MACHO_FILE_PARSE_OK) {
+        return parse_load_commands_result;
+    }
+
+    return E_MACHO_FILE_PARSE_OK;
+}
+
+/*
+ * A fat-arch of either a 32-bit or 64-bit fat mach-o file, after being
+ * verified.
+ */
+
+struct map_arch {
+    struct range range;
+    const struct arch_info *arch;
+};
+
+static enum macho_file_parse_result
+verify_map_archs(const uint8_t *__notnull const map,
+                 const uint64_t size,
+                 const uint32_t magic,
+                 const uint32_t nfat_arch,
+                 const struct tbd_parse_options tbd_options,
+                 struct map_arch *__notnull const archs)
+{
+    const bool is_64 = magic_is_fat_64(magic);
+    const bool is_big_endian = magic_is_big_endian(magic);
+
+    uint64_t archs_size =
+        (is_64) ? sizeof(struct fat_arch_64) : sizeof(struct fat_arch);
+
+    if (guard_overflow_mul(&archs_size, nfat_arch)) {
+        return E_MACHO_FILE_PARSE_TOO_MANY_ARCHITECTURES;
+    }
+
+    uint64_t total_headers_size = sizeof(struct fat_header);
+    if (guard_overflow_add(&total_headers_size, archs_size)) {
+        return E_MACHO_FILE_PARSE_TOO_MANY_ARCHITECTURES;
+    }
+
+    if (total_headers_size > size) {
+        return E_MACHO_FILE_PARSE_TOO_MANY_ARCHITECTURES;
+    }
+
+    const struct range available_range = {
+        .begin = total_headers_size,
+        .end = size
+    };
+
+    /*
+     * The fat-archs are verified on a copy, as verifying them also swaps them,
+     * and stores their arch-info within them.
+     */
+
+    const uint8_t *const arch_list = map + sizeof(struct fat_header);
+    for (uint32_t i = 0; i != nfat_arch; i++) {
+        struct range arch_range = {};
+        enum macho_file_parse_result verify_arch_result =
+            E_MACHO_FILE_PARSE_OK;
+
+        const struct arch_info *arch_info = NULL;
+        if (is_64) {
+            struct fat_arch_64 arch = {};
+            memcpy(&arch, arch_list + (i * sizeof(arch)), sizeof(arch));
+
+            verify_arch_result =
+                verify_fat_64_arch(&arch,
+                                   0,
+                                   available_range,
+                                   is_big_endian,
+                                   tbd_options,
+                                   &arch_range);
+
+            if (!tbd_options.ignore_targets) {
+                memcpy(&arch_info, &arch.cputype, sizeof(arch_info));
+            }
+        } else {
+            struct fat_arch arch = {};
+            memcpy(&arch, arch_list + (i * sizeof(arch)), sizeof(arch));
+
+            verify_arch_result =
+                verify_fat_32_arch(&arch,
+                                   0,
+                                   available_range,
+                                   is_big_endian,
+                                   tbd_options,
+                                   &arch_range);
+
+            if (!tbd_options.ignore_targets) {
+                memcpy(&arch_info, &arch.cputype, sizeof(arch_info));
+            }
+        }
+
+        if (verify_arch_result != E_MACHO_FILE_PARSE_OK) {
+            return verify_arch_result;
+        }
+
+        /*
+         * Make sure the arch doesn't overlap with any previous archs.
+         */
+
+        for (uint32_t j = 0; j != i; j++) {
+            if (ranges_overlap(arch_range, archs[j].range)) {
+                return E_MACHO_FILE_PARSE_OVERLAPPING_ARCHITECTURES;
+            }
+        }
+
+        archs[i].range = arch_range;
+        archs[i].arch = arch_info;
+    }
+
+    return E_MACHO_FILE_PARSE_OK;
+}
+
+static enum macho_file_parse_result
+handle_fat_map(struct tbd_create_info *__notnull const info_in,
+               const uint8_t *__notnull const map,
+               const uint64_t size,
+               const uint32_t magic,
+               const uint32_t nfat_arch,
+               struct macho_file_parse_extra_args extra,
+               const struct tbd_parse_options tbd_options,
+               const struct macho_file_parse_options options)
+{
+    if (nfat_arch == 0) {
+        return E_MACHO_FILE_PARSE_NO_ARCHITECTURES;
+    }
+
+    struct map_arch *const archs = calloc(nfat_arch, sizeof(struct map_arch));
+    if (archs == NULL) {
+        return E_MACHO_FILE_PARSE_ALLOC_FAIL;
+    }
+
+    const enum macho_file_parse_result verify_archs_result =
+        verify_map_archs(map, size, magic, nfat_arch, tbd_options, archs);
+
+    if (verify_archs_result != E_MACHO_FILE_PARSE_OK) {
+        free(archs);
+        return verify_archs_result;
+    }
+
+    uint32_t filetype = 0;
+
+    bool ignore_filetype = false;
+    bool parsed_one_arch = false;
+
+    for (uint32_t arch_index = 0; arch_index != nfat_arch; arch_index++) {
+        const struct map_arch *const arch = archs + arch_index;
+        const uint8_t *const macho = map + arch->range.begin;
+
+        struct mach_header header = {};
+        memcpy(&header, macho, sizeof(header));
+
+        const bool arch_is_big_endian = magic_is_big_endian(header.magic);
+        if (arch_is_big_endian) {
+            swap_mach_header(&header);
+        } else if (!magic_is_thin(header.magic)) {
+            if (options.skip_invalid_archs) {
+                continue;
+            }
+
+            free(archs);
+            return E_MACHO_FILE_PARSE_INVALID_ARCHITECTURE;
+        }
+
+        if (!ignore_filetype) {
+            if (filetype != 0) {
+                if (header.filetype != filetype) {
+                    const bool should_continue =
+                        call_callback(info_in,
+                                      ERR_MACHO_FILE_PARSE_FILETYPE_CONFLICT,
+                                      extra.callback,
+                                      extra.cb_info);
+
+                    if (!should_continue) {
+                        free(archs);
+                        return E_MACHO_FILE_PARSE_ERROR_PASSED_TO_CALLBACK;
+                    }
+                }
+            } else if (is_invalid_filetype(header.filetype)) {
+                if (!options.ignore_wrong_filetype) {
+                    const bool should_continue =
+                        call_callback(info_in,
+                                      ERR_MACHO_FILE_PARSE_WRONG_FILETYPE,
+                                      extra.callback,
+                                      extra.cb_info);
+
+                    if (!should_continue) {
+                        free(archs);
+                        return E_MACHO_FILE_PARSE_ERROR_PASSED_TO_CALLBACK;
+                    }
+
+                    ignore_filetype = true;
+                }
+            } else {
+                filetype = header.filetype;
+            }
+        }
+
+        /*
+         * Verify that header's cpu-type matches arch's cpu-type.
+         */
+
+        const struct arch_info *const arch_info = arch->arch;
+        if (arch_info != NULL) {
+            if (header.cputype != arch_info->cputype ||
+                header.cpusubtype != arch_info->cpusubtype)
+            {
+                free(archs);
+                return E_MACHO_FILE_PARSE_CONFLICTING_ARCH_INFO;
+            }
+        }
+
+        const enum macho_file_parse_result handle_arch_result =
+            parse_thin_map(info_in,
+                           macho,
+                           range_get_size(arch->range),
+                           &header,
+                           arch_info,
+                           extra,
+                           arch_is_big_endian,
+                           arch_index,
+                           tbd_options,
+                           options);
+
+        if (handle_arch_result != E_MACHO_FILE_PARSE_OK) {
+            free(archs);
+            return handle_arch_result;
+        }
+
+        parsed_one_arch = true;
+    }
+
+    free(archs);
+
+    if (!parsed_one_arch) {
+        return E_MACHO_FILE_PARSE_NO_VALID_ARCHITECTURES;
+    }
+
+    return E_MACHO_FILE_PARSE_OK;
+}
+
+static bool
+is_missing_data(const struct tbd_create_info *__notnull const info_in,
+                const struct tbd_parse_options tbd_options)
+{
+    if (tbd_options.ignore_exports || tbd_options.ignore_missing_exports) {
+        return false;
+    }
+
+    const struct array *const metadata = &info_in->fields.metadata;
+    const struct array *const symbols = &info_in->fields.symbols;
+
+    return (metadata->item_count == 0 && symbols->item_count == 0);
+}
+
+enum macho_file_parse_result
+macho_file_parse_from_map(struct tbd_create_info *__notnull const info_in,
+                          const uint8_t *__notnull const map,
+                          const uint64_t size,
+                          struct macho_file_parse_extra_args extra,
+                          const struct tbd_parse_options tbd_options,
+                          const struct macho_file_parse_options options)
+{
+    if (size < sizeof(struct mach_header)) {
+        return E_MACHO_FILE_PARSE_SIZE_TOO_SMALL;
+    }
+
+    if (info_in->budget != NULL) {
+        parse_budget_start(info_in->budget);
+    }
+
+    uint32_t magic = 0;
+    memcpy(&magic, map, sizeof(magic));
+
+    if (magic_is_fat(magic)) {
+        uint32_t nfat_arch = 0;
+        memcpy(&nfat_arch, map + sizeof(magic), sizeof(nfat_arch));
+
+        if (magic_is_big_endian(magic)) {
+            nfat_arch = swap_uint32(nfat_arch);
+        }
+
+        const enum tbd_ci_set_target_count_result set_count_result =
+            tbd_ci_set_target_count(info_in, nfat_arch);
+
+        if (set_count_result != E_TBD_CI_SET_TARGET_COUNT_OK) {
+            return E_MACHO_FILE_PARSE_ALLOC_FAIL;
+        }
+
+        const enum macho_file_parse_result handle_fat_result =
+            handle_fat_map(info_in,
+                           map,
+                           size,
+                           magic,
+                           nfat_arch,
+                           extra,
+                           tbd_options,
+                           options);
+
+        if (handle_fat_result != E_MACHO_FILE_PARSE_OK) {
+            return handle_fat_result;
+        }
+
+        if (is_missing_data(info_in, tbd_options)) {
+            return E_MACHO_FILE_PARSE_NO_DATA;
+        }
+
+        if (tbd_options.ignore_targets) {
+            info_in->flags.uses_full_targets = true;
+        } else {
+            tbd_ci_sort_info(info_in);
+        }
+
+        return E_MACHO_FILE_PARSE_OK;
+    }
+
+    if (!magic_is_thin(magic)) {
+        return E_MACHO_FILE_PARSE_INVALID_ARCHITECTURE;
+    }
+
+    struct mach_header header = {};
+    memcpy(&header, map, sizeof(header));
+
+    const bool is_big_endian = magic_is_big_endian(magic);
+    if (is_big_endian) {
+        swap_mach_header(&header);
+    }
+
+    if (is_invalid_filetype(header.filetype)) {
+        if (!options.ignore_wrong_filetype) {
+            const bool should_continue =
+                call_callback(info_in,
+                              ERR_MACHO_FILE_PARSE_WRONG_FILETYPE,
+                              extra.callback,
+                              extra.cb_info);
+
+            if (!should_continue) {
+                return E_MACHO_FILE_PARSE_ERROR_PASSED_TO_CALLBACK;
+            }
+        }
+    }
+
+    const struct arch_info *arch = NULL;
+    if (!tbd_options.ignore_targets) {
+        arch = arch_info_for_cputype(header.cputype, header.cpusubtype);
+        if (arch == NULL) {
+            return E_MACHO_FILE_PARSE_UNSUPPORTED_CPUTYPE;
+        }
+    }
+
+    const enum macho_file_parse_result parse_thin_result =
+        parse_thin_map(info_in,
+                       map,
+                       size,
+                       &header,
+                       arch,
+                       extra,
+                       is_big_endian,
+                       0,
+                       tbd_options,
+                       options);
+
+    if (parse_thin_result != E_MACHO_FILE_PARSE_OK) {
+        return parse_thin_result;
+    }
+
+    if (is_missing_data(info_in, tbd_options)) {
+        return E_MACHO_FILE_PARSE_NO_DATA;
+    }
+
+    info_in->flags.uses_full_targets = true;
+    return E_MACHO_FILE_PARSE_OK;
+}
+
 static bool magic_is_fat_32(const uint32_t magic) {
     switch (magic) {
         case FAT_MAGIC:
@@ -6,8 +6,12 @@
 //  Copyright © 2019 - 2020 inoahdev. All rights reserved.
 //
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "dsc_image.h"
 #include "guard_overflow.h"
@@ -15,7 +19,9 @@
 #include "macho_file.h"
 #include "macho_file_parse_export_trie.h"
 #include "our_io.h"
+#include "parse_budget.h"
 #include "string_buffer.h"
+#include "symbol_filter.h"
 
 static inline uint8_t uleb_byte_get_has_next(const uint8_t byte) {
     return (byte & 0x80);
@@ -238,6 +244,72 @@ has_overlapping_range(const struct range list[const 128],
     return false;
 }
 
+/*
+ * A sub-tree of the export-trie, found while splitting the export-trie, that is
+ * parsed on its own.
+ *
+ * Only the tree-nodes on the path to the sub-tree are needed to validate the
+ * sub-tree's own tree-nodes, so their ranges are stored alongside the sub-tree.
+ */
+
+#define TRIE_SPLIT_MAX_DEPTH 8
+
+struct trie_subtree {
+    uint32_t offset;
+    uint32_t prefix_length;
+    uint64_t prefix_offset;
+
+    struct range node_ranges[TRIE_SPLIT_MAX_DEPTH];
+    uint8_t node_ranges_count;
+
+    struct array symbols;
+    enum macho_file_parse_result result;
+};
+
+struct trie_subtrees {
+    struct array list;
+    struct string_buffer prefixes;
+};
+
+static enum macho_file_parse_result
+add_subtree(struct trie_subtrees *__notnull const subtrees,
+            const uint32_t offset,
+            const struct string_buffer *__notnull const prefix,
+            const struct range node_ranges[const 128],
+            const uint8_t node_ranges_count)
+{
+    if (unlikely(node_ranges_count > TRIE_SPLIT_MAX_DEPTH)) {
+        return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+    }
+
+    struct trie_subtree subtree = {
+        .offset = offset,
+        .prefix_length = (uint32_t)prefix->length,
+        .prefix_offset = subtrees->prefixes.length,
+        .node_ranges_count = node_ranges_count
+    };
+
+    memcpy(subtree.node_ranges,
+           node_ranges,
+           sizeof(*node_ranges) * node_ranges_count);
+
+    const enum string_buffer_result add_prefix_result =
+        sb_add_c_str(&subtrees->prefixes, prefix->data, prefix->length);
+
+    if (unlikely(add_prefix_result != E_STRING_BUFFER_OK)) {
+        return E_MACHO_FILE_PARSE_ALLOC_FAIL;
+    }
+
+    const enum array_result add_subtree_result =
+        array_add_item(&subtrees->list, sizeof(subtree), &subtree, NULL);
+
+    if (unlikely(add_subtree_result != E_ARRAY_OK)) {
+        return E_MACHO_FILE_PARSE_ARRAY_FAIL;
+    }
+
+    return E_MACHO_FILE_PARSE_OK;
+}
+
 /*
  * The export-trie is a compressed tree designed to store symbols and other info
  * in an efficient fashion.
@@ -370,8 +442,21 @@ parse_trie_node(struct tbd_create_info *__notnull const info_in,
                 uint8_t node_ranges_count,
                 const uint32_t export_size,
                 struct string_buffer *__notnull const sb_buffer,
-                const struct tbd_parse_options options)
+                const struct tbd_parse_options options,
+                struct trie_subtrees *const subtrees)
 {
+    /*
+     * Tree-nodes may be pointed to by several children, so a malformed
+     * export-trie can have far more tree-nodes to visit than its size suggests.
+     */
+
+    struct parse_budget *const budget = info_in->budget;
+    if (budget != NULL) {
+        if (unlikely(!parse_budget_use_trie_node(budget))) {
+            return E_MACHO_FILE_PARSE_BUDGET_EXCEEDED;
+        }
+    }
+
     const uint8_t *iter = start + offset;
     uint64_t iter_size = 0;
 
@@ -513,6 +598,12 @@ parse_trie_node(struct tbd_create_info *__notnull const info_in,
                 break;
         }
 
+        if (budget != NULL) {
+            if (unlikely(!parse_budget_use_symbol(budget, sb_buffer->length))) {
+                return E_MACHO_FILE_PARSE_BUDGET_EXCEEDED;
+            }
+        }
+
         const enum tbd_ci_add_data_result add_symbol_result =
             tbd_ci_add_symbol_with_info_and_len(info_in,
                                                 sb_buffer->data,
@@ -555,6 +646,8 @@ parse_trie_node(struct tbd_create_info *__notnull const info_in,
     const uint32_t orig_buff_length = (uint32_t)sb_buffer->length;
     const uint8_t orig_node_ranges_count = (uint8_t)node_ranges_count;
 
+    const struct symbol_filter *const filter = info_in->symbol_filter;
+
     for (uint8_t i = 0; i != children_count; i++) {
         /*
          * Pass the length-calculation of the string to strnlen in the hopes of
@@ -600,6 +693,44 @@ parse_trie_node(struct tbd_create_info *__notnull const info_in,
             return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
         }
 
+        /*
+         * Skip the child's entire sub-tree if no symbol starting with the
+         * child's prefix can pass the symbol-filter.
+         */
+
+        if (filter != NULL) {
+            const bool may_match =
+                symbol_filter_may_match_prefix(filter,
+                                               sb_buffer->data,
+                                               sb_buffer->length);
+
+            if (!may_match) {
+                sb_buffer->length = orig_buff_length;
+                continue;
+            }
+        }
+
+        /*
+         * When splitting the export-trie, record the child's sub-tree to be
+         * parsed later instead of descending into it.
+         */
+
+        if (subtrees != NULL) {
+            const enum macho_file_parse_result add_subtree_result =
+                add_subtree(subtrees,
+                            next,
+                            sb_buffer,
+                            node_ranges,
+                            node_ranges_count);
+
+            if (add_subtree_result != E_MACHO_FILE_PARSE_OK) {
+                return add_subtree_result;
+            }
+
+            sb_buffer->length = orig_buff_length;
+            continue;
+        }
+
         const enum macho_file_parse_result parse_export_result =
             parse_trie_node(info_in,
                             arch_index,
@@ -610,7 +741,8 @@ parse_trie_node(struct tbd_create_info *__notnull const info_in,
                             node_ranges_count,
                             export_size,
                             sb_buffer,
-                            options);
+                            options,
+                            NULL);
 
         if (unlikely(parse_export_result != E_MACHO_FILE_PARSE_OK)) {
             return parse_export_result;
@@ -623,6 +755,391 @@ parse_trie_node(struct tbd_create_info *__notnull const info_in,
     return E_MACHO_FILE_PARSE_OK;
 }
 
+/*
+ * Export-tries smaller than this are parsed quickly enough on a single thread
+ * that splitting them would only add overhead.
+ */
+
+#define PARALLEL_TRIE_MIN_SIZE (1ull << 18)
+#define PARALLEL_TRIE_MAX_THREADS 64
+
+/*
+ * Split the export-trie until there are at least this many sub-trees for every
+ * thread, so that a few large sub-trees don't leave the other threads idle.
+ */
+
+#define PARALLEL_TRIE_SUBTREES_PER_THREAD 8
+
+struct trie_job {
+    const struct macho_file_parse_export_trie_args *args;
+
+    const uint8_t *export_trie;
+    const uint8_t *end;
+
+    /*
+     * A copy of the caller's create-info, with no symbols, that every sub-tree
+     * starts out from, so that each sub-tree's symbols are staged in its own
+     * array.
+     */
+
+    struct tbd_create_info info;
+
+    struct trie_subtree *subtrees;
+    uint64_t subtree_count;
+
+    const char *prefixes;
+    atomic_uint_fast64_t next_subtree;
+};
+
+static enum macho_file_parse_result
+parse_subtree(const struct macho_file_parse_export_trie_args *__notnull args,
+              struct tbd_create_info *__notnull const info_in,
+              const uint8_t *__notnull const export_trie,
+              const uint8_t *__notnull const end,
+              const struct trie_subtree *__notnull const subtree,
+              const char *const prefixes,
+              struct string_buffer *__notnull const sb_buffer,
+              struct trie_subtrees *const subtrees)
+{
+    sb_clear(sb_buffer);
+    if (subtree->prefix_length != 0) {
+        const char *const prefix = prefixes + subtree->prefix_offset;
+        const enum string_buffer_result add_prefix_result =
+            sb_add_c_str(sb_buffer, prefix, subtree->prefix_length);
+
+        if (unlikely(add_prefix_result != E_STRING_BUFFER_OK)) {
+            return E_MACHO_FILE_PARSE_ALLOC_FAIL;
+        }
+    }
+
+    struct range node_ranges[128] = {};
+    memcpy(node_ranges,
+           subtree->node_ranges,
+           sizeof(*node_ranges) * subtree->node_ranges_count);
+
+    const enum macho_file_parse_result parse_node_result =
+        parse_trie_node(info_in,
+                        args->arch_index,
+                        export_trie,
+                        subtree->offset,
+                        end,
+                        node_ranges,
+                        subtree->node_ranges_count,
+                        args->export_size,
+                        sb_buffer,
+                        args->tbd_options,
+                        subtrees);
+
+    return parse_node_result;
+}
+
+/*
+ * Every thread takes the next sub-tree no thread has parsed yet, until none
+ * are left. Each thread has its own symbol-buffer for the sub-tree's prefix.
+ */
+
+static void *parse_subtrees_on_thread(void *__notnull const arg) {
+    struct trie_job *const job = (struct trie_job *)arg;
+    struct string_buffer sb_buffer = {};
+
+    do {
+        const uint64_t index = atomic_fetch_add(&job->next_subtree, 1);
+        if (index >= job->subtree_count) {
+            break;
+        }
+
+        struct trie_subtree *const subtree = job->subtrees + index;
+        struct tbd_create_info info = job->info;
+
+        subtree->result =
+            parse_subtree(job->args,
+                          &info,
+                          job->export_trie,
+                          job->end,
+                          subtree,
+                          job->prefixes,
+                          &sb_buffer,
+                          NULL);
+
+        subtree->symbols = info.fields.symbols;
+    } while (true);
+
+    sb_destroy(&sb_buffer);
+    return NULL;
+}
+
+static void
+destroy_subtree_symbols(struct array *__notnull const symbols,
+                        const bool free_strings)
+{
+    struct tbd_symbol_info *info = symbols->data;
+    const struct tbd_symbol_info *const end = symbols->data_end;
+
+    for (; info != end; info++) {
+        if (free_strings) {
+            free(info->string);
+        }
+
+        bit_list_destroy(&info->targets);
+    }
+
+    array_destroy(symbols);
+}
+
+/*
+ * Merge the sorted symbols of every sub-tree into info_in, pairing sub-trees
+ * up so that every symbol is only moved a logarithmic number of times.
+ */
+
+static enum macho_file_parse_result
+merge_subtree_symbols(struct tbd_create_info *__notnull const info_in,
+                      struct trie_subtree *__notnull const subtrees,
+                      const uint64_t count)
+{
+    enum macho_file_parse_result result = E_MACHO_FILE_PARSE_OK;
+    for (uint64_t step = 1; step < count; step <<= 1) {
+        for (uint64_t i = 0; i + step < count; i += (step << 1)) {
+            struct tbd_create_info staging = *info_in;
+            staging.fields.symbols = subtrees[i].symbols;
+
+            const enum tbd_ci_add_data_result merge_result =
+                tbd_ci_merge_sorted_symbols(&staging,
+                                            &subtrees[i + step].symbols);
+
+            subtrees[i].symbols = staging.fields.symbols;
+            if (merge_result != E_TBD_CI_ADD_DATA_OK) {
+                result = E_MACHO_FILE_PARSE_CREATE_SYMBOL_LIST_FAIL;
+            }
+        }
+    }
+
+    if (count != 0) {
+        const enum tbd_ci_add_data_result merge_result =
+            tbd_ci_merge_sorted_symbols(info_in, &subtrees[0].symbols);
+
+        if (merge_result != E_TBD_CI_ADD_DATA_OK) {
+            result = E_MACHO_FILE_PARSE_CREATE_SYMBOL_LIST_FAIL;
+        }
+    }
+
+    /*
+     * Only symbols that failed to be merged are left.
+     */
+
+    const bool free_strings = tbd_ci_owns_strings(info_in);
+    for (uint64_t i = 0; i != count; i++) {
+        destroy_subtree_symbols(&subtrees[i].symbols, free_strings);
+    }
+
+    return result;
+}
+
+static void destroy_subtrees(struct trie_subtrees *__notnull const subtrees) {
+    array_destroy(&subtrees->list);
+    sb_destroy(&subtrees->prefixes);
+}
+
+/*
+ * Split the export-trie, level by level, into enough sub-trees for every
+ * thread. The symbols of the tree-nodes above the sub-trees are added to
+ * info_in directly.
+ */
+
+static enum macho_file_parse_result
+split_trie(const struct macho_file_parse_export_trie_args *__notnull args,
+           const uint8_t *__notnull const export_trie,
+           const uint8_t *__notnull const end,
+           const uint64_t wanted_count,
+           struct trie_subtrees *__notnull const subtrees_out)
+{
+    struct trie_subtrees level = {};
+    const struct trie_subtree root = {};
+
+    if (array_add_item(&level.list, sizeof(root), &root, NULL) != E_ARRAY_OK) {
+        return E_MACHO_FILE_PARSE_ARRAY_FAIL;
+    }
+
+    for (uint8_t depth = 0; depth != TRIE_SPLIT_MAX_DEPTH; depth++) {
+        if (level.list.item_count >= wanted_count) {
+            break;
+        }
+
+        struct trie_subtrees next_level = {};
+
+        const struct trie_subtree *subtree = level.list.data;
+        const struct trie_subtree *const subtrees_end = level.list.data_end;
+
+        for (; subtree != subtrees_end; subtree++) {
+            const enum macho_file_parse_result parse_result =
+                parse_subtree(args,
+                              args->info_in,
+                              export_trie,
+                              end,
+                              subtree,
+                              level.prefixes.data,
+                              args->sb_buffer,
+                              &next_level);
+
+            if (parse_result != E_MACHO_FILE_PARSE_OK) {
+                destroy_subtrees(&next_level);
+                destroy_subtrees(&level);
+
+                return parse_result;
+            }
+        }
+
+        destroy_subtrees(&level);
+        level = next_level;
+
+        if (level.list.item_count == 0) {
+            break;
+        }
+    }
+
+    *subtrees_out = level;
+    return E_MACHO_FILE_PARSE_OK;
+}
+
+static uint64_t get_thread_count(void) {
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1) {
+        return 1;
+    }
+
+    if (count > PARALLEL_TRIE_MAX_THREADS) {
+        return PARALLEL_TRIE_MAX_THREADS;
+    }
+
+    return (uint64_t)count;
+}
+
+/*
+ * Parse the export-trie by splitting it into independent sub-trees, which are
+ * parsed on several threads, each into its own symbols-array.
+ *
+ * Each sub-tree's symbols are sorted just as info_in's symbols are, so they're
+ * merged into info_in afterwards, giving the same result as parsing the whole
+ * export-trie on one thread.
+ */
+
+static enum macho_file_parse_result
+parse_trie_in_parallel(
+    const struct macho_file_parse_export_trie_args *__notnull const args,
+    const uint8_t *__notnull const export_trie,
+    const uint8_t *__notnull const end,
+    const uint64_t thread_count)
+{
+    struct trie_subtrees subtrees = {};
+    const enum macho_file_parse_result split_result =
+        split_trie(args,
+                   export_trie,
+                   end,
+                   thread_count * PARALLEL_TRIE_SUBTREES_PER_THREAD,
+                   &subtrees);
+
+    if (split_result != E_MACHO_FILE_PARSE_OK) {
+        return split_result;
+    }
+
+    struct trie_job job = {
+        .args = args,
+        .export_trie = export_trie,
+        .end = end,
+        .info = *args->info_in,
+        .subtrees = subtrees.list.data,
+        .subtree_count = subtrees.list.item_count,
+        .prefixes = subtrees.prefixes.data
+    };
+
+    const struct array empty = {};
+    job.info.fields.symbols = empty;
+
+    atomic_init(&job.next_subtree, 0);
+
+    uint64_t threads_count = thread_count - 1;
+    if (threads_count > job.subtree_count) {
+        threads_count = job.subtree_count;
+    }
+
+    /*
+     * The current thread parses sub-trees as well, so a failure to create a
+     * thread only means less sub-trees are parsed at once.
+     */
+
+    pthread_t threads[PARALLEL_TRIE_MAX_THREADS];
+    uint64_t created_count = 0;
+
+    for (; created_count != threads_count; created_count++) {
+        pthread_t *const thread = threads + created_count;
+        if (pthread_create(thread, NULL, parse_subtrees_on_thread, &job) != 0) {
+            break;
+        }
+    }
+
+    parse_subtrees_on_thread(&job);
+    for (uint64_t i = 0; i != created_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    enum macho_file_parse_result result = E_MACHO_FILE_PARSE_OK;
+    for (uint64_t i = 0; i != job.subtree_count; i++) {
+        if (job.subtrees[i].result != E_MACHO_FILE_PARSE_OK) {
+            result = job.subtrees[i].result;
+            break;
+        }
+    }
+
+    const enum macho_file_parse_result merge_result =
+        merge_subtree_symbols(args->info_in, job.subtrees, job.subtree_count);
+
+    if (result == E_MACHO_FILE_PARSE_OK) {
+        result = merge_result;
+    }
+
+    destroy_subtrees(&subtrees);
+    return result;
+}
+
+static enum macho_file_parse_result
+parse_trie(const struct macho_file_parse_export_trie_args *__notnull const args,
+           const uint8_t *__notnull const export_trie)
+{
+    const uint8_t *const end = export_trie + args->export_size;
+
+    /*
+     * Symbol-sinks are called in the order symbols are found, and are not
+     * expected to be called from several threads.
+     */
+
+    if (args->parallel &&
+        args->export_size >= PARALLEL_TRIE_MIN_SIZE &&
+        args->info_in->symbol_sink == NULL)
+    {
+        const uint64_t thread_count = get_thread_count();
+        if (thread_count > 1) {
+            return parse_trie_in_parallel(args, export_trie, end, thread_count);
+        }
+    }
+
+    struct range node_ranges[128] = {};
+    const uint8_t node_ranges_count = 0;
+
+    const enum macho_file_parse_result parse_node_result =
+        parse_trie_node(args->info_in,
+                        args->arch_index,
+                        export_trie,
+                        0,
+                        end,
+                        node_ranges,
+                        node_ranges_count,
+                        args->export_size,
+                        args->sb_buffer,
+                        args->tbd_options,
+                        NULL);
+
+    return parse_node_result;
+}
+
 enum macho_file_parse_result
 macho_file_parse_export_trie_from_file(
     const struct macho_file_parse_export_trie_args args,
@@ -675,22 +1192,8 @@ macho_file_parse_export_trie_from_file(
         return E_MACHO_FILE_PARSE_READ_FAIL;
     }
 
-    struct range node_ranges[128] = {};
-
-    const uint8_t node_ranges_count = 0;
-    const uint8_t *const end = export_trie + args.export_size;
-
     const enum macho_file_parse_result parse_node_result =
-        parse_trie_node(args.info_in,
-                        args.arch_index,
-                        export_trie,
-                        0,
-                        end,
-                        node_ranges,
-                        node_ranges_count,
-                        args.export_size,
-                        args.sb_buffer,
-                        args.tbd_options);
+        parse_trie(&args, export_trie);
 
     free(export_trie);
 
@@ -729,22 +1232,8 @@ macho_file_parse_export_trie_from_map(
     }
 
     const uint8_t *const export_trie = map + args.export_off;
-    const uint8_t *const end = export_trie + args.export_size;
-
-    struct range node_ranges[128] = {};
-    uint8_t node_ranges_count = 0;
-
     const enum macho_file_parse_result parse_node_result =
-        parse_trie_node(args.info_in,
-                        args.arch_index,
-                        export_trie,
-                        0,
-                        end,
-                        node_ranges,
-                        node_ranges_count,
-                        args.export_size,
-                        args.sb_buffer,
-                        args.tbd_options);
+        parse_trie(&args, export_trie);
 
     if (parse_node_result != E_MACHO_FILE_PARSE_OK) {
         return parse_node_result;
@@ -752,3 +1241,149 @@ macho_file_parse_export_trie_from_map(
 
     return E_MACHO_FILE_PARSE_OK;
 }
+
+static bool is_valid_export_flags(const uint64_t flags) {
+    const uint8_t kind = (flags & EXPORT_SYMBOL_FLAGS_KIND_MASK);
+    return (kind == EXPORT_SYMBOL_FLAGS_KIND_REGULAR ||
+            kind == EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE ||
+            kind == EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL);
+}
+
+enum macho_file_parse_result
+macho_file_lookup_in_export_trie(
+    const uint8_t *__notnull const export_trie,
+    const uint32_t export_size,
+    const char *__notnull const symbol,
+    const uint64_t length,
+    struct macho_file_export_trie_lookup *__notnull const lookup_out)
+{
+    if (export_size < 2) {
+        return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+    }
+
+    const uint8_t *const end = export_trie + export_size;
+
+    uint32_t offset = 0;
+    uint64_t index = 0;
+
+    lookup_out->found = false;
+
+    /*
+     * From dyld, don't descend an export-trie that gets too deep. As every
+     * tree-node visited counts towards the limit, this also keeps a cyclic
+     * export-trie from being followed forever.
+     */
+
+    for (uint8_t depth = 0; depth != 128; depth++) {
+        const uint8_t *iter = export_trie + offset;
+        uint64_t terminal_size = 0;
+
+        if ((iter = read_uleb128_64(iter, end, &terminal_size)) == NULL) {
+            return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+        }
+
+        /*
+         * The children-count must follow the export-info, if any.
+         */
+
+        if (unlikely(terminal_size >= (uint64_t)(end - iter))) {
+            return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+        }
+
+        if (index == length) {
+            if (terminal_size == 0) {
+                return E_MACHO_FILE_PARSE_OK;
+            }
+
+            uint64_t flags = 0;
+            if (read_uleb128_64(iter, end, &flags) == NULL) {
+                return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+            }
+
+            if (unlikely(!is_valid_export_flags(flags))) {
+                return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+            }
+
+            lookup_out->flags = flags;
+            lookup_out->found = true;
+
+            return E_MACHO_FILE_PARSE_OK;
+        }
+
+        iter += terminal_size;
+
+        const uint8_t children_count = *iter;
+        iter++;
+
+        const char *const rest = symbol + index;
+        const uint64_t rest_length = length - index;
+
+        bool found_child = false;
+        for (uint8_t i = 0; i != children_count; i++) {
+            if (unlikely(iter == end)) {
+                return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+            }
+
+            const char *const label = (const char *)iter;
+
+            const uint32_t max_length = (uint32_t)(end - iter);
+            const uint32_t label_length = (uint32_t)strnlen(label, max_length);
+
+            /*
+             * We can't have the string reach the end of the export-trie.
+             */
+
+            if (unlikely(label_length == max_length)) {
+                return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+            }
+
+            iter += (label_length + 1);
+            if (unlikely(iter == end)) {
+                return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+            }
+
+            /*
+             * No two children of a tree-node have labels starting with the same
+             * character, so only one child can lead to the symbol, and the rest
+             * are skipped without reading their sub-trees.
+             */
+
+            if (label_length == 0 || label[0] != rest[0]) {
+                if ((iter = skip_uleb128(iter, end)) == NULL) {
+                    return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+                }
+
+                continue;
+            }
+
+            if (label_length > rest_length) {
+                return E_MACHO_FILE_PARSE_OK;
+            }
+
+            if (memcmp(label, rest, label_length) != 0) {
+                return E_MACHO_FILE_PARSE_OK;
+            }
+
+            uint32_t next = 0;
+            if (read_uleb128_32(iter, end, &next) == NULL) {
+                return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+            }
+
+            if (unlikely(next >= export_size)) {
+                return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+            }
+
+            offset = next;
+            index += label_length;
+
+            found_child = true;
+            break;
+        }
+
+        if (!found_child) {
+            return E_MACHO_FILE_PARSE_OK;
+        }
+    }
+
+    return E_MACHO_FILE_PARSE_INVALID_EXPORTS_TRIE;
+}
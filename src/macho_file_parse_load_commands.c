@@ -211,7 +211,8 @@ parse_section_from_file(struct tbd_create_info *__notnull const info_in,
         return E_MACHO_FILE_PARSE_READ_FAIL;
     }
 
-    if (tbd_should_parse_objc_constraint(tbd_options, info_in->version)) {
+    const enum tbd_version parse_version = tbd_ci_get_parse_version(info_in);
+    if (tbd_should_parse_objc_constraint(tbd_options, parse_version)) {
         enum tbd_objc_constraint objc_constraint =
             TBD_OBJC_CONSTRAINT_RETAIN_RELEASE;
 
@@ -857,6 +858,15 @@ macho_file_parse_load_commands_from_file(
         return handle_targets_platform_uuid_result;
     }
 
+    /*
+     * Neither the export-trie nor the symbol-table is needed if both exports
+     * and undefineds are ignored.
+     */
+
+    if (tbd_options.ignore_exports && tbd_options.ignore_undefineds) {
+        return E_MACHO_FILE_PARSE_OK;
+    }
+
     enum macho_file_parse_result ret = E_MACHO_FILE_PARSE_OK;
 
     bool parsed_export_trie = false;
@@ -883,6 +893,7 @@ macho_file_parse_load_commands_from_file(
 
                 .is_64 = flags.is_64,
                 .is_big_endian = flags.is_big_endian,
+                .parallel = options.parallel_export_trie,
 
                 .export_off = export_off,
                 .export_size = export_size,
@@ -1016,7 +1027,8 @@ parse_section_from_map(struct tbd_create_info *__notnull const info_in,
     }
 
     const uint32_t flags = image_info->flags;
-    if (tbd_should_parse_objc_constraint(tbd_options, info_in->version)) {
+    const enum tbd_version parse_version = tbd_ci_get_parse_version(info_in);
+    if (tbd_should_parse_objc_constraint(tbd_options, parse_version)) {
         enum tbd_objc_constraint objc_constraint =
             TBD_OBJC_CONSTRAINT_RETAIN_RELEASE;
 
@@ -1463,6 +1475,15 @@ macho_file_parse_load_commands_from_map(
         return handle_targets_platform_uuid_result;
     }
 
+    /*
+     * Neither the export-trie nor the symbol-table is needed if both exports
+     * and undefineds are ignored.
+     */
+
+    if (tbd_options.ignore_exports && tbd_options.ignore_undefineds) {
+        return E_MACHO_FILE_PARSE_OK;
+    }
+
     enum macho_file_parse_result ret = E_MACHO_FILE_PARSE_OK;
 
     bool parsed_export_trie = false;
@@ -1484,6 +1505,27 @@ macho_file_parse_load_commands_from_map(
                 lc_info_out->export_size = export_size;
             }
 
+            /*
+             * The caller parses the export-trie itself, so avoid adding every
+             * export twice.
+             */
+
+            if (options.dont_parse_exports) {
+                if (lc_info_out != NULL) {
+                    if (flags.is_big_endian) {
+                        symtab.symoff = swap_uint32(symtab.symoff);
+                        symtab.nsyms = swap_uint32(symtab.nsyms);
+
+                        symtab.stroff = swap_uint32(symtab.stroff);
+                        symtab.strsize = swap_uint32(symtab.strsize);
+                    }
+
+                    lc_info_out->symtab = symtab;
+                }
+
+                return E_MACHO_FILE_PARSE_OK;
+            }
+
             const struct macho_file_parse_export_trie_args args = {
                 .info_in = info_in,
                 .available_range = parse_info->available_map_range,
@@ -1492,6 +1534,7 @@ macho_file_parse_load_commands_from_map(
 
                 .is_64 = flags.is_64,
                 .is_big_endian = flags.is_big_endian,
+                .parallel = options.parallel_export_trie,
 
                 .export_off = export_off,
                 .export_size = export_size,
@@ -222,7 +222,7 @@ parse_bv_platform(
         return E_MACHO_FILE_PARSE_OK;
     }
 
-    if (tbd_uses_archs(info_in->version)) {
+    if (tbd_uses_archs(tbd_ci_get_parse_version(info_in))) {
         const bool should_continue =
             call_callback(callback,
                           info_in,
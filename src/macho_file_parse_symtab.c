@@ -22,6 +22,7 @@
 
 #include "macho_file_parse_symtab.h"
 #include "our_io.h"
+#include "parse_budget.h"
 
 #include "range.h"
 #include "swap.h"
@@ -89,6 +90,14 @@ handle_symbol(struct tbd_create_info *__notnull const info_in,
         meta_type = TBD_SYMBOL_META_TYPE_UNDEFINED;
     }
 
+    struct parse_budget *const budget = info_in->budget;
+    if (budget != NULL) {
+        const uint64_t length = strnlen(string, max_len);
+        if (unlikely(!parse_budget_use_symbol(budget, length))) {
+            return E_MACHO_FILE_PARSE_BUDGET_EXCEEDED;
+        }
+    }
+
     const enum tbd_ci_add_data_result add_symbol_result =
         tbd_ci_add_symbol_with_info(info_in,
                                     string,
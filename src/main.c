@@ -11,13 +11,20 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "copy.h"
+#include "dir_cache.h"
 #include "dir_recurse.h"
+#include "dsc_cache.h"
+#include "dsc_merge.h"
+#include "export_diff.h"
+#include "export_dump.h"
+#include "export_query.h"
 #include "macho_file.h"
 #include "our_io.h"
 #include "path.h"
@@ -25,11 +32,15 @@
 #include "parse_or_list_fields.h"
 #include "parse_dsc_for_main.h"
 #include "parse_macho_for_main.h"
+#include "parse_tbd_for_main.h"
+#include "parse_zip_for_main.h"
 
 #include "request_user_input.h"
+#include "serve.h"
+#include "string_pool.h"
+#include "symbol_index.h"
 #include "tbd.h"
 #include "tbd_for_main.h"
-#include "tbd_write.h"
 #include "unused.h"
 #include "usage.h"
 #include "util.h"
@@ -43,6 +54,7 @@ struct recurse_callback_info {
 
     struct retained_user_info *retained;
     struct string_buffer *export_trie_sb;
+    struct dir_cache *dir_cache;
 };
 
 static bool
@@ -63,7 +75,8 @@ recurse_directory_callback(const char *__notnull const dir_path,
     struct magic_buffer magic_buffer = {};
 
     const char *const name = dirent->d_name;
-    const bool should_combine = tbd->options.combine_tbds;
+    const bool should_combine =
+        tbd->options.combine_tbds || tbd->options.archive_tbds;
 
     if (tbd->filetypes.macho) {
         struct parse_macho_for_main_args args = {
@@ -83,7 +96,8 @@ recurse_directory_callback(const char *__notnull const dir_path,
             .dont_handle_non_macho_error = true,
             .print_paths = true,
 
-            .export_trie_sb = recurse_info->export_trie_sb
+            .export_trie_sb = recurse_info->export_trie_sb,
+            .dir_cache = recurse_info->dir_cache
         };
 
         if (should_combine) {
@@ -133,7 +147,8 @@ recurse_directory_callback(const char *__notnull const dir_path,
             .dont_handle_non_dsc_error = true,
             .print_paths = true,
 
-            .export_trie_sb = recurse_info->export_trie_sb
+            .export_trie_sb = recurse_info->export_trie_sb,
+            .dir_cache = recurse_info->dir_cache
         };
 
         if (should_combine) {
@@ -170,6 +185,53 @@ recurse_directory_callback(const char *__notnull const dir_path,
         }
     }
 
+    /*
+     * .tbd files are only parsed while recursing when explicitly asked for, as
+     * directories of mach-o files usually also have their own .tbd files.
+     */
+
+    if (tbd->filetypes.tbd && tbd->filetypes.user_provided) {
+        struct parse_tbd_for_main_args args = {
+            .fd = fd,
+            .magic_buffer = &magic_buffer,
+
+            .tbd = tbd,
+            .orig = orig,
+
+            .dir_path = dir_path,
+            .dir_path_length = dir_path_length,
+
+            .name = name,
+            .name_length = name_length,
+
+            .dont_handle_non_tbd_error = true,
+            .print_paths = true,
+
+            .dir_cache = recurse_info->dir_cache
+        };
+
+        if (should_combine) {
+            args.combine_file = recurse_info->combine_file;
+        }
+
+        const enum parse_tbd_for_main_result parse_as_tbd_result =
+            parse_tbd_file_for_main_while_recursing(&args);
+
+        switch (parse_as_tbd_result) {
+            case E_PARSE_TBD_FOR_MAIN_OK:
+                if (should_combine) {
+                    recurse_info->combine_file = args.combine_file;
+                }
+
+                recurse_info->files_parsed += 1;
+                break;
+
+            case E_PARSE_TBD_FOR_MAIN_NOT_A_TBD:
+            case E_PARSE_TBD_FOR_MAIN_OTHER_ERROR:
+                break;
+        }
+    }
+
     close(fd);
     return true;
 }
@@ -231,6 +293,8 @@ static void setup_tbd_for_main(struct tbd_for_main *__notnull const tbd) {
     tbd->info.version = TBD_VERSION_V2;
     tbd->filetypes.macho = true;
     tbd->filetypes.dyld_shared_cache = true;
+    tbd->filetypes.tbd = true;
+    tbd->filetypes.zip = true;
 }
 
 static void
@@ -305,13 +369,12 @@ check_targets(const struct tbd_for_main *__notnull const tbd,
     return 1;
 }
 
-static bool
-verify_tbd_for_main(struct tbd_for_main *__notnull const tbd,
-                    const char *__notnull const path)
+static int
+verify_tbd_version(struct tbd_for_main *__notnull const tbd,
+                   const char *__notnull const path,
+                   int result)
 {
     const enum tbd_version version = tbd->info.version;
-    int result = 0;
-
     switch (version) {
         case TBD_VERSION_NONE:
             fprintf(stderr,
@@ -383,10 +446,43 @@ verify_tbd_for_main(struct tbd_for_main *__notnull const tbd,
             break;
 
         case TBD_VERSION_V4:
+        case TBD_VERSION_V5:
             result = check_objc_constraint(tbd, version, result);
             break;
     }
 
+    return result;
+}
+
+static bool
+verify_tbd_for_main(struct tbd_for_main *__notnull const tbd,
+                    const char *__notnull const path)
+{
+    int result = 0;
+
+    /*
+     * With multiple tbd-versions, the options are checked against every
+     * version, before the create-info is made version-neutral.
+     */
+
+    const uint32_t versions = tbd->versions;
+    if (versions != 0) {
+        for (enum tbd_version version = TBD_VERSION_V1;
+             version <= TBD_VERSION_V5;
+             version++)
+        {
+            if (versions & (1u << version)) {
+                tbd->info.version = version;
+                result = verify_tbd_version(tbd, path, result);
+            }
+        }
+
+        tbd->info.version = TBD_VERSION_V4;
+        tbd->info.flags.version_neutral = true;
+    } else {
+        result = verify_tbd_version(tbd, path, result);
+    }
+
     if (tbd->flags.provided_ignore_current_version) {
         if (tbd->flags.provided_current_version) {
             fprintf(stderr,
@@ -573,408 +669,1211 @@ verify_tbd_for_main(struct tbd_for_main *__notnull const tbd,
     return result;
 }
 
-int main(const int argc, char *const argv[]) {
-    if (argc < 2) {
-        print_usage();
-        return 0;
-    }
+struct main_run_info {
+    struct retained_user_info *retained;
+    struct string_buffer *export_trie_sb;
 
     /*
-     * Store an index into the tbds array indicating the "current" tbd for when
-     * we parsing output arguments.
+     * An optional cache of mapped dyld_shared_cache files, for when multiple
+     * tbds are likely to parse the same dyld_shared_cache file.
      */
 
-    struct array tbds = {};
-    uint64_t current_tbd_index = 0;
+    struct dsc_cache *dsc_cache;
+    struct dir_cache *dir_cache;
 
-    bool has_stdout = false;
-    bool will_parse_export_trie = false;
+    /*
+     * Every tbd of the run interns its strings in the same string-pool, so
+     * that strings repeated across images are only stored once.
+     */
 
-    for (int index = 1; index != argc; index++) {
-        /*
-         * Every argument parsed in this loop should be an option. Any extra
-         * arguments, like a path-string, should be parsed by the option it
-         * belongs to.
-         */
+    struct string_pool *string_pool;
+    bool print_paths : 1;
+};
 
-        const char *const argument = argv[index];
-        const char argument_front = argument[0];
+static int
+recurse_directory_for_main(struct tbd_for_main *__notnull const tbd,
+                           struct tbd_for_main *__notnull const copy,
+                           const struct main_run_info *__notnull const info)
+{
+    const struct tbd_for_main_options options = tbd->options;
+    /*
+     * We have to check write_path here, as its possible the
+     * output-command was not provided, leaving the write_path NULL.
+     */
 
-        if (argument_front != '-') {
-            fprintf(stderr,
-                    "Unrecognized argument (at index %d): %s\n",
-                    index,
-                    argument);
+    if (tbd->write_path == NULL) {
+        fputs("Writing to stdout (the terminal) while recursing a "
+              "directory is not supported.\nPlease provide a directory "
+              "to write all created files to\n",
+              stderr);
 
-            destroy_tbds_array(&tbds);
-            return 1;
-        }
+        return 1;
+    }
 
-        const char *option = argument + 1;
-        const char option_front = option[0];
+    struct recurse_callback_info recurse_info = {
+        .tbd = copy,
+        .orig = tbd,
+        .retained = info->retained,
+        .export_trie_sb = info->export_trie_sb,
+        .dir_cache = info->dir_cache
+    };
+
+    enum dir_recurse_result recurse_dir_result = E_DIR_RECURSE_OK;
+    if (options.recurse_subdirectories) {
+        recurse_dir_result =
+            dir_recurse_with_subdirs(tbd->parse_path,
+                                     tbd->parse_path_length,
+                                     O_RDONLY,
+                                     &recurse_info,
+                                     recurse_directory_callback,
+                                     recurse_directory_fail_callback);
+    } else {
+        recurse_dir_result =
+            dir_recurse(tbd->parse_path,
+                        tbd->parse_path_length,
+                        O_RDONLY,
+                        &recurse_info,
+                        recurse_directory_callback,
+                        recurse_directory_fail_callback);
+    }
 
-        if (option_front == '-') {
-            option += 1;
+    if (recurse_dir_result != E_DIR_RECURSE_OK) {
+        if (info->print_paths) {
+            fprintf(stderr,
+                    "Failed to recurse directory (at path %s), "
+                    "error: %s\n",
+                    tbd->parse_path,
+                    strerror(errno));
+        } else {
+            fprintf(stderr,
+                    "Failed to recurse directory at the provided path, "
+                    "error: %s\n",
+                    strerror(errno));
         }
+    }
 
-        if (strcmp(option, "h") == 0 || strcmp(option, "help") == 0) {
-            if (index != 1 || argc != 2) {
-                fprintf(stderr, "%s needs to be run by itself\n", argument);
-                destroy_tbds_array(&tbds);
-
-                return 1;
-            }
+    if (recurse_info.files_parsed == 0) {
+        if (info->print_paths) {
+            fprintf(stderr,
+                    "No new .tbd files were created while parsing "
+                    "directory (at path %s)\n",
+                    tbd->parse_path);
+        } else {
+            fputs("No new .tbd files were created while parsing "
+                  "directory at the provided path\n",
+                  stderr);
+        }
+    }
 
-            print_usage();
-            return 0;
-        } else if (strcmp(option, "o") == 0 || strcmp(option, "output") == 0) {
-            index += 1;
-            if (index == argc) {
-                fputs("Please provide either a path to a write-file or "
-                      "\"stdout\" to print to stdout (terminal)\n",
+    if (recurse_info.combine_file != NULL) {
+        if (tbd_for_main_write_combine_end(tbd, recurse_info.combine_file)) {
+            if (info->print_paths) {
+                fprintf(stderr,
+                        "Failed to write footer for combined .tbd file "
+                        "for files from directory (at path %s)\n",
+                        tbd->parse_path);
+            } else {
+                fputs("Failed to write footer for combined .tbd file "
+                      "for files from directory at the provided path\n",
                       stderr);
-
-                destroy_tbds_array(&tbds);
-                return 1;
             }
 
-            struct tbd_for_main *const tbd =
-                array_get_item_at_index_unsafe(&tbds,
-                                               sizeof(struct tbd_for_main),
-                                               current_tbd_index);
+            return 1;
+        }
 
-            if (tbd == NULL) {
-                /*
-                 * Subtract one from the index to get the index of the '-o' arg.
-                 */
+        fclose(recurse_info.combine_file);
+    }
 
-                fprintf(stderr,
-                        "No corresponding tbd exists for output arguments at "
-                        "index: %d\n",
-                        index - 1);
+    /*
+     * Since user-input can modify tbd (orig) to set info for all
+     * created .tbd files, there may be some shared (and allocated) info
+     * between both copy and `tbd`.
+     *
+     * To handle this situation, we destroy copy, because copy will
+     * likely have more allocated information than `tbd`.
+     *
+     * tbd on the other hand is cleared with memset(), and not
+     * destroyed, to avoid a double-free.
+     */
 
-                destroy_tbds_array(&tbds);
-                return 1;
-            }
+    tbd_for_main_destroy(copy);
+    memset(tbd, 0, sizeof(*tbd));
+    return 0;
+}
 
-            bool found_path = false;
-            for (; index != argc; index++) {
-                /*
-                 * Here, we can either receive an option or a path-string, so
-                 * the same validation as above cannot be carried out here.
-                 */
+static void
+parse_file_for_main(struct tbd_for_main *__notnull const tbd,
+                    struct tbd_for_main *__notnull const copy,
+                    const int fd,
+                    const struct main_run_info *__notnull const info)
+{
+    char *const parse_path = tbd->parse_path;
 
-                const char *const in_arg = argv[index];
-                const char in_arg_front = in_arg[0];
+    /*
+     * We need to store a buffer to read magic.
+     */
 
-                if (in_arg_front == '-') {
-                    const char *in_opt = in_arg + 1;
-                    const char in_opt_front = in_opt[0];
+    struct magic_buffer magic_buffer = {};
+    if (tbd->filetypes.macho) {
+        struct parse_macho_for_main_args args = {
+            .fd = fd,
+            .magic_buffer = &magic_buffer,
+            .retained = info->retained,
 
-                    if (in_opt_front == '-') {
-                        in_opt += 1;
-                    }
+            .tbd = copy,
+            .orig = tbd,
 
-                    if (strcmp(in_opt, "preserve-subdirs") == 0) {
-                        tbd->options.preserve_directory_subdirs = true;
-                    } else if (strcmp(in_opt, "no-overwrite") == 0) {
-                        tbd->options.no_overwrite = true;
-                    } else if (strcmp(in_opt, "replace-path-extension") == 0) {
-                        tbd->options.replace_path_extension = true;
-                    } else if (strcmp(in_opt, "combine-tbds") == 0) {
-                        tbd->options.combine_tbds = true;
-                    } else {
-                        fprintf(stderr, "Unrecognized option: %s\n", in_arg);
-                        destroy_tbds_array(&tbds);
+            .dir_path = parse_path,
+            .dir_path_length = tbd->parse_path_length,
 
-                        return 1;
-                    }
+            .dont_handle_non_macho_error = false,
+            .print_paths = info->print_paths,
 
-                    continue;
-                }
+            .export_trie_sb = info->export_trie_sb,
+            .dir_cache = info->dir_cache,
 
-                /*
-                 * We only allow printing to stdout for single-files, and
-                 * not when recursing directories.
-                 */
+            .options.verify_write_path = true
+        };
 
-                const char *const path = in_arg;
-                if (strcmp(path, "stdout") == 0) {
-                    if (tbd->options.recurse_directories) {
-                        fputs("Writing to stdout (terminal) while recursing "
-                              "a directory is not supported.\nPlease provide "
-                              "a directory to write all created files to\n",
-                              stderr);
+        /*
+         * We're only supposed to print the non-macho error if no other
+         * filetypes are enabled.
+         */
 
-                        destroy_tbds_array(&tbds);
-                        return 1;
-                    }
+        if (tbd->filetypes.dyld_shared_cache ||
+            tbd->filetypes.tbd ||
+            tbd->filetypes.zip)
+        {
+            args.dont_handle_non_macho_error = true;
+        }
 
-                    if (has_stdout) {
-                        fputs("Printing more than one file to stdout is not "
-                              "allowed\n",
-                              stderr);
+        const enum parse_macho_for_main_result parse_result =
+            parse_macho_file_for_main(args);
 
-                        destroy_tbds_array(&tbds);
-                        return 1;
-                    }
+        if (parse_result != E_PARSE_MACHO_FOR_MAIN_NOT_A_MACHO) {
+            return;
+        }
+    }
 
-                    found_path = true;
-                    has_stdout = true;
+    if (tbd->filetypes.dyld_shared_cache) {
+        struct parse_dsc_for_main_args args = {
+            .fd = fd,
+            .magic_buffer = &magic_buffer,
+            .retained = info->retained,
 
-                    continue;
-                }
+            .tbd = copy,
+            .orig = tbd,
 
-                /*
-                 * Ensure options for recursing directories are not being
-                 * provided for other contexts and circumstances.
-                 *
-                 * We allow dyld_shared_cache files to slip through as they can
-                 * be exported to a directory due to the fact that they store
-                 * multiple mach-o images.
-                 */
+            .dsc_dir_path = parse_path,
+            .dsc_dir_path_length = tbd->parse_path_length,
 
-                const struct tbd_for_main_options options = tbd->options;
-                if (!options.recurse_directories &&
-                    !tbd->filetypes.dyld_shared_cache)
-                {
-                    if (options.preserve_directory_subdirs) {
-                        fputs("Option --preserve-subdirs can only be provided "
-                              "for either recursing directoriess, or parsing "
-                              "dyld_shared_cache files\n",
-                              stderr);
+            .dont_handle_non_dsc_error = false,
+            .print_paths = info->print_paths,
 
-                        destroy_tbds_array(&tbds);
-                        return 1;
-                    }
+            .export_trie_sb = info->export_trie_sb,
+            .dsc_cache = info->dsc_cache,
+            .dir_cache = info->dir_cache,
 
-                    if (options.replace_path_extension) {
-                        fputs("Option --replace-path-extension can only be "
-                              "provided for recursing directories.\nYou can "
-                              "change the extension of your write-file when "
-                              "not recursing by changing the extension in its "
-                              "path-string\n",
-                              stderr);
+            .options.verify_write_path = true
+        };
 
-                        destroy_tbds_array(&tbds);
-                        return 1;
-                    }
+        if (tbd->filetypes.tbd || tbd->filetypes.zip) {
+            args.dont_handle_non_dsc_error = true;
+        }
 
-                    if (options.combine_tbds) {
-                        fputs("Option --combine-tbds can only be provided "
-                              "recursing directories and parsing "
-                              "dyld_shared_cache files\n",
-                              stderr);
+        const enum parse_dsc_for_main_result parse_result =
+            parse_dsc_for_main(args);
 
-                        destroy_tbds_array(&tbds);
-                        return 1;
-                    }
-                }
+        if (parse_result != E_PARSE_DSC_FOR_MAIN_NOT_A_SHARED_CACHE) {
+            return;
+        }
+    }
 
-                /*
-                 * We may have been provided with a path relative to the
-                 * current-directory.
-                 */
+    if (tbd->filetypes.zip) {
+        /*
+         * Messages about a zip-file's members always include its path.
+         */
 
-                uint64_t full_path_length = strlen(path);
-                char *full_path =
-                    path_get_absolute_path(path,
-                                           full_path_length,
-                                           &full_path_length);
+        const char *zip_path = parse_path;
+        uint64_t zip_path_length = tbd->parse_path_length;
 
-                if (full_path == NULL) {
-                    fputs("Failed to allocate memory\n", stderr);
-                    destroy_tbds_array(&tbds);
+        if (zip_path == NULL) {
+            zip_path = "stdin";
+            zip_path_length = 5;
+        }
 
-                    return 1;
-                }
+        const struct parse_zip_for_main_args args = {
+            .fd = fd,
+            .magic_buffer = &magic_buffer,
+            .retained = info->retained,
 
-                /*
-                 * Verify that object at our write-path (if existing) is a
-                 * directory either when recursing, or when parsing a
-                 * dyld_shared_cache file, and a regular file when parsing a
-                 * single file.
-                 */
+            .tbd = copy,
+            .orig = tbd,
 
-                struct stat info = {};
-                if (stat(full_path, &info) == 0) {
-                    if (S_ISREG(info.st_mode)) {
-                        if (options.recurse_directories &&
-                            !tbd->options.combine_tbds)
-                        {
-                            fputs("Writing to a regular file while recursing a "
-                                  "directory is not supported.\nTo combine all "
-                                  ".tbds into a single file, please provide "
-                                  "the --combine option.\nOtherwise, please "
-                                  "provide a directory to write all found "
-                                  "files to\n",
-                                  stderr);
-
-                            if (full_path != path) {
-                                free(full_path);
-                            }
-
-                            destroy_tbds_array(&tbds);
-                            return 1;
-                        }
-                    } else if (S_ISDIR(info.st_mode)) {
-                        if (!options.recurse_directories &&
-                            !tbd->filetypes.dyld_shared_cache)
-                        {
-                            fputs("Writing to a directory while parsing a "
-                                  "single mach-o file is not supported.\n"
-                                  "Please provide a path to a file to write "
-                                  "the provided mach-o file's .tbd file\n",
-                                  stderr);
-
-                            if (full_path != path) {
-                                free(full_path);
-                            }
-
-                            destroy_tbds_array(&tbds);
-                            return 1;
-                        }
-
-                        if (options.combine_tbds) {
-                            fputs("We cannot combine all tbds to a single file "
-                                  "and write to a directory.\nPlease provide a "
-                                  "path to a file to write the created .tbd(s)"
-                                  "\n",
-                                  stderr);
-
-                            if (full_path != path) {
-                                free(full_path);
-                            }
-
-                            destroy_tbds_array(&tbds);
-                            return 1;
-                        }
-                    }
-                }
+            .path = zip_path,
+            .path_length = zip_path_length,
 
-                /*
-                 * Copy the path (if still from argv) to allow open_r to create
-                 * the file, as modifying full_path's memory is necessary.
-                 */
+            .dont_handle_non_zip_error = tbd->filetypes.tbd,
+            .print_paths = info->print_paths,
 
-                if (full_path == path) {
-                    full_path = alloc_and_copy(full_path, full_path_length);
-                    if (full_path == NULL) {
-                        fputs("Failed to allocate memory\n", stderr);
-                        destroy_tbds_array(&tbds);
+            .export_trie_sb = info->export_trie_sb,
+            .dir_cache = info->dir_cache
+        };
 
-                        return 1;
-                    }
-                }
+        const enum parse_zip_for_main_result parse_result =
+            parse_zip_for_main(&args);
 
-                tbd->write_path = full_path;
-                tbd->write_path_length = full_path_length;
-                found_path = true;
+        if (parse_result != E_PARSE_ZIP_FOR_MAIN_NOT_A_ZIP) {
+            return;
+        }
+    }
 
-                break;
-            }
+    if (tbd->filetypes.tbd) {
+        const struct parse_tbd_for_main_args args = {
+            .fd = fd,
+            .magic_buffer = &magic_buffer,
 
-            if (!found_path) {
-                fputs("Please provide either a path to a write-file or "
-                      "\"stdout\" to print to stdout (terminal)\n",
-                      stderr);
+            .tbd = copy,
+            .orig = tbd,
 
-                destroy_tbds_array(&tbds);
-                return 1;
-            }
+            .dir_path = parse_path,
+            .dir_path_length = tbd->parse_path_length,
 
-            current_tbd_index += 1;
-        } else if (strcmp(option, "p") == 0 || strcmp(option, "path") == 0) {
-            index += 1;
-            if (index == argc) {
-                fputs("Please provide either a path to a mach-o file, a path "
-                      "to a dyld_shared_cache file, or \"stdin\" to parse from "
-                      "terminal input\n",
-                      stderr);
+            .dont_handle_non_tbd_error = false,
+            .print_paths = info->print_paths,
 
-                destroy_tbds_array(&tbds);
-                return 1;
-            }
+            .dir_cache = info->dir_cache
+        };
 
-            struct tbd_for_main tbd = {};
-            setup_tbd_for_main(&tbd);
+        const enum parse_tbd_for_main_result parse_result =
+            parse_tbd_file_for_main(args);
 
-            bool found_path = false;
-            for (; index != argc; index++) {
-                const char *const inner_arg = argv[index];
-                const char inner_arg_front = inner_arg[0];
+        if (parse_result != E_PARSE_TBD_FOR_MAIN_NOT_A_TBD) {
+            return;
+        }
+    }
 
-                if (inner_arg_front == '-') {
-                    const char *inner_opt = inner_arg + 1;
-                    const char inner_opt_front = inner_opt[0];
+    if (!tbd->filetypes.user_provided) {
+        if (info->print_paths) {
+            fputs("File (at path %s) is not among any of the provided "
+                  "filetypes\n",
+                  stderr);
+        } else {
+            fputs("File at the provided path is not among any of the "
+                  "provided filetypes\n",
+                  stderr);
+        }
+    } else {
+        if (info->print_paths) {
+            fputs("File (at path %s) is not among any of the supported "
+                  "filetypes\n",
+                  stderr);
+        } else {
+            fputs("File at the provided path is not among any of the "
+                  "supported filetypes\n",
+                  stderr);
+        }
+    }
+}
+
+static bool
+write_all(const int fd, const char *__notnull buffer, uint64_t size) {
+    while (size != 0) {
+        const ssize_t written = our_write(fd, buffer, size);
+        if (written < 0) {
+            return false;
+        }
+
+        buffer += written;
+        size -= (uint64_t)written;
+    }
+
+    return true;
+}
+
+/*
+ * Piped input can neither be seeked through nor mapped, so stdin is read once,
+ * in large chunks, into an anonymous file, which every parser can then use
+ * like a regular file. stdin is used directly when it's already a regular file.
+ */
+
+#define STDIN_CHUNK_SIZE (1024 * 1024)
+
+static int open_stdin_for_parsing(void) {
+    struct stat info = {};
+    if (fstat(STDIN_FILENO, &info) == 0 && S_ISREG(info.st_mode)) {
+        return dup(STDIN_FILENO);
+    }
+
+    const int fd = our_create_anonymous_file();
+    if (fd < 0) {
+        return -1;
+    }
+
+    char *const chunk = malloc(STDIN_CHUNK_SIZE);
+    if (chunk == NULL) {
+        fputs("Failed to allocate memory\n", stderr);
+        exit(1);
+    }
+
+    do {
+        const ssize_t read_size =
+            our_read(STDIN_FILENO, chunk, STDIN_CHUNK_SIZE);
+
+        if (read_size == 0) {
+            break;
+        }
+
+        if (read_size < 0 || !write_all(fd, chunk, (uint64_t)read_size)) {
+            const int error = errno;
+
+            free(chunk);
+            close(fd);
+
+            errno = error;
+            return -1;
+        }
+    } while (true);
+
+    free(chunk);
+
+    if (our_lseek(fd, 0, SEEK_SET) < 0) {
+        const int error = errno;
+        close(fd);
+
+        errno = error;
+        return -1;
+    }
+
+    return fd;
+}
+
+static int
+run_tbd_for_main(struct tbd_for_main *__notnull const tbd,
+                 const struct main_run_info *__notnull const info)
+{
+    /*
+     * To allow user-input to modify tbd-info for single files, we create a
+     * copy of tbd to separate the initial info from the user-input info.
+     */
+
+    tbd->info.string_pool = info->string_pool;
+
+    struct tbd_for_main copy = *tbd;
+    if (tbd->options.recurse_directories) {
+        return recurse_directory_for_main(tbd, &copy, info);
+    }
+
+    /*
+     * parse_path is only NULL when stdin was provided as the path.
+     */
+
+    if (tbd->parse_path == NULL) {
+        const int fd = open_stdin_for_parsing();
+        if (fd >= 0) {
+            parse_file_for_main(tbd, &copy, fd, info);
+            close(fd);
+        } else {
+            fprintf(stderr,
+                    "Failed to read from stdin, error: %s\n",
+                    strerror(errno));
+        }
+    } else {
+        const int fd = our_open(tbd->parse_path, O_RDONLY, 0);
+        if (fd >= 0) {
+            parse_file_for_main(tbd, &copy, fd, info);
+            close(fd);
+        } else {
+            if (info->print_paths) {
+                fprintf(stderr,
+                        "Failed to open file (at path %s), error: %s\n",
+                        tbd->parse_path,
+                        strerror(errno));
+            } else {
+                fprintf(stderr,
+                        "Failed to open the file at the provided path, "
+                        "error: %s\n",
+                        strerror(errno));
+            }
+        }
+    }
+
+    /*
+     * As when recursing, copy is destroyed instead of tbd, as copy likely has
+     * more allocated information than tbd.
+     */
+
+    tbd_for_main_destroy(&copy);
+    memset(tbd, 0, sizeof(*tbd));
+
+    return 0;
+}
+
+/*
+ * Parse the path-options and path following -p/--path, with index_in pointing
+ * to the first argument after -p/--path.
+ *
+ * On return, index_in points to the argument of the path.
+ */
+
+static int
+parse_path_arguments(int *__notnull const index_in,
+                     struct tbd_for_main *__notnull const tbd,
+                     const int argc,
+                     char *const argv[])
+{
+    int index = *index_in;
+
+    bool found_path = false;
+    for (; index != argc; index++) {
+        const char *const inner_arg = argv[index];
+        const char inner_arg_front = inner_arg[0];
+
+        if (inner_arg_front == '-') {
+            const char *inner_opt = inner_arg + 1;
+            const char inner_opt_front = inner_opt[0];
+
+            if (inner_opt_front == '-') {
+                inner_opt += 1;
+            }
+
+            const bool ret =
+                tbd_for_main_parse_option(&index,
+                                          tbd,
+                                          argc,
+                                          argv,
+                                          inner_opt);
+
+            if (ret) {
+                continue;
+            }
+
+            fprintf(stderr, "Unrecognized option: %s\n", inner_arg);
+            return 1;
+        }
+
+        if (verify_tbd_for_main(tbd, inner_arg)) {
+            return 1;
+        }
+
+        /*
+         * Copy the path, if still from argv, to allow open_r to create
+         * the file.
+         */
+
+        if (tbd->parse_path == inner_arg) {
+            /*
+             * Prevent any ending slashes from being copied to make
+             * directory recursing easier.
+             *
+             * We only need to do this when full_path was not
+             * created with the current-directory, as our path
+             * functions don't append ending slashes.
+             */
+
+            tbd->parse_path_length =
+                remove_end_slashes(tbd->parse_path,
+                                   tbd->parse_path_length);
+
+            tbd->parse_path =
+                alloc_and_copy(tbd->parse_path, tbd->parse_path_length);
+
+            if (tbd->parse_path == NULL) {
+                fputs("Failed to allocate memory\n", stderr);
+                exit(1);
+            }
+        }
+
+        found_path = true;
+        break;
+    }
+
+    if (!found_path) {
+        fputs("Please provide either a path to a mach-o file or "
+              "\"stdin\" to parse from terminal input\n",
+              stderr);
+
+        return 1;
+    }
+
+    *index_in = index;
+    return 0;
+}
+
+static char *
+append_first_version(const struct tbd_for_main *__notnull const tbd,
+                     char *__notnull const path,
+                     uint64_t *__notnull const length_in)
+{
+    enum tbd_version first = TBD_VERSION_V1;
+    while (!(tbd->versions & (1u << first))) {
+        first++;
+    }
+
+    const uint64_t length = *length_in;
+    char *const version_path = malloc(length + 4);
+
+    if (version_path == NULL) {
+        fputs("Failed to allocate memory\n", stderr);
+        exit(1);
+    }
+
+    memcpy(version_path, path, length);
+    version_path[length] = '-';
+
+    memcpy(version_path + length + 1, tbd_version_to_string(first), 3);
+    free(path);
+
+    *length_in = length + 3;
+    return version_path;
+}
+
+/*
+ * Parse the output-options and path following -o/--output, with index_in
+ * pointing to the first argument after -o/--output.
+ *
+ * On return, index_in points to the argument of the path.
+ */
+
+static int
+parse_output_arguments(int *__notnull const index_in,
+                       struct tbd_for_main *__notnull const tbd,
+                       const int argc,
+                       char *const argv[],
+                       bool *__notnull const has_stdout)
+{
+    int index = *index_in;
+
+    bool found_path = false;
+    for (; index != argc; index++) {
+        /*
+         * Here, we can either receive an option or a path-string, so
+         * the same validation as in main() cannot be carried out here.
+         */
+
+        const char *const in_arg = argv[index];
+        const char in_arg_front = in_arg[0];
+
+        if (in_arg_front == '-') {
+            const char *in_opt = in_arg + 1;
+            const char in_opt_front = in_opt[0];
+
+            if (in_opt_front == '-') {
+                in_opt += 1;
+            }
+
+            if (strcmp(in_opt, "preserve-subdirs") == 0) {
+                tbd->options.preserve_directory_subdirs = true;
+            } else if (strcmp(in_opt, "no-overwrite") == 0) {
+                tbd->options.no_overwrite = true;
+            } else if (strcmp(in_opt, "replace-path-extension") == 0) {
+                tbd->options.replace_path_extension = true;
+            } else if (strcmp(in_opt, "combine-tbds") == 0) {
+                tbd->options.combine_tbds = true;
+            } else if (strcmp(in_opt, "archive") == 0) {
+                tbd->options.archive_tbds = true;
+            } else if (strcmp(in_opt, "write-if-changed") == 0) {
+                tbd->options.write_if_changed = true;
+            } else {
+                fprintf(stderr, "Unrecognized option: %s\n", in_arg);
+                return 1;
+            }
+
+            continue;
+        }
+
+        /*
+         * We only allow printing to stdout for single-files, and
+         * not when recursing directories.
+         */
+
+        const char *const path = in_arg;
+        if (strcmp(path, "stdout") == 0) {
+            if (tbd->options.recurse_directories) {
+                fputs("Writing to stdout (terminal) while recursing "
+                      "a directory is not supported.\nPlease provide "
+                      "a directory to write all created files to\n",
+                      stderr);
+
+                return 1;
+            }
+
+            if (*has_stdout) {
+                fputs("Printing more than one file to stdout is not "
+                      "allowed\n",
+                      stderr);
+
+                return 1;
+            }
+
+            if (tbd->options.archive_tbds) {
+                fputs("Writing an archive to stdout (the terminal) is not "
+                      "supported.\nPlease provide a path to write the "
+                      "archive to\n",
+                      stderr);
+
+                return 1;
+            }
+
+            found_path = true;
+            *has_stdout = true;
+
+            break;
+        }
+
+        /*
+         * Ensure options for recursing directories are not being
+         * provided for other contexts and circumstances.
+         *
+         * We allow dyld_shared_cache files to slip through as they can
+         * be exported to a directory due to the fact that they store
+         * multiple mach-o images.
+         */
+
+        const struct tbd_for_main_options options = tbd->options;
+        if (!options.recurse_directories &&
+            !tbd->filetypes.dyld_shared_cache)
+        {
+            if (options.preserve_directory_subdirs) {
+                fputs("Option --preserve-subdirs can only be provided "
+                      "for either recursing directoriess, or parsing "
+                      "dyld_shared_cache files\n",
+                      stderr);
+
+                return 1;
+            }
+
+            if (options.replace_path_extension) {
+                fputs("Option --replace-path-extension can only be "
+                      "provided for recursing directories.\nYou can "
+                      "change the extension of your write-file when "
+                      "not recursing by changing the extension in its "
+                      "path-string\n",
+                      stderr);
+
+                return 1;
+            }
+
+            if (options.combine_tbds) {
+                fputs("Option --combine-tbds can only be provided "
+                      "recursing directories and parsing "
+                      "dyld_shared_cache files\n",
+                      stderr);
+
+                return 1;
+            }
+
+            if (options.archive_tbds) {
+                fputs("Option --archive can only be provided recursing "
+                      "directories and parsing dyld_shared_cache files\n",
+                      stderr);
+
+                return 1;
+            }
+        }
+
+        if (options.combine_tbds && options.archive_tbds) {
+            fputs("Options --combine-tbds and --archive cannot both be "
+                  "provided\n",
+                  stderr);
+
+            return 1;
+        }
+
+        /*
+         * A json document can't have other documents appended to it, and so
+         * tbd-version v5 can't be combined into a single file.
+         */
+
+        const bool writes_v5 =
+            (tbd->versions & (1u << TBD_VERSION_V5)) ||
+            (tbd->versions == 0 && tbd->info.version == TBD_VERSION_V5);
+
+        if (options.combine_tbds && writes_v5) {
+            fputs("Option --combine-tbds is not supported for tbd-version "
+                  "v5\n",
+                  stderr);
+
+            return 1;
+        }
+
+        /*
+         * Documents of different tbd-versions can't be mixed in a single
+         * file, as the result isn't a valid .tbd file of any version.
+         */
+
+        if (options.combine_tbds && tbd->versions != 0) {
+            fputs("Option --combine-tbds cannot be provided with multiple "
+                  "tbd-versions\n",
+                  stderr);
+
+            return 1;
+        }
+
+        if (options.write_if_changed &&
+            (options.combine_tbds || options.archive_tbds))
+        {
+            fputs("Option --write-if-changed cannot be provided when "
+                  "writing all tbds to a single file\n",
+                  stderr);
+
+            return 1;
+        }
+
+        /*
+         * We may have been provided with a path relative to the
+         * current-directory.
+         */
+
+        uint64_t full_path_length = strlen(path);
+        char *full_path =
+            path_get_absolute_path(path,
+                                   full_path_length,
+                                   &full_path_length);
+
+        if (full_path == NULL) {
+            fputs("Failed to allocate memory\n", stderr);
+            return 1;
+        }
+
+        /*
+         * Verify that object at our write-path (if existing) is a
+         * directory either when recursing, or when parsing a
+         * dyld_shared_cache file, and a regular file when parsing a
+         * single file.
+         */
+
+        struct stat info = {};
+        if (stat(full_path, &info) == 0) {
+            if (S_ISREG(info.st_mode)) {
+                if (options.recurse_directories &&
+                    !options.combine_tbds &&
+                    !options.archive_tbds)
+                {
+                    fputs("Writing to a regular file while recursing a "
+                          "directory is not supported.\nTo combine all "
+                          ".tbds into a single file, please provide "
+                          "the --combine option.\nOtherwise, please "
+                          "provide a directory to write all found "
+                          "files to\n",
+                          stderr);
+
+                    if (full_path != path) {
+                        free(full_path);
+                    }
+
+                    return 1;
+                }
+            } else if (S_ISDIR(info.st_mode)) {
+                if (!options.recurse_directories &&
+                    !tbd->filetypes.dyld_shared_cache)
+                {
+                    fputs("Writing to a directory while parsing a "
+                          "single mach-o file is not supported.\n"
+                          "Please provide a path to a file to write "
+                          "the provided mach-o file's .tbd file\n",
+                          stderr);
+
+                    if (full_path != path) {
+                        free(full_path);
+                    }
+
+                    return 1;
+                }
+
+                if (options.combine_tbds || options.archive_tbds) {
+                    fputs("We cannot combine all tbds to a single file "
+                          "and write to a directory.\nPlease provide a "
+                          "path to a file to write the created .tbd(s)"
+                          "\n",
+                          stderr);
+
+                    if (full_path != path) {
+                        free(full_path);
+                    }
+
+                    return 1;
+                }
+            }
+        }
+
+        /*
+         * Copy the path (if still from argv) to allow open_r to create
+         * the file, as modifying full_path's memory is necessary.
+         */
+
+        if (full_path == path) {
+            full_path = alloc_and_copy(full_path, full_path_length);
+            if (full_path == NULL) {
+                fputs("Failed to allocate memory\n", stderr);
+                return 1;
+            }
+        }
+
+        /*
+         * With multiple tbd-versions, each version is written out to its own
+         * write-path, made by appending the version to the provided path, as
+         * in "<path>-v2", unless all .tbds are written to a single file.
+         */
+
+        if (tbd->versions != 0 &&
+            !options.combine_tbds &&
+            !options.archive_tbds)
+        {
+            full_path = append_first_version(tbd, full_path, &full_path_length);
+        }
+
+        tbd->write_path = full_path;
+        tbd->write_path_length = full_path_length;
+        found_path = true;
+
+        break;
+    }
+
+    if (!found_path) {
+        fputs("Please provide either a path to a write-file or "
+              "\"stdout\" to print to stdout (terminal)\n",
+              stderr);
+
+        return 1;
+    }
+
+    *index_in = index;
+    return 0;
+}
+
+/*
+ * Split the manifest-line in place into tokens, separated by tabs, or by spaces
+ * if the line contains no tabs.
+ */
+
+static enum array_result
+split_manifest_line(char *__notnull const line,
+                    struct array *__notnull const tokens)
+{
+    const char separator = (strchr(line, '\t') != NULL) ? '\t' : ' ';
+    char *iter = line;
+
+    array_clear(tokens);
+    while (*iter != '\0') {
+        if (*iter == separator) {
+            iter++;
+            continue;
+        }
+
+        const enum array_result add_result =
+            array_add_item(tokens, sizeof(iter), &iter, NULL);
+
+        if (add_result != E_ARRAY_OK) {
+            return add_result;
+        }
+
+        char *const next = strchr(iter, separator);
+        if (next == NULL) {
+            break;
+        }
+
+        *next = '\0';
+        iter = next + 1;
+    }
+
+    return E_ARRAY_OK;
+}
+
+/*
+ * Parse a single manifest-line, in the form of:
+ *     [path-options] <input-path> [output-options] <output-path>
+ */
+
+static bool
+parse_manifest_line(struct tbd_for_main *__notnull const tbd,
+                    const struct array *__notnull const tokens,
+                    bool *__notnull const has_stdout)
+{
+    char *const *const argv = tokens->data;
+    const int argc = (int)tokens->item_count;
+
+    int index = 0;
+    if (parse_path_arguments(&index, tbd, argc, argv)) {
+        return false;
+    }
+
+    index += 1;
+    if (index == argc) {
+        fputs("Please provide either a path to a write-file or \"stdout\"\n",
+              stderr);
+
+        return false;
+    }
+
+    if (parse_output_arguments(&index, tbd, argc, argv, has_stdout)) {
+        return false;
+    }
+
+    if (index + 1 != argc) {
+        fprintf(stderr, "Unrecognized argument: %s\n", argv[index + 1]);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Run every tbd described in the manifest at path in this process, sharing the
+ * export-trie buffer, user-input, and mapped dyld_shared_cache files between
+ * all lines.
+ *
+ * Empty lines, and lines starting with '#', are skipped.
+ */
+
+static int run_manifest_for_main(const char *__notnull const path) {
+    FILE *file = stdin;
+    if (strcmp(path, "stdin") != 0) {
+        file = fopen(path, "r");
+        if (file == NULL) {
+            fprintf(stderr,
+                    "Failed to open manifest (at path %s), error: %s\n",
+                    path,
+                    strerror(errno));
+
+            return 1;
+        }
+    }
+
+    struct string_buffer export_trie_sb = {};
+    const enum string_buffer_result reserve_sb_result =
+        sb_reserve_space(&export_trie_sb, 512);
+
+    if (reserve_sb_result != E_STRING_BUFFER_OK) {
+        fputs("Failed to allocate memory\n", stderr);
+        return 1;
+    }
+
+    struct string_pool string_pool = {};
+    if (string_pool_create(&string_pool) != E_STRING_POOL_OK) {
+        fputs("Failed to allocate memory\n", stderr);
+        sb_destroy(&export_trie_sb);
+
+        return 1;
+    }
+
+    struct retained_user_info retained = {};
+    struct dsc_cache dsc_cache = {};
+    struct dir_cache dir_cache = {};
+
+    const struct main_run_info run_info = {
+        .retained = &retained,
+        .export_trie_sb = &export_trie_sb,
+        .dsc_cache = &dsc_cache,
+        .dir_cache = &dir_cache,
+        .string_pool = &string_pool,
+        .print_paths = true
+    };
+
+    struct array tokens = {};
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    uint64_t line_number = 0;
+
+    int result = 0;
+    do {
+        /*
+         * our_getline() returns 0 at end-of-file, as even empty lines include
+         * a newline.
+         */
+
+        ssize_t length = our_getline(&line, &line_capacity, file);
+        if (length <= 0) {
+            break;
+        }
+
+        line_number += 1;
+        if (line[length - 1] == '\n') {
+            length -= 1;
+            line[length] = '\0';
+        }
+
+        if (length != 0 && line[length - 1] == '\r') {
+            length -= 1;
+            line[length] = '\0';
+        }
+
+        if (length == 0 || line[0] == '#') {
+            continue;
+        }
+
+        if (split_manifest_line(line, &tokens) != E_ARRAY_OK) {
+            fputs("Failed to allocate memory\n", stderr);
+
+            result = 1;
+            break;
+        }
+
+        if (tokens.item_count == 0) {
+            continue;
+        }
+
+        /*
+         * Every line is its own run, so one line writing to stdout doesn't
+         * stop the lines after it from doing the same.
+         */
+
+        struct tbd_for_main tbd = {};
+        bool has_stdout = false;
+
+        setup_tbd_for_main(&tbd);
+
+        if (!parse_manifest_line(&tbd, &tokens, &has_stdout)) {
+            fprintf(stderr,
+                    "Skipping line %" PRIu64 " of the manifest\n",
+                    line_number);
+
+            /*
+             * On failure, the parse-path may not have been copied out of the
+             * line yet.
+             */
+
+            if (tbd.parse_path >= line && tbd.parse_path < line + length) {
+                tbd.parse_path = NULL;
+            }
+
+            tbd_for_main_destroy(&tbd);
+            result = 1;
+
+            continue;
+        }
+
+        if (run_tbd_for_main(&tbd, &run_info)) {
+            result = 1;
+        }
+    } while (true);
+
+    free(line);
+    array_destroy(&tokens);
+
+    dsc_cache_destroy(&dsc_cache);
+    dir_cache_destroy(&dir_cache);
+    sb_destroy(&export_trie_sb);
+    string_pool_destroy(&string_pool);
+
+    if (file != stdin) {
+        fclose(file);
+    }
+
+    return result;
+}
+
+int main(const int argc, char *const argv[]) {
+    if (argc < 2) {
+        print_usage();
+        return 0;
+    }
+
+    /*
+     * Store an index into the tbds array indicating the "current" tbd for when
+     * we parsing output arguments.
+     */
+
+    struct array tbds = {};
+    uint64_t current_tbd_index = 0;
+
+    bool has_stdout = false;
+    bool will_parse_export_trie = false;
+
+    for (int index = 1; index != argc; index++) {
+        /*
+         * Every argument parsed in this loop should be an option. Any extra
+         * arguments, like a path-string, should be parsed by the option it
+         * belongs to.
+         */
 
-                    if (inner_opt_front == '-') {
-                        inner_opt += 1;
-                    }
+        const char *const argument = argv[index];
+        const char argument_front = argument[0];
 
-                    const bool ret =
-                        tbd_for_main_parse_option(&index,
-                                                  &tbd,
-                                                  argc,
-                                                  argv,
-                                                  inner_opt);
+        if (argument_front != '-') {
+            fprintf(stderr,
+                    "Unrecognized argument (at index %d): %s\n",
+                    index,
+                    argument);
 
-                    if (ret) {
-                        continue;
-                    }
+            destroy_tbds_array(&tbds);
+            return 1;
+        }
 
-                    fprintf(stderr, "Unrecognized option: %s\n", inner_arg);
-                    destroy_tbds_array(&tbds);
+        const char *option = argument + 1;
+        const char option_front = option[0];
 
-                    return 1;
-                }
+        if (option_front == '-') {
+            option += 1;
+        }
 
-                if (verify_tbd_for_main(&tbd, inner_arg)) {
-                    destroy_tbds_array(&tbds);
-                    return 1;
-                }
+        if (strcmp(option, "h") == 0 || strcmp(option, "help") == 0) {
+            if (index != 1 || argc != 2) {
+                fprintf(stderr, "%s needs to be run by itself\n", argument);
+                destroy_tbds_array(&tbds);
+
+                return 1;
+            }
+
+            print_usage();
+            return 0;
+        } else if (strcmp(option, "o") == 0 || strcmp(option, "output") == 0) {
+            index += 1;
+            if (index == argc) {
+                fputs("Please provide either a path to a write-file or "
+                      "\"stdout\" to print to stdout (terminal)\n",
+                      stderr);
+
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
+            struct tbd_for_main *const tbd =
+                array_get_item_at_index_unsafe(&tbds,
+                                               sizeof(struct tbd_for_main),
+                                               current_tbd_index);
 
+            if (tbd == NULL) {
                 /*
-                 * Copy the path, if still from argv, to allow open_r to create
-                 * the file.
+                 * Subtract one from the index to get the index of the '-o' arg.
                  */
 
-                if (tbd.parse_path == inner_arg) {
-                    /*
-                     * Prevent any ending slashes from being copied to make
-                     * directory recursing easier.
-                     *
-                     * We only need to do this when full_path was not
-                     * created with the current-directory, as our path
-                     * functions don't append ending slashes.
-                     */
-
-                    tbd.parse_path_length =
-                        remove_end_slashes(tbd.parse_path,
-                                           tbd.parse_path_length);
-
-                    tbd.parse_path =
-                        alloc_and_copy(tbd.parse_path, tbd.parse_path_length);
-
-                    if (tbd.parse_path == NULL) {
-                        fputs("Failed to allocate memory\n", stderr);
-                        exit(1);
-                    }
-                }
+                fprintf(stderr,
+                        "No corresponding tbd exists for output arguments at "
+                        "index: %d\n",
+                        index - 1);
 
-                found_path = true;
-                break;
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
+            if (parse_output_arguments(&index, tbd, argc, argv, &has_stdout)) {
+                destroy_tbds_array(&tbds);
+                return 1;
             }
 
-            if (!found_path) {
-                fputs("Please provide either a path to a mach-o file or "
-                      "\"stdin\" to parse from terminal input\n",
+            current_tbd_index += 1;
+        } else if (strcmp(option, "p") == 0 || strcmp(option, "path") == 0) {
+            index += 1;
+            if (index == argc) {
+                fputs("Please provide either a path to a mach-o file, a path "
+                      "to a dyld_shared_cache file, or \"stdin\" to parse from "
+                      "terminal input\n",
                       stderr);
 
                 destroy_tbds_array(&tbds);
                 return 1;
             }
 
+            struct tbd_for_main tbd = {};
+            setup_tbd_for_main(&tbd);
+
+            if (parse_path_arguments(&index, &tbd, argc, argv)) {
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
             if (!tbd.parse_options.ignore_exports) {
                 if (!tbd.macho_options.use_symbol_table) {
                     will_parse_export_trie = true;
@@ -993,6 +1892,75 @@ int main(const int argc, char *const argv[]) {
 
                 return 1;
             }
+        } else if (strcmp(option, "build-symbol-index") == 0) {
+            if (index != 1 || argc < 4) {
+                fputs("--build-symbol-index needs to be run by itself, with a "
+                      "path to write the symbol-index to, followed by paths to "
+                      "the dyld_shared_cache files whose images will be "
+                      "indexed\n",
+                      stderr);
+
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
+            return symbol_index_build_for_main(argv[2],
+                                               (const char **)argv + 3,
+                                               (uint64_t)(argc - 3));
+        } else if (strcmp(option, "diff") == 0) {
+            if (index != 1 || argc != 4) {
+                fputs("--diff needs to be run by itself, with the paths to the "
+                      "old and new mach-o or dyld_shared_cache files to "
+                      "compare\n",
+                      stderr);
+
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
+            return export_diff_for_main(argv[2], argv[3]);
+        } else if (strcmp(option, "dump-exports") == 0) {
+            if (index != 1 || argc < 4) {
+                fputs("--dump-exports needs to be run by itself, with a format "
+                      "(ndjson or tsv), followed by paths to the mach-o or "
+                      "dyld_shared_cache files whose exports will be dumped\n",
+                      stderr);
+
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
+            const enum export_dump_format format =
+                export_dump_format_from_string(argv[2]);
+
+            if (format == EXPORT_DUMP_FORMAT_NONE) {
+                fprintf(stderr,
+                        "Unrecognized format for --dump-exports: %s. Only "
+                        "ndjson and tsv are supported\n",
+                        argv[2]);
+
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
+            return export_dump_for_main(format,
+                                        (const char **)argv + 3,
+                                        (uint64_t)(argc - 3));
+        } else if (strcmp(option, "merge-dsc") == 0) {
+            if (index != 1 || argc < 5) {
+                fputs("--merge-dsc needs to be run by itself, with a path to "
+                      "the directory to write the merged .tbd files to, "
+                      "followed by paths to at least two dyld_shared_cache "
+                      "files\n",
+                      stderr);
+
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
+            return dsc_merge_for_main(argv[2],
+                                      (const char **)argv + 3,
+                                      (uint64_t)(argc - 3));
         } else if (strcmp(option, "list-architectures") == 0) {
             if (index != 1 || argc > 3) {
                 fputs("--list-architectures needs to be run either by itself, "
@@ -1132,6 +2100,92 @@ int main(const int argc, char *const argv[]) {
 
             print_tbd_version_list();
             return 0;
+        } else if (strcmp(option, "lookup-symbol") == 0) {
+            if (index != 1 || argc < 4) {
+                fputs("--lookup-symbol needs to be run by itself, with a path "
+                      "to a symbol-index, followed by the symbols to look "
+                      "up\n",
+                      stderr);
+
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
+            return symbol_index_lookup_for_main(argv[2],
+                                                (const char **)argv + 3,
+                                                (uint64_t)(argc - 3));
+        } else if (strcmp(option, "query-symbol") == 0) {
+            if (index != 1 || argc < 4) {
+                fputs("--query-symbol needs to be run by itself, with a path "
+                      "to a dyld_shared_cache file, followed by the symbols to "
+                      "look up\n",
+                      stderr);
+
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
+            return export_query_for_main(argv[2],
+                                         (const char **)argv + 3,
+                                         (uint64_t)(argc - 3));
+        } else if (strcmp(option, "manifest") == 0) {
+            if (index != 1 || argc != 3) {
+                fputs("--manifest needs to be run by itself, with a path to a "
+                      "manifest file, or \"stdin\" to read the manifest from "
+                      "terminal input\n",
+                      stderr);
+
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
+            return run_manifest_for_main(argv[2]);
+        } else if (strcmp(option, "serve") == 0) {
+            if (index != 1) {
+                fputs("--serve needs to be run by itself, with an optional "
+                      "path to a unix domain socket to listen on\n",
+                      stderr);
+
+                destroy_tbds_array(&tbds);
+                return 1;
+            }
+
+            struct serve_options serve_options = {};
+            for (index++; index != argc; index++) {
+                const char *const arg = argv[index];
+                if (strcmp(arg, "--max-caches") == 0) {
+                    index += 1;
+                    if (index == argc) {
+                        fputs("Please provide the maximum number of "
+                              "dyld_shared_cache files to keep mapped\n",
+                              stderr);
+
+                        return 1;
+                    }
+
+                    const char *const count_arg = argv[index];
+                    char *count_end = NULL;
+
+                    const uint64_t count = strtoull(count_arg, &count_end, 10);
+                    if (count == 0 || *count_end != '\0') {
+                        fprintf(stderr,
+                                "Invalid maximum number of dyld_shared_cache "
+                                "files: %s\n",
+                                count_arg);
+
+                        return 1;
+                    }
+
+                    serve_options.max_cache_count = count;
+                } else if (serve_options.socket_path == NULL) {
+                    serve_options.socket_path = arg;
+                } else {
+                    fprintf(stderr, "Unrecognized argument: %s\n", arg);
+                    return 1;
+                }
+            }
+
+            return serve_for_main(serve_options);
         } else if (strcmp(option, "u") == 0 || strcmp(option, "usage") == 0) {
             if (index != 1 || argc != 2) {
                 fprintf(stderr,
@@ -1175,235 +2229,38 @@ int main(const int argc, char *const argv[]) {
      * path-strings of the file we're parsing.
      */
 
-    const bool should_print_paths = (tbds.item_count != 1);
-    struct retained_user_info retained = {};
-
-    struct tbd_for_main *tbd = tbds.data;
-    const struct tbd_for_main *const end = tbds.data_end;
-
-    for (; tbd != end; tbd++) {
-        /*
-         * To allow user-input to modify tbd-info for single files, we create a
-         * copy of tbd to separate the initial info from the user-input info.
-         */
-
-        struct tbd_for_main copy = *tbd;
-        const struct tbd_for_main_options options = tbd->options;
-
-        if (options.recurse_directories) {
-            /*
-             * We have to check write_path here, as its possible the
-             * output-command was not provided, leaving the write_path NULL.
-             */
-
-            if (tbd->write_path == NULL) {
-                fputs("Writing to stdout (the terminal) while recursing a "
-                      "directory is not supported.\nPlease provide a directory "
-                      "to write all created files to\n",
-                      stderr);
-
-                destroy_tbds_array(&tbds);
-                return 1;
-            }
-
-            struct recurse_callback_info recurse_info = {
-                .tbd = &copy,
-                .orig = tbd,
-                .retained = &retained,
-                .export_trie_sb = &export_trie_sb
-            };
-
-            enum dir_recurse_result recurse_dir_result = E_DIR_RECURSE_OK;
-            if (options.recurse_subdirectories) {
-                recurse_dir_result =
-                    dir_recurse_with_subdirs(tbd->parse_path,
-                                             tbd->parse_path_length,
-                                             O_RDONLY,
-                                             &recurse_info,
-                                             recurse_directory_callback,
-                                             recurse_directory_fail_callback);
-            } else {
-                recurse_dir_result =
-                    dir_recurse(tbd->parse_path,
-                                tbd->parse_path_length,
-                                O_RDONLY,
-                                &recurse_info,
-                                recurse_directory_callback,
-                                recurse_directory_fail_callback);
-            }
-
-            if (recurse_dir_result != E_DIR_RECURSE_OK) {
-                if (should_print_paths) {
-                    fprintf(stderr,
-                            "Failed to recurse directory (at path %s), "
-                            "error: %s\n",
-                            tbd->parse_path,
-                            strerror(errno));
-                } else {
-                    fprintf(stderr,
-                            "Failed to recurse directory at the provided path, "
-                            "error: %s\n",
-                            strerror(errno));
-                }
-            }
-
-            if (recurse_info.files_parsed == 0) {
-                if (should_print_paths) {
-                    fprintf(stderr,
-                            "No new .tbd files were created while parsing "
-                            "directory (at path %s)\n",
-                            tbd->parse_path);
-                } else {
-                    fputs("No new .tbd files were created while parsing "
-                          "directory at the provided path\n",
-                          stderr);
-                }
-            }
-
-            if (tbd->options.combine_tbds) {
-                if (tbd_write_footer(recurse_info.combine_file)) {
-                    if (should_print_paths) {
-                        fprintf(stderr,
-                                "Failed to write footer for combined .tbd file "
-                                "for files from directory (at path %s)\n",
-                                tbd->parse_path);
-                    } else {
-                        fputs("Failed to write footer for combined .tbd file "
-                              "for files from directory at the provided path\n",
-                              stderr);
-                    }
-
-                    return 1;
-                }
-
-                fclose(recurse_info.combine_file);
-            }
-
-            /*
-             * Since user-input can modify tbd (orig) to set info for all
-             * created .tbd files, there may be some shared (and allocated) info
-             * between both copy and `tbd`.
-             *
-             * To handle this situation, we destroy copy, because copy will
-             * likely have more allocated information than `tbd`.
-             *
-             * tbd on the other hand is cleared with memset(), and not
-             * destroyed, to avoid a double-free.
-             */
-
-            tbd_for_main_destroy(&copy);
-            memset(tbd, 0, sizeof(*tbd));
-        } else {
-            char *const parse_path = tbd->parse_path;
-            const int fd = our_open(parse_path, O_RDONLY, 0);
-
-            if (fd < 0) {
-                if (should_print_paths) {
-                    fprintf(stderr,
-                            "Failed to open file (at path %s), error: %s\n",
-                            tbd->parse_path,
-                            strerror(errno));
-                } else {
-                    fprintf(stderr,
-                            "Failed to open the file at the provided path, "
-                            "error: %s\n",
-                            strerror(errno));
-                }
-
-                continue;
-            }
-
-            /*
-             * We need to store a buffer to read magic.
-             */
-
-            struct magic_buffer magic_buffer = {};
-            if (tbd->filetypes.macho) {
-                struct parse_macho_for_main_args args = {
-                    .fd = fd,
-                    .magic_buffer = &magic_buffer,
-                    .retained = &retained,
-
-                    .tbd = &copy,
-                    .orig = tbd,
-
-                    .dir_path = parse_path,
-                    .dir_path_length = tbd->parse_path_length,
-
-                    .dont_handle_non_macho_error = false,
-                    .print_paths = should_print_paths,
-
-                    .export_trie_sb = &export_trie_sb,
-                    .options.verify_write_path = true
-                };
+    struct string_pool string_pool = {};
+    if (string_pool_create(&string_pool) != E_STRING_POOL_OK) {
+        fputs("Failed to allocate memory\n", stderr);
 
-                /*
-                 * We're only supposed to print the non-macho error if no other
-                 * filetypes are enabled.
-                 */
-
-                if (tbd->filetypes.dyld_shared_cache) {
-                    args.dont_handle_non_macho_error = true;
-                }
-
-                const enum parse_macho_for_main_result parse_result =
-                    parse_macho_file_for_main(args);
-
-                if (parse_result != E_PARSE_MACHO_FOR_MAIN_NOT_A_MACHO) {
-                    continue;
-                }
-            }
-
-            if (tbd->filetypes.dyld_shared_cache) {
-                struct parse_dsc_for_main_args args = {
-                    .fd = fd,
-                    .magic_buffer = &magic_buffer,
-                    .retained = &retained,
-
-                    .tbd = &copy,
-                    .orig = tbd,
-
-                    .dsc_dir_path = parse_path,
-                    .dsc_dir_path_length = tbd->parse_path_length,
+        destroy_tbds_array(&tbds);
+        sb_destroy(&export_trie_sb);
 
-                    .dont_handle_non_dsc_error = false,
-                    .print_paths = should_print_paths,
+        return 1;
+    }
 
-                    .export_trie_sb = &export_trie_sb,
-                    .options.verify_write_path = true
-                };
+    struct retained_user_info retained = {};
+    struct dir_cache dir_cache = {};
 
-                const enum parse_dsc_for_main_result parse_result =
-                    parse_dsc_for_main(args);
+    const struct main_run_info run_info = {
+        .retained = &retained,
+        .export_trie_sb = &export_trie_sb,
+        .dir_cache = &dir_cache,
+        .string_pool = &string_pool,
+        .print_paths = (tbds.item_count != 1)
+    };
 
-                if (parse_result != E_PARSE_DSC_FOR_MAIN_NOT_A_SHARED_CACHE) {
-                    continue;
-                }
-            }
+    struct tbd_for_main *tbd = tbds.data;
+    const struct tbd_for_main *const end = tbds.data_end;
 
-            if (!tbd->filetypes.user_provided) {
-                if (should_print_paths) {
-                    fputs("File (at path %s) is not among any of the provided "
-                          "filetypes\n",
-                          stderr);
-                } else {
-                    fputs("File at the provided path is not among any of the "
-                          "provided filetypes\n",
-                          stderr);
-                }
-            } else {
-                if (should_print_paths) {
-                    fputs("File (at path %s) is not among any of the supported "
-                          "filetypes\n",
-                          stderr);
-                } else {
-                    fputs("File at the provided path is not among any of the "
-                          "supported filetypes\n",
-                          stderr);
-                }
-            }
+    for (; tbd != end; tbd++) {
+        if (run_tbd_for_main(tbd, &run_info)) {
+            destroy_tbds_array(&tbds);
+            dir_cache_destroy(&dir_cache);
+            sb_destroy(&export_trie_sb);
+            string_pool_destroy(&string_pool);
 
-            tbd_for_main_destroy(tbd);
+            return 1;
         }
     }
 
@@ -1413,7 +2270,9 @@ int main(const int argc, char *const argv[]) {
      * array_destroy().
      */
 
+    dir_cache_destroy(&dir_cache);
     sb_destroy(&export_trie_sb);
+    string_pool_destroy(&string_pool);
     array_destroy(&tbds);
 
     return 0;
@@ -8,12 +8,18 @@
 
 #include <sys/stat.h>
 
+#if defined(__linux__)
+#include <linux/memfd.h>
+#include <sys/syscall.h>
+#endif
+
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <unistd.h>
 
 #include "our_io.h"
+#include "unused.h"
 
 int our_open(const char *const path, const int flags, const int mode) {
     do {
@@ -31,12 +37,17 @@ int our_open(const char *const path, const int flags, const int mode) {
     return -1;
 }
 
-int our_openat(const int dirfd, const char *const path, const int flags) {
+int
+our_openat(const int dirfd,
+           const char *const path,
+           const int flags,
+           const int mode)
+{
     do {
 #ifdef O_CLOEXEC
-        const int fd = openat(dirfd, path, flags | O_CLOEXEC);
+        const int fd = openat(dirfd, path, flags | O_CLOEXEC, mode);
 #else
-        const int fd = openat(dirfd, path, flags);
+        const int fd = openat(dirfd, path, flags, mode);
 #endif
 
         if (fd != -1) {
@@ -58,6 +69,17 @@ int our_mkdir(const char *const path, const mode_t mode) {
     return -1;
 }
 
+int our_mkdirat(const int dirfd, const char *const path, const mode_t mode) {
+    do {
+        const int ret = mkdirat(dirfd, path, mode);
+        if (ret == 0) {
+            return ret;
+        }
+    } while (errno == EINTR);
+
+    return -1;
+}
+
 int our_unlink(const char *const path) {
     do {
         const int ret = unlink(path);
@@ -102,6 +124,63 @@ ssize_t our_read(const int fd, void *const buf, const size_t size) {
     return -1;
 }
 
+ssize_t our_write(const int fd, const void *const buf, const size_t size) {
+    do {
+        const ssize_t num = write(fd, buf, size);
+        if (num != -1) {
+            return num;
+        }
+    } while (errno == EINTR);
+
+    return -1;
+}
+
+int our_create_anonymous_file(void) {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    const int memfd = (int)syscall(SYS_memfd_create, "tbd", MFD_CLOEXEC);
+    if (memfd >= 0) {
+        return memfd;
+    }
+#endif
+
+    /*
+     * tmpfile() unlinks the file it creates, so only its file-descriptor needs
+     * to be kept.
+     */
+
+    FILE *const file = tmpfile();
+    if (file == NULL) {
+        return -1;
+    }
+
+    const int fd = dup(fileno(file));
+    fclose(file);
+
+    return fd;
+}
+
+/*
+ * Only a hint, so failures are ignored. Both F_RDADVISE and POSIX_FADV_WILLNEED
+ * start the reads without waiting for them to complete.
+ */
+
+void
+our_read_ahead(__unused const int fd,
+               __unused const off_t offset,
+               __unused const size_t size)
+{
+#if defined(F_RDADVISE)
+    struct radvisory advisory = {
+        .ra_offset = offset,
+        .ra_count = (int)size
+    };
+
+    fcntl(fd, F_RDADVISE, &advisory);
+#elif defined(POSIX_FADV_WILLNEED)
+    posix_fadvise(fd, offset, (off_t)size, POSIX_FADV_WILLNEED);
+#endif
+}
+
 DIR *our_fdopendir(const int fd) {
     do {
         DIR *const dir = fdopendir(fd);
@@ -0,0 +1,92 @@
+//
+//  src/parse_budget.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <time.h>
+
+#include "likely.h"
+#include "parse_budget.h"
+#include "tbd.h"
+
+/*
+ * Reading the clock for every tree-node or symbol would cost more than the
+ * work itself, so the deadline is only checked once every this many uses.
+ */
+
+#define DEADLINE_CHECK_INTERVAL 1024
+
+static uint64_t get_monotonic_time(void) {
+    struct timespec time = {};
+    if (clock_gettime(CLOCK_MONOTONIC, &time) != 0) {
+        return 0;
+    }
+
+    return ((uint64_t)time.tv_sec * 1000000000ull) + (uint64_t)time.tv_nsec;
+}
+
+void parse_budget_start(struct parse_budget *__notnull const budget) {
+    atomic_store(&budget->trie_nodes, 0);
+    atomic_store(&budget->symbols, 0);
+    atomic_store(&budget->bytes, 0);
+
+    budget->deadline = 0;
+
+    const uint64_t max_milliseconds = budget->limits.max_milliseconds;
+    if (max_milliseconds != 0) {
+        budget->deadline = get_monotonic_time() + max_milliseconds * 1000000;
+    }
+}
+
+static bool
+is_past_deadline(const struct parse_budget *__notnull const budget,
+                 const uint64_t count)
+{
+    if (budget->deadline == 0) {
+        return false;
+    }
+
+    if (count % DEADLINE_CHECK_INTERVAL != 0) {
+        return false;
+    }
+
+    return (get_monotonic_time() > budget->deadline);
+}
+
+bool parse_budget_use_trie_node(struct parse_budget *__notnull const budget) {
+    const uint64_t count = atomic_fetch_add(&budget->trie_nodes, 1) + 1;
+    const uint64_t max_trie_nodes = budget->limits.max_trie_nodes;
+
+    if (unlikely(max_trie_nodes != 0 && count > max_trie_nodes)) {
+        return false;
+    }
+
+    return !is_past_deadline(budget, count);
+}
+
+bool
+parse_budget_use_symbol(struct parse_budget *__notnull const budget,
+                        const uint64_t length)
+{
+    const uint64_t count = atomic_fetch_add(&budget->symbols, 1) + 1;
+    const uint64_t max_symbols = budget->limits.max_symbols;
+
+    if (unlikely(max_symbols != 0 && count > max_symbols)) {
+        return false;
+    }
+
+    const uint64_t max_bytes = budget->limits.max_bytes;
+    if (max_bytes != 0) {
+        const uint64_t size = sizeof(struct tbd_symbol_info) + length;
+        const uint64_t bytes = atomic_fetch_add(&budget->bytes, size) + size;
+
+        if (unlikely(bytes > max_bytes)) {
+            return false;
+        }
+    }
+
+    return !is_past_deadline(budget, count);
+}
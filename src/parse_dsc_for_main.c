@@ -17,6 +17,8 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "dsc_cache.h"
+#include "dsc_closure.h"
 #include "handle_dsc_parse_result.h"
 #include "magic_buffer.h"
 #include "parse_dsc_for_main.h"
@@ -27,8 +29,8 @@
 
 #include "recursive.h"
 #include "tbd_for_main.h"
-#include "tbd_write.h"
 #include "unused.h"
+#include "util.h"
 
 struct dsc_iterate_images_info {
     struct dyld_shared_cache_info *dsc_info;
@@ -60,12 +62,23 @@ struct dsc_iterate_images_info {
     bool parse_all_images : 1;
     bool did_print_messages_header : 1;
 
+    /*
+     * Dependencies are written out like the requested image that they were
+     * found from, through dependency_filter, which is NULL for images
+     * provided by number.
+     */
+
+    bool parsing_dependencies : 1;
+    const struct tbd_for_main_dsc_image_filter *dependency_filter;
+
     struct retained_user_info *retained;
     struct string_buffer *export_trie_sb;
+    struct dir_cache *dir_cache;
 };
 
 enum dyld_cache_image_info_pad {
-    F_DYLD_CACHE_IMAGE_INFO_PAD_ALREADY_EXTRACTED = 1ull << 0
+    F_DYLD_CACHE_IMAGE_INFO_PAD_ALREADY_EXTRACTED = 1ull << 0,
+    F_DYLD_CACHE_IMAGE_INFO_PAD_IN_CLOSURE = 1ull << 1
 };
 
 static void
@@ -130,6 +143,7 @@ print_image_error(struct dsc_iterate_images_info *__notnull const iterate_info,
         case E_DSC_IMAGE_PARSE_CREATE_SYMBOLS_FAIL:
         case E_DSC_IMAGE_PARSE_CREATE_TARGET_LIST_FAIL:
         case E_DSC_IMAGE_PARSE_SIMULATOR_TYPE_MISMATCH:
+        case E_DSC_IMAGE_PARSE_BUDGET_EXCEEDED:
             break;
     }
 
@@ -185,12 +199,33 @@ open_file_for_path(struct dsc_iterate_images_info *__notnull const info,
         return file;
     }
 
-    const enum tbd_for_main_open_write_file_result open_file_result =
-        tbd_for_main_open_write_file_for_path(tbd,
-                                              path,
-                                              path_length,
-                                              &file,
-                                              terminator_out);
+    /*
+     * When archiving, all .tbds are written to the archive at the write-path
+     * provided, and not to the image's own write-path. The directories created
+     * for the archive should not be removed if an image fails to be written.
+     */
+
+    char *archive_terminator = NULL;
+    enum tbd_for_main_open_write_file_result open_file_result =
+        E_TBD_FOR_MAIN_OPEN_WRITE_FILE_OK;
+
+    if (tbd->options.archive_tbds) {
+        open_file_result =
+            tbd_for_main_open_write_file_for_path(tbd,
+                                                  info->dir_cache,
+                                                  tbd->write_path,
+                                                  tbd->write_path_length,
+                                                  &file,
+                                                  &archive_terminator);
+    } else {
+        open_file_result =
+            tbd_for_main_open_write_file_for_path(tbd,
+                                                  info->dir_cache,
+                                                  path,
+                                                  path_length,
+                                                  &file,
+                                                  terminator_out);
+    }
 
     if (open_file_result != E_TBD_FOR_MAIN_OPEN_WRITE_FILE_OK) {
         print_write_file_result(info, tbd, open_file_result);
@@ -211,7 +246,8 @@ write_to_path(struct dsc_iterate_images_info *__notnull const iterate_info,
               const uint64_t write_path_length)
 {
     char *terminator = NULL;
-    const bool should_combine = tbd->options.combine_tbds;
+    const bool should_combine =
+        tbd->options.combine_tbds || tbd->options.archive_tbds;
 
     FILE *const file =
         open_file_for_path(iterate_info,
@@ -397,12 +433,87 @@ mark_happening_list_found(struct tbd_for_main *__notnull const tbd) {
     }
 }
 
+/*
+ * Write out a dependency the same way the requested image it was found from
+ * was written, through the filter the requested image passed.
+ */
+
+static void
+write_out_tbd_info_for_dependency(
+    struct dsc_iterate_images_info *__notnull const info,
+    struct tbd_for_main *__notnull const tbd,
+    const char *__notnull const path,
+    const uint64_t path_length)
+{
+    const struct tbd_for_main_dsc_image_filter *const filter =
+        info->dependency_filter;
+
+    if (filter == NULL) {
+        write_out_tbd_info_for_image_path(info, tbd, path, path_length);
+        return;
+    }
+
+    switch (filter->type) {
+        case TBD_FOR_MAIN_DSC_IMAGE_FILTER_TYPE_PATH:
+            break;
+
+        case TBD_FOR_MAIN_DSC_IMAGE_FILTER_TYPE_DIRECTORY: {
+            /*
+             * Dependencies outside the filter's directory are written out to
+             * their image-paths instead.
+             */
+
+            const char *dir = NULL;
+            if (path_has_dir_component(path,
+                                       path_length,
+                                       filter->string,
+                                       filter->length,
+                                       &dir))
+            {
+                write_out_tbd_info_for_filter_dir(info,
+                                                  tbd,
+                                                  dir,
+                                                  path,
+                                                  path_length);
+
+                return;
+            }
+
+            break;
+        }
+
+        case TBD_FOR_MAIN_DSC_IMAGE_FILTER_TYPE_FILE: {
+            const char *const path_end = path + path_length;
+            const char *const last_slash = find_last_slash(path, path_end);
+
+            const char *name = path;
+            if (last_slash != NULL) {
+                name = last_slash + 1;
+            }
+
+            write_out_tbd_info_for_filter_filename(info,
+                                                   tbd,
+                                                   name,
+                                                   (uint64_t)(path_end - name));
+
+            return;
+        }
+    }
+
+    write_out_tbd_info_for_image_path(info, tbd, path, path_length);
+}
+
 static void
 write_out_tbd_info(struct dsc_iterate_images_info *__notnull const info,
                    struct tbd_for_main *__notnull const tbd,
                    const char *__notnull const path,
                    const uint64_t path_length)
 {
+    if (info->parsing_dependencies) {
+        write_out_tbd_info_for_dependency(info, tbd, path, path_length);
+        return;
+    }
+
     if (info->parse_all_images) {
         write_out_tbd_info_for_image_path(info, tbd, path, path_length);
         return;
@@ -427,6 +538,13 @@ write_out_tbd_info(struct dsc_iterate_images_info *__notnull const info,
             write_to_path(info, tbd, tbd->write_path, tbd->write_path_length);
             return;
         }
+
+        /*
+         * Images provided by number don't pass through any filter, and so are
+         * written out to their image-paths inside the write-path directory.
+         */
+
+        write_out_tbd_info_for_image_path(info, tbd, path, path_length);
     }
 }
 
@@ -447,6 +565,9 @@ actually_parse_image(
     cb_info->did_print_messages_header =
         iterate_info->did_print_messages_header;
 
+    const struct tbd_parse_options parse_options =
+        tbd_for_main_create_parse_plan(tbd);
+
     struct dsc_image_parse_options options = {};
     const enum dsc_image_parse_result parse_image_result =
         dsc_image_parse(info,
@@ -456,7 +577,7 @@ actually_parse_image(
                         cb_info,
                         iterate_info->export_trie_sb,
                         tbd->macho_options,
-                        tbd->parse_options,
+                        parse_options,
                         options);
 
     iterate_info->did_print_messages_header =
@@ -752,6 +873,130 @@ dsc_iterate_images(
     print_dsc_warnings(info, filters);
 }
 
+/*
+ * Find the first filter the image at path passes through, or NULL if the image
+ * was only provided by number.
+ */
+
+static const struct tbd_for_main_dsc_image_filter *
+find_filter_for_image(struct dsc_iterate_images_info *__notnull const info,
+                      const char *__notnull const path)
+{
+    const struct array *const filters = &info->tbd->dsc_image_filters;
+
+    struct tbd_for_main_dsc_image_filter *filter = filters->data;
+    const struct tbd_for_main_dsc_image_filter *const end = filters->data_end;
+
+    info->image_path_length = 0;
+    for (; filter != end; filter++) {
+        if (image_path_passes_through_filter(info, path, filter)) {
+            return filter;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Extract every image that the images already extracted load or re-export,
+ * directly or indirectly, which weren't themselves requested.
+ *
+ * Only the load-commands of images are read to find the closure, so that
+ * only the images in the closure are ever fully parsed.
+ *
+ * Each dependency is written out like the first requested image it was found
+ * from.
+ */
+
+static void
+parse_dependency_closure(
+    struct dyld_shared_cache_info *__notnull const dsc_info,
+    struct dsc_iterate_images_info *__notnull const info)
+{
+    const struct tbd_for_main *const tbd = info->tbd;
+    if (!tbd->options.dsc_with_dependencies) {
+        return;
+    }
+
+    /*
+     * Without any filters or numbers, every image was already extracted.
+     */
+
+    if (tbd->dsc_image_filters.item_count == 0 &&
+        tbd->dsc_image_numbers.item_count == 0)
+    {
+        return;
+    }
+
+    struct dsc_closure closure = {};
+    const enum dsc_closure_result create_closure_result =
+        dsc_closure_create(&closure,
+                           dsc_info,
+                           F_DYLD_CACHE_IMAGE_INFO_PAD_IN_CLOSURE);
+
+    if (create_closure_result != E_DSC_CLOSURE_OK) {
+        fputs("Failed to allocate memory\n", stderr);
+        exit(1);
+    }
+
+    /*
+     * Mark the requested images first, so that they're never extracted again
+     * as a dependency of another requested image.
+     */
+
+    struct dyld_cache_image_info *const images = dsc_info->images;
+    const uint32_t images_count = dsc_info->images_count;
+
+    for (uint32_t i = 0; i != images_count; i++) {
+        struct dyld_cache_image_info *const image = images + i;
+        if (image->pad & F_DYLD_CACHE_IMAGE_INFO_PAD_ALREADY_EXTRACTED) {
+            image->pad |= F_DYLD_CACHE_IMAGE_INFO_PAD_IN_CLOSURE;
+        }
+    }
+
+    info->parsing_dependencies = true;
+
+    /*
+     * Dependencies are only parsed once every requested image has been
+     * visited, so only requested images have the already-extracted flag.
+     */
+
+    for (uint32_t i = 0; i != images_count; i++) {
+        const struct dyld_cache_image_info *const image = images + i;
+        if (!(image->pad & F_DYLD_CACHE_IMAGE_INFO_PAD_ALREADY_EXTRACTED)) {
+            continue;
+        }
+
+        const char *const image_path =
+            (const char *)(dsc_info->map + image->pathFileOffset);
+
+        info->dependency_filter = find_filter_for_image(info, image_path);
+        dsc_closure_mark_dependencies(&closure, i);
+
+        for (uint32_t j = 0; j != closure.queue_count; j++) {
+            struct dyld_cache_image_info *const dependency =
+                images + closure.queue[j];
+
+            const char *const dependency_path =
+                (const char *)(dsc_info->map + dependency->pathFileOffset);
+
+            info->image_path = dependency_path;
+            info->image_path_length = 0;
+
+            actually_parse_image(info, dependency, dependency_path);
+        }
+    }
+
+    info->parsing_dependencies = false;
+    info->dependency_filter = NULL;
+
+    for (uint32_t i = 0; i != images_count; i++) {
+        images[i].pad &= ~(uint32_t)F_DYLD_CACHE_IMAGE_INFO_PAD_IN_CLOSURE;
+    }
+
+    dsc_closure_destroy(&closure);
+}
+
 enum read_magic_result {
     E_READ_MAGIC_OK,
     E_READ_MAGIC_READ_FAILED,
@@ -778,7 +1023,12 @@ static void verify_write_path(struct tbd_for_main *__notnull const tbd) {
         const struct array *const numbers = &tbd->dsc_image_numbers;
         const uint64_t paths_count = tbd->dsc_filter_paths_count;
 
-        if (paths_count == 1) {
+        if (tbd->options.dsc_with_dependencies) {
+            /*
+             * The dependencies of an image are extracted alongside it, so
+             * more than one image may always be written out.
+             */
+        } else if (paths_count == 1) {
             if (filters->item_count == paths_count) {
                 if (numbers->item_count == 0) {
                     return;
@@ -844,7 +1094,12 @@ static void verify_write_path(struct tbd_for_main *__notnull const tbd) {
         const struct array *const numbers = &tbd->dsc_image_numbers;
         const uint64_t paths_count = tbd->dsc_filter_paths_count;
 
-        if (paths_count == 1) {
+        if (tbd->options.dsc_with_dependencies) {
+            /*
+             * The dependencies of an image are extracted alongside it, so
+             * more than one image may always be written out.
+             */
+        } else if (paths_count == 1) {
             if (filters->item_count == paths_count) {
                 if (numbers->item_count == 0) {
                     tbd->flags.dsc_write_path_is_file = true;
@@ -886,7 +1141,11 @@ static void verify_write_path(struct tbd_for_main *__notnull const tbd) {
         const uint64_t numbers_count = numbers->item_count;
         const uint64_t paths_count = tbd->dsc_filter_paths_count;
 
-        if (numbers_count == 1) {
+        if (tbd->options.dsc_with_dependencies) {
+            /*
+             * Dependencies are written out alongside the requested images.
+             */
+        } else if (numbers_count == 1) {
             if (paths_count == filters->item_count) {
                 tbd->flags.dsc_write_path_is_file = true;
                 return;
@@ -927,12 +1186,33 @@ parse_dsc_for_main(const struct parse_dsc_for_main_args args) {
     struct dyld_shared_cache_parse_options dsc_options = args.tbd->dsc_options;
     dsc_options.zero_image_pads = true;
 
-    struct dyld_shared_cache_info dsc_info = {};
-    const enum dyld_shared_cache_parse_result parse_dsc_file_result =
-        dyld_shared_cache_parse_from_file(&dsc_info,
-                                          args.fd,
-                                          (const char *)args.magic_buffer->buff,
-                                          dsc_options);
+    /*
+     * When a dsc_cache is provided, the dyld_shared_cache is owned by the
+     * cache, and stays mapped for the next tbd to parse it.
+     */
+
+    const char *const magic = (const char *)args.magic_buffer->buff;
+
+    struct dyld_shared_cache_info dsc_info_storage = {};
+    struct dyld_shared_cache_info *dsc_info = &dsc_info_storage;
+
+    enum dyld_shared_cache_parse_result parse_dsc_file_result =
+        E_DYLD_SHARED_CACHE_PARSE_OK;
+
+    if (args.dsc_cache != NULL) {
+        parse_dsc_file_result =
+            dsc_cache_get_for_fd(args.dsc_cache,
+                                 args.fd,
+                                 magic,
+                                 dsc_options,
+                                 &dsc_info);
+    } else {
+        parse_dsc_file_result =
+            dyld_shared_cache_parse_from_file(dsc_info,
+                                              args.fd,
+                                              magic,
+                                              dsc_options);
+    }
 
     if (parse_dsc_file_result == E_DYLD_SHARED_CACHE_PARSE_NOT_A_CACHE) {
         if (args.dont_handle_non_dsc_error) {
@@ -958,10 +1238,17 @@ parse_dsc_for_main(const struct parse_dsc_for_main_args args) {
         return E_PARSE_DSC_FOR_MAIN_OTHER_ERROR;
     }
 
+    /*
+     * When archiving, every image is written to the archive under its own
+     * write-path, so the write-path is never the path of a single image.
+     */
+
     if (args.tbd->options.combine_tbds) {
         args.tbd->flags.dsc_write_path_is_file = true;
         args.tbd->write_options.ignore_footer = true;
-    } else if (args.options.verify_write_path) {
+    } else if (args.options.verify_write_path &&
+               !args.tbd->options.archive_tbds)
+    {
         verify_write_path(args.tbd);
     }
 
@@ -974,7 +1261,7 @@ parse_dsc_for_main(const struct parse_dsc_for_main_args args) {
     };
 
     struct dsc_iterate_images_info iterate_info = {
-        .dsc_info = &dsc_info,
+        .dsc_info = dsc_info,
 
         .dsc_dir_path = args.dsc_dir_path,
         .dsc_name = args.dsc_name,
@@ -994,7 +1281,8 @@ parse_dsc_for_main(const struct parse_dsc_for_main_args args) {
         .print_paths = args.print_paths,
         .parse_all_images = true,
 
-        .export_trie_sb = args.export_trie_sb
+        .export_trie_sb = args.export_trie_sb,
+        .dir_cache = args.dir_cache
     };
 
     const struct array *const filters = &args.tbd->dsc_image_filters;
@@ -1018,7 +1306,7 @@ parse_dsc_for_main(const struct parse_dsc_for_main_args args) {
 
         for (; iter != end; iter++) {
             const uint32_t number = *iter;
-            if (number > dsc_info.images_count) {
+            if (number > dsc_info->images_count) {
                 if (args.print_paths) {
                     fprintf(stderr,
                             "dyld_shared_cache (at path %s/%s) does not have "
@@ -1042,11 +1330,15 @@ parse_dsc_for_main(const struct parse_dsc_for_main_args args) {
             }
 
             const uint32_t index = number - 1;
-            struct dyld_cache_image_info *const image = dsc_info.images + index;
+            struct dyld_cache_image_info *const image =
+                dsc_info->images + index;
 
             const uint32_t path_offset = image->pathFileOffset;
             const char *const image_path =
-                (const char *)(dsc_info.map + path_offset);
+                (const char *)(dsc_info->map + path_offset);
+
+            iterate_info.image_path = image_path;
+            iterate_info.image_path_length = 0;
 
             if (actually_parse_image(&iterate_info, image, image_path) == 0) {
                 image->pad |= F_DYLD_CACHE_IMAGE_INFO_PAD_ALREADY_EXTRACTED;
@@ -1060,7 +1352,11 @@ parse_dsc_for_main(const struct parse_dsc_for_main_args args) {
 
         if (filters->item_count == 0) {
             print_dsc_warnings(&iterate_info, filters);
-            dyld_shared_cache_info_destroy(&dsc_info);
+            parse_dependency_closure(dsc_info, &iterate_info);
+
+            if (args.dsc_cache == NULL) {
+                dyld_shared_cache_info_destroy(dsc_info);
+            }
 
             return E_PARSE_DSC_FOR_MAIN_OK;
         }
@@ -1082,23 +1378,27 @@ parse_dsc_for_main(const struct parse_dsc_for_main_args args) {
      * unnecessary mkdir() calls.
      */
 
-    dsc_iterate_images(&dsc_info, &iterate_info);
-    dyld_shared_cache_info_destroy(&dsc_info);
+    dsc_iterate_images(dsc_info, &iterate_info);
+    parse_dependency_closure(dsc_info, &iterate_info);
+
+    if (args.dsc_cache == NULL) {
+        dyld_shared_cache_info_destroy(dsc_info);
+    }
 
     /*
      * After iterating over all our images, we need to cleanup after
      * combine_file.
      *
      * Specifically, we need to do two things:
-     *     (1) First, we need to write the tbd-footer, which is written last
-     *         after writing out all the tbds.
+     *     (1) First, we need to write the tbd-footer (or the end of the
+     *         archive), which is written last after writing out all the tbds.
      *
      *     (2) Second, finally close the combine-file.
      */
 
     FILE *const combine_file = iterate_info.combine_file;
     if (combine_file != NULL) {
-        if (tbd_write_footer(combine_file)) {
+        if (tbd_for_main_write_combine_end(args.tbd, combine_file)) {
             if (args.print_paths) {
                 fprintf(stderr,
                         "Failed to write footer for combined .tbd file for "
@@ -1178,7 +1478,9 @@ parse_dsc_for_main_while_recursing(
     if (tbd->options.combine_tbds) {
         tbd->flags.dsc_write_path_is_file = true;
         tbd->write_options.ignore_footer = true;
-    } else if (args->options.verify_write_path) {
+    } else if (args->options.verify_write_path &&
+               !tbd->options.archive_tbds)
+    {
         verify_write_path(tbd);
     }
 
@@ -1237,7 +1539,8 @@ parse_dsc_for_main_while_recursing(
         .print_paths = print_paths,
         .parse_all_images = true,
 
-        .export_trie_sb = args->export_trie_sb
+        .export_trie_sb = args->export_trie_sb,
+        .dir_cache = args->dir_cache
     };
 
     const struct array *const filters = &tbd->dsc_image_filters;
@@ -1288,6 +1591,9 @@ parse_dsc_for_main_while_recursing(
             const char *const image_path =
                 (const char *)(dsc_info.map + path_offset);
 
+            iterate_info.image_path = image_path;
+            iterate_info.image_path_length = 0;
+
             if (actually_parse_image(&iterate_info, image, image_path) == 0) {
                 image->pad |= F_DYLD_CACHE_IMAGE_INFO_PAD_ALREADY_EXTRACTED;
             }
@@ -1303,10 +1609,11 @@ parse_dsc_for_main_while_recursing(
 
         const uint64_t filters_count = filters->item_count;
         if (filters_count == 0) {
-            free(write_path);
-
             print_dsc_warnings(&iterate_info, filters);
+            parse_dependency_closure(&dsc_info, &iterate_info);
+
             dyld_shared_cache_info_destroy(&dsc_info);
+            free(write_path);
 
             return E_PARSE_DSC_FOR_MAIN_OK;
         }
@@ -1331,6 +1638,8 @@ parse_dsc_for_main_while_recursing(
      */
 
     dsc_iterate_images(&dsc_info, &iterate_info);
+    parse_dependency_closure(&dsc_info, &iterate_info);
+
     dyld_shared_cache_info_destroy(&dsc_info);
 
     /*
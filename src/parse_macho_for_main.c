@@ -19,9 +19,11 @@
 #include "macho_file.h"
 #include "our_io.h"
 #include "parse_macho_for_main.h"
+#include "path.h"
 #include "recursive.h"
 #include "tbd.h"
 #include "tbd_for_main.h"
+#include "util.h"
 
 static void verify_write_path(const struct tbd_for_main *__notnull const tbd) {
     const char *const write_path = tbd->write_path;
@@ -69,6 +71,7 @@ open_file_for_path(const struct parse_macho_for_main_args *__notnull const args,
     const struct tbd_for_main *const tbd = args->tbd;
     const enum tbd_for_main_open_write_file_result open_file_result =
         tbd_for_main_open_write_file_for_path(tbd,
+                                              args->dir_cache,
                                               write_path,
                                               write_path_length,
                                               &file,
@@ -126,13 +129,35 @@ open_file_for_path_while_recursing(struct parse_macho_for_main_args *const args,
         return file;
     }
 
+    /*
+     * When archiving, all .tbds are written to the archive at the write-path
+     * provided, and not to the file's own write-path. The directories created
+     * for the archive should not be removed if a file fails to be written.
+     */
+
     const struct tbd_for_main *const tbd = args->tbd;
-    const enum tbd_for_main_open_write_file_result open_file_result =
-        tbd_for_main_open_write_file_for_path(tbd,
-                                              write_path,
-                                              write_path_length,
-                                              &file,
-                                              terminator_out);
+
+    char *archive_terminator = NULL;
+    enum tbd_for_main_open_write_file_result open_file_result =
+        E_TBD_FOR_MAIN_OPEN_WRITE_FILE_OK;
+
+    if (tbd->options.archive_tbds) {
+        open_file_result =
+            tbd_for_main_open_write_file_for_path(tbd,
+                                                  args->dir_cache,
+                                                  tbd->write_path,
+                                                  tbd->write_path_length,
+                                                  &file,
+                                                  &archive_terminator);
+    } else {
+        open_file_result =
+            tbd_for_main_open_write_file_for_path(tbd,
+                                                  args->dir_cache,
+                                                  write_path,
+                                                  write_path_length,
+                                                  &file,
+                                                  terminator_out);
+    }
 
     switch (open_file_result) {
         case E_TBD_FOR_MAIN_OPEN_WRITE_FILE_OK:
@@ -158,13 +183,67 @@ open_file_for_path_while_recursing(struct parse_macho_for_main_args *const args,
             return NULL;
     }
 
-    if (tbd->options.combine_tbds) {
+    if (tbd->options.combine_tbds || tbd->options.archive_tbds) {
         args->combine_file = file;
     }
 
     return file;
 }
 
+/*
+ * A single mach-o file is stored in the archive under its own file-name.
+ */
+
+static void
+write_to_archive(const struct parse_macho_for_main_args *__notnull const args,
+                 FILE *__notnull const file)
+{
+    const struct tbd_for_main *const tbd = args->tbd;
+
+    const char *const path = args->dir_path;
+    const char *const path_end = path + args->dir_path_length;
+    const char *const last_slash = find_last_slash(path, path_end);
+
+    const char *name = path;
+    if (last_slash != NULL) {
+        name = last_slash + 1;
+    }
+
+    uint64_t member_path_length = 0;
+    char *const member_path =
+        path_append_comp_and_ext(tbd->write_path,
+                                 tbd->write_path_length,
+                                 name,
+                                 (uint64_t)(path_end - name),
+                                 "tbd",
+                                 3,
+                                 &member_path_length);
+
+    if (member_path == NULL) {
+        fputs("Failed to allocate memory\n", stderr);
+        exit(1);
+    }
+
+    tbd_for_main_write_to_file(tbd,
+                               member_path,
+                               member_path_length,
+                               NULL,
+                               file,
+                               args->print_paths);
+
+    free(member_path);
+
+    if (tbd_for_main_write_combine_end(tbd, file)) {
+        if (args->print_paths) {
+            fprintf(stderr,
+                    "Failed to finish the archive at path: %s\n",
+                    tbd->write_path);
+        } else {
+            fputs("Failed to finish the provided archive\n", stderr);
+        }
+    }
+}
+
 enum parse_macho_for_main_result
 parse_macho_file_for_main(const struct parse_macho_for_main_args args) {
     struct macho_file macho = {};
@@ -224,11 +303,14 @@ parse_macho_file_for_main(const struct parse_macho_for_main_args args) {
         .export_trie_sb = &sb_buffer
     };
 
+    const struct tbd_parse_options parse_options =
+        tbd_for_main_create_parse_plan(args.tbd);
+
     const enum macho_file_parse_result parse_macho_result =
         macho_file_parse_from_file(info,
                                    &macho,
                                    extra,
-                                   args.tbd->parse_options,
+                                   parse_options,
                                    args.tbd->macho_options);
 
     if (parse_macho_result != E_MACHO_FILE_PARSE_OK) {
@@ -264,12 +346,16 @@ parse_macho_file_for_main(const struct parse_macho_for_main_args args) {
             return E_PARSE_MACHO_FOR_MAIN_OK;
         }
 
-        tbd_for_main_write_to_file(args.tbd,
-                                   write_path,
-                                   write_path_length,
-                                   terminator,
-                                   file,
-                                   args.print_paths);
+        if (args.tbd->options.archive_tbds) {
+            write_to_archive(&args, file);
+        } else {
+            tbd_for_main_write_to_file(args.tbd,
+                                       write_path,
+                                       write_path_length,
+                                       terminator,
+                                       file,
+                                       args.print_paths);
+        }
 
         fclose(file);
     } else {
@@ -280,47 +366,21 @@ parse_macho_file_for_main(const struct parse_macho_for_main_args args) {
     return E_PARSE_MACHO_FOR_MAIN_OK;
 }
 
-enum parse_macho_for_main_result
-parse_macho_file_for_main_while_recursing(
-    struct parse_macho_for_main_args *__notnull const args)
+/*
+ * Parse a mach-o file for a recursing-operation, either from macho, or from
+ * map if macho is NULL, and write out its .tbd file.
+ *
+ * Mach-o files from a map are members of an archive, with args->name storing
+ * the member's path, which is preserved under the write-path.
+ */
+
+static enum parse_macho_for_main_result
+parse_and_write_while_recursing(
+    struct parse_macho_for_main_args *__notnull const args,
+    struct macho_file *const macho,
+    const uint8_t *const map,
+    const uint64_t map_size)
 {
-    struct macho_file macho = {};
-    struct range range = {};
-
-    const enum macho_file_open_result open_macho_result =
-        macho_file_open(&macho, args->magic_buffer, args->fd, range);
-
-    switch (open_macho_result) {
-        case E_MACHO_FILE_OPEN_OK:
-            break;
-
-        case E_MACHO_FILE_OPEN_READ_FAIL:
-        case E_MACHO_FILE_OPEN_FSTAT_FAIL:
-            handle_macho_file_open_result(open_macho_result,
-                                          args->dir_path,
-                                          args->name,
-                                          args->print_paths,
-                                          true);
-
-            return E_PARSE_MACHO_FOR_MAIN_OTHER_ERROR;
-
-        case E_MACHO_FILE_OPEN_NOT_A_MACHO:
-            if (args->dont_handle_non_macho_error) {
-                return E_PARSE_MACHO_FOR_MAIN_NOT_A_MACHO;
-            }
-
-            handle_macho_file_open_result(open_macho_result,
-                                          args->dir_path,
-                                          args->name,
-                                          args->print_paths,
-                                          true);
-
-            return E_PARSE_MACHO_FOR_MAIN_NOT_A_MACHO;
-
-        default:
-            break;
-    }
-
     /*
      * Handle any provided replacement options.
      */
@@ -352,12 +412,26 @@ parse_macho_file_for_main_while_recursing(
         .export_trie_sb = args->export_trie_sb
     };
 
-    const enum macho_file_parse_result parse_macho_result =
-        macho_file_parse_from_file(info,
-                                   &macho,
-                                   extra,
-                                   tbd->parse_options,
-                                   tbd->macho_options);
+    const struct tbd_parse_options parse_options =
+        tbd_for_main_create_parse_plan(tbd);
+
+    enum macho_file_parse_result parse_macho_result = E_MACHO_FILE_PARSE_OK;
+    if (macho != NULL) {
+        parse_macho_result =
+            macho_file_parse_from_file(info,
+                                       macho,
+                                       extra,
+                                       parse_options,
+                                       tbd->macho_options);
+    } else {
+        parse_macho_result =
+            macho_file_parse_from_map(info,
+                                      map,
+                                      map_size,
+                                      extra,
+                                      parse_options,
+                                      tbd->macho_options);
+    }
 
     if (parse_macho_result != E_MACHO_FILE_PARSE_OK) {
         tbd_create_info_clear_fields_and_create_from(info, orig_info);
@@ -376,17 +450,38 @@ parse_macho_file_for_main_while_recursing(
     char *write_path = NULL;
     uint64_t write_path_length = 0;
 
-    const bool should_combine = tbd->options.combine_tbds;
-    if (!should_combine) {
-        write_path =
-            tbd_for_main_create_write_path_for_recursing(tbd,
-                                                         dir_path,
-                                                         args->dir_path_length,
+    const bool should_combine =
+        tbd->options.combine_tbds || tbd->options.archive_tbds;
+
+    /*
+     * When archiving, we still need each file's write-path to name its member
+     * in the archive.
+     */
+
+    const bool alloc_path = !tbd->options.combine_tbds;
+    if (alloc_path) {
+        if (macho != NULL) {
+            write_path =
+                tbd_for_main_create_write_path_for_recursing(
+                    tbd,
+                    dir_path,
+                    args->dir_path_length,
+                    name,
+                    args->name_length,
+                    "tbd",
+                    3,
+                    &write_path_length);
+        } else {
+            write_path =
+                tbd_for_main_create_dsc_image_write_path(tbd,
+                                                         tbd->write_path,
+                                                         tbd->write_path_length,
                                                          name,
                                                          args->name_length,
                                                          "tbd",
                                                          3,
                                                          &write_path_length);
+        }
     } else {
         write_path = tbd->write_path;
         write_path_length = tbd->write_path_length;
@@ -402,7 +497,7 @@ parse_macho_file_for_main_while_recursing(
                                            &terminator);
 
     if (file == NULL) {
-        if (!should_combine) {
+        if (alloc_path) {
             free(write_path);
         }
 
@@ -419,9 +514,65 @@ parse_macho_file_for_main_while_recursing(
 
     if (!should_combine) {
         fclose(file);
+    }
+
+    if (alloc_path) {
         free(write_path);
     }
 
     tbd_create_info_clear_fields_and_create_from(info, orig_info);
     return E_PARSE_MACHO_FOR_MAIN_OK;
 }
+
+enum parse_macho_for_main_result
+parse_macho_file_for_main_while_recursing(
+    struct parse_macho_for_main_args *__notnull const args)
+{
+    struct macho_file macho = {};
+    struct range range = {};
+
+    const enum macho_file_open_result open_macho_result =
+        macho_file_open(&macho, args->magic_buffer, args->fd, range);
+
+    switch (open_macho_result) {
+        case E_MACHO_FILE_OPEN_OK:
+            break;
+
+        case E_MACHO_FILE_OPEN_READ_FAIL:
+        case E_MACHO_FILE_OPEN_FSTAT_FAIL:
+            handle_macho_file_open_result(open_macho_result,
+                                          args->dir_path,
+                                          args->name,
+                                          args->print_paths,
+                                          true);
+
+            return E_PARSE_MACHO_FOR_MAIN_OTHER_ERROR;
+
+        case E_MACHO_FILE_OPEN_NOT_A_MACHO:
+            if (args->dont_handle_non_macho_error) {
+                return E_PARSE_MACHO_FOR_MAIN_NOT_A_MACHO;
+            }
+
+            handle_macho_file_open_result(open_macho_result,
+                                          args->dir_path,
+                                          args->name,
+                                          args->print_paths,
+                                          true);
+
+            return E_PARSE_MACHO_FOR_MAIN_NOT_A_MACHO;
+
+        default:
+            break;
+    }
+
+    return parse_and_write_while_recursing(args, &macho, NULL, 0);
+}
+
+enum parse_macho_for_main_result
+parse_macho_map_for_main_while_recursing(
+    struct parse_macho_for_main_args *__notnull const args,
+    const uint8_t *__notnull const map,
+    const uint64_t map_size)
+{
+    return parse_and_write_while_recursing(args, NULL, map, map_size);
+}
@@ -0,0 +1,449 @@
+//
+//  src/parse_tbd_for_main.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <inttypes.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "parse_tbd_for_main.h"
+#include "tbd.h"
+#include "tbd_for_main.h"
+#include "tbd_read.h"
+
+static void verify_write_path(const struct tbd_for_main *__notnull const tbd) {
+    const char *const write_path = tbd->write_path;
+    if (write_path == NULL) {
+        return;
+    }
+
+    struct stat sbuf = {};
+    if (stat(write_path, &sbuf) < 0) {
+        /*
+         * The write-file doesn't have to exist.
+         */
+
+        if (errno != ENOENT) {
+            fprintf(stderr,
+                    "Failed to get information on object at the provided write-"
+                    "path (%s), error: %s\n",
+                    write_path,
+                    strerror(errno));
+
+            exit(1);
+        }
+
+        return;
+    }
+
+    if (!S_ISREG(sbuf.st_mode)) {
+        fprintf(stderr,
+                "Writing to a regular file while parsing a .tbd file (at path "
+                "%s) is not supported",
+                tbd->parse_path);
+
+        exit(1);
+    }
+}
+
+static void
+print_file_path(const struct parse_tbd_for_main_args *__notnull const args,
+                const bool is_recursing)
+{
+    if (is_recursing) {
+        fprintf(stderr, "File (at path %s/%s)", args->dir_path, args->name);
+    } else if (args->print_paths) {
+        fprintf(stderr, "File (at path %s)", args->dir_path);
+    } else {
+        fputs("File at the provided path", stderr);
+    }
+}
+
+static void
+handle_open_result(const struct parse_tbd_for_main_args *__notnull const args,
+                   const enum tbd_file_open_result result,
+                   const bool is_recursing)
+{
+    switch (result) {
+        case E_TBD_FILE_OPEN_OK:
+            break;
+
+        case E_TBD_FILE_OPEN_ALLOC_FAIL:
+            fputs("Failed to allocate memory\n", stderr);
+            break;
+
+        case E_TBD_FILE_OPEN_READ_FAIL:
+            print_file_path(args, is_recursing);
+            fprintf(stderr, " could not be read, error: %s\n", strerror(errno));
+
+            break;
+
+        case E_TBD_FILE_OPEN_FSTAT_FAIL:
+            print_file_path(args, is_recursing);
+            fprintf(stderr,
+                    " could not be fstat()'d, error: %s\n",
+                    strerror(errno));
+
+            break;
+
+        case E_TBD_FILE_OPEN_MMAP_FAIL:
+            print_file_path(args, is_recursing);
+            fprintf(stderr,
+                    " could not be mapped, error: %s\n",
+                    strerror(errno));
+
+            break;
+
+        case E_TBD_FILE_OPEN_NOT_A_TBD:
+            print_file_path(args, is_recursing);
+            fputs(" is not a valid .tbd file\n", stderr);
+
+            break;
+    }
+}
+
+static void
+handle_read_result(const struct parse_tbd_for_main_args *__notnull const args,
+                   const struct tbd_file *__notnull const file,
+                   const enum tbd_file_read_result result,
+                   const bool is_recursing)
+{
+    const char *reason = NULL;
+    switch (result) {
+        case E_TBD_FILE_READ_OK:
+            return;
+
+        case E_TBD_FILE_READ_NO_MORE_DOCUMENTS:
+            print_file_path(args, is_recursing);
+            fputs(" has no documents\n", stderr);
+
+            return;
+
+        case E_TBD_FILE_READ_ALLOC_FAIL:
+        case E_TBD_FILE_READ_ARRAY_FAIL:
+            fputs("Failed to allocate memory\n", stderr);
+            return;
+
+        case E_TBD_FILE_READ_UNSUPPORTED_VERSION:
+            reason = "has an unsupported tbd-version";
+            break;
+
+        case E_TBD_FILE_READ_INVALID_SYNTAX:
+            reason = "has invalid syntax";
+            break;
+
+        case E_TBD_FILE_READ_INVALID_ARCH:
+            reason = "has an unrecognized arch";
+            break;
+
+        case E_TBD_FILE_READ_INVALID_PLATFORM:
+            reason = "has an unrecognized platform";
+            break;
+
+        case E_TBD_FILE_READ_INVALID_TARGET:
+            reason = "has an invalid target";
+            break;
+
+        case E_TBD_FILE_READ_INVALID_VERSION:
+            reason = "has an invalid version";
+            break;
+
+        case E_TBD_FILE_READ_INVALID_UUID:
+            reason = "has an invalid uuid";
+            break;
+
+        case E_TBD_FILE_READ_MISSING_TARGETS:
+            reason = "is missing its archs or targets";
+            break;
+
+        case E_TBD_FILE_READ_MISSING_INSTALL_NAME:
+            reason = "is missing its install-name";
+            break;
+
+        case E_TBD_FILE_READ_MISSING_PLATFORM:
+            reason = "is missing its platform";
+            break;
+
+        case E_TBD_FILE_READ_NON_UNIQUE_UUID:
+            reason = "has a non-unique uuid";
+            break;
+
+        case E_TBD_FILE_READ_PARENT_UMBRELLA_CONFLICT:
+            reason = "has conflicting parent-umbrellas";
+            break;
+    }
+
+    print_file_path(args, is_recursing);
+    fprintf(stderr, " %s (on line %" PRIu64 ")\n", reason, file->line);
+}
+
+/*
+ * Clear the create-info, which may borrow strings from the file, before the
+ * file is closed.
+ */
+
+static void
+clear_and_close(const struct parse_tbd_for_main_args *__notnull const args,
+                struct tbd_file *__notnull const file)
+{
+    struct tbd_create_info *const info = &args->tbd->info;
+    const struct tbd_create_info *const orig_info = &args->orig->info;
+
+    tbd_create_info_clear_fields_and_create_from(info, orig_info);
+    info->version = orig_info->version;
+
+    tbd_file_close(file);
+}
+
+static enum parse_tbd_for_main_result
+read_tbd_file(const struct parse_tbd_for_main_args *__notnull const args,
+              struct tbd_file *__notnull const file,
+              const bool is_recursing)
+{
+    const enum tbd_file_open_result open_result =
+        tbd_file_open(file, args->magic_buffer, args->fd);
+
+    switch (open_result) {
+        case E_TBD_FILE_OPEN_OK:
+            break;
+
+        case E_TBD_FILE_OPEN_NOT_A_TBD:
+            if (!args->dont_handle_non_tbd_error) {
+                handle_open_result(args, open_result, is_recursing);
+            }
+
+            return E_PARSE_TBD_FOR_MAIN_NOT_A_TBD;
+
+        default:
+            handle_open_result(args, open_result, is_recursing);
+            return E_PARSE_TBD_FOR_MAIN_OTHER_ERROR;
+    }
+
+    /*
+     * Unless a tbd-version was provided, the .tbd file is written out in its
+     * own version.
+     */
+
+    struct tbd_for_main *const tbd = args->tbd;
+    if (!tbd->flags.provided_tbd_version) {
+        tbd->info.version = TBD_VERSION_NONE;
+    }
+
+    const enum tbd_file_read_result read_result =
+        tbd_file_read_next(file, &tbd->info, tbd->parse_options);
+
+    if (read_result != E_TBD_FILE_READ_OK) {
+        handle_read_result(args, file, read_result, is_recursing);
+        clear_and_close(args, file);
+
+        return E_PARSE_TBD_FOR_MAIN_OTHER_ERROR;
+    }
+
+    tbd_for_main_handle_post_parse(tbd);
+    return E_PARSE_TBD_FOR_MAIN_OK;
+}
+
+enum parse_tbd_for_main_result
+parse_tbd_file_for_main(const struct parse_tbd_for_main_args args) {
+    struct tbd_file file = {};
+    const enum parse_tbd_for_main_result read_result =
+        read_tbd_file(&args, &file, false);
+
+    if (read_result != E_PARSE_TBD_FOR_MAIN_OK) {
+        return read_result;
+    }
+
+    struct tbd_for_main *const tbd = args.tbd;
+    verify_write_path(tbd);
+
+    char *const write_path = tbd->write_path;
+    const uint64_t write_path_length = tbd->write_path_length;
+
+    if (write_path == NULL) {
+        tbd_for_main_write_to_stdout(tbd, args.dir_path, true);
+        clear_and_close(&args, &file);
+
+        return E_PARSE_TBD_FOR_MAIN_OK;
+    }
+
+    FILE *write_file = NULL;
+    char *terminator = NULL;
+
+    const enum tbd_for_main_open_write_file_result open_file_result =
+        tbd_for_main_open_write_file_for_path(tbd,
+                                              args.dir_cache,
+                                              write_path,
+                                              write_path_length,
+                                              &write_file,
+                                              &terminator);
+
+    switch (open_file_result) {
+        case E_TBD_FOR_MAIN_OPEN_WRITE_FILE_OK:
+            tbd_for_main_write_to_file(tbd,
+                                       write_path,
+                                       write_path_length,
+                                       terminator,
+                                       write_file,
+                                       args.print_paths);
+
+            fclose(write_file);
+            break;
+
+        case E_TBD_FOR_MAIN_OPEN_WRITE_FILE_FAILED:
+            fprintf(stderr,
+                    "Failed to open the provided write-file, error: %s\n",
+                    strerror(errno));
+
+            break;
+
+        case E_TBD_FOR_MAIN_OPEN_WRITE_FILE_PATH_ALREADY_EXISTS:
+            if (!tbd->options.ignore_warnings) {
+                fputs("File at the provided path has an object at its "
+                      "write-path\n",
+                      stderr);
+            }
+
+            break;
+    }
+
+    clear_and_close(&args, &file);
+    return E_PARSE_TBD_FOR_MAIN_OK;
+}
+
+enum parse_tbd_for_main_result
+parse_tbd_file_for_main_while_recursing(
+    struct parse_tbd_for_main_args *__notnull const args)
+{
+    struct tbd_file file = {};
+    const enum parse_tbd_for_main_result read_result =
+        read_tbd_file(args, &file, true);
+
+    if (read_result != E_PARSE_TBD_FOR_MAIN_OK) {
+        return read_result;
+    }
+
+    struct tbd_for_main *const tbd = args->tbd;
+
+    char *write_path = NULL;
+    uint64_t write_path_length = 0;
+
+    const bool should_combine =
+        tbd->options.combine_tbds || tbd->options.archive_tbds;
+
+    /*
+     * Drop the .tbd extension the file already has, so the extension isn't
+     * added twice.
+     */
+
+    uint64_t name_length = args->name_length;
+    if (name_length > 4) {
+        if (memcmp(args->name + name_length - 4, ".tbd", 4) == 0) {
+            name_length -= 4;
+        }
+    }
+
+    const bool alloc_path = !tbd->options.combine_tbds;
+    if (alloc_path) {
+        write_path =
+            tbd_for_main_create_write_path_for_recursing(tbd,
+                                                         args->dir_path,
+                                                         args->dir_path_length,
+                                                         args->name,
+                                                         name_length,
+                                                         "tbd",
+                                                         3,
+                                                         &write_path_length);
+    } else {
+        write_path = tbd->write_path;
+        write_path_length = tbd->write_path_length;
+
+        tbd->write_options.ignore_footer = true;
+    }
+
+    FILE *file_out = args->combine_file;
+    char *terminator = NULL;
+
+    if (file_out == NULL) {
+        char *open_path = write_path;
+        uint64_t open_path_length = write_path_length;
+
+        if (tbd->options.archive_tbds) {
+            open_path = tbd->write_path;
+            open_path_length = tbd->write_path_length;
+        }
+
+        const enum tbd_for_main_open_write_file_result open_file_result =
+            tbd_for_main_open_write_file_for_path(tbd,
+                                                  args->dir_cache,
+                                                  open_path,
+                                                  open_path_length,
+                                                  &file_out,
+                                                  &terminator);
+
+        switch (open_file_result) {
+            case E_TBD_FOR_MAIN_OPEN_WRITE_FILE_OK:
+                break;
+
+            case E_TBD_FOR_MAIN_OPEN_WRITE_FILE_FAILED:
+                fprintf(stderr,
+                        "Failed to open write-file (at path: %s), error: %s\n",
+                        open_path,
+                        strerror(errno));
+
+                break;
+
+            case E_TBD_FOR_MAIN_OPEN_WRITE_FILE_PATH_ALREADY_EXISTS:
+                if (!tbd->options.ignore_warnings) {
+                    fprintf(stderr,
+                            "File at write-path (%s) already exists\n",
+                            open_path);
+                }
+
+                break;
+        }
+
+        if (file_out == NULL) {
+            if (alloc_path) {
+                free(write_path);
+            }
+
+            clear_and_close(args, &file);
+            return E_PARSE_TBD_FOR_MAIN_OTHER_ERROR;
+        }
+
+        if (should_combine) {
+            args->combine_file = file_out;
+        }
+
+        if (tbd->options.archive_tbds) {
+            terminator = NULL;
+        }
+    }
+
+    tbd_for_main_write_to_file(tbd,
+                               write_path,
+                               write_path_length,
+                               terminator,
+                               file_out,
+                               true);
+
+    if (!should_combine) {
+        fclose(file_out);
+    }
+
+    if (alloc_path) {
+        free(write_path);
+    }
+
+    clear_and_close(args, &file);
+    return E_PARSE_TBD_FOR_MAIN_OK;
+}
@@ -0,0 +1,351 @@
+//
+//  src/parse_zip_for_main.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "copy.h"
+#include "macho_file.h"
+#include "parse_macho_for_main.h"
+#include "parse_zip_for_main.h"
+#include "zip_file.h"
+
+static bool is_zip_magic(const uint8_t *__notnull const magic) {
+    if (magic[0] != 'P' || magic[1] != 'K') {
+        return false;
+    }
+
+    /*
+     * An empty zip-file only has its end-of-central-directory record.
+     */
+
+    return ((magic[2] == 3 && magic[3] == 4) ||
+            (magic[2] == 5 && magic[3] == 6));
+}
+
+static void
+handle_zip_open_result(const struct parse_zip_for_main_args *__notnull args,
+                       const enum zip_file_open_result result)
+{
+    const char *reason = NULL;
+    switch (result) {
+        case E_ZIP_FILE_OPEN_OK:
+            return;
+
+        case E_ZIP_FILE_OPEN_FSTAT_FAIL:
+            reason = "Failed to get information on";
+            break;
+
+        case E_ZIP_FILE_OPEN_MMAP_FAIL:
+            reason = "Failed to map";
+            break;
+
+        case E_ZIP_FILE_OPEN_NOT_A_ZIP:
+        case E_ZIP_FILE_OPEN_INVALID_CENTRAL_DIRECTORY:
+            reason = "Found an invalid central-directory in";
+            break;
+
+        case E_ZIP_FILE_OPEN_MULTIPLE_DISKS:
+            reason = "Multi-disk archives are not supported, for";
+            break;
+    }
+
+    if (args->print_paths) {
+        fprintf(stderr, "%s zip file at path: %s\n", reason, args->path);
+    } else {
+        fprintf(stderr, "%s zip file at the provided path\n", reason);
+    }
+}
+
+/*
+ * Member-names become paths under the write-path, so names that would escape
+ * the write-path are not allowed.
+ */
+
+static bool
+member_name_is_safe(const char *__notnull const name, const uint64_t length) {
+    if (length == 0 || name[0] == '/') {
+        return false;
+    }
+
+    if (memchr(name, '\0', length) != NULL) {
+        return false;
+    }
+
+    const char *comp = name;
+    const char *const end = name + length;
+
+    while (comp != end) {
+        const char *comp_end = memchr(comp, '/', (size_t)(end - comp));
+        if (comp_end == NULL) {
+            comp_end = end;
+        }
+
+        if (comp_end - comp == 2 && comp[0] == '.' && comp[1] == '.') {
+            return false;
+        }
+
+        if (comp_end == end) {
+            break;
+        }
+
+        comp = comp_end + 1;
+    }
+
+    return true;
+}
+
+static void
+handle_member_read_result(const struct parse_zip_for_main_args *__notnull args,
+                          const struct zip_file_member *__notnull const member,
+                          const enum zip_file_read_result result)
+{
+    const int name_length = (int)member->name_length;
+    switch (result) {
+        case E_ZIP_FILE_READ_OK:
+            break;
+
+        case E_ZIP_FILE_READ_ALLOC_FAIL:
+            fputs("Failed to allocate memory\n", stderr);
+            exit(1);
+
+        /*
+         * Members that can't be read can't be known to be mach-o files either,
+         * so they're skipped silently.
+         */
+
+        case E_ZIP_FILE_READ_ENCRYPTED:
+        case E_ZIP_FILE_READ_UNSUPPORTED_COMPRESSION:
+            break;
+
+        case E_ZIP_FILE_READ_INVALID_LOCAL_HEADER:
+            fprintf(stderr,
+                    "Member (with name %.*s) of zip file (at path %s) has an "
+                    "invalid local-header\n",
+                    name_length,
+                    member->name,
+                    args->path);
+
+            break;
+
+        case E_ZIP_FILE_READ_INVALID_DATA:
+            fprintf(stderr,
+                    "Member (with name %.*s) of zip file (at path %s) has "
+                    "invalid or corrupt data\n",
+                    name_length,
+                    member->name,
+                    args->path);
+
+            break;
+    }
+}
+
+/*
+ * Check a member's magic before reading all of it, so that only the front of
+ * members that aren't mach-o files is ever inflated.
+ */
+
+static bool
+member_is_macho(const struct parse_zip_for_main_args *__notnull const args,
+                const struct zip_file *__notnull const zip,
+                const struct zip_file_member *__notnull const member)
+{
+    if (zip_file_member_is_directory(member)) {
+        return false;
+    }
+
+    if (member->size < sizeof(struct mach_header)) {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    const enum zip_file_read_result read_front_result =
+        zip_file_read_member_front(zip, member, &magic, sizeof(magic));
+
+    if (read_front_result != E_ZIP_FILE_READ_OK) {
+        handle_member_read_result(args, member, read_front_result);
+        return false;
+    }
+
+    return macho_file_magic_is_valid(magic);
+}
+
+static bool
+parse_member(const struct parse_zip_for_main_args *__notnull const args,
+             struct parse_macho_for_main_args *__notnull const macho_args,
+             const struct zip_file *__notnull const zip,
+             const struct zip_file_member *__notnull const member)
+{
+    if (!member_name_is_safe(member->name, member->name_length)) {
+        fprintf(stderr,
+                "Member (with name %.*s) of zip file (at path %s) has a name "
+                "that can't be used as a write-path, skipping\n",
+                (int)member->name_length,
+                member->name,
+                args->path);
+
+        return false;
+    }
+
+    struct zip_file_data data = {};
+    const enum zip_file_read_result read_result =
+        zip_file_read_member(zip, member, &data);
+
+    if (read_result != E_ZIP_FILE_READ_OK) {
+        handle_member_read_result(args, member, read_result);
+        return false;
+    }
+
+    char *const name = alloc_and_copy(member->name, member->name_length);
+    if (name == NULL) {
+        fputs("Failed to allocate memory\n", stderr);
+        exit(1);
+    }
+
+    macho_args->name = name;
+    macho_args->name_length = member->name_length;
+
+    const enum parse_macho_for_main_result parse_result =
+        parse_macho_map_for_main_while_recursing(macho_args,
+                                                 data.data,
+                                                 data.size);
+
+    free(name);
+    zip_file_data_destroy(&data);
+
+    return (parse_result == E_PARSE_MACHO_FOR_MAIN_OK);
+}
+
+enum parse_zip_for_main_result
+parse_zip_for_main(const struct parse_zip_for_main_args *__notnull const args) {
+    const enum magic_buffer_result read_magic_result =
+        magic_buffer_read_n(args->magic_buffer, args->fd, 4);
+
+    if (read_magic_result != E_MAGIC_BUFFER_OK) {
+        if (args->print_paths) {
+            fprintf(stderr,
+                    "Failed to read file at path: %s, error: %s\n",
+                    args->path,
+                    strerror(errno));
+        } else {
+            fprintf(stderr,
+                    "Failed to read file at the provided path, error: %s\n",
+                    strerror(errno));
+        }
+
+        return E_PARSE_ZIP_FOR_MAIN_OTHER_ERROR;
+    }
+
+    const struct magic_buffer *const magic_buffer = args->magic_buffer;
+    if (magic_buffer->read < 4 || !is_zip_magic(magic_buffer->buff)) {
+        if (!args->dont_handle_non_zip_error) {
+            if (args->print_paths) {
+                fprintf(stderr,
+                        "File at path %s is not a zip file\n",
+                        args->path);
+            } else {
+                fputs("File at the provided path is not a zip file\n",
+                      stderr);
+            }
+        }
+
+        return E_PARSE_ZIP_FOR_MAIN_NOT_A_ZIP;
+    }
+
+    struct tbd_for_main *const tbd = args->tbd;
+    if (tbd->write_path == NULL) {
+        fputs("Writing to stdout (the terminal) while parsing a zip file is "
+              "not supported.\nPlease provide a directory to write all "
+              "created files to\n",
+              stderr);
+
+        return E_PARSE_ZIP_FOR_MAIN_OTHER_ERROR;
+    }
+
+    struct zip_file zip = {};
+    const enum zip_file_open_result open_result = zip_file_open(&zip, args->fd);
+
+    if (open_result != E_ZIP_FILE_OPEN_OK) {
+        handle_zip_open_result(args, open_result);
+        return E_PARSE_ZIP_FOR_MAIN_OTHER_ERROR;
+    }
+
+    struct parse_macho_for_main_args macho_args = {
+        .fd = -1,
+        .retained = args->retained,
+
+        .tbd = tbd,
+        .orig = args->orig,
+
+        .dir_path = args->path,
+        .dir_path_length = args->path_length,
+
+        .print_paths = true,
+
+        .export_trie_sb = args->export_trie_sb,
+        .dir_cache = args->dir_cache
+    };
+
+    enum parse_zip_for_main_result result = E_PARSE_ZIP_FOR_MAIN_OK;
+    uint64_t files_parsed = 0;
+    uint64_t offset = 0;
+
+    do {
+        struct zip_file_member member = {};
+        const enum zip_file_member_result get_member_result =
+            zip_file_get_next_member(&zip, &offset, &member);
+
+        if (get_member_result == E_ZIP_FILE_MEMBER_NO_MORE_MEMBERS) {
+            break;
+        }
+
+        if (get_member_result != E_ZIP_FILE_MEMBER_OK) {
+            fprintf(stderr,
+                    "Zip file (at path %s) has an invalid central-directory "
+                    "entry\n",
+                    args->path);
+
+            result = E_PARSE_ZIP_FOR_MAIN_OTHER_ERROR;
+            break;
+        }
+
+        if (!member_is_macho(args, &zip, &member)) {
+            continue;
+        }
+
+        if (parse_member(args, &macho_args, &zip, &member)) {
+            files_parsed += 1;
+        }
+    } while (true);
+
+    zip_file_close(&zip);
+
+    if (files_parsed == 0) {
+        fprintf(stderr,
+                "No new .tbd files were created while parsing zip file (at "
+                "path %s)\n",
+                args->path);
+    }
+
+    FILE *const combine_file = macho_args.combine_file;
+    if (combine_file != NULL) {
+        if (tbd_for_main_write_combine_end(tbd, combine_file)) {
+            fprintf(stderr,
+                    "Failed to write footer for combined .tbd file for files "
+                    "from zip file (at path %s)\n",
+                    args->path);
+
+            result = E_PARSE_ZIP_FOR_MAIN_OTHER_ERROR;
+        }
+
+        fclose(combine_file);
+    }
+
+    return result;
+}
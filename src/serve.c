@@ -0,0 +1,543 @@
+//
+//  src/serve.c
+//  tbd
+//
+//  Created by inoahdev on 2/4/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dsc_cache.h"
+#include "libtbd.h"
+#include "magic_buffer.h"
+#include "our_io.h"
+#include "parse_or_list_fields.h"
+#include "serve.h"
+
+struct serve_info {
+    struct dsc_cache dsc_cache;
+
+    struct libtbd_context ctx;
+    struct tbd_create_info create_info;
+};
+
+enum serve_stream_result {
+    E_SERVE_STREAM_OK,
+    E_SERVE_STREAM_QUIT,
+    E_SERVE_STREAM_WRITE_FAIL
+};
+
+static const char *get_result_description(const enum libtbd_result result) {
+    switch (result) {
+        case E_LIBTBD_OK:
+            return "No error";
+
+        case E_LIBTBD_ALLOC_FAIL:
+            return "Failed to allocate memory";
+
+        case E_LIBTBD_OPEN_FAIL:
+            return "Failed to open file";
+
+        case E_LIBTBD_READ_FAIL:
+            return "Failed to read file";
+
+        case E_LIBTBD_NOT_A_MACHO:
+            return "File is not a mach-o file";
+
+        case E_LIBTBD_NOT_A_CACHE:
+            return "File is not a dyld_shared_cache file";
+
+        case E_LIBTBD_MACHO_PARSE_FAIL:
+            return "Failed to parse mach-o file";
+
+        case E_LIBTBD_DSC_PARSE_FAIL:
+            return "dyld_shared_cache file is invalid";
+
+        case E_LIBTBD_DSC_IMAGE_PARSE_FAIL:
+            return "Failed to parse dyld_shared_cache image";
+
+        case E_LIBTBD_DSC_IMAGE_NOT_FOUND:
+            return "No image with the provided path exists in the "
+                   "dyld_shared_cache";
+
+        case E_LIBTBD_WRITE_FAIL:
+            return "Failed to write .tbd";
+
+        case E_LIBTBD_BUFFER_TOO_SMALL:
+            return "Buffer is too small";
+    }
+
+    return "Unknown error";
+}
+
+static const char *
+get_dsc_result_description(const enum dyld_shared_cache_parse_result result) {
+    switch (result) {
+        case E_DYLD_SHARED_CACHE_PARSE_OK:
+            return "No error";
+
+        case E_DYLD_SHARED_CACHE_PARSE_ALLOC_FAIL:
+            return "Failed to allocate memory";
+
+        case E_DYLD_SHARED_CACHE_PARSE_FSTAT_FAIL:
+        case E_DYLD_SHARED_CACHE_PARSE_READ_FAIL:
+        case E_DYLD_SHARED_CACHE_PARSE_MMAP_FAIL:
+            return "Failed to read file";
+
+        case E_DYLD_SHARED_CACHE_PARSE_NOT_A_CACHE:
+            return "File is not a dyld_shared_cache file";
+
+        case E_DYLD_SHARED_CACHE_PARSE_INVALID_IMAGES:
+            return "dyld_shared_cache file has an invalid images-list";
+
+        case E_DYLD_SHARED_CACHE_PARSE_INVALID_MAPPINGS:
+            return "dyld_shared_cache file has an invalid mappings-list";
+
+        case E_DYLD_SHARED_CACHE_PARSE_OVERLAPPING_RANGES:
+            return "dyld_shared_cache file has overlapping ranges";
+
+        case E_DYLD_SHARED_CACHE_PARSE_OVERLAPPING_IMAGES:
+            return "dyld_shared_cache file has overlapping images";
+
+        case E_DYLD_SHARED_CACHE_PARSE_OVERLAPPING_MAPPINGS:
+            return "dyld_shared_cache file has overlapping mappings";
+    }
+
+    return "Unknown error";
+}
+
+static struct dyld_shared_cache_info *
+get_dsc_for_path(struct serve_info *__notnull const info,
+                 const char *__notnull const path,
+                 const char **__notnull const error_out)
+{
+    const int fd = our_open(path, O_RDONLY, 0);
+    if (fd < 0) {
+        *error_out = strerror(errno);
+        return NULL;
+    }
+
+    struct magic_buffer magic_buffer = {};
+    const enum magic_buffer_result read_magic_result =
+        magic_buffer_read_n(&magic_buffer, fd, 16);
+
+    if (read_magic_result != E_MAGIC_BUFFER_OK) {
+        close(fd);
+
+        *error_out = "Failed to read file";
+        return NULL;
+    }
+
+    /*
+     * The file can be closed as the dyld_shared_cache stays mapped until it's
+     * evicted.
+     */
+
+    const struct dyld_shared_cache_parse_options options = {};
+    struct dyld_shared_cache_info *dsc_info = NULL;
+
+    const enum dyld_shared_cache_parse_result parse_result =
+        dsc_cache_get_for_fd(&info->dsc_cache,
+                             fd,
+                             (const char *)magic_buffer.buff,
+                             options,
+                             &dsc_info);
+
+    close(fd);
+
+    if (parse_result != E_DYLD_SHARED_CACHE_PARSE_OK) {
+        *error_out = get_dsc_result_description(parse_result);
+        return NULL;
+    }
+
+    return dsc_info;
+}
+
+/*
+ * Split line in place into at most max_count fields. If more fields are
+ * present, max_count + 1 is returned.
+ */
+
+static uint64_t
+split_fields(char *__notnull const line,
+             char **__notnull const fields,
+             const uint64_t max_count)
+{
+    const char separator = (strchr(line, '\t') != NULL) ? '\t' : ' ';
+
+    uint64_t count = 0;
+    char *iter = line;
+
+    while (*iter != '\0') {
+        if (*iter == separator) {
+            iter++;
+            continue;
+        }
+
+        if (count == max_count) {
+            return count + 1;
+        }
+
+        fields[count] = iter;
+        count++;
+
+        char *const next = strchr(iter, separator);
+        if (next == NULL) {
+            break;
+        }
+
+        *next = '\0';
+        iter = next + 1;
+    }
+
+    return count;
+}
+
+static bool reply_error(FILE *__notnull const out, const char *__notnull msg) {
+    fprintf(out, "error %s\n", msg);
+    return fflush(out) == 0;
+}
+
+static bool
+reply_path_error(FILE *__notnull const out,
+                 const char *__notnull const error,
+                 const char *__notnull const path)
+{
+    fprintf(out, "error %s (at path %s)\n", error, path);
+    return fflush(out) == 0;
+}
+
+static bool reply_ok(FILE *__notnull const out) {
+    fputs("ok\n", out);
+    return fflush(out) == 0;
+}
+
+static bool
+write_info_to_path(struct serve_info *__notnull const info,
+                   FILE *__notnull const out,
+                   const struct libtbd_options options,
+                   const char *__notnull const output_path)
+{
+    FILE *const file = fopen(output_path, "w");
+    if (file == NULL) {
+        return reply_path_error(out, strerror(errno), output_path);
+    }
+
+    const enum libtbd_result write_result =
+        libtbd_write_to_file(&info->create_info, file, options);
+
+    if (fclose(file) != 0 || write_result != E_LIBTBD_OK) {
+        return reply_path_error(out,
+                                get_result_description(E_LIBTBD_WRITE_FAIL),
+                                output_path);
+    }
+
+    return reply_ok(out);
+}
+
+static bool
+write_info_to_reply(struct serve_info *__notnull const info,
+                    FILE *__notnull const out,
+                    const struct libtbd_options options)
+{
+    char *buffer = NULL;
+    uint64_t length = 0;
+
+    const enum libtbd_result write_result =
+        libtbd_write_to_alloc_buffer(&info->create_info,
+                                     options,
+                                     &buffer,
+                                     &length);
+
+    if (write_result != E_LIBTBD_OK) {
+        return reply_error(out, get_result_description(write_result));
+    }
+
+    fprintf(out, "ok %" PRIu64 "\n", length);
+    fwrite(buffer, 1, length, out);
+
+    free(buffer);
+    return fflush(out) == 0;
+}
+
+static bool
+handle_extract_request(struct serve_info *__notnull const info,
+                       FILE *__notnull const out,
+                       char *const *__notnull const fields,
+                       const uint64_t field_count)
+{
+    if (field_count < 3 || field_count > 5) {
+        return reply_error(out,
+                           "Usage: extract <dsc-path> <image-path> [version] "
+                           "[output-path]");
+    }
+
+    const char *const dsc_path = fields[1];
+    const char *const image_path = fields[2];
+
+    struct libtbd_options options = {};
+    options.version = TBD_VERSION_V2;
+
+    if (field_count > 3) {
+        options.version = parse_tbd_version(fields[3]);
+        if (options.version == TBD_VERSION_NONE) {
+            return reply_error(out, "Unrecognized tbd-version");
+        }
+    }
+
+    const char *error = NULL;
+    struct dyld_shared_cache_info *const dsc_info =
+        get_dsc_for_path(info, dsc_path, &error);
+
+    if (dsc_info == NULL) {
+        return reply_path_error(out, error, dsc_path);
+    }
+
+    const enum libtbd_result result =
+        libtbd_parse_dsc_image_with_path(&info->ctx,
+                                         &info->create_info,
+                                         dsc_info,
+                                         image_path,
+                                         options,
+                                         NULL);
+
+    bool reply_result = false;
+    if (result != E_LIBTBD_OK) {
+        reply_result = reply_path_error(out,
+                                        get_result_description(result),
+                                        image_path);
+    } else if (field_count == 5) {
+        reply_result = write_info_to_path(info, out, options, fields[4]);
+    } else {
+        reply_result = write_info_to_reply(info, out, options);
+    }
+
+    /*
+     * The create-info may point into the dyld_shared_cache's map, so it must
+     * be cleared before the dyld_shared_cache can be evicted.
+     */
+
+    const struct tbd_create_info empty = {};
+    tbd_create_info_clear_fields_and_create_from(&info->create_info, &empty);
+
+    return reply_result;
+}
+
+static enum serve_stream_result
+handle_request(struct serve_info *__notnull const info,
+               FILE *__notnull const out,
+               char *__notnull const line)
+{
+    char *fields[5] = {};
+    const uint64_t field_count = split_fields(line, fields, 5);
+
+    if (field_count == 0) {
+        return E_SERVE_STREAM_OK;
+    }
+
+    bool reply_result = false;
+    const char *const command = fields[0];
+
+    if (strcmp(command, "extract") == 0) {
+        reply_result = handle_extract_request(info, out, fields, field_count);
+    } else if (strcmp(command, "evict") == 0) {
+        if (field_count != 2) {
+            reply_result = reply_error(out, "Usage: evict <dsc-path>");
+        } else {
+            dsc_cache_evict_path(&info->dsc_cache, fields[1]);
+            reply_result = reply_ok(out);
+        }
+    } else if (strcmp(command, "quit") == 0) {
+        reply_ok(out);
+        return E_SERVE_STREAM_QUIT;
+    } else {
+        reply_result = reply_error(out, "Unrecognized request");
+    }
+
+    if (!reply_result) {
+        return E_SERVE_STREAM_WRITE_FAIL;
+    }
+
+    return E_SERVE_STREAM_OK;
+}
+
+static enum serve_stream_result
+serve_stream(struct serve_info *__notnull const info,
+             FILE *__notnull const in,
+             FILE *__notnull const out)
+{
+    char *line = NULL;
+    size_t line_capacity = 0;
+
+    enum serve_stream_result result = E_SERVE_STREAM_OK;
+    do {
+        /*
+         * our_getline() returns 0 at end-of-file, as even empty lines include
+         * a newline.
+         */
+
+        ssize_t length = our_getline(&line, &line_capacity, in);
+        if (length <= 0) {
+            break;
+        }
+
+        if (length != 0 && line[length - 1] == '\n') {
+            length -= 1;
+            line[length] = '\0';
+        }
+
+        if (length != 0 && line[length - 1] == '\r') {
+            line[length - 1] = '\0';
+        }
+
+        result = handle_request(info, out, line);
+    } while (result == E_SERVE_STREAM_OK);
+
+    free(line);
+    return result;
+}
+
+static int serve_socket(struct serve_info *__notnull const info,
+                        const char *__notnull const socket_path)
+{
+    struct sockaddr_un addr = {};
+    const size_t socket_path_length = strlen(socket_path);
+
+    if (socket_path_length >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket-path (%s) is too long\n", socket_path);
+        return 1;
+    }
+
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, socket_path, socket_path_length + 1);
+
+    /*
+     * Remove a socket left behind by a previous run, but never any other kind
+     * of file.
+     */
+
+    struct stat sbuf = {};
+    if (stat(socket_path, &sbuf) == 0 && S_ISSOCK(sbuf.st_mode)) {
+        our_unlink(socket_path);
+    }
+
+    const int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_fd < 0) {
+        fprintf(stderr,
+                "Failed to create socket, error: %s\n",
+                strerror(errno));
+
+        return 1;
+    }
+
+    if (bind(socket_fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr,
+                "Failed to bind socket to path %s, error: %s\n",
+                socket_path,
+                strerror(errno));
+
+        close(socket_fd);
+        return 1;
+    }
+
+    if (listen(socket_fd, 16) != 0) {
+        fprintf(stderr,
+                "Failed to listen on socket, error: %s\n",
+                strerror(errno));
+
+        close(socket_fd);
+        our_unlink(socket_path);
+
+        return 1;
+    }
+
+    /*
+     * A client disconnecting before reading its reply should only end its own
+     * session.
+     */
+
+    signal(SIGPIPE, SIG_IGN);
+
+    /*
+     * A quit request ends the server, and not just the session of the client
+     * that sent it.
+     */
+
+    int result = 1;
+    do {
+        const int client_fd = accept(socket_fd, NULL, NULL);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            fprintf(stderr,
+                    "Failed to accept connection, error: %s\n",
+                    strerror(errno));
+
+            break;
+        }
+
+        const int out_fd = dup(client_fd);
+        FILE *const in = fdopen(client_fd, "r");
+        FILE *const out = (out_fd >= 0) ? fdopen(out_fd, "w") : NULL;
+
+        enum serve_stream_result stream_result = E_SERVE_STREAM_OK;
+        if (in != NULL && out != NULL) {
+            stream_result = serve_stream(info, in, out);
+        }
+
+        if (in != NULL) {
+            fclose(in);
+        } else {
+            close(client_fd);
+        }
+
+        if (out != NULL) {
+            fclose(out);
+        } else if (out_fd >= 0) {
+            close(out_fd);
+        }
+
+        if (stream_result == E_SERVE_STREAM_QUIT) {
+            result = 0;
+            break;
+        }
+    } while (true);
+
+    close(socket_fd);
+    our_unlink(socket_path);
+
+    return result;
+}
+
+int serve_for_main(const struct serve_options options) {
+    struct serve_info info = {
+        .dsc_cache.max_count = options.max_cache_count
+    };
+
+    int result = 0;
+    if (options.socket_path != NULL) {
+        result = serve_socket(&info, options.socket_path);
+    } else {
+        serve_stream(&info, stdin, stdout);
+    }
+
+    dsc_cache_destroy(&info.dsc_cache);
+    tbd_create_info_destroy(&info.create_info);
+    libtbd_context_destroy(&info.ctx);
+
+    return result;
+}
@@ -0,0 +1,262 @@
+//
+//  src/string_pool.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "likely.h"
+#include "string_pool.h"
+
+/*
+ * Strings are copied into blocks of this size, except for strings too large to
+ * share a block, which get a block of their own.
+ */
+
+#define STRING_POOL_BLOCK_SIZE (64 * 1024)
+#define STRING_POOL_MAX_SHARED_LENGTH (STRING_POOL_BLOCK_SIZE / 8)
+
+#define STRING_POOL_INITIAL_CAPACITY 256
+
+struct string_pool_block {
+    struct string_pool_block *next;
+
+    uint64_t used;
+    uint64_t size;
+
+    char data[];
+};
+
+static uint64_t hash_string(const char *__notnull string, uint64_t length) {
+    /*
+     * FNV-1a
+     */
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint64_t i = 0; i != length; i++) {
+        hash ^= (uint8_t)string[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+enum string_pool_result string_pool_create(struct string_pool *__notnull pool) {
+    for (uint64_t i = 0; i != STRING_POOL_SHARD_COUNT; i++) {
+        struct string_pool_shard *const shard = pool->shards + i;
+        if (pthread_mutex_init(&shard->lock, NULL) != 0) {
+            for (uint64_t j = 0; j != i; j++) {
+                pthread_mutex_destroy(&pool->shards[j].lock);
+            }
+
+            return E_STRING_POOL_ALLOC_FAIL;
+        }
+
+        shard->entries = NULL;
+        shard->entry_count = 0;
+        shard->mask = 0;
+        shard->blocks = NULL;
+    }
+
+    return E_STRING_POOL_OK;
+}
+
+static struct string_pool_entry *
+find_entry(const struct string_pool_shard *__notnull const shard,
+           const char *__notnull const string,
+           const uint64_t length,
+           const uint64_t hash)
+{
+    const uint64_t mask = shard->mask;
+    uint64_t slot = hash & mask;
+
+    for (;; slot = (slot + 1) & mask) {
+        struct string_pool_entry *const entry = shard->entries + slot;
+        if (entry->string == NULL) {
+            return entry;
+        }
+
+        if (entry->hash != hash || entry->length != length) {
+            continue;
+        }
+
+        if (memcmp(entry->string, string, length) == 0) {
+            return entry;
+        }
+    }
+}
+
+/*
+ * Keep the hash-table at most half full, to keep probe-sequences short.
+ */
+
+static bool grow_entries_if_needed(struct string_pool_shard *__notnull shard) {
+    const uint64_t capacity = (shard->entries != NULL) ? shard->mask + 1 : 0;
+    if ((shard->entry_count + 1) * 2 <= capacity) {
+        return true;
+    }
+
+    uint64_t new_capacity = STRING_POOL_INITIAL_CAPACITY;
+    if (capacity != 0) {
+        new_capacity = capacity * 2;
+    }
+
+    struct string_pool_entry *const entries =
+        calloc(new_capacity, sizeof(struct string_pool_entry));
+
+    if (unlikely(entries == NULL)) {
+        return false;
+    }
+
+    const uint64_t new_mask = new_capacity - 1;
+    for (uint64_t i = 0; i != capacity; i++) {
+        const struct string_pool_entry *const entry = shard->entries + i;
+        if (entry->string == NULL) {
+            continue;
+        }
+
+        uint64_t slot = entry->hash & new_mask;
+        while (entries[slot].string != NULL) {
+            slot = (slot + 1) & new_mask;
+        }
+
+        entries[slot] = *entry;
+    }
+
+    free(shard->entries);
+
+    shard->entries = entries;
+    shard->mask = new_mask;
+
+    return true;
+}
+
+static char *
+copy_into_blocks(struct string_pool_shard *__notnull const shard,
+                 const char *__notnull const string,
+                 const uint64_t length)
+{
+    const uint64_t size = length + 1;
+
+    /*
+     * Large strings are given their own block, placed behind the current
+     * block, so that the space left in the current block isn't wasted.
+     */
+
+    struct string_pool_block *block = shard->blocks;
+    if (size > STRING_POOL_MAX_SHARED_LENGTH) {
+        struct string_pool_block *const own_block =
+            malloc(sizeof(struct string_pool_block) + size);
+
+        if (unlikely(own_block == NULL)) {
+            return NULL;
+        }
+
+        own_block->used = size;
+        own_block->size = size;
+
+        if (block != NULL) {
+            own_block->next = block->next;
+            block->next = own_block;
+        } else {
+            own_block->next = NULL;
+            shard->blocks = own_block;
+        }
+
+        block = own_block;
+    } else {
+        if (block == NULL || block->size - block->used < size) {
+            struct string_pool_block *const new_block =
+                malloc(sizeof(struct string_pool_block) +
+                       STRING_POOL_BLOCK_SIZE);
+
+            if (unlikely(new_block == NULL)) {
+                return NULL;
+            }
+
+            new_block->next = block;
+            new_block->used = 0;
+            new_block->size = STRING_POOL_BLOCK_SIZE;
+
+            shard->blocks = new_block;
+            block = new_block;
+        }
+
+        block->used += size;
+    }
+
+    char *const copy = block->data + block->used - size;
+
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+
+    return copy;
+}
+
+const char *
+string_pool_intern(struct string_pool *__notnull const pool,
+                   const char *__notnull const string,
+                   const uint64_t length)
+{
+    const uint64_t hash = hash_string(string, length);
+
+    /*
+     * The lowest bits of the hash pick the slot, so the highest bits are used
+     * to pick the shard.
+     */
+
+    struct string_pool_shard *const shard =
+        pool->shards + (hash >> 58) % STRING_POOL_SHARD_COUNT;
+
+    pthread_mutex_lock(&shard->lock);
+
+    const char *result = NULL;
+    if (grow_entries_if_needed(shard)) {
+        struct string_pool_entry *const entry =
+            find_entry(shard, string, length, hash);
+
+        if (entry->string != NULL) {
+            result = entry->string;
+        } else {
+            const char *const copy = copy_into_blocks(shard, string, length);
+            if (copy != NULL) {
+                entry->string = copy;
+                entry->length = length;
+                entry->hash = hash;
+
+                shard->entry_count += 1;
+                result = copy;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+    return result;
+}
+
+void string_pool_destroy(struct string_pool *__notnull const pool) {
+    for (uint64_t i = 0; i != STRING_POOL_SHARD_COUNT; i++) {
+        struct string_pool_shard *const shard = pool->shards + i;
+        struct string_pool_block *block = shard->blocks;
+
+        while (block != NULL) {
+            struct string_pool_block *const next = block->next;
+
+            free(block);
+            block = next;
+        }
+
+        free(shard->entries);
+        pthread_mutex_destroy(&shard->lock);
+
+        shard->entries = NULL;
+        shard->entry_count = 0;
+        shard->mask = 0;
+        shard->blocks = NULL;
+    }
+}
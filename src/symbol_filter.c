@@ -0,0 +1,419 @@
+//
+//  src/symbol_filter.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "copy.h"
+#include "likely.h"
+#include "symbol_filter.h"
+
+/*
+ * The root node is always at index zero, and so can never be a child or
+ * sibling, which lets zero mark the lack of one. Tails are stored as their
+ * index plus one for the same reason.
+ */
+
+struct pattern_node {
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint32_t first_tail;
+
+    char ch;
+
+    bool matches_exactly : 1;
+    bool matches_all_after : 1;
+};
+
+struct pattern_tail {
+    char *glob;
+    uint64_t length;
+
+    uint32_t next;
+};
+
+static inline bool is_wildcard(const char ch) {
+    return (ch == '*' || ch == '?');
+}
+
+static inline const struct pattern_node *
+get_node(const struct symbol_pattern_set *__notnull const set,
+         const uint32_t index)
+{
+    const struct pattern_node *const nodes = set->nodes.data;
+    return nodes + index;
+}
+
+static uint32_t
+find_child(const struct symbol_pattern_set *__notnull const set,
+           const uint32_t index,
+           const char ch)
+{
+    uint32_t child = get_node(set, index)->first_child;
+    while (child != 0) {
+        const struct pattern_node *const node = get_node(set, child);
+        if (node->ch == ch) {
+            return child;
+        }
+
+        child = node->next_sibling;
+    }
+
+    return 0;
+}
+
+static enum symbol_filter_result
+add_node(struct symbol_pattern_set *__notnull const set,
+         const struct pattern_node *__notnull const node)
+{
+    const enum array_result add_node_result =
+        array_add_item(&set->nodes, sizeof(*node), node, NULL);
+
+    if (unlikely(add_node_result != E_ARRAY_OK)) {
+        return E_SYMBOL_FILTER_ARRAY_FAIL;
+    }
+
+    return E_SYMBOL_FILTER_OK;
+}
+
+/*
+ * Find or create the node for the literal prefix of a pattern, returning its
+ * index in index_out.
+ */
+
+static enum symbol_filter_result
+add_prefix(struct symbol_pattern_set *__notnull const set,
+           const char *__notnull const prefix,
+           const uint64_t length,
+           uint32_t *__notnull const index_out)
+{
+    if (set->nodes.item_count == 0) {
+        const struct pattern_node root = {};
+        const enum symbol_filter_result add_root_result = add_node(set, &root);
+
+        if (add_root_result != E_SYMBOL_FILTER_OK) {
+            return add_root_result;
+        }
+    }
+
+    uint32_t index = 0;
+    for (uint64_t i = 0; i != length; i++) {
+        const uint32_t child = find_child(set, index, prefix[i]);
+        if (child != 0) {
+            index = child;
+            continue;
+        }
+
+        const uint32_t new_index = (uint32_t)set->nodes.item_count;
+        const struct pattern_node node = {
+            .next_sibling = get_node(set, index)->first_child,
+            .ch = prefix[i]
+        };
+
+        const enum symbol_filter_result add_node_result = add_node(set, &node);
+        if (add_node_result != E_SYMBOL_FILTER_OK) {
+            return add_node_result;
+        }
+
+        struct pattern_node *const parent =
+            array_get_item_at_index_unsafe(&set->nodes, sizeof(*parent), index);
+
+        parent->first_child = new_index;
+        index = new_index;
+    }
+
+    *index_out = index;
+    return E_SYMBOL_FILTER_OK;
+}
+
+enum symbol_filter_result
+symbol_pattern_set_add(struct symbol_pattern_set *__notnull const set,
+                       const char *__notnull const pattern,
+                       const uint64_t length)
+{
+    if (length == 0) {
+        return E_SYMBOL_FILTER_EMPTY_PATTERN;
+    }
+
+    uint64_t prefix_length = 0;
+    while (prefix_length != length && !is_wildcard(pattern[prefix_length])) {
+        prefix_length++;
+    }
+
+    uint32_t index = 0;
+    const enum symbol_filter_result add_prefix_result =
+        add_prefix(set, pattern, prefix_length, &index);
+
+    if (add_prefix_result != E_SYMBOL_FILTER_OK) {
+        return add_prefix_result;
+    }
+
+    struct pattern_node *const node =
+        array_get_item_at_index_unsafe(&set->nodes, sizeof(*node), index);
+
+    const char *const tail = pattern + prefix_length;
+    const uint64_t tail_length = length - prefix_length;
+
+    set->pattern_count += 1;
+
+    if (tail_length == 0) {
+        node->matches_exactly = true;
+        return E_SYMBOL_FILTER_OK;
+    }
+
+    if (tail_length == 1 && tail[0] == '*') {
+        node->matches_all_after = true;
+        return E_SYMBOL_FILTER_OK;
+    }
+
+    struct pattern_tail pattern_tail = {
+        .length = tail_length,
+        .next = node->first_tail
+    };
+
+    pattern_tail.glob = alloc_and_copy(tail, tail_length);
+    if (pattern_tail.glob == NULL) {
+        return E_SYMBOL_FILTER_ALLOC_FAIL;
+    }
+
+    const enum array_result add_tail_result =
+        array_add_item(&set->tails, sizeof(pattern_tail), &pattern_tail, NULL);
+
+    if (unlikely(add_tail_result != E_ARRAY_OK)) {
+        free(pattern_tail.glob);
+        return E_SYMBOL_FILTER_ARRAY_FAIL;
+    }
+
+    node->first_tail = (uint32_t)set->tails.item_count;
+    return E_SYMBOL_FILTER_OK;
+}
+
+/*
+ * Match string against glob, backtracking only to the last '*' seen.
+ */
+
+static bool
+glob_matches(const char *__notnull const glob,
+             const uint64_t glob_length,
+             const char *__notnull const string,
+             const uint64_t length)
+{
+    uint64_t g = 0;
+    uint64_t s = 0;
+
+    uint64_t star = UINT64_MAX;
+    uint64_t star_s = 0;
+
+    while (s != length) {
+        if (g != glob_length) {
+            const char ch = glob[g];
+            if (ch == '*') {
+                star = g;
+                star_s = s;
+
+                g++;
+                continue;
+            }
+
+            if (ch == '?' || ch == string[s]) {
+                g++;
+                s++;
+
+                continue;
+            }
+        }
+
+        if (star == UINT64_MAX) {
+            return false;
+        }
+
+        g = star + 1;
+        star_s++;
+        s = star_s;
+    }
+
+    while (g != glob_length && glob[g] == '*') {
+        g++;
+    }
+
+    return (g == glob_length);
+}
+
+static bool
+tails_match(const struct symbol_pattern_set *__notnull const set,
+            uint32_t tail_index,
+            const char *__notnull const string,
+            const uint64_t length)
+{
+    const struct pattern_tail *const tails = set->tails.data;
+    while (tail_index != 0) {
+        const struct pattern_tail *const tail = tails + (tail_index - 1);
+        if (glob_matches(tail->glob, tail->length, string, length)) {
+            return true;
+        }
+
+        tail_index = tail->next;
+    }
+
+    return false;
+}
+
+static bool
+set_matches(const struct symbol_pattern_set *__notnull const set,
+            const char *__notnull const string,
+            const uint64_t length)
+{
+    uint32_t index = 0;
+    uint64_t i = 0;
+
+    do {
+        const struct pattern_node *const node = get_node(set, index);
+        if (node->matches_all_after) {
+            return true;
+        }
+
+        if (node->first_tail != 0) {
+            const char *const rest = string + i;
+            if (tails_match(set, node->first_tail, rest, length - i)) {
+                return true;
+            }
+        }
+
+        if (i == length) {
+            return node->matches_exactly;
+        }
+
+        index = find_child(set, index, string[i]);
+        i++;
+    } while (index != 0);
+
+    return false;
+}
+
+/*
+ * Return whether a pattern could match a string starting with prefix. Nodes
+ * only exist for the prefixes of patterns, so reaching the end of prefix means
+ * some pattern extends it.
+ */
+
+static bool
+set_may_match_prefix(const struct symbol_pattern_set *__notnull const set,
+                     const char *__notnull const prefix,
+                     const uint64_t length)
+{
+    uint32_t index = 0;
+    uint64_t i = 0;
+
+    do {
+        const struct pattern_node *const node = get_node(set, index);
+        if (node->matches_all_after || node->first_tail != 0) {
+            return true;
+        }
+
+        if (i == length) {
+            return true;
+        }
+
+        index = find_child(set, index, prefix[i]);
+        i++;
+    } while (index != 0);
+
+    return false;
+}
+
+/*
+ * Return whether a pattern matches every string starting with prefix.
+ */
+
+static bool
+set_matches_all_with_prefix(const struct symbol_pattern_set *__notnull set,
+                            const char *__notnull const prefix,
+                            const uint64_t length)
+{
+    uint32_t index = 0;
+    uint64_t i = 0;
+
+    do {
+        const struct pattern_node *const node = get_node(set, index);
+        if (node->matches_all_after) {
+            return true;
+        }
+
+        if (i == length) {
+            return false;
+        }
+
+        index = find_child(set, index, prefix[i]);
+        i++;
+    } while (index != 0);
+
+    return false;
+}
+
+bool
+symbol_filter_matches(const struct symbol_filter *__notnull const filter,
+                      const char *__notnull const string,
+                      const uint64_t length)
+{
+    if (filter->include.pattern_count != 0) {
+        if (!set_matches(&filter->include, string, length)) {
+            return false;
+        }
+    }
+
+    if (filter->exclude.pattern_count != 0) {
+        if (set_matches(&filter->exclude, string, length)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+symbol_filter_may_match_prefix(
+    const struct symbol_filter *__notnull const filter,
+    const char *__notnull const prefix,
+    const uint64_t length)
+{
+    if (filter->include.pattern_count != 0) {
+        if (!set_may_match_prefix(&filter->include, prefix, length)) {
+            return false;
+        }
+    }
+
+    if (filter->exclude.pattern_count != 0) {
+        const bool excludes_all =
+            set_matches_all_with_prefix(&filter->exclude, prefix, length);
+
+        if (excludes_all) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void destroy_set(struct symbol_pattern_set *__notnull const set) {
+    struct pattern_tail *tail = set->tails.data;
+    const struct pattern_tail *const end = set->tails.data_end;
+
+    for (; tail != end; tail++) {
+        free(tail->glob);
+    }
+
+    array_destroy(&set->nodes);
+    array_destroy(&set->tails);
+
+    set->pattern_count = 0;
+}
+
+void symbol_filter_destroy(struct symbol_filter *__notnull const filter) {
+    destroy_set(&filter->include);
+    destroy_set(&filter->exclude);
+}
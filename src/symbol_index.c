@@ -0,0 +1,841 @@
+//
+//  src/symbol_index.c
+//  tbd
+//
+//  Created by inoahdev on 2/9/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libtbd.h"
+#include "our_io.h"
+#include "string_buffer.h"
+#include "symbol_index.h"
+
+/*
+ * While building, the entries' names are stored in a separate string-buffer,
+ * as the entries are only given their final offsets after they're sorted.
+ */
+
+struct builder_entry {
+    uint64_t name_offset;
+    const char *name;
+
+    uint32_t name_length;
+    uint32_t image_index;
+
+    uint64_t targets;
+
+    uint8_t type;
+    uint8_t meta_type;
+};
+
+struct symbol_index_builder {
+    struct array images;
+    struct array entries;
+
+    struct string_buffer names;
+    struct string_buffer strings;
+};
+
+static bool
+add_string(struct string_buffer *__notnull const sb,
+           const char *__notnull const string,
+           const uint64_t length,
+           uint64_t *__notnull const offset_out)
+{
+    const uint64_t offset = sb->length;
+
+    /*
+     * Add the null-terminator to the pool as well, so strings can be used in
+     * place when the index is mapped.
+     */
+
+    if (sb_add_c_str(sb, string, length) != E_STRING_BUFFER_OK) {
+        return false;
+    }
+
+    if (sb_add_c_str(sb, "", 1) != E_STRING_BUFFER_OK) {
+        return false;
+    }
+
+    *offset_out = offset;
+    return true;
+}
+
+static bool
+add_image(struct symbol_index_builder *__notnull const builder,
+          const char *__notnull const path,
+          const struct tbd_create_info *__notnull const info)
+{
+    const uint64_t path_length = strlen(path);
+
+    struct symbol_index_image image = {
+        .path_length = (uint32_t)path_length
+    };
+
+    if (!add_string(&builder->strings, path, path_length, &image.path_offset)) {
+        return false;
+    }
+
+    uint64_t targets_count = info->fields.targets.set_count;
+    if (targets_count > SYMBOL_INDEX_MAX_TARGET_COUNT) {
+        targets_count = SYMBOL_INDEX_MAX_TARGET_COUNT;
+    }
+
+    image.targets_offset = builder->strings.length;
+    image.targets_count = (uint32_t)targets_count;
+
+    for (uint64_t i = 0; i != targets_count; i++) {
+        const struct arch_info *arch = NULL;
+        enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+        target_list_get_target(&info->fields.targets, i, &arch, &platform);
+
+        const char *const platform_string =
+            tbd_platform_to_string(platform, TBD_VERSION_V4);
+
+        char target[128] = {};
+        const int length =
+            snprintf(target,
+                     sizeof(target),
+                     "%s-%s",
+                     arch->name,
+                     platform_string != NULL ? platform_string : "unknown");
+
+        if (length < 0 || (size_t)length >= sizeof(target)) {
+            return false;
+        }
+
+        uint64_t offset = 0;
+        if (!add_string(&builder->strings, target, (uint64_t)length, &offset)) {
+            return false;
+        }
+    }
+
+    const enum array_result add_image_result =
+        array_add_item(&builder->images, sizeof(image), &image, NULL);
+
+    if (add_image_result != E_ARRAY_OK) {
+        return false;
+    }
+
+    const uint64_t image_index = builder->images.item_count - 1;
+    const uint64_t all_targets =
+        (targets_count == 64) ? ~0ull : ((1ull << targets_count) - 1);
+
+    const struct tbd_symbol_info *symbol = info->fields.symbols.data;
+    const struct tbd_symbol_info *const end = info->fields.symbols.data_end;
+
+    for (; symbol != end; symbol++) {
+        if (symbol->meta_type == TBD_SYMBOL_META_TYPE_UNDEFINED) {
+            continue;
+        }
+
+        struct builder_entry entry = {
+            .name_length = (uint32_t)symbol->length,
+            .image_index = (uint32_t)image_index,
+            .type = (uint8_t)symbol->type,
+            .meta_type = (uint8_t)symbol->meta_type
+        };
+
+        if (info->flags.uses_full_targets) {
+            entry.targets = all_targets;
+        } else {
+            for (uint64_t i = 0; i != targets_count; i++) {
+                if (bit_list_get_for_index(symbol->targets, i)) {
+                    entry.targets |= (1ull << i);
+                }
+            }
+        }
+
+        const bool add_name_result =
+            add_string(&builder->names,
+                       symbol->string,
+                       symbol->length,
+                       &entry.name_offset);
+
+        if (!add_name_result) {
+            return false;
+        }
+
+        const enum array_result add_entry_result =
+            array_add_item(&builder->entries, sizeof(entry), &entry, NULL);
+
+        if (add_entry_result != E_ARRAY_OK) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int
+compare_names(const char *__notnull const left,
+              const uint64_t left_length,
+              const char *__notnull const right,
+              const uint64_t right_length)
+{
+    const uint64_t min_length =
+        (left_length < right_length) ? left_length : right_length;
+
+    const int compare = memcmp(left, right, min_length);
+    if (compare != 0) {
+        return compare;
+    }
+
+    if (left_length < right_length) {
+        return -1;
+    }
+
+    if (left_length > right_length) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static int
+builder_entry_comparator(const void *__notnull const array_item,
+                         const void *__notnull const item)
+{
+    const struct builder_entry *const left = array_item;
+    const struct builder_entry *const right = item;
+
+    const int compare =
+        compare_names(left->name,
+                      left->name_length,
+                      right->name,
+                      right->name_length);
+
+    if (compare != 0) {
+        return compare;
+    }
+
+    if (left->image_index < right->image_index) {
+        return -1;
+    }
+
+    if (left->image_index > right->image_index) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static bool
+parse_dsc_into_builder(struct symbol_index_builder *__notnull const builder,
+                       struct libtbd_context *__notnull const ctx,
+                       const char *__notnull const dsc_path)
+{
+    struct libtbd_options options = {};
+
+    options.version = TBD_VERSION_V4;
+    options.parse_options.ignore_clients = true;
+    options.parse_options.ignore_parent_umbrellas = true;
+    options.parse_options.ignore_undefineds = true;
+    options.parse_options.ignore_uuids = true;
+    options.parse_options.ignore_missing_uuids = true;
+    options.parse_options.ignore_missing_exports = true;
+
+    struct dyld_shared_cache_info dsc_info = {};
+    const enum libtbd_result open_result =
+        libtbd_open_dsc(&dsc_info, dsc_path, options, NULL);
+
+    if (open_result != E_LIBTBD_OK) {
+        fprintf(stderr,
+                "Failed to open dyld_shared_cache file at path: %s\n",
+                dsc_path);
+
+        return false;
+    }
+
+    struct tbd_create_info info = {};
+    const struct tbd_create_info empty = {};
+
+    bool result = true;
+    for (uint32_t i = 0; i != dsc_info.images_count; i++) {
+        struct dyld_cache_image_info *const image = dsc_info.images + i;
+        const char *const image_path =
+            (const char *)(dsc_info.map + image->pathFileOffset);
+
+        const enum libtbd_result parse_result =
+            libtbd_parse_dsc_image(ctx, &info, &dsc_info, image, options, NULL);
+
+        if (parse_result != E_LIBTBD_OK) {
+            fprintf(stderr,
+                    "Warning: Failed to parse image (at path %s) of "
+                    "dyld_shared_cache file at path: %s, skipping\n",
+                    image_path,
+                    dsc_path);
+
+            tbd_create_info_clear_fields_and_create_from(&info, &empty);
+            continue;
+        }
+
+        const bool add_result = add_image(builder, image_path, &info);
+
+        /*
+         * The create-info may point into the dyld_shared_cache's map, so it
+         * must be cleared before the dyld_shared_cache is destroyed.
+         */
+
+        tbd_create_info_clear_fields_and_create_from(&info, &empty);
+        if (!add_result) {
+            fputs("Failed to allocate memory\n", stderr);
+
+            result = false;
+            break;
+        }
+    }
+
+    tbd_create_info_destroy(&info);
+    dyld_shared_cache_info_destroy(&dsc_info);
+
+    return result;
+}
+
+/*
+ * Sort the entries, and move their (now de-duplicated) names into the final
+ * string-pool.
+ */
+
+static bool finalize_builder(struct symbol_index_builder *__notnull builder) {
+    struct builder_entry *const entries = builder->entries.data;
+    const uint64_t entry_count = builder->entries.item_count;
+
+    for (uint64_t i = 0; i != entry_count; i++) {
+        entries[i].name = builder->names.data + entries[i].name_offset;
+    }
+
+    array_sort_with_comparator(&builder->entries,
+                               sizeof(struct builder_entry),
+                               builder_entry_comparator);
+
+    const struct builder_entry *last = NULL;
+    for (uint64_t i = 0; i != entry_count; i++) {
+        struct builder_entry *const entry = entries + i;
+        if (last != NULL &&
+            compare_names(last->name,
+                          last->name_length,
+                          entry->name,
+                          entry->name_length) == 0)
+        {
+            entry->name_offset = last->name_offset;
+            continue;
+        }
+
+        const bool add_result =
+            add_string(&builder->strings,
+                       entry->name,
+                       entry->name_length,
+                       &entry->name_offset);
+
+        if (!add_result) {
+            return false;
+        }
+
+        last = entry;
+    }
+
+    return true;
+}
+
+static bool
+write_index(const struct symbol_index_builder *__notnull const builder,
+            FILE *__notnull const file)
+{
+    const uint64_t image_count = builder->images.item_count;
+    const uint64_t entry_count = builder->entries.item_count;
+
+    struct symbol_index_header header = {
+        .version = SYMBOL_INDEX_VERSION,
+        .image_count = (uint32_t)image_count,
+        .entry_count = entry_count,
+        .images_offset = sizeof(header),
+        .strings_size = builder->strings.length
+    };
+
+    memcpy(header.magic, SYMBOL_INDEX_MAGIC, sizeof(header.magic));
+
+    header.entries_offset =
+        header.images_offset + image_count * sizeof(struct symbol_index_image);
+
+    header.strings_offset =
+        header.entries_offset +
+        entry_count * sizeof(struct symbol_index_entry);
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        return false;
+    }
+
+    if (image_count != 0) {
+        const size_t images_size =
+            image_count * sizeof(struct symbol_index_image);
+
+        if (fwrite(builder->images.data, images_size, 1, file) != 1) {
+            return false;
+        }
+    }
+
+    const struct builder_entry *entry = builder->entries.data;
+    const struct builder_entry *const end = builder->entries.data_end;
+
+    for (; entry != end; entry++) {
+        const struct symbol_index_entry index_entry = {
+            .name_offset = entry->name_offset,
+            .name_length = entry->name_length,
+            .image_index = entry->image_index,
+            .targets = entry->targets,
+            .type = entry->type,
+            .meta_type = entry->meta_type
+        };
+
+        if (fwrite(&index_entry, sizeof(index_entry), 1, file) != 1) {
+            return false;
+        }
+    }
+
+    if (builder->strings.length != 0) {
+        const uint64_t length = builder->strings.length;
+        if (fwrite(builder->strings.data, length, 1, file) != 1) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void destroy_builder(struct symbol_index_builder *__notnull builder) {
+    array_destroy(&builder->images);
+    array_destroy(&builder->entries);
+
+    sb_destroy(&builder->names);
+    sb_destroy(&builder->strings);
+}
+
+int
+symbol_index_build_for_main(const char *__notnull const index_path,
+                            const char *const *__notnull const dsc_paths,
+                            const uint64_t dsc_count)
+{
+    struct symbol_index_builder builder = {};
+    struct libtbd_context ctx = {};
+
+    for (uint64_t i = 0; i != dsc_count; i++) {
+        if (!parse_dsc_into_builder(&builder, &ctx, dsc_paths[i])) {
+            libtbd_context_destroy(&ctx);
+            destroy_builder(&builder);
+
+            return 1;
+        }
+    }
+
+    libtbd_context_destroy(&ctx);
+
+    if (builder.images.item_count > UINT32_MAX) {
+        fputs("Too many images to create a symbol-index\n", stderr);
+        destroy_builder(&builder);
+
+        return 1;
+    }
+
+    if (!finalize_builder(&builder)) {
+        fputs("Failed to allocate memory\n", stderr);
+        destroy_builder(&builder);
+
+        return 1;
+    }
+
+    FILE *const file = fopen(index_path, "w");
+    if (file == NULL) {
+        fprintf(stderr,
+                "Failed to open symbol-index file at path: %s, error: %s\n",
+                index_path,
+                strerror(errno));
+
+        destroy_builder(&builder);
+        return 1;
+    }
+
+    const bool write_result = write_index(&builder, file);
+    destroy_builder(&builder);
+
+    if (fclose(file) != 0 || !write_result) {
+        fprintf(stderr,
+                "Failed to write symbol-index file at path: %s\n",
+                index_path);
+
+        return 1;
+    }
+
+    return 0;
+}
+
+struct mapped_index {
+    const uint8_t *map;
+    uint64_t size;
+
+    const struct symbol_index_header *header;
+    const struct symbol_index_image *images;
+    const struct symbol_index_entry *entries;
+    const char *strings;
+};
+
+static bool
+range_is_in_file(const uint64_t offset,
+                 const uint64_t size,
+                 const uint64_t file_size)
+{
+    if (offset > file_size) {
+        return false;
+    }
+
+    return (size <= file_size - offset);
+}
+
+static bool validate_header(struct mapped_index *__notnull const index) {
+    if (index->size < sizeof(struct symbol_index_header)) {
+        return false;
+    }
+
+    const struct symbol_index_header *const header =
+        (const struct symbol_index_header *)index->map;
+
+    if (memcmp(header->magic, SYMBOL_INDEX_MAGIC, sizeof(header->magic)) != 0) {
+        return false;
+    }
+
+    if (header->version != SYMBOL_INDEX_VERSION) {
+        return false;
+    }
+
+    /*
+     * Keep the tables aligned, and make sure their sizes can't overflow.
+     */
+
+    if ((header->images_offset % 8) != 0 || (header->entries_offset % 8) != 0) {
+        return false;
+    }
+
+    const uint64_t max_entry_count =
+        UINT64_MAX / sizeof(struct symbol_index_entry);
+
+    if (header->entry_count > max_entry_count) {
+        return false;
+    }
+
+    const uint64_t images_size =
+        header->image_count * sizeof(struct symbol_index_image);
+    const uint64_t entries_size =
+        header->entry_count * sizeof(struct symbol_index_entry);
+
+    const uint64_t size = index->size;
+    if (!range_is_in_file(header->images_offset, images_size, size) ||
+        !range_is_in_file(header->entries_offset, entries_size, size) ||
+        !range_is_in_file(header->strings_offset, header->strings_size, size))
+    {
+        return false;
+    }
+
+    index->header = header;
+    index->images =
+        (const struct symbol_index_image *)(index->map + header->images_offset);
+    index->entries =
+        (const struct symbol_index_entry *)
+            (index->map + header->entries_offset);
+
+    index->strings = (const char *)(index->map + header->strings_offset);
+    return true;
+}
+
+/*
+ * Get a string from the string-pool, or NULL if the string isn't entirely
+ * within the string-pool.
+ */
+
+static const char *
+get_string(const struct mapped_index *__notnull const index,
+           const uint64_t offset,
+           const uint64_t length)
+{
+    const uint64_t strings_size = index->header->strings_size;
+    if (offset >= strings_size || length >= strings_size - offset) {
+        return NULL;
+    }
+
+    const char *const string = index->strings + offset;
+    if (string[length] != '\0') {
+        return NULL;
+    }
+
+    return string;
+}
+
+/*
+ * Find the first entry whose name is not less than name, returning
+ * entry_count if all entries are less than name, or UINT64_MAX if an invalid
+ * entry was found.
+ */
+
+static uint64_t
+find_lower_bound(const struct mapped_index *__notnull const index,
+                 const char *__notnull const name,
+                 const uint64_t name_length)
+{
+    uint64_t low = 0;
+    uint64_t high = index->header->entry_count;
+
+    while (low < high) {
+        const uint64_t middle = low + (high - low) / 2;
+        const struct symbol_index_entry *const entry = index->entries + middle;
+
+        const char *const entry_name =
+            get_string(index, entry->name_offset, entry->name_length);
+
+        if (entry_name == NULL) {
+            return UINT64_MAX;
+        }
+
+        const int compare =
+            compare_names(entry_name, entry->name_length, name, name_length);
+
+        if (compare < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+static const char *get_symbol_type_desc(const uint8_t type) {
+    switch (type) {
+        case TBD_SYMBOL_TYPE_CLIENT:
+            return "client";
+
+        case TBD_SYMBOL_TYPE_REEXPORT:
+            return "reexport";
+
+        case TBD_SYMBOL_TYPE_NORMAL:
+            return "normal";
+
+        case TBD_SYMBOL_TYPE_OBJC_CLASS:
+            return "objc-class";
+
+        case TBD_SYMBOL_TYPE_OBJC_EHTYPE:
+            return "objc-eh-type";
+
+        case TBD_SYMBOL_TYPE_OBJC_IVAR:
+            return "objc-ivar";
+
+        case TBD_SYMBOL_TYPE_WEAK_DEF:
+            return "weak-def";
+
+        case TBD_SYMBOL_TYPE_THREAD_LOCAL:
+            return "thread-local";
+    }
+
+    return "unknown";
+}
+
+static bool
+print_entry(const struct mapped_index *__notnull const index,
+            const struct symbol_index_entry *__notnull const entry,
+            const char *__notnull const name)
+{
+    if (entry->image_index >= index->header->image_count) {
+        return false;
+    }
+
+    const struct symbol_index_image *const image =
+        index->images + entry->image_index;
+
+    const char *const path =
+        get_string(index, image->path_offset, image->path_length);
+
+    if (path == NULL) {
+        return false;
+    }
+
+    const char *const type =
+        (entry->meta_type == TBD_SYMBOL_META_TYPE_REEXPORT) ?
+            "reexport" : get_symbol_type_desc(entry->type);
+
+    fprintf(stdout, "%s\t%s\t%s\t", name, path, type);
+
+    /*
+     * The image's targets are stored back to back in the string-pool, so walk
+     * through them, printing the ones the symbol is exported for.
+     */
+
+    uint64_t offset = image->targets_offset;
+    bool printed_target = false;
+
+    const uint32_t targets_count = image->targets_count;
+    for (uint32_t i = 0; i != targets_count; i++) {
+        if (offset >= index->header->strings_size) {
+            return false;
+        }
+
+        const char *const target = index->strings + offset;
+        const uint64_t max_length = index->header->strings_size - offset;
+        const uint64_t length = strnlen(target, max_length);
+
+        if (length == max_length) {
+            return false;
+        }
+
+        if (i < SYMBOL_INDEX_MAX_TARGET_COUNT &&
+            (entry->targets & (1ull << i)) != 0)
+        {
+            if (printed_target) {
+                fputc(',', stdout);
+            }
+
+            fputs(target, stdout);
+            printed_target = true;
+        }
+
+        offset += length + 1;
+    }
+
+    fputc('\n', stdout);
+    return true;
+}
+
+static int
+lookup_in_index(const struct mapped_index *__notnull const index,
+                const char *const *__notnull const symbols,
+                const uint64_t symbol_count)
+{
+    int result = 0;
+    for (uint64_t i = 0; i != symbol_count; i++) {
+        const char *const symbol = symbols[i];
+        const uint64_t length = strlen(symbol);
+
+        uint64_t entry_index = find_lower_bound(index, symbol, length);
+        if (entry_index == UINT64_MAX) {
+            fputs("Symbol-index file is corrupt\n", stderr);
+            return 1;
+        }
+
+        bool found = false;
+
+        const uint64_t entry_count = index->header->entry_count;
+        for (; entry_index != entry_count; entry_index++) {
+            const struct symbol_index_entry *const entry =
+                index->entries + entry_index;
+
+            const char *const name =
+                get_string(index, entry->name_offset, entry->name_length);
+
+            if (name == NULL) {
+                fputs("Symbol-index file is corrupt\n", stderr);
+                return 1;
+            }
+
+            if (compare_names(name, entry->name_length, symbol, length) != 0) {
+                break;
+            }
+
+            if (!print_entry(index, entry, name)) {
+                fputs("Symbol-index file is corrupt\n", stderr);
+                return 1;
+            }
+
+            found = true;
+        }
+
+        if (!found) {
+            fprintf(stderr, "No images export symbol: %s\n", symbol);
+            result = 1;
+        }
+    }
+
+    return result;
+}
+
+int
+symbol_index_lookup_for_main(const char *__notnull const index_path,
+                             const char *const *__notnull const symbols,
+                             const uint64_t symbol_count)
+{
+    const int fd = our_open(index_path, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr,
+                "Failed to open symbol-index file at path: %s, error: %s\n",
+                index_path,
+                strerror(errno));
+
+        return 1;
+    }
+
+    struct stat sbuf = {};
+    if (fstat(fd, &sbuf) != 0) {
+        fprintf(stderr,
+                "Failed to get information on symbol-index file at path: %s, "
+                "error: %s\n",
+                index_path,
+                strerror(errno));
+
+        close(fd);
+        return 1;
+    }
+
+    const uint64_t size = (uint64_t)sbuf.st_size;
+    if (size < sizeof(struct symbol_index_header)) {
+        fprintf(stderr,
+                "File at path %s is not a symbol-index file\n",
+                index_path);
+
+        close(fd);
+        return 1;
+    }
+
+    /*
+     * Only the pages touched by the binary-search are ever read in, so the
+     * cost of a lookup doesn't grow with the size of the index.
+     */
+
+    void *const map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        fprintf(stderr,
+                "Failed to map symbol-index file at path: %s, error: %s\n",
+                index_path,
+                strerror(errno));
+
+        return 1;
+    }
+
+    struct mapped_index index = {
+        .map = map,
+        .size = size
+    };
+
+    if (!validate_header(&index)) {
+        fprintf(stderr,
+                "File at path %s is not a valid symbol-index file\n",
+                index_path);
+
+        munmap(map, size);
+        return 1;
+    }
+
+    const int result = lookup_in_index(&index, symbols, symbol_count);
+    munmap(map, size);
+
+    return result;
+}
@@ -0,0 +1,264 @@
+//
+//  src/tar_write.c
+//  tbd
+//
+//  Created by inoahdev on 2/8/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "tar_write.h"
+
+#define TAR_BLOCK_SIZE 512
+
+struct ustar_header {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char typeflag;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char pad[12];
+};
+
+_Static_assert(sizeof(struct ustar_header) == TAR_BLOCK_SIZE,
+               "ustar header must be exactly one block");
+
+/*
+ * Write value as a null-terminated octal-number, padded with zeros, filling
+ * the entire field.
+ */
+
+static int
+write_octal(char *__notnull const field,
+            const size_t field_size,
+            const uint64_t value)
+{
+    char buffer[24] = {};
+    const int length =
+        snprintf(buffer,
+                 sizeof(buffer),
+                 "%0*" PRIo64,
+                 (int)(field_size - 1),
+                 value);
+
+    if (length < 0 || (size_t)length != field_size - 1) {
+        return 1;
+    }
+
+    memcpy(field, buffer, field_size);
+    return 0;
+}
+
+/*
+ * Split name at a slash into the header's prefix and name fields, which is
+ * how ustar stores names longer than 100 bytes.
+ */
+
+static bool
+set_header_name(struct ustar_header *__notnull const header,
+                const char *__notnull const name,
+                const uint64_t name_length)
+{
+    if (name_length <= sizeof(header->name)) {
+        memcpy(header->name, name, name_length);
+        return true;
+    }
+
+    const uint64_t max_prefix_length = sizeof(header->prefix);
+    for (uint64_t i = 0; i != name_length && i <= max_prefix_length; i++) {
+        if (name[i] != '/') {
+            continue;
+        }
+
+        const uint64_t rest_length = name_length - i - 1;
+        if (rest_length == 0 || rest_length > sizeof(header->name)) {
+            continue;
+        }
+
+        memcpy(header->prefix, name, i);
+        memcpy(header->name, name + i + 1, rest_length);
+
+        return true;
+    }
+
+    return false;
+}
+
+static int
+write_header(FILE *__notnull const file,
+             struct ustar_header *__notnull const header,
+             const char typeflag,
+             const uint64_t size,
+             const time_t mtime)
+{
+    header->typeflag = typeflag;
+
+    if (write_octal(header->mode, sizeof(header->mode), 0644) ||
+        write_octal(header->uid, sizeof(header->uid), 0) ||
+        write_octal(header->gid, sizeof(header->gid), 0) ||
+        write_octal(header->size, sizeof(header->size), size) ||
+        write_octal(header->mtime, sizeof(header->mtime), (uint64_t)mtime))
+    {
+        return 1;
+    }
+
+    memcpy(header->magic, "ustar", sizeof(header->magic));
+    memcpy(header->version, "00", sizeof(header->version));
+
+    /*
+     * The checksum is calculated with the checksum-field filled with spaces.
+     */
+
+    memset(header->checksum, ' ', sizeof(header->checksum));
+
+    const unsigned char *iter = (const unsigned char *)header;
+    const unsigned char *const end = iter + sizeof(*header);
+
+    uint64_t checksum = 0;
+    for (; iter != end; iter++) {
+        checksum += *iter;
+    }
+
+    if (write_octal(header->checksum, sizeof(header->checksum) - 1, checksum)) {
+        return 1;
+    }
+
+    if (fwrite(header, sizeof(*header), 1, file) != 1) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Pad the data written out to the end of its last block.
+ */
+
+static int write_padding(FILE *__notnull const file, const uint64_t size) {
+    const uint64_t remainder = size % TAR_BLOCK_SIZE;
+    if (remainder == 0) {
+        return 0;
+    }
+
+    static const char zeros[TAR_BLOCK_SIZE] = {};
+    if (fwrite(zeros, TAR_BLOCK_SIZE - remainder, 1, file) != 1) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static uint64_t count_digits(uint64_t number) {
+    uint64_t count = 1;
+    for (number /= 10; number != 0; number /= 10) {
+        count++;
+    }
+
+    return count;
+}
+
+/*
+ * Write a pax extended header holding the full path of the member following
+ * it.
+ */
+
+static int
+write_pax_path_header(FILE *__notnull const file,
+                      const char *__notnull const name,
+                      const uint64_t name_length,
+                      const time_t mtime)
+{
+    /*
+     * Each pax record is "<length> path=<name>\n", where length includes the
+     * digits of length itself.
+     */
+
+    const uint64_t record_length = strlen(" path=\n") + name_length;
+
+    uint64_t length = record_length + count_digits(record_length);
+    if (count_digits(length) != count_digits(record_length)) {
+        length = record_length + count_digits(length);
+    }
+
+    struct ustar_header header = {};
+    memcpy(header.name, "PaxHeader", strlen("PaxHeader"));
+
+    if (write_header(file, &header, 'x', length, mtime)) {
+        return 1;
+    }
+
+    if (fprintf(file, "%" PRIu64 " path=", length) < 0) {
+        return 1;
+    }
+
+    if (fwrite(name, name_length, 1, file) != 1) {
+        return 1;
+    }
+
+    if (fputc('\n', file) == EOF) {
+        return 1;
+    }
+
+    if (write_padding(file, length)) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int
+tar_write_member(FILE *__notnull const file,
+                 const char *__notnull const name,
+                 const uint64_t name_length,
+                 const void *const data,
+                 const uint64_t size,
+                 const time_t mtime)
+{
+    struct ustar_header header = {};
+    if (!set_header_name(&header, name, name_length)) {
+        if (write_pax_path_header(file, name, name_length, mtime)) {
+            return 1;
+        }
+
+        memcpy(header.name, name, sizeof(header.name));
+    }
+
+    if (write_header(file, &header, '0', size, mtime)) {
+        return 1;
+    }
+
+    if (size != 0) {
+        if (fwrite(data, size, 1, file) != 1) {
+            return 1;
+        }
+
+        if (write_padding(file, size)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int tar_write_end(FILE *__notnull const file) {
+    static const char zeros[TAR_BLOCK_SIZE * 2] = {};
+    if (fwrite(zeros, sizeof(zeros), 1, file) != 1) {
+        return 1;
+    }
+
+    return 0;
+}
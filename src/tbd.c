@@ -14,9 +14,12 @@
 
 #include "copy.h"
 #include "likely.h"
+#include "string_pool.h"
+#include "symbol_filter.h"
 #include "target_list.h"
 #include "tbd.h"
 #include "tbd_write.h"
+#include "tbd_write_json.h"
 #include "yaml.h"
 
 const char *tbd_version_to_string(const enum tbd_version version) {
@@ -35,6 +38,9 @@ const char *tbd_version_to_string(const enum tbd_version version) {
 
         case TBD_VERSION_V4:
             return "v4";
+
+        case TBD_VERSION_V5:
+            return "v5";
     }
 }
 
@@ -47,7 +53,7 @@ tbd_platform_to_string(const enum tbd_platform platform,
             return NULL;
 
         case TBD_PLATFORM_MACOS:
-            if (version == TBD_VERSION_V4) {
+            if (version >= TBD_VERSION_V4) {
                 return "macos";
             }
 
@@ -66,7 +72,7 @@ tbd_platform_to_string(const enum tbd_platform platform,
             return "bridgeos";
 
         case TBD_PLATFORM_IOSMAC:
-            if (version == TBD_VERSION_V4) {
+            if (version >= TBD_VERSION_V4) {
                 return "maccatalyst";
             }
 
@@ -94,7 +100,7 @@ tbd_should_parse_objc_constraint(const struct tbd_parse_options options,
         return false;
     }
 
-    if (version == TBD_VERSION_V1 || version == TBD_VERSION_V4) {
+    if (version == TBD_VERSION_V1 || version >= TBD_VERSION_V4) {
         return false;
     }
 
@@ -116,7 +122,78 @@ tbd_should_parse_flags(const struct tbd_parse_options options,
 }
 
 bool tbd_uses_archs(const enum tbd_version version) {
-    return (version != TBD_VERSION_V4);
+    return (version != TBD_VERSION_V4 && version != TBD_VERSION_V5);
+}
+
+struct tbd_parse_options
+tbd_create_parse_plan(struct tbd_parse_options options,
+                      const struct tbd_create_options write_options,
+                      const enum tbd_version version)
+{
+    options.ignore_clients |= write_options.ignore_clients;
+    options.ignore_exports |= write_options.ignore_exports;
+    options.ignore_objc_constraint |= write_options.ignore_objc_constraint;
+    options.ignore_reexports |= write_options.ignore_reexports;
+    options.ignore_swift_version |= write_options.ignore_swift_version;
+    options.ignore_undefineds |= write_options.ignore_undefineds;
+    options.ignore_uuids |= write_options.ignore_uuids;
+
+    options.ignore_normal_syms |= write_options.ignore_normal_syms;
+    options.ignore_objc_class_syms |= write_options.ignore_objc_class_syms;
+    options.ignore_objc_ivar_syms |= write_options.ignore_objc_ivar_syms;
+    options.ignore_objc_ehtype_syms |= write_options.ignore_objc_ehtype_syms;
+    options.ignore_thread_local_syms |= write_options.ignore_thread_local_syms;
+    options.ignore_weak_defs_syms |= write_options.ignore_weak_defs_syms;
+
+    /*
+     * Without a tbd-version, we can't know what will be written out.
+     */
+
+    if (version == TBD_VERSION_NONE) {
+        return options;
+    }
+
+    if (!tbd_should_parse_objc_constraint(options, version)) {
+        options.ignore_objc_constraint = true;
+    }
+
+    if (!tbd_should_parse_swift_version(options, version)) {
+        options.ignore_swift_version = true;
+    }
+
+    if (version == TBD_VERSION_V1) {
+        options.ignore_undefineds = true;
+    }
+
+    /*
+     * With every type of symbol ignored, neither the export-trie nor the
+     * symbol-table can provide anything.
+     *
+     * Before tbd-version v4 however, clients and re-exports are also stored as
+     * exports, and so exports can only be ignored if they are as well.
+     */
+
+    const bool ignores_all_syms =
+        (options.ignore_normal_syms &&
+         options.ignore_objc_class_syms &&
+         options.ignore_objc_ivar_syms &&
+         options.ignore_objc_ehtype_syms &&
+         options.ignore_thread_local_syms &&
+         options.ignore_weak_defs_syms);
+
+    if (ignores_all_syms) {
+        options.ignore_undefineds = true;
+
+        const bool lc_exports_are_ignored =
+            (version >= TBD_VERSION_V4 ||
+             (options.ignore_clients && options.ignore_reexports));
+
+        if (lc_exports_are_ignored) {
+            options.ignore_exports = true;
+        }
+    }
+
+    return options;
 }
 
 enum tbd_ci_set_target_count_result
@@ -198,6 +275,10 @@ tbd_symbol_info_targets_comparator(const void *__notnull const array_item,
      * Add one to also compare the null-terminator.
      */
 
+    if (array_string == string) {
+        return 0;
+    }
+
     if (array_length > length) {
         return memcmp(array_string, string, length + 1);
     } else {
@@ -267,6 +348,10 @@ tbd_symbol_info_no_targets_comparator(const void *__notnull const array_item,
      * Add one to also compare the null-terminator.
      */
 
+    if (array_string == string) {
+        return 0;
+    }
+
     if (array_length > length) {
         return memcmp(array_string, string, length + 1);
     } else {
@@ -313,6 +398,10 @@ tbd_metadata_info_no_targets_comparator(const void *__notnull const array_item,
      * Add one to also compare the null-terminator.
      */
 
+    if (array_string == string) {
+        return 0;
+    }
+
     if (array_length > length) {
         return memcmp(array_string, string, length + 1);
     } else {
@@ -378,6 +467,10 @@ tbd_metadata_info_comparator(const void *__notnull const array_item,
      * is accurate.
      */
 
+    if (array_string == string) {
+        return 0;
+    }
+
     if (array_length > length) {
         return memcmp(array_string, string, length + 1);
     } else {
@@ -385,13 +478,39 @@ tbd_metadata_info_comparator(const void *__notnull const array_item,
     }
 }
 
-static enum tbd_ci_add_data_result
-add_metadata_with_type(struct tbd_create_info *__notnull const info_in,
-                       const char *__notnull const string,
-                       const uint64_t length,
-                       const uint64_t bit_index,
-                       const enum tbd_metadata_type type,
-                       const struct tbd_parse_options options)
+bool tbd_ci_owns_strings(const struct tbd_create_info *__notnull const info) {
+    return (!info->flags.borrows_strings && info->string_pool == NULL);
+}
+
+/*
+ * Get the string info_in should store for a new symbol or metadata, which is
+ * string itself if info_in borrows its strings.
+ */
+
+static char *
+get_string_to_store(const struct tbd_create_info *__notnull const info_in,
+                    const char *__notnull const string,
+                    const uint64_t length)
+{
+    if (info_in->flags.borrows_strings) {
+        return (char *)string;
+    }
+
+    struct string_pool *const string_pool = info_in->string_pool;
+    if (string_pool != NULL) {
+        return (char *)string_pool_intern(string_pool, string, length);
+    }
+
+    return alloc_and_copy(string, length);
+}
+
+enum tbd_ci_add_data_result
+tbd_ci_add_metadata(struct tbd_create_info *__notnull const info_in,
+                    const char *__notnull const string,
+                    const uint64_t length,
+                    const uint64_t bit_index,
+                    const enum tbd_metadata_type type,
+                    const struct tbd_parse_options options)
 {
     struct tbd_metadata_info info = {
         .string = (char *)string,
@@ -416,7 +535,7 @@ add_metadata_with_type(struct tbd_create_info *__notnull const info_in,
         return E_TBD_CI_ADD_DATA_OK;
     }
 
-    info.string = alloc_and_copy(info.string, info.length);
+    info.string = get_string_to_store(info_in, string, length);
     if (unlikely(info.string == NULL)) {
         return E_TBD_CI_ADD_DATA_ALLOC_FAIL;
     }
@@ -430,7 +549,10 @@ add_metadata_with_type(struct tbd_create_info *__notnull const info_in,
         bit_list_create_with_capacity(&info.targets, targets_count);
 
     if (create_bits_result != E_BIT_LIST_OK) {
-        free(info.string);
+        if (tbd_ci_owns_strings(info_in)) {
+            free(info.string);
+        }
+
         return E_TBD_CI_ADD_DATA_ALLOC_FAIL;
     }
 
@@ -449,7 +571,10 @@ add_metadata_with_type(struct tbd_create_info *__notnull const info_in,
                                               NULL);
 
     if (unlikely(add_export_info_result != E_ARRAY_OK)) {
-        free(info.string);
+        if (tbd_ci_owns_strings(info_in)) {
+            free(info.string);
+        }
+
         return E_TBD_CI_ADD_DATA_ARRAY_FAIL;
     }
 
@@ -483,7 +608,7 @@ tbd_ci_add_parent_umbrella(struct tbd_create_info *__notnull const info_in,
         return E_TBD_CI_ADD_PARENT_UMBRELLA_OK;
     }
 
-    if (tbd_uses_archs(info_in->version)) {
+    if (tbd_uses_archs(tbd_ci_get_parse_version(info_in))) {
         const struct tbd_metadata_info *const parent_umbrella =
             get_parent_umbrella(&info_in->fields.metadata);
 
@@ -499,12 +624,12 @@ tbd_ci_add_parent_umbrella(struct tbd_create_info *__notnull const info_in,
     }
 
     const enum tbd_ci_add_data_result add_metadata_result =
-        add_metadata_with_type(info_in,
-                               string,
-                               length,
-                               arch_index,
-                               TBD_METADATA_TYPE_PARENT_UMBRELLA,
-                               options);
+        tbd_ci_add_metadata(info_in,
+                            string,
+                            length,
+                            arch_index,
+                            TBD_METADATA_TYPE_PARENT_UMBRELLA,
+                            options);
 
     switch (add_metadata_result) {
         case E_TBD_CI_ADD_DATA_OK:
@@ -553,6 +678,15 @@ tbd_ci_set_single_platform(struct tbd_create_info *__notnull const info,
     }
 }
 
+enum tbd_version
+tbd_ci_get_parse_version(const struct tbd_create_info *__notnull const info) {
+    if (info->flags.version_neutral) {
+        return TBD_VERSION_NONE;
+    }
+
+    return info->version;
+}
+
 enum tbd_platform
 tbd_ci_get_single_platform(const struct tbd_create_info *__notnull const info) {
     const struct arch_info *arch = NULL;
@@ -632,6 +766,30 @@ tbd_ci_add_symbol_with_type(struct tbd_create_info *__notnull const info_in,
             break;
     }
 
+    const tbd_ci_symbol_sink symbol_sink = info_in->symbol_sink;
+    if (symbol_sink != NULL) {
+        if (meta_type == TBD_SYMBOL_META_TYPE_EXPORT) {
+            if (options.ignore_exports) {
+                return E_TBD_CI_ADD_DATA_OK;
+            }
+        }
+
+        const bool sink_result =
+            symbol_sink(info_in,
+                        string,
+                        length,
+                        arch_index,
+                        type,
+                        meta_type,
+                        info_in->sink_info);
+
+        if (!sink_result) {
+            return E_TBD_CI_ADD_DATA_ARRAY_FAIL;
+        }
+
+        return E_TBD_CI_ADD_DATA_OK;
+    }
+
     const enum tbd_version version = info_in->version;
     switch (version) {
         case TBD_VERSION_NONE:
@@ -683,11 +841,12 @@ tbd_ci_add_symbol_with_type(struct tbd_create_info *__notnull const info_in,
             break;
 
         /*
-         * On tbd-version v4, clients and re-exports are their own metadata
-         * sections.
+         * On tbd-version v4 and later, clients and re-exports are their own
+         * metadata sections.
          */
 
         case TBD_VERSION_V4:
+        case TBD_VERSION_V5:
             switch (type) {
                 case TBD_SYMBOL_TYPE_NONE:
                 case TBD_SYMBOL_TYPE_NORMAL:
@@ -706,19 +865,19 @@ tbd_ci_add_symbol_with_type(struct tbd_create_info *__notnull const info_in,
 
                 case TBD_SYMBOL_TYPE_CLIENT: {
                     const enum tbd_ci_add_data_result add_client_result =
-                        add_metadata_with_type(info_in,
-                                               string,
-                                               length,
-                                               arch_index,
-                                               TBD_METADATA_TYPE_CLIENT,
-                                               options);
+                        tbd_ci_add_metadata(info_in,
+                                            string,
+                                            length,
+                                            arch_index,
+                                            TBD_METADATA_TYPE_CLIENT,
+                                            options);
 
                     return add_client_result;
                 }
 
                 case TBD_SYMBOL_TYPE_REEXPORT: {
                     const enum tbd_ci_add_data_result add_reexport_result =
-                        add_metadata_with_type(
+                        tbd_ci_add_metadata(
                             info_in,
                             string,
                             length,
@@ -757,7 +916,7 @@ tbd_ci_add_symbol_with_type(struct tbd_create_info *__notnull const info_in,
         return E_TBD_CI_ADD_DATA_OK;
     }
 
-    symbol_info.string = alloc_and_copy(symbol_info.string, symbol_info.length);
+    symbol_info.string = get_string_to_store(info_in, string, length);
     if (unlikely(symbol_info.string == NULL)) {
         return E_TBD_CI_ADD_DATA_ALLOC_FAIL;
     }
@@ -771,7 +930,10 @@ tbd_ci_add_symbol_with_type(struct tbd_create_info *__notnull const info_in,
         bit_list_create_with_capacity(&symbol_info.targets, targets_count);
 
     if (create_bits_result != E_BIT_LIST_OK) {
-        free(symbol_info.string);
+        if (tbd_ci_owns_strings(info_in)) {
+            free(symbol_info.string);
+        }
+
         return E_TBD_CI_ADD_DATA_ALLOC_FAIL;
     }
 
@@ -789,7 +951,10 @@ tbd_ci_add_symbol_with_type(struct tbd_create_info *__notnull const info_in,
                                               NULL);
 
     if (unlikely(add_export_info_result != E_ARRAY_OK)) {
-        free(symbol_info.string);
+        if (tbd_ci_owns_strings(info_in)) {
+            free(symbol_info.string);
+        }
+
         return E_TBD_CI_ADD_DATA_ARRAY_FAIL;
     }
 
@@ -1009,6 +1174,14 @@ tbd_ci_add_symbol_with_info(struct tbd_create_info *__notnull const info_in,
                             const bool is_exported,
                             const struct tbd_parse_options options)
 {
+    const struct symbol_filter *const filter = info_in->symbol_filter;
+    if (filter != NULL) {
+        const uint64_t raw_length = strnlen(string, lnmax);
+        if (!symbol_filter_matches(filter, string, raw_length)) {
+            return E_TBD_CI_ADD_DATA_OK;
+        }
+    }
+
     uint64_t length = 0;
     enum tbd_symbol_type type = TBD_SYMBOL_TYPE_NORMAL;
 
@@ -1137,6 +1310,13 @@ tbd_ci_add_symbol_with_info_and_len(
     const bool is_exported,
     const struct tbd_parse_options options)
 {
+    const struct symbol_filter *const filter = info_in->symbol_filter;
+    if (filter != NULL) {
+        if (!symbol_filter_matches(filter, string, len)) {
+            return E_TBD_CI_ADD_DATA_OK;
+        }
+    }
+
     enum tbd_symbol_type type = TBD_SYMBOL_TYPE_NORMAL;
 
     /*
@@ -1335,6 +1515,14 @@ tbd_create_with_info(const struct tbd_create_info *__notnull const info,
                      const struct tbd_create_options options)
 {
     const enum tbd_version version = info->version;
+    if (version == TBD_VERSION_V5) {
+        if (tbd_write_json(file, info, options)) {
+            return E_TBD_CREATE_WRITE_FAIL;
+        }
+
+        return E_TBD_CREATE_OK;
+    }
+
     if (tbd_write_magic(file, version)) {
         return E_TBD_CREATE_WRITE_FAIL;
     }
@@ -1461,25 +1649,35 @@ tbd_create_with_info(const struct tbd_create_info *__notnull const info,
     return E_TBD_CREATE_OK;
 }
 
-static void clear_metadata_array(struct array *__notnull const list) {
+static void
+clear_metadata_array(struct array *__notnull const list,
+                     const bool free_strings)
+{
     struct tbd_metadata_info *info = list->data;
     const struct tbd_metadata_info *const end = list->data_end;
 
     for (; info != end; info++) {
         bit_list_destroy(&info->targets);
-        free(info->string);
+        if (free_strings) {
+            free(info->string);
+        }
     }
 
     array_clear(list);
 }
 
-static void clear_symbols_array(struct array *__notnull const list) {
+static void
+clear_symbols_array(struct array *__notnull const list,
+                    const bool free_strings)
+{
     struct tbd_symbol_info *info = list->data;
     const struct tbd_symbol_info *const end = list->data_end;
 
     for (; info != end; info++) {
         bit_list_destroy(&info->targets);
-        free(info->string);
+        if (free_strings) {
+            free(info->string);
+        }
     }
 
     array_clear(list);
@@ -1494,8 +1692,10 @@ tbd_create_info_clear_fields_and_create_from(
         free((char *)dst->fields.install_name);
     }
 
-    clear_metadata_array(&dst->fields.metadata);
-    clear_symbols_array(&dst->fields.symbols);
+    const bool free_strings = tbd_ci_owns_strings(dst);
+
+    clear_metadata_array(&dst->fields.metadata, free_strings);
+    clear_symbols_array(&dst->fields.symbols, free_strings);
     array_clear(&dst->fields.uuids);
 
     const struct array metadata = dst->fields.metadata;
@@ -1510,37 +1710,469 @@ tbd_create_info_clear_fields_and_create_from(
     dst->fields.uuids = uuids;
 }
 
-static void destroy_metadata_array(struct array *__notnull const list) {
+static void
+destroy_metadata_array(struct array *__notnull const list,
+                       const bool free_strings)
+{
     struct tbd_metadata_info *info = list->data;
     const struct tbd_metadata_info *const end = list->data_end;
 
     for (; info != end; info++) {
         bit_list_destroy(&info->targets);
-        free(info->string);
+        if (free_strings) {
+            free(info->string);
+        }
     }
 
     array_destroy(list);
 }
 
-static void destroy_symbols_array(struct array *__notnull const list) {
+static void
+destroy_symbols_array(struct array *__notnull const list,
+                      const bool free_strings)
+{
     struct tbd_symbol_info *info = list->data;
     const struct tbd_symbol_info *const end = list->data_end;
 
     for (; info != end; info++) {
         bit_list_destroy(&info->targets);
-        free(info->string);
+        if (free_strings) {
+            free(info->string);
+        }
     }
 
     array_destroy(list);
 }
 
+static void
+add_targets(struct bit_list *__notnull const list,
+            const struct bit_list targets,
+            const uint64_t targets_count)
+{
+    for (uint64_t i = 0; i != targets_count; i++) {
+        if (bit_list_get_for_index(targets, i)) {
+            bit_list_set_bit(list, i);
+        }
+    }
+}
+
+struct merge_symbols_info {
+    uint64_t targets_count;
+    bool owns_strings : 1;
+};
+
+/*
+ * Fold a duplicate symbol, dropped when merging, into the symbol kept.
+ */
+
+static void
+merge_duplicate_symbol(void *__notnull const kept,
+                       void *__notnull const dropped,
+                       void *const cb_info)
+{
+    const struct merge_symbols_info *const info =
+        (const struct merge_symbols_info *)cb_info;
+
+    struct tbd_symbol_info *const kept_symbol = (struct tbd_symbol_info *)kept;
+    struct tbd_symbol_info *const dropped_symbol =
+        (struct tbd_symbol_info *)dropped;
+
+    add_targets(&kept_symbol->targets,
+                dropped_symbol->targets,
+                info->targets_count);
+
+    if (info->owns_strings) {
+        free(dropped_symbol->string);
+    }
+
+    bit_list_destroy(&dropped_symbol->targets);
+}
+
+enum tbd_ci_add_data_result
+tbd_ci_merge_sorted_symbols(struct tbd_create_info *__notnull const info_in,
+                            struct array *__notnull const symbols)
+{
+    struct array *const own = &info_in->fields.symbols;
+    if (symbols->item_count == 0) {
+        return E_TBD_CI_ADD_DATA_OK;
+    }
+
+    const struct array empty = {};
+    if (own->item_count == 0) {
+        array_destroy(own);
+
+        *own = *symbols;
+        *symbols = empty;
+
+        return E_TBD_CI_ADD_DATA_OK;
+    }
+
+    struct merge_symbols_info merge_info = {
+        .targets_count = info_in->fields.targets.set_count,
+        .owns_strings = tbd_ci_owns_strings(info_in)
+    };
+
+    const enum array_result merge_result =
+        array_add_and_unique_items_from_sorted_array(
+            own,
+            sizeof(struct tbd_symbol_info),
+            symbols,
+            tbd_symbol_info_no_targets_comparator,
+            merge_duplicate_symbol,
+            &merge_info);
+
+    if (merge_result != E_ARRAY_OK) {
+        return E_TBD_CI_ADD_DATA_ARRAY_FAIL;
+    }
+
+    /*
+     * Every symbol has been moved into own, so only the buffer of symbols is
+     * destroyed.
+     */
+
+    array_destroy(symbols);
+    *symbols = empty;
+
+    return E_TBD_CI_ADD_DATA_OK;
+}
+
+/*
+ * Add a symbol, with the targets of a symbol or metadata of a version-neutral
+ * create-info, to info_in. The symbol's string is created by appending string
+ * to prefix.
+ */
+
+static enum tbd_ci_add_data_result
+add_converted_symbol(struct tbd_create_info *__notnull const info_in,
+                     const char *__notnull const prefix,
+                     const uint64_t prefix_length,
+                     const char *__notnull const string,
+                     const uint64_t length,
+                     const struct bit_list targets,
+                     const enum tbd_symbol_type type,
+                     const enum tbd_symbol_meta_type meta_type)
+{
+    const uint64_t full_length = prefix_length + length;
+    char *const full_string = malloc(full_length + 1);
+
+    if (unlikely(full_string == NULL)) {
+        return E_TBD_CI_ADD_DATA_ALLOC_FAIL;
+    }
+
+    memcpy(full_string, prefix, prefix_length);
+    memcpy(full_string + prefix_length, string, length);
+
+    full_string[full_length] = '\0';
+
+    struct tbd_symbol_info symbol_info = {
+        .length = full_length,
+        .string = full_string,
+        .type = type,
+        .meta_type = meta_type
+    };
+
+    const uint64_t targets_count = info_in->fields.targets.set_count;
+
+    struct array_cached_index_info cached_info = {};
+    struct tbd_symbol_info *const existing_info =
+        array_find_item_in_sorted(&info_in->fields.symbols,
+                                  sizeof(symbol_info),
+                                  &symbol_info,
+                                  tbd_symbol_info_no_targets_comparator,
+                                  &cached_info);
+
+    if (existing_info != NULL) {
+        add_targets(&existing_info->targets, targets, targets_count);
+        free(full_string);
+
+        return E_TBD_CI_ADD_DATA_OK;
+    }
+
+    if (yaml_c_str_needs_quotes(full_string, full_length)) {
+        symbol_info.flags.needs_quotes = true;
+    }
+
+    const enum bit_list_result create_bits_result =
+        bit_list_create_with_capacity(&symbol_info.targets, targets_count);
+
+    if (create_bits_result != E_BIT_LIST_OK) {
+        free(full_string);
+        return E_TBD_CI_ADD_DATA_ALLOC_FAIL;
+    }
+
+    add_targets(&symbol_info.targets, targets, targets_count);
+
+    const enum array_result add_symbol_info_result =
+        array_add_item_with_cached_index_info(&info_in->fields.symbols,
+                                              sizeof(symbol_info),
+                                              &symbol_info,
+                                              &cached_info,
+                                              NULL);
+
+    if (unlikely(add_symbol_info_result != E_ARRAY_OK)) {
+        bit_list_destroy(&symbol_info.targets);
+        free(full_string);
+
+        return E_TBD_CI_ADD_DATA_ARRAY_FAIL;
+    }
+
+    return E_TBD_CI_ADD_DATA_OK;
+}
+
+static enum tbd_ci_add_data_result
+add_converted_metadata(struct tbd_create_info *__notnull const info_in,
+                       const struct tbd_metadata_info *__notnull const info)
+{
+    switch (info->type) {
+        case TBD_METADATA_TYPE_NONE:
+            break;
+
+        case TBD_METADATA_TYPE_PARENT_UMBRELLA: {
+            struct tbd_metadata_info umbrella = {
+                .length = info->length,
+                .type = info->type,
+                .flags = info->flags
+            };
+
+            umbrella.string = alloc_and_copy(info->string, info->length);
+
+            if (unlikely(umbrella.string == NULL)) {
+                return E_TBD_CI_ADD_DATA_ALLOC_FAIL;
+            }
+
+            const uint64_t targets_count = info_in->fields.targets.set_count;
+            const enum bit_list_result create_bits_result =
+                bit_list_create_with_capacity(&umbrella.targets, targets_count);
+
+            if (create_bits_result != E_BIT_LIST_OK) {
+                free(umbrella.string);
+                return E_TBD_CI_ADD_DATA_ALLOC_FAIL;
+            }
+
+            add_targets(&umbrella.targets, info->targets, targets_count);
+
+            const enum array_result add_umbrella_result =
+                array_add_item(&info_in->fields.metadata,
+                               sizeof(umbrella),
+                               &umbrella,
+                               NULL);
+
+            if (unlikely(add_umbrella_result != E_ARRAY_OK)) {
+                bit_list_destroy(&umbrella.targets);
+                free(umbrella.string);
+
+                return E_TBD_CI_ADD_DATA_ARRAY_FAIL;
+            }
+
+            break;
+        }
+
+        /*
+         * Before tbd-version v4, clients and re-exports are stored as exported
+         * symbols.
+         */
+
+        case TBD_METADATA_TYPE_CLIENT:
+            return add_converted_symbol(info_in,
+                                        "",
+                                        0,
+                                        info->string,
+                                        info->length,
+                                        info->targets,
+                                        TBD_SYMBOL_TYPE_CLIENT,
+                                        TBD_SYMBOL_META_TYPE_EXPORT);
+
+        case TBD_METADATA_TYPE_REEXPORTED_LIBRARY:
+            return add_converted_symbol(info_in,
+                                        "",
+                                        0,
+                                        info->string,
+                                        info->length,
+                                        info->targets,
+                                        TBD_SYMBOL_TYPE_REEXPORT,
+                                        TBD_SYMBOL_META_TYPE_EXPORT);
+    }
+
+    return E_TBD_CI_ADD_DATA_OK;
+}
+
+/*
+ * Convert a symbol from its tbd-version v4 form, as stored in version-neutral
+ * create-infos, back to the form of info_in's (older) tbd-version, mirroring
+ * tbd_ci_add_symbol_with_type() and tbd_ci_add_symbol_with_info().
+ */
+
+static enum tbd_ci_add_data_result
+add_converted_symbol_info(struct tbd_create_info *__notnull const info_in,
+                          const struct tbd_symbol_info *__notnull const info)
+{
+    const enum tbd_version version = info_in->version;
+
+    enum tbd_symbol_type type = info->type;
+    enum tbd_symbol_meta_type meta_type = info->meta_type;
+
+    switch (meta_type) {
+        case TBD_SYMBOL_META_TYPE_NONE:
+            return E_TBD_CI_ADD_DATA_OK;
+
+        case TBD_SYMBOL_META_TYPE_EXPORT:
+            break;
+
+        case TBD_SYMBOL_META_TYPE_REEXPORT:
+            meta_type = TBD_SYMBOL_META_TYPE_EXPORT;
+            break;
+
+        case TBD_SYMBOL_META_TYPE_UNDEFINED:
+            if (version == TBD_VERSION_V1) {
+                return E_TBD_CI_ADD_DATA_OK;
+            }
+
+            break;
+    }
+
+    const char *prefix = "";
+    uint64_t prefix_length = 0;
+
+    /*
+     * Before tbd-version v3, objc-class and objc-ivar names keep their leading
+     * underscore, and objc eh-type symbols are normal symbols.
+     */
+
+    if (version < TBD_VERSION_V3) {
+        switch (type) {
+            case TBD_SYMBOL_TYPE_OBJC_CLASS:
+            case TBD_SYMBOL_TYPE_OBJC_IVAR:
+                prefix = "_";
+                prefix_length = 1;
+
+                break;
+
+            case TBD_SYMBOL_TYPE_OBJC_EHTYPE:
+                prefix = "_OBJC_EHTYPE_$_";
+                prefix_length = 15;
+                type = TBD_SYMBOL_TYPE_NORMAL;
+
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return add_converted_symbol(info_in,
+                                prefix,
+                                prefix_length,
+                                info->string,
+                                info->length,
+                                info->targets,
+                                type,
+                                meta_type);
+}
+
+static enum tbd_ci_add_data_result
+convert_neutral_info(struct tbd_create_info *__notnull const info_in,
+                     const struct tbd_create_info *__notnull const neutral)
+{
+    const struct tbd_metadata_info *metadata = neutral->fields.metadata.data;
+    const struct tbd_metadata_info *const metadata_end =
+        neutral->fields.metadata.data_end;
+
+    for (; metadata != metadata_end; metadata++) {
+        const enum tbd_ci_add_data_result add_metadata_result =
+            add_converted_metadata(info_in, metadata);
+
+        if (add_metadata_result != E_TBD_CI_ADD_DATA_OK) {
+            return add_metadata_result;
+        }
+    }
+
+    const struct tbd_symbol_info *symbol = neutral->fields.symbols.data;
+    const struct tbd_symbol_info *const symbols_end =
+        neutral->fields.symbols.data_end;
+
+    for (; symbol != symbols_end; symbol++) {
+        const enum tbd_ci_add_data_result add_symbol_result =
+            add_converted_symbol_info(info_in, symbol);
+
+        if (add_symbol_result != E_TBD_CI_ADD_DATA_OK) {
+            return add_symbol_result;
+        }
+    }
+
+    return E_TBD_CI_ADD_DATA_OK;
+}
+
+enum tbd_create_result
+tbd_create_with_info_for_version(
+    const struct tbd_create_info *__notnull const info,
+    const enum tbd_version version,
+    FILE *__notnull const file,
+    const struct tbd_create_options options)
+{
+    if (!info->flags.version_neutral || version == info->version) {
+        return tbd_create_with_info(info, file, options);
+    }
+
+    /*
+     * Version-neutral create-infos are stored in their tbd-version v4 form,
+     * which tbd-version v5 shares, and so don't need to be converted.
+     */
+
+    if (version == TBD_VERSION_V5) {
+        struct tbd_create_info v5_info = *info;
+        v5_info.version = TBD_VERSION_V5;
+
+        return tbd_create_with_info(&v5_info, file, options);
+    }
+
+    /*
+     * Everything but the symbols and metadata is shared with info, and so
+     * isn't destroyed with the converted create-info.
+     */
+
+    struct tbd_create_info converted = {
+        .version = version,
+        .fields = info->fields,
+        .flags = info->flags
+    };
+
+    converted.fields.metadata = (struct array){};
+    converted.fields.symbols = (struct array){};
+
+    converted.flags.borrows_strings = false;
+    converted.flags.version_neutral = false;
+
+    const enum tbd_ci_add_data_result convert_result =
+        convert_neutral_info(&converted, info);
+
+    enum tbd_create_result result = E_TBD_CREATE_ALLOC_FAIL;
+    if (convert_result == E_TBD_CI_ADD_DATA_OK) {
+        array_sort_with_comparator(&converted.fields.metadata,
+                                   sizeof(struct tbd_metadata_info),
+                                   tbd_metadata_info_comparator);
+
+        array_sort_with_comparator(&converted.fields.symbols,
+                                   sizeof(struct tbd_symbol_info),
+                                   tbd_symbol_info_targets_comparator);
+
+        result = tbd_create_with_info(&converted, file, options);
+    }
+
+    destroy_metadata_array(&converted.fields.metadata, true);
+    destroy_symbols_array(&converted.fields.symbols, true);
+
+    return result;
+}
+
 void tbd_create_info_destroy(struct tbd_create_info *__notnull const info) {
     if (info->flags.install_name_was_allocated) {
         free((char *)info->fields.install_name);
     }
 
-    destroy_metadata_array(&info->fields.metadata);
-    destroy_symbols_array(&info->fields.symbols);
+    const bool free_strings = tbd_ci_owns_strings(info);
+
+    destroy_metadata_array(&info->fields.metadata, free_strings);
+    destroy_symbols_array(&info->fields.symbols, free_strings);
 
     target_list_destroy(&info->fields.targets);
     array_destroy(&info->fields.uuids);
@@ -1549,5 +2181,6 @@ void tbd_create_info_destroy(struct tbd_create_info *__notnull const info) {
 
     info->flags.install_name_was_allocated = false;
     info->flags.install_name_needs_quotes = false;
+    info->flags.borrows_strings = false;
 }
 
@@ -12,16 +12,26 @@
 #include <errno.h>
 #include <fcntl.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "copy.h"
 #include "macho_file.h"
+#include "our_io.h"
+#include "parse_budget.h"
 #include "parse_or_list_fields.h"
 
 #include "path.h"
 #include "recursive.h"
+#include "symbol_filter.h"
+#include "tar_write.h"
 #include "tbd.h"
 #include "tbd_for_main.h"
+#include "tbd_write.h"
+#include "util.h"
 #include "yaml.h"
 
 static void
@@ -122,6 +132,53 @@ add_image_number(int *__notnull const index_in,
     *index_in = index + 1;
 }
 
+static struct parse_budget *
+get_budget(struct tbd_for_main *__notnull const tbd) {
+    struct parse_budget *budget = tbd->budget;
+    if (budget == NULL) {
+        budget = calloc(1, sizeof(*budget));
+        if (budget == NULL) {
+            fputs("Failed to allocate memory\n", stderr);
+            exit(1);
+        }
+
+        tbd->budget = budget;
+        tbd->info.budget = budget;
+    }
+
+    return budget;
+}
+
+static uint64_t
+parse_budget_limit(int *__notnull const index_in,
+                   const int argc,
+                   char *const *__notnull const argv,
+                   const char *__notnull const description)
+{
+    const int index = *index_in + 1;
+    if (index == argc) {
+        fprintf(stderr, "Please provide the %s\n", description);
+        exit(1);
+    }
+
+    const char *const limit_string = argv[index];
+
+    char *limit_end = NULL;
+    const uint64_t limit = strtoull(limit_string, &limit_end, 10);
+
+    if (limit == 0 || *limit_end != '\0') {
+        fprintf(stderr,
+                "A limit of \"%s\" is invalid for the %s\n",
+                limit_string,
+                description);
+
+        exit(1);
+    }
+
+    *index_in = index;
+    return limit;
+}
+
 static void
 add_image_path(int *__notnull const index_in,
                struct tbd_for_main *__notnull const tbd,
@@ -159,6 +216,128 @@ add_image_path(int *__notnull const index_in,
     *index_in = index + 1;
 }
 
+/*
+ * Add a comma-separated list of symbol-patterns to the include or exclude set
+ * of tbd's symbol-filter, creating the symbol-filter if necessary.
+ */
+
+static void
+add_symbol_patterns(int *__notnull const index_in,
+                    struct tbd_for_main *__notnull const tbd,
+                    const int argc,
+                    char *const *__notnull const argv,
+                    const bool exclude)
+{
+    const int index = *index_in + 1;
+    if (index == argc) {
+        fprintf(stderr,
+                "Please provide a comma-separated list of symbol-patterns to "
+                "%s\n",
+                exclude ? "exclude" : "include");
+
+        exit(1);
+    }
+
+    struct symbol_filter *filter = tbd->symbol_filter;
+    if (filter == NULL) {
+        filter = calloc(1, sizeof(*filter));
+        if (filter == NULL) {
+            fputs("Failed to allocate memory\n", stderr);
+            exit(1);
+        }
+
+        tbd->symbol_filter = filter;
+        tbd->info.symbol_filter = filter;
+    }
+
+    struct symbol_pattern_set *const set =
+        (exclude) ? &filter->exclude : &filter->include;
+
+    const char *iter = argv[index];
+    do {
+        const char *const comma = strchr(iter, ',');
+        const uint64_t length =
+            (comma != NULL) ? (uint64_t)(comma - iter) : strlen(iter);
+
+        switch (symbol_pattern_set_add(set, iter, length)) {
+            case E_SYMBOL_FILTER_OK:
+                break;
+
+            case E_SYMBOL_FILTER_ALLOC_FAIL:
+            case E_SYMBOL_FILTER_ARRAY_FAIL:
+                fputs("Failed to allocate memory\n", stderr);
+                exit(1);
+
+            case E_SYMBOL_FILTER_EMPTY_PATTERN:
+                fprintf(stderr,
+                        "Symbol-pattern list \"%s\" has an empty pattern\n",
+                        argv[index]);
+
+                exit(1);
+        }
+
+        if (comma == NULL) {
+            break;
+        }
+
+        iter = comma + 1;
+    } while (true);
+
+    *index_in = index;
+}
+
+/*
+ * Parse a comma-separated list of tbd-versions, such as "v2,v3,v4", which are
+ * all written out from a single parse.
+ */
+
+static void
+set_tbd_versions(struct tbd_for_main *__notnull const tbd,
+                 const char *__notnull const list)
+{
+    uint32_t versions = 0;
+
+    const char *iter = list;
+    do {
+        const char *const comma = strchr(iter, ',');
+        const uint64_t length =
+            (comma != NULL) ? (uint64_t)(comma - iter) : strlen(iter);
+
+        enum tbd_version version = TBD_VERSION_NONE;
+        if (length == 2) {
+            const char name[3] = { iter[0], iter[1], '\0' };
+            version = parse_tbd_version(name);
+        }
+
+        if (version == TBD_VERSION_NONE) {
+            fprintf(stderr,
+                    "Unrecognized .tbd version: %.*s.\nRun "
+                    "--list-tbd-versions to see a list of valid "
+                    "tbd-versions\n",
+                    (int)length,
+                    iter);
+
+            exit(1);
+        }
+
+        versions |= (1u << version);
+        if (comma == NULL) {
+            break;
+        }
+
+        iter = comma + 1;
+    } while (true);
+
+    enum tbd_version first = TBD_VERSION_V1;
+    while (!(versions & (1u << first))) {
+        first++;
+    }
+
+    tbd->info.version = first;
+    tbd->versions = (versions != (1u << first)) ? versions : 0;
+    tbd->flags.provided_tbd_version = true;
+}
+
 bool
 tbd_for_main_parse_option(int *const __notnull index_in,
                           struct tbd_for_main *__notnull const tbd,
@@ -188,6 +367,9 @@ tbd_for_main_parse_option(int *const __notnull index_in,
         tbd->parse_options.ignore_current_version = true;
         tbd->write_options.ignore_current_version = true;
         tbd->flags.provided_ignore_current_version = true;
+    } else if (strcmp(option, "ignore-exports") == 0) {
+        tbd->parse_options.ignore_exports = true;
+        tbd->write_options.ignore_exports = true;
     } else if (strcmp(option, "ignore-flags") == 0) {
         tbd->parse_options.ignore_flags = true;
         tbd->write_options.ignore_flags = true;
@@ -241,6 +423,10 @@ tbd_for_main_parse_option(int *const __notnull index_in,
         tbd->write_options.ignore_weak_defs_syms = true;
     } else if (strcmp(option, "ignore-wrong-filetype") == 0) {
         tbd->macho_options.ignore_wrong_filetype = true;
+    } else if (strcmp(option, "include-symbols") == 0) {
+        add_symbol_patterns(&index, tbd, argc, argv, false);
+    } else if (strcmp(option, "exclude-symbols") == 0) {
+        add_symbol_patterns(&index, tbd, argc, argv, true);
     } else if (strcmp(option, "filter-image-directory") == 0) {
         add_image_filter(&index, tbd, argc, argv, true);
     } else if (strcmp(option, "filter-image-filename") == 0) {
@@ -249,6 +435,8 @@ tbd_for_main_parse_option(int *const __notnull index_in,
         add_image_number(&index, tbd, argc, argv);
     } else if (strcmp(option, "image-path") == 0) {
         add_image_path(&index, tbd, argc, argv);
+    } else if (strcmp(option, "with-dependencies") == 0) {
+        tbd->options.dsc_with_dependencies = true;
     } else if (strcmp(option, "dsc") == 0) {
         if (!tbd->filetypes.user_provided) {
             tbd->filetypes.value = 0;
@@ -263,6 +451,20 @@ tbd_for_main_parse_option(int *const __notnull index_in,
 
         tbd->filetypes.macho = true;
         tbd->filetypes.user_provided = true;
+    } else if (strcmp(option, "tbd") == 0) {
+        if (!tbd->filetypes.user_provided) {
+            tbd->filetypes.value = 0;
+        }
+
+        tbd->filetypes.tbd = true;
+        tbd->filetypes.user_provided = true;
+    } else if (strcmp(option, "zip") == 0) {
+        if (!tbd->filetypes.user_provided) {
+            tbd->filetypes.value = 0;
+        }
+
+        tbd->filetypes.zip = true;
+        tbd->filetypes.user_provided = true;
     } else if (strcmp(option, "r") == 0 || strcmp(option, "recurse") == 0) {
         tbd->options.recurse_directories = true;
 
@@ -526,6 +728,32 @@ tbd_for_main_parse_option(int *const __notnull index_in,
         tbd->flags.provided_targets = true;
     } else if (strcmp(option, "skip-invalid-archs") == 0) {
         tbd->macho_options.skip_invalid_archs = true;
+    } else if (strcmp(option, "max-image-bytes") == 0) {
+        get_budget(tbd)->limits.max_bytes =
+            parse_budget_limit(&index,
+                               argc,
+                               argv,
+                               "maximum bytes of symbols stored for an image");
+    } else if (strcmp(option, "max-image-time") == 0) {
+        get_budget(tbd)->limits.max_milliseconds =
+            parse_budget_limit(&index,
+                               argc,
+                               argv,
+                               "maximum milliseconds to parse an image for");
+    } else if (strcmp(option, "max-symbols") == 0) {
+        get_budget(tbd)->limits.max_symbols =
+            parse_budget_limit(&index,
+                               argc,
+                               argv,
+                               "maximum symbols found in an image");
+    } else if (strcmp(option, "max-trie-nodes") == 0) {
+        get_budget(tbd)->limits.max_trie_nodes =
+            parse_budget_limit(&index,
+                               argc,
+                               argv,
+                               "maximum export-trie nodes visited in an image");
+    } else if (strcmp(option, "parallel-export-trie") == 0) {
+        tbd->macho_options.parallel_export_trie = true;
     } else if (strcmp(option, "use-export-trie") == 0) {
         tbd->macho_options.use_export_trie = true;
     } else if (strcmp(option, "use-symbol-table") == 0) {
@@ -548,19 +776,24 @@ tbd_for_main_parse_option(int *const __notnull index_in,
         }
 
         const char *const argument = argv[index];
-        const enum tbd_version version = parse_tbd_version(argument);
+        if (strchr(argument, ',') != NULL) {
+            set_tbd_versions(tbd, argument);
+        } else {
+            const enum tbd_version version = parse_tbd_version(argument);
+            if (version == TBD_VERSION_NONE) {
+                fprintf(stderr,
+                        "Unrecognized .tbd version: %s.\nRun "
+                        "--list-tbd-versions to see a list of valid "
+                        "tbd-versions\n",
+                        argument);
 
-        if (version == TBD_VERSION_NONE) {
-            fprintf(stderr,
-                    "Unrecognized .tbd version: %s.\nRun --list-tbd-versions "
-                    "to see a list of valid tbd-versions\n",
-                    argument);
+                exit(1);
+            }
 
-            exit(1);
+            tbd->info.version = version;
+            tbd->versions = 0;
+            tbd->flags.provided_tbd_version = true;
         }
-
-        tbd->info.version = version;
-        tbd->flags.provided_tbd_version = true;
     } else if (strcmp(option, "v1") == 0) {
         if (tbd->flags.provided_tbd_version) {
             fputs("Note: Option -v has been provided multiple times.\nOlder "
@@ -569,6 +802,7 @@ tbd_for_main_parse_option(int *const __notnull index_in,
         }
 
         tbd->info.version = TBD_VERSION_V1;
+        tbd->versions = 0;
         tbd->flags.provided_tbd_version = true;
     } else if (strcmp(option, "v2") == 0) {
         if (tbd->flags.provided_tbd_version) {
@@ -578,6 +812,7 @@ tbd_for_main_parse_option(int *const __notnull index_in,
         }
 
         tbd->info.version = TBD_VERSION_V2;
+        tbd->versions = 0;
         tbd->flags.provided_tbd_version = true;
     } else if (strcmp(option, "v3") == 0) {
         if (tbd->flags.provided_tbd_version) {
@@ -587,6 +822,7 @@ tbd_for_main_parse_option(int *const __notnull index_in,
         }
 
         tbd->info.version = TBD_VERSION_V3;
+        tbd->versions = 0;
         tbd->flags.provided_tbd_version = true;
     } else if (strcmp(option, "v4") == 0) {
         if (tbd->flags.provided_tbd_version) {
@@ -596,7 +832,26 @@ tbd_for_main_parse_option(int *const __notnull index_in,
         }
 
         tbd->info.version = TBD_VERSION_V4;
+        tbd->versions = 0;
         tbd->flags.provided_tbd_version = true;
+    } else if (strcmp(option, "v5") == 0) {
+        if (tbd->flags.provided_tbd_version) {
+            fputs("Note: Option -v has been provided multiple times.\nOlder "
+                  "option's .tbd version will be overriden\n",
+                  stderr);
+        }
+
+        tbd->info.version = TBD_VERSION_V5;
+        tbd->versions = 0;
+        tbd->flags.provided_tbd_version = true;
+    } else if (option[0] == 'v' && strchr(option, ',') != NULL) {
+        if (tbd->flags.provided_tbd_version) {
+            fputs("Note: Option -v has been provided multiple times.\nOlder "
+                  "option's .tbd version will be overriden\n",
+                  stderr);
+        }
+
+        set_tbd_versions(tbd, option);
     } else {
         return false;
     }
@@ -611,6 +866,51 @@ void tbd_for_main_handle_post_parse(struct tbd_for_main *__notnull const tbd) {
     }
 }
 
+struct tbd_parse_options
+tbd_for_main_create_parse_plan(const struct tbd_for_main *__notnull const tbd) {
+    const uint32_t versions = tbd->versions;
+    if (versions == 0) {
+        return tbd_create_parse_plan(tbd->parse_options,
+                                     tbd->write_options,
+                                     tbd->info.version);
+    }
+
+    /*
+     * Information is only skipped if it's skipped for every tbd-version.
+     */
+
+    struct tbd_parse_options plan = {};
+    bool found_plan = false;
+
+    for (enum tbd_version version = TBD_VERSION_V1;
+         version <= TBD_VERSION_V5;
+         version++)
+    {
+        if (!(versions & (1u << version))) {
+            continue;
+        }
+
+        const struct tbd_parse_options version_plan =
+            tbd_create_parse_plan(tbd->parse_options,
+                                  tbd->write_options,
+                                  version);
+
+        if (!found_plan) {
+            plan = version_plan;
+            found_plan = true;
+
+            continue;
+        }
+
+        plan.ignore_exports &= version_plan.ignore_exports;
+        plan.ignore_objc_constraint &= version_plan.ignore_objc_constraint;
+        plan.ignore_swift_version &= version_plan.ignore_swift_version;
+        plan.ignore_undefineds &= version_plan.ignore_undefineds;
+    }
+
+    return plan;
+}
+
 char *
 tbd_for_main_create_write_path(const struct tbd_for_main *__notnull const tbd,
                                const char *const file_name,
@@ -791,6 +1091,7 @@ tbd_for_main_create_dsc_folder_path(
 enum tbd_for_main_open_write_file_result
 tbd_for_main_open_write_file_for_path(
     const struct tbd_for_main *__notnull const tbd,
+    struct dir_cache *const dir_cache,
     char *__notnull const path,
     const uint64_t path_length,
     FILE **__notnull const file_out,
@@ -798,18 +1099,43 @@ tbd_for_main_open_write_file_for_path(
 {
     char *terminator = NULL;
 
-    const int flags = tbd->options.no_overwrite ? O_EXCL : 0;
-    const int write_fd =
-        open_r(path,
-               path_length,
-               O_WRONLY | O_TRUNC | flags,
-               DEFFILEMODE,
-               0755,
-               &terminator);
+    int flags = O_WRONLY | O_TRUNC;
+    if (tbd->options.write_if_changed) {
+        /*
+         * The file's existing contents are needed to check if they've
+         * changed, so the file is only truncated once we know they have.
+         */
+
+        flags = O_RDWR;
+    }
+
+    if (tbd->options.no_overwrite) {
+        flags |= O_EXCL;
+    }
+    int write_fd = -1;
+
+    if (dir_cache != NULL) {
+        write_fd =
+            dir_cache_open_file(dir_cache,
+                                path,
+                                path_length,
+                                flags,
+                                DEFFILEMODE,
+                                0755,
+                                &terminator);
+    } else {
+        write_fd =
+            open_r(path,
+                   path_length,
+                   flags,
+                   DEFFILEMODE,
+                   0755,
+                   &terminator);
+    }
 
     if (write_fd < 0) {
         /*
-         * Although getting the file descriptor failed, its likely open_r still
+         * Although getting the file descriptor failed, its likely we still
          * created the directory hierarchy, and if so the terminator shouldn't
          * be NULL.
          */
@@ -842,6 +1168,376 @@ tbd_for_main_open_write_file_for_path(
     return E_TBD_FOR_MAIN_OPEN_WRITE_FILE_OK;
 }
 
+/*
+ * Write the .tbd into an allocated buffer, for when the .tbd's contents are
+ * needed before writing out to the file.
+ */
+
+static enum tbd_create_result
+create_in_buffer(const struct tbd_for_main *__notnull const tbd,
+                 const enum tbd_version version,
+                 char **__notnull const buffer_out,
+                 size_t *__notnull const size_out)
+{
+    char *buffer = NULL;
+    size_t size = 0;
+
+    FILE *const buffer_file = open_memstream(&buffer, &size);
+    if (buffer_file == NULL) {
+        return E_TBD_CREATE_WRITE_FAIL;
+    }
+
+    const enum tbd_create_result create_tbd_result =
+        tbd_create_with_info_for_version(&tbd->info,
+                                         version,
+                                         buffer_file,
+                                         tbd->write_options);
+
+    /*
+     * The buffer and size are only updated on fflush() or fclose().
+     */
+
+    if (fclose(buffer_file) != 0) {
+        free(buffer);
+        return E_TBD_CREATE_WRITE_FAIL;
+    }
+
+    if (create_tbd_result != E_TBD_CREATE_OK) {
+        free(buffer);
+        return create_tbd_result;
+    }
+
+    *buffer_out = buffer;
+    *size_out = size;
+
+    return E_TBD_CREATE_OK;
+}
+
+/*
+ * Write the .tbd into memory first, as a tar member's header holds the size of
+ * its contents.
+ */
+
+static enum tbd_create_result
+write_to_archive(const struct tbd_for_main *__notnull const tbd,
+                 const enum tbd_version version,
+                 const char *__notnull const write_path,
+                 const uint64_t write_path_length,
+                 FILE *__notnull const file)
+{
+    char *buffer = NULL;
+    size_t size = 0;
+
+    const enum tbd_create_result create_tbd_result =
+        create_in_buffer(tbd, version, &buffer, &size);
+
+    if (create_tbd_result != E_TBD_CREATE_OK) {
+        return create_tbd_result;
+    }
+
+    /*
+     * Members are named after their write-path, relative to the archive's
+     * path, so that extracting the archive recreates the same hierarchy as
+     * writing out to a directory would have.
+     */
+
+    const char *name = write_path;
+    uint64_t name_length = write_path_length;
+
+    if (write_path_length > tbd->write_path_length) {
+        name =
+            remove_front_slashes(write_path + tbd->write_path_length,
+                                 write_path_length - tbd->write_path_length,
+                                 &name_length);
+    }
+
+    if (name == NULL || name_length == 0) {
+        free(buffer);
+        return E_TBD_CREATE_WRITE_FAIL;
+    }
+
+    /*
+     * With multiple tbd-versions, each version's members are stored under a
+     * directory named after the version.
+     */
+
+    char *version_name = NULL;
+    if (tbd->versions != 0) {
+        version_name =
+            path_append_component(tbd_version_to_string(version),
+                                  2,
+                                  name,
+                                  name_length,
+                                  &name_length);
+
+        if (version_name == NULL) {
+            free(buffer);
+            return E_TBD_CREATE_ALLOC_FAIL;
+        }
+
+        name = version_name;
+    }
+
+    const int write_result =
+        tar_write_member(file, name, name_length, buffer, size, time(NULL));
+
+    free(version_name);
+    free(buffer);
+
+    if (write_result != 0) {
+        return E_TBD_CREATE_WRITE_FAIL;
+    }
+
+    return E_TBD_CREATE_OK;
+}
+
+/*
+ * Compare the existing contents of the file at fd with buffer, stopping at the
+ * first difference.
+ */
+
+static bool
+file_matches_buffer(const int fd,
+                    const char *__notnull const buffer,
+                    const uint64_t size)
+{
+    struct stat sbuf = {};
+    if (fstat(fd, &sbuf) != 0) {
+        return false;
+    }
+
+    if ((uint64_t)sbuf.st_size != size) {
+        return false;
+    }
+
+    if (our_lseek(fd, 0, SEEK_SET) < 0) {
+        return false;
+    }
+
+    char chunk[16384];
+    uint64_t offset = 0;
+
+    while (offset != size) {
+        uint64_t chunk_size = size - offset;
+        if (chunk_size > sizeof(chunk)) {
+            chunk_size = sizeof(chunk);
+        }
+
+        const ssize_t read_size = our_read(fd, chunk, chunk_size);
+        if (read_size <= 0) {
+            return false;
+        }
+
+        if (memcmp(chunk, buffer + offset, (size_t)read_size) != 0) {
+            return false;
+        }
+
+        offset += (uint64_t)read_size;
+    }
+
+    return true;
+}
+
+/*
+ * The write-file was opened without truncating, so its existing contents can
+ * be compared against the new .tbd, and left untouched (along with its
+ * modification-time) if they're the same.
+ */
+
+static enum tbd_create_result
+write_if_changed(const struct tbd_for_main *__notnull const tbd,
+                 const enum tbd_version version,
+                 FILE *__notnull const file)
+{
+    char *buffer = NULL;
+    size_t size = 0;
+
+    const enum tbd_create_result create_tbd_result =
+        create_in_buffer(tbd, version, &buffer, &size);
+
+    if (create_tbd_result != E_TBD_CREATE_OK) {
+        return create_tbd_result;
+    }
+
+    const int fd = fileno(file);
+    if (file_matches_buffer(fd, buffer, size)) {
+        free(buffer);
+        return E_TBD_CREATE_OK;
+    }
+
+    if (our_lseek(fd, 0, SEEK_SET) < 0) {
+        free(buffer);
+        return E_TBD_CREATE_WRITE_FAIL;
+    }
+
+    if (size != 0) {
+        if (fwrite(buffer, size, 1, file) != 1) {
+            free(buffer);
+            return E_TBD_CREATE_WRITE_FAIL;
+        }
+    }
+
+    free(buffer);
+
+    /*
+     * Remove whatever remains of the file's previous (and longer) contents.
+     */
+
+    if (fflush(file) != 0 || ftruncate(fd, (off_t)size) != 0) {
+        return E_TBD_CREATE_WRITE_FAIL;
+    }
+
+    return E_TBD_CREATE_OK;
+}
+
+/*
+ * Get the first tbd-version written out, which is written to the write-path
+ * provided by the caller.
+ */
+
+static enum tbd_version
+get_first_version(const struct tbd_for_main *__notnull const tbd) {
+    const uint32_t versions = tbd->versions;
+    if (versions == 0) {
+        return tbd->info.version;
+    }
+
+    enum tbd_version version = TBD_VERSION_V1;
+    while (!(versions & (1u << version))) {
+        version++;
+    }
+
+    return version;
+}
+
+static enum tbd_create_result
+write_version_to_file(const struct tbd_for_main *__notnull const tbd,
+                      const enum tbd_version version,
+                      const char *__notnull const write_path,
+                      const uint64_t write_path_length,
+                      FILE *__notnull const file)
+{
+    if (tbd->options.archive_tbds) {
+        return write_to_archive(tbd,
+                                version,
+                                write_path,
+                                write_path_length,
+                                file);
+    }
+
+    if (tbd->options.write_if_changed) {
+        return write_if_changed(tbd, version, file);
+    }
+
+    return tbd_create_with_info_for_version(&tbd->info,
+                                            version,
+                                            file,
+                                            tbd->write_options);
+}
+
+static void
+handle_write_result(const struct tbd_for_main *__notnull const tbd,
+                    const enum tbd_create_result create_tbd_result,
+                    char *__notnull const write_path,
+                    const uint64_t write_path_length,
+                    char *const terminator,
+                    const bool print_paths)
+{
+    if (create_tbd_result == E_TBD_CREATE_OK) {
+        return;
+    }
+
+    if (!tbd->options.ignore_warnings) {
+        if (print_paths) {
+            fprintf(stderr,
+                    "Failed to write to write-file (at path %s)\n",
+                    write_path);
+        } else {
+            fputs("Failed to write to provided write-file\n", stderr);
+        }
+    }
+
+    if (terminator != NULL) {
+        remove_file_r(write_path, write_path_length, terminator);
+    }
+}
+
+/*
+ * The write-path of the first tbd-version ends with "-<version>", which is
+ * replaced to get the write-paths of the other versions, as every path written
+ * to is created from the write-path.
+ */
+
+static void
+write_version_to_own_file(const struct tbd_for_main *__notnull const tbd,
+                          const enum tbd_version version,
+                          const char *__notnull const write_path,
+                          const uint64_t write_path_length,
+                          const bool print_paths)
+{
+    char *const version_path = alloc_and_copy(write_path, write_path_length);
+    if (version_path == NULL) {
+        fputs("Failed to allocate memory\n", stderr);
+        exit(1);
+    }
+
+    const char *const version_string = tbd_version_to_string(version);
+    memcpy(version_path + tbd->write_path_length - 2, version_string, 2);
+
+    FILE *file = NULL;
+    char *terminator = NULL;
+
+    const enum tbd_for_main_open_write_file_result open_file_result =
+        tbd_for_main_open_write_file_for_path(tbd,
+                                              NULL,
+                                              version_path,
+                                              write_path_length,
+                                              &file,
+                                              &terminator);
+
+    switch (open_file_result) {
+        case E_TBD_FOR_MAIN_OPEN_WRITE_FILE_OK: {
+            const enum tbd_create_result create_tbd_result =
+                write_version_to_file(tbd,
+                                      version,
+                                      version_path,
+                                      write_path_length,
+                                      file);
+
+            handle_write_result(tbd,
+                                create_tbd_result,
+                                version_path,
+                                write_path_length,
+                                terminator,
+                                print_paths);
+
+            fclose(file);
+            break;
+        }
+
+        case E_TBD_FOR_MAIN_OPEN_WRITE_FILE_FAILED:
+            if (!tbd->options.ignore_warnings) {
+                fprintf(stderr,
+                        "Failed to open write-file (at path %s), error: %s\n",
+                        version_path,
+                        strerror(errno));
+            }
+
+            break;
+
+        case E_TBD_FOR_MAIN_OPEN_WRITE_FILE_PATH_ALREADY_EXISTS:
+            if (!tbd->options.ignore_warnings) {
+                fprintf(stderr,
+                        "File at write-path (%s) already exists\n",
+                        version_path);
+            }
+
+            break;
+    }
+
+    free(version_path);
+}
+
 void
 tbd_for_main_write_to_file(const struct tbd_for_main *__notnull const tbd,
                            char *__notnull const write_path,
@@ -850,35 +1546,117 @@ tbd_for_main_write_to_file(const struct tbd_for_main *__notnull const tbd,
                            FILE *__notnull const file,
                            const bool print_paths)
 {
-    const struct tbd_create_info *const create_info = &tbd->info;
+    const enum tbd_version first = get_first_version(tbd);
     const enum tbd_create_result create_tbd_result =
-        tbd_create_with_info(create_info, file, tbd->write_options);
+        write_version_to_file(tbd,
+                              first,
+                              write_path,
+                              write_path_length,
+                              file);
+
+    handle_write_result(tbd,
+                        create_tbd_result,
+                        write_path,
+                        write_path_length,
+                        terminator,
+                        print_paths);
+
+    const uint32_t versions = tbd->versions;
+    if (versions == 0) {
+        return;
+    }
 
-    if (create_tbd_result != E_TBD_CREATE_OK) {
-        if (!tbd->options.ignore_warnings) {
-            if (print_paths) {
-                fprintf(stderr,
-                        "Failed to write to write-file (at path %s)\n",
-                        write_path);
-            } else {
-                fputs("Failed to write to provided write-file\n", stderr);
-            }
+    /*
+     * When archiving, every version is written out to the same archive, under
+     * its own directory. Combining multiple versions is rejected beforehand.
+     */
+
+    const bool is_single_file = tbd->options.archive_tbds;
+
+    for (enum tbd_version version = first + 1;
+         version <= TBD_VERSION_V5;
+         version++)
+    {
+        if (!(versions & (1u << version))) {
+            continue;
         }
 
-        if (terminator != NULL) {
-            remove_file_r(write_path, write_path_length, terminator);
+        if (!is_single_file) {
+            write_version_to_own_file(tbd,
+                                      version,
+                                      write_path,
+                                      write_path_length,
+                                      print_paths);
+
+            continue;
         }
+
+        const enum tbd_create_result create_version_result =
+            write_version_to_file(tbd,
+                                  version,
+                                  write_path,
+                                  write_path_length,
+                                  file);
+
+        handle_write_result(tbd,
+                            create_version_result,
+                            write_path,
+                            write_path_length,
+                            NULL,
+                            print_paths);
     }
 }
 
+/*
+ * Write out every tbd-version to stdout, one after the other.
+ */
+
+static enum tbd_create_result
+write_to_stdout(const struct tbd_for_main *__notnull const tbd) {
+    const uint32_t versions = tbd->versions;
+    if (versions == 0) {
+        return tbd_create_with_info(&tbd->info, stdout, tbd->write_options);
+    }
+
+    for (enum tbd_version version = TBD_VERSION_V1;
+         version <= TBD_VERSION_V5;
+         version++)
+    {
+        if (!(versions & (1u << version))) {
+            continue;
+        }
+
+        const enum tbd_create_result create_tbd_result =
+            tbd_create_with_info_for_version(&tbd->info,
+                                             version,
+                                             stdout,
+                                             tbd->write_options);
+
+        if (create_tbd_result != E_TBD_CREATE_OK) {
+            return create_tbd_result;
+        }
+    }
+
+    return E_TBD_CREATE_OK;
+}
+
+int
+tbd_for_main_write_combine_end(const struct tbd_for_main *__notnull const tbd,
+                               FILE *__notnull const file)
+{
+    if (tbd->options.archive_tbds) {
+        return tar_write_end(file);
+    }
+
+    return tbd_write_footer(file);
+}
+
 void
 tbd_for_main_write_to_stdout(const struct tbd_for_main *__notnull const tbd,
                              const char *__notnull const input_path,
                              const bool print_paths)
 {
-    const struct tbd_create_info *const create_info = &tbd->info;
-    const enum tbd_create_result create_tbd_result =
-        tbd_create_with_info(create_info, stdout, tbd->write_options);
+    const enum tbd_create_result create_tbd_result = write_to_stdout(tbd);
 
     if (create_tbd_result != E_TBD_CREATE_OK) {
         if (!tbd->options.ignore_warnings) {
@@ -904,9 +1682,7 @@ tbd_for_main_write_to_stdout_for_dsc_image(
     const char *__notnull const image_path,
     const bool print_paths)
 {
-    const struct tbd_create_info *const create_info = &tbd->info;
-    const enum tbd_create_result create_tbd_result =
-        tbd_create_with_info(create_info, stdout, tbd->write_options);
+    const enum tbd_create_result create_tbd_result = write_to_stdout(tbd);
 
     if (create_tbd_result != E_TBD_CREATE_OK) {
         if (!tbd->options.ignore_warnings) {
@@ -936,6 +1712,16 @@ void tbd_for_main_destroy(struct tbd_for_main *__notnull const tbd) {
     array_destroy(&tbd->dsc_image_filters);
     array_destroy(&tbd->dsc_image_numbers);
 
+    if (tbd->symbol_filter != NULL) {
+        symbol_filter_destroy(tbd->symbol_filter);
+        free(tbd->symbol_filter);
+
+        tbd->symbol_filter = NULL;
+    }
+
+    free(tbd->budget);
+    tbd->budget = NULL;
+
     free(tbd->parse_path);
     free(tbd->write_path);
 
@@ -0,0 +1,2196 @@
+//
+//  src/tbd_read.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "copy.h"
+#include "likely.h"
+#include "symbol_filter.h"
+#include "tbd_read.h"
+#include "yaml.h"
+
+enum tbd_file_open_result
+tbd_file_open(struct tbd_file *__notnull const file,
+              struct magic_buffer *__notnull const buffer,
+              const int fd)
+{
+    if (magic_buffer_read_n(buffer, fd, 3) != E_MAGIC_BUFFER_OK) {
+        return E_TBD_FILE_OPEN_READ_FAIL;
+    }
+
+    if (buffer->read < 3 || memcmp(buffer->buff, "---", 3) != 0) {
+        return E_TBD_FILE_OPEN_NOT_A_TBD;
+    }
+
+    struct stat sbuf = {};
+    if (fstat(fd, &sbuf) < 0) {
+        return E_TBD_FILE_OPEN_FSTAT_FAIL;
+    }
+
+    /*
+     * The tokenizer relies on a null-byte following the last character of the
+     * file. As the remainder of a mapping's last page is zero-filled, the file
+     * can be mapped unless it ends exactly on a page-boundary, in which case
+     * the file is instead read into a buffer one byte larger.
+     */
+
+    const uint64_t size = (uint64_t)sbuf.st_size;
+    const uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+
+    char *map = NULL;
+    if ((size % page_size) != 0) {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            return E_TBD_FILE_OPEN_MMAP_FAIL;
+        }
+    } else {
+        map = malloc(size + 1);
+        if (map == NULL) {
+            return E_TBD_FILE_OPEN_ALLOC_FAIL;
+        }
+
+        uint64_t offset = 0;
+        while (offset != size) {
+            const ssize_t read_size =
+                pread(fd, map + offset, size - offset, (off_t)offset);
+
+            if (read_size <= 0) {
+                free(map);
+                return E_TBD_FILE_OPEN_READ_FAIL;
+            }
+
+            offset += (uint64_t)read_size;
+        }
+
+        map[size] = '\0';
+        file->was_alloced = true;
+    }
+
+    file->map = map;
+    file->size = size;
+    file->iter = map;
+    file->line = 1;
+
+    return E_TBD_FILE_OPEN_OK;
+}
+
+struct read_info {
+    struct tbd_file *file;
+    struct tbd_create_info *info;
+    struct tbd_parse_options options;
+
+    /*
+     * The version of the document being read, which may differ from the
+     * create-info's version.
+     */
+
+    enum tbd_version version;
+
+    /*
+     * Up to tbd-version v3, targets are created with the platform only being
+     * set once the document has been read.
+     */
+
+    enum tbd_platform platform;
+
+    /*
+     * Targets can no longer be added once symbols or metadata have been added,
+     * as their target bit-lists are created with the target-count at the time.
+     */
+
+    bool targets_locked : 1;
+};
+
+static inline bool is_space(const char ch) {
+    return (ch == ' ' || ch == '\t' || ch == '\r');
+}
+
+static inline bool is_token_end(const char ch) {
+    return (is_space(ch) || ch == '\n' || ch == '\0');
+}
+
+static char *
+skip_line(struct tbd_file *__notnull const file, char *__notnull iter) {
+    while (*iter != '\n' && *iter != '\0') {
+        iter++;
+    }
+
+    if (*iter == '\n') {
+        iter++;
+        file->line++;
+    }
+
+    return iter;
+}
+
+/*
+ * Skip past empty lines and comments to the next line with content, and return
+ * a pointer to its first character, without consuming the line.
+ */
+
+static char *
+peek_line(struct tbd_file *__notnull const file,
+          uint64_t *__notnull const indent_out)
+{
+    char *iter = file->iter;
+    do {
+        char *const begin = iter;
+        while (*iter == ' ') {
+            iter++;
+        }
+
+        const char ch = *iter;
+        if (ch == '\n' || ch == '\r' || ch == '#') {
+            iter = skip_line(file, iter);
+            continue;
+        }
+
+        file->iter = begin;
+        *indent_out = (uint64_t)(iter - begin);
+
+        return iter;
+    } while (true);
+}
+
+static inline bool is_document_start(const char *__notnull const line) {
+    return (memcmp(line, "---", 3) == 0 && is_token_end(line[3]));
+}
+
+static inline bool is_document_end(const char *__notnull const line) {
+    return (memcmp(line, "...", 3) == 0 && is_token_end(line[3]));
+}
+
+static inline bool is_block_value(const char *__notnull const value) {
+    return (*value == '\n' || *value == '\0' || *value == '#');
+}
+
+/*
+ * Terminate the key at line, and return a pointer to its value, or NULL if the
+ * line is not a key.
+ */
+
+static char *
+parse_key(char *__notnull iter, const char **__notnull const key_out) {
+    const char *const key = iter;
+    for (;; iter++) {
+        const char ch = *iter;
+        if (ch == ':') {
+            if (is_token_end(iter[1])) {
+                break;
+            }
+        } else if (ch == '\n' || ch == '\0') {
+            return NULL;
+        }
+    }
+
+    *iter = '\0';
+    iter++;
+
+    while (is_space(*iter)) {
+        iter++;
+    }
+
+    *key_out = key;
+    return iter;
+}
+
+static inline char unescape_char(const char ch) {
+    switch (ch) {
+        case '"':
+        case '\\':
+        case '/':
+            return ch;
+
+        case 't':
+            return '\t';
+
+        default:
+            return '\0';
+    }
+}
+
+/*
+ * Unescape, in place, the quoted scalar whose opening quote is at begin, and
+ * return a pointer past its closing quote, or NULL if the scalar is invalid.
+ *
+ * Double-quoted scalars use backslash escapes, while single-quoted scalars
+ * only escape a quote by doubling it.
+ */
+
+static char *
+unquote_scalar(char *__notnull const begin, char **__notnull const end_out) {
+    const char quote = *begin;
+
+    char *iter = begin + 1;
+    char *out = iter;
+
+    for (;; iter++) {
+        char ch = *iter;
+        if (ch == '\n' || ch == '\0') {
+            return NULL;
+        }
+
+        if (ch == quote) {
+            if (quote != '\'' || iter[1] != '\'') {
+                break;
+            }
+
+            iter++;
+        } else if (ch == '\\' && quote == '"') {
+            iter++;
+            ch = unescape_char(*iter);
+
+            if (ch == '\0') {
+                return NULL;
+            }
+        }
+
+        *out = ch;
+        out++;
+    }
+
+    *end_out = out;
+    return iter + 1;
+}
+
+/*
+ * Skip the spaces and comment that may follow a quoted scalar.
+ */
+
+static char *skip_quoted_scalar_trailer(char *__notnull iter) {
+    const char *const begin = iter;
+    while (is_space(*iter)) {
+        iter++;
+    }
+
+    if (*iter == '#' && iter != begin) {
+        while (*iter != '\n' && *iter != '\0') {
+            iter++;
+        }
+    }
+
+    return iter;
+}
+
+/*
+ * Read the scalar at value, and move on to the line following it.
+ */
+
+static enum tbd_file_read_result
+read_scalar(struct tbd_file *__notnull const file,
+            char *__notnull const value,
+            char **__notnull const string_out,
+            uint64_t *__notnull const length_out)
+{
+    if (is_block_value(value)) {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    char *begin = value;
+    char *end = NULL;
+    char *iter = value;
+
+    if (*value == '\'' || *value == '"') {
+        begin = value + 1;
+        iter = unquote_scalar(value, &end);
+
+        if (iter == NULL) {
+            return E_TBD_FILE_READ_INVALID_SYNTAX;
+        }
+
+        iter = skip_quoted_scalar_trailer(iter);
+        if (*iter != '\n' && *iter != '\0') {
+            return E_TBD_FILE_READ_INVALID_SYNTAX;
+        }
+    } else {
+        for (; *iter != '\n' && *iter != '\0'; iter++) {
+            if (*iter == '#' && is_space(iter[-1])) {
+                break;
+            }
+        }
+
+        end = iter;
+        while (is_space(end[-1])) {
+            end--;
+        }
+    }
+
+    /*
+     * Move on to the next line before terminating the scalar, as the newline
+     * may be overwritten.
+     */
+
+    file->iter = skip_line(file, iter);
+    *end = '\0';
+
+    *string_out = begin;
+    *length_out = (uint64_t)(end - begin);
+
+    return E_TBD_FILE_READ_OK;
+}
+
+struct flow_seq {
+    char *iter;
+    bool ended : 1;
+};
+
+enum next_flow_item_result {
+    E_NEXT_FLOW_ITEM_OK,
+    E_NEXT_FLOW_ITEM_END,
+    E_NEXT_FLOW_ITEM_INVALID
+};
+
+static enum tbd_file_read_result
+begin_flow_seq(char *__notnull const value, struct flow_seq *__notnull seq) {
+    if (*value != '[') {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    seq->iter = value + 1;
+    seq->ended = false;
+
+    return E_TBD_FILE_READ_OK;
+}
+
+static inline void
+end_flow_seq(struct tbd_file *__notnull const file,
+             const struct flow_seq *__notnull const seq)
+{
+    file->iter = skip_line(file, seq->iter);
+}
+
+/*
+ * Flow-sequences may span multiple lines, and are read one item at a time.
+ *
+ * As an item is terminated with a null-byte written over the delimiter after
+ * it, we have to remember if the delimiter was the sequence's end.
+ */
+
+static enum next_flow_item_result
+next_flow_item(struct tbd_file *__notnull const file,
+               struct flow_seq *__notnull const seq,
+               char **__notnull const string_out,
+               uint64_t *__notnull const length_out)
+{
+    if (seq->ended) {
+        return E_NEXT_FLOW_ITEM_END;
+    }
+
+    char *iter = seq->iter;
+    for (;; iter++) {
+        const char ch = *iter;
+        if (ch == '\n') {
+            file->line++;
+            continue;
+        }
+
+        if (!is_space(ch) && ch != ',') {
+            break;
+        }
+    }
+
+    switch (*iter) {
+        case ']':
+            seq->iter = iter + 1;
+            seq->ended = true;
+
+            return E_NEXT_FLOW_ITEM_END;
+
+        case '\0':
+            return E_NEXT_FLOW_ITEM_INVALID;
+
+        default:
+            break;
+    }
+
+    char *begin = iter;
+    char *end = NULL;
+
+    if (*iter == '\'' || *iter == '"') {
+        begin = iter + 1;
+        iter = unquote_scalar(iter, &end);
+
+        if (iter == NULL) {
+            return E_NEXT_FLOW_ITEM_INVALID;
+        }
+
+        /*
+         * Leave the delimiter after the item to be skipped by the next call.
+         */
+
+        iter = skip_quoted_scalar_trailer(iter);
+        if (*iter != ',' && *iter != ']' && *iter != '\n') {
+            return E_NEXT_FLOW_ITEM_INVALID;
+        }
+    } else {
+        for (;; iter++) {
+            const char ch = *iter;
+            if (ch == ',' || ch == ']' || ch == '\n' || ch == '\0') {
+                break;
+            }
+        }
+
+        end = iter;
+        while (is_space(end[-1])) {
+            end--;
+        }
+
+        if (end == iter) {
+            switch (*iter) {
+                case ']':
+                    seq->ended = true;
+                    break;
+
+                case '\n':
+                    file->line++;
+                    break;
+
+                case '\0':
+                    return E_NEXT_FLOW_ITEM_INVALID;
+
+                default:
+                    break;
+            }
+
+            iter++;
+        }
+    }
+
+    *end = '\0';
+    seq->iter = iter;
+
+    *string_out = begin;
+    *length_out = (uint64_t)(end - begin);
+
+    return E_NEXT_FLOW_ITEM_OK;
+}
+
+/*
+ * Skip the value of an unknown key, which may be a scalar, a flow-sequence, or
+ * a block of lines indented further than the key.
+ */
+
+static enum tbd_file_read_result
+skip_value(struct tbd_file *__notnull const file,
+           char *__notnull const value,
+           const uint64_t key_indent)
+{
+    if (*value == '[') {
+        struct flow_seq seq = {};
+        begin_flow_seq(value, &seq);
+
+        char *string = NULL;
+        uint64_t length = 0;
+
+        enum next_flow_item_result next_result = E_NEXT_FLOW_ITEM_OK;
+        do {
+            next_result = next_flow_item(file, &seq, &string, &length);
+        } while (next_result == E_NEXT_FLOW_ITEM_OK);
+
+        if (next_result == E_NEXT_FLOW_ITEM_INVALID) {
+            return E_TBD_FILE_READ_INVALID_SYNTAX;
+        }
+
+        end_flow_seq(file, &seq);
+        return E_TBD_FILE_READ_OK;
+    }
+
+    if (!is_block_value(value)) {
+        char *string = NULL;
+        uint64_t length = 0;
+
+        return read_scalar(file, value, &string, &length);
+    }
+
+    file->iter = skip_line(file, value);
+    do {
+        uint64_t indent = 0;
+        char *const line = peek_line(file, &indent);
+
+        if (*line == '\0') {
+            break;
+        }
+
+        if (indent < key_indent) {
+            break;
+        }
+
+        if (indent == key_indent) {
+            if (line[0] != '-' || !is_token_end(line[1])) {
+                break;
+            }
+        }
+
+        file->iter = skip_line(file, line);
+    } while (true);
+
+    return E_TBD_FILE_READ_OK;
+}
+
+/*
+ * Block-sequences of mappings, such as the export-groups, are read one item
+ * (and one key of the item) at a time.
+ */
+
+struct block_item {
+    char *first_line;
+    uint64_t indent;
+};
+
+static bool
+next_block_item(struct tbd_file *__notnull const file,
+                struct block_item *__notnull const item)
+{
+    uint64_t indent = 0;
+    char *const line = peek_line(file, &indent);
+
+    if (line[0] != '-' || !is_space(line[1])) {
+        return false;
+    }
+
+    char *iter = line + 1;
+    while (is_space(*iter)) {
+        iter++;
+    }
+
+    item->first_line = iter;
+    item->indent = indent + (uint64_t)(iter - line);
+
+    return true;
+}
+
+static char *
+next_item_line(struct tbd_file *__notnull const file,
+               struct block_item *__notnull const item)
+{
+    char *const first_line = item->first_line;
+    if (first_line != NULL) {
+        item->first_line = NULL;
+        return first_line;
+    }
+
+    uint64_t indent = 0;
+    char *const line = peek_line(file, &indent);
+
+    if (*line == '\0' || indent != item->indent) {
+        return NULL;
+    }
+
+    return line;
+}
+
+static enum tbd_platform parse_platform(const char *__notnull const string) {
+    for (enum tbd_platform platform = TBD_PLATFORM_MACOS;
+         platform <= TBD_PLATFORM_DRIVERKIT;
+         platform++)
+    {
+        const char *const v3_str =
+            tbd_platform_to_string(platform, TBD_VERSION_V3);
+
+        if (strcmp(string, v3_str) == 0) {
+            return platform;
+        }
+
+        const char *const v4_str =
+            tbd_platform_to_string(platform, TBD_VERSION_V4);
+
+        if (strcmp(string, v4_str) == 0) {
+            return platform;
+        }
+    }
+
+    return TBD_PLATFORM_NONE;
+}
+
+/*
+ * Targets are written as <arch>-<platform>, and as no arch has a dash in its
+ * name, the first dash separates the two.
+ */
+
+static enum tbd_file_read_result
+parse_target(char *__notnull const string,
+             const struct arch_info **__notnull const arch_out,
+             enum tbd_platform *__notnull const platform_out)
+{
+    char *const dash = strchr(string, '-');
+    if (dash == NULL) {
+        return E_TBD_FILE_READ_INVALID_TARGET;
+    }
+
+    *dash = '\0';
+
+    const struct arch_info *const arch = arch_info_for_name(string);
+    if (arch == NULL) {
+        return E_TBD_FILE_READ_INVALID_ARCH;
+    }
+
+    const enum tbd_platform platform = parse_platform(dash + 1);
+    if (platform == TBD_PLATFORM_NONE) {
+        return E_TBD_FILE_READ_INVALID_PLATFORM;
+    }
+
+    *arch_out = arch;
+    *platform_out = platform;
+
+    return E_TBD_FILE_READ_OK;
+}
+
+static inline int hex_value(const char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+
+    return -1;
+}
+
+static enum tbd_file_read_result
+parse_uuid(const char *__notnull iter, uint8_t uuid[const 16]) {
+    uint64_t index = 0;
+    for (; *iter != '\0'; iter++) {
+        if (*iter == '-') {
+            continue;
+        }
+
+        const int high = hex_value(iter[0]);
+        const int low = hex_value(iter[1]);
+
+        if (high < 0 || low < 0 || index == 16) {
+            return E_TBD_FILE_READ_INVALID_UUID;
+        }
+
+        uuid[index] = (uint8_t)((high << 4) | low);
+
+        index++;
+        iter++;
+    }
+
+    if (index != 16) {
+        return E_TBD_FILE_READ_INVALID_UUID;
+    }
+
+    return E_TBD_FILE_READ_OK;
+}
+
+static bool
+parse_number(const char **__notnull const iter_in,
+             const uint32_t max,
+             uint32_t *__notnull const number_out)
+{
+    const char *iter = *iter_in;
+    if (*iter < '0' || *iter > '9') {
+        return false;
+    }
+
+    uint32_t number = 0;
+    for (; *iter >= '0' && *iter <= '9'; iter++) {
+        number = (number * 10) + (uint32_t)(*iter - '0');
+        if (number > max) {
+            return false;
+        }
+    }
+
+    *iter_in = iter;
+    *number_out = number;
+
+    return true;
+}
+
+/*
+ * Versions are written as major[.minor[.revision]], and are packed as
+ * xxxx.yy.zz.
+ */
+
+static enum tbd_file_read_result
+parse_packed_version(const char *__notnull iter,
+                     uint32_t *__notnull const out)
+{
+    uint32_t major = 0;
+    uint32_t minor = 0;
+    uint32_t revision = 0;
+
+    if (!parse_number(&iter, UINT16_MAX, &major)) {
+        return E_TBD_FILE_READ_INVALID_VERSION;
+    }
+
+    if (*iter == '.') {
+        iter++;
+        if (!parse_number(&iter, UINT8_MAX, &minor)) {
+            return E_TBD_FILE_READ_INVALID_VERSION;
+        }
+
+        if (*iter == '.') {
+            iter++;
+            if (!parse_number(&iter, UINT8_MAX, &revision)) {
+                return E_TBD_FILE_READ_INVALID_VERSION;
+            }
+        }
+    }
+
+    if (*iter != '\0') {
+        return E_TBD_FILE_READ_INVALID_VERSION;
+    }
+
+    *out = (major << 16) | (minor << 8) | revision;
+    return E_TBD_FILE_READ_OK;
+}
+
+/*
+ * The inverse of tbd_write_swift_version(), where swift-version 1 is written as
+ * "1", 2 as "1.2", and every later version as one less than itself.
+ */
+
+static enum tbd_file_read_result
+parse_swift_version(const char *__notnull iter, uint32_t *__notnull const out) {
+    uint32_t major = 0;
+    uint32_t minor = 0;
+
+    if (!parse_number(&iter, UINT32_MAX - 1, &major)) {
+        return E_TBD_FILE_READ_INVALID_VERSION;
+    }
+
+    if (*iter == '.') {
+        iter++;
+        if (!parse_number(&iter, UINT8_MAX, &minor)) {
+            return E_TBD_FILE_READ_INVALID_VERSION;
+        }
+    }
+
+    if (*iter != '\0') {
+        return E_TBD_FILE_READ_INVALID_VERSION;
+    }
+
+    if (major == 1) {
+        switch (minor) {
+            case 0:
+                *out = 1;
+                return E_TBD_FILE_READ_OK;
+
+            case 2:
+                *out = 2;
+                return E_TBD_FILE_READ_OK;
+
+            default:
+                return E_TBD_FILE_READ_INVALID_VERSION;
+        }
+    }
+
+    if (major == 0 || minor != 0) {
+        return E_TBD_FILE_READ_INVALID_VERSION;
+    }
+
+    *out = major + 1;
+    return E_TBD_FILE_READ_OK;
+}
+
+static enum tbd_objc_constraint
+parse_objc_constraint(const char *__notnull const string) {
+    if (strcmp(string, "none") == 0) {
+        return TBD_OBJC_CONSTRAINT_NONE;
+    } else if (strcmp(string, "gc") == 0) {
+        return TBD_OBJC_CONSTRAINT_GC;
+    } else if (strcmp(string, "retain_release") == 0) {
+        return TBD_OBJC_CONSTRAINT_RETAIN_RELEASE;
+    } else if (strcmp(string, "retain_release_or_gc") == 0) {
+        return TBD_OBJC_CONSTRAINT_RETAIN_RELEASE_OR_GC;
+    } else if (strcmp(string, "retain_release_for_simulator") == 0) {
+        return TBD_OBJC_CONSTRAINT_RETAIN_RELEASE_FOR_SIMULATOR;
+    }
+
+    return TBD_OBJC_CONSTRAINT_NO_VALUE;
+}
+
+static uint64_t
+find_target_index(const struct target_list *__notnull const list,
+                  const struct arch_info *__notnull const arch,
+                  const enum tbd_platform platform,
+                  const bool match_platform)
+{
+    const uint64_t count = list->set_count;
+    for (uint64_t i = 0; i != count; i++) {
+        const struct arch_info *target_arch = NULL;
+        enum tbd_platform target_platform = TBD_PLATFORM_NONE;
+
+        target_list_get_target(list, i, &target_arch, &target_platform);
+        if (target_arch != arch) {
+            continue;
+        }
+
+        if (match_platform && target_platform != platform) {
+            continue;
+        }
+
+        return i;
+    }
+
+    return UINT64_MAX;
+}
+
+static enum tbd_file_read_result
+translate_add_data_result(const enum tbd_ci_add_data_result result) {
+    switch (result) {
+        case E_TBD_CI_ADD_DATA_OK:
+            break;
+
+        case E_TBD_CI_ADD_DATA_ALLOC_FAIL:
+            return E_TBD_FILE_READ_ALLOC_FAIL;
+
+        case E_TBD_CI_ADD_DATA_ARRAY_FAIL:
+            return E_TBD_FILE_READ_ARRAY_FAIL;
+    }
+
+    return E_TBD_FILE_READ_OK;
+}
+
+/*
+ * Symbols and metadata can only be added once the targets they're indexed
+ * against are known.
+ */
+
+static enum tbd_file_read_result
+lock_targets(struct read_info *__notnull const read_info) {
+    if (!read_info->options.ignore_targets) {
+        if (read_info->info->fields.targets.set_count == 0) {
+            return E_TBD_FILE_READ_MISSING_TARGETS;
+        }
+    }
+
+    read_info->targets_locked = true;
+    return E_TBD_FILE_READ_OK;
+}
+
+static enum tbd_file_read_result
+read_archs(struct read_info *__notnull const read_info, char *__notnull value) {
+    struct tbd_file *const file = read_info->file;
+    if (read_info->targets_locked) {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    struct flow_seq seq = {};
+    const enum tbd_file_read_result begin_result = begin_flow_seq(value, &seq);
+
+    if (begin_result != E_TBD_FILE_READ_OK) {
+        return begin_result;
+    }
+
+    struct target_list *const targets = &read_info->info->fields.targets;
+
+    char *string = NULL;
+    uint64_t length = 0;
+
+    enum next_flow_item_result next_result = E_NEXT_FLOW_ITEM_OK;
+    while ((next_result = next_flow_item(file, &seq, &string, &length)) ==
+           E_NEXT_FLOW_ITEM_OK)
+    {
+        const struct arch_info *const arch = arch_info_for_name(string);
+        if (arch == NULL) {
+            return E_TBD_FILE_READ_INVALID_ARCH;
+        }
+
+        if (target_list_has_arch(targets, arch)) {
+            continue;
+        }
+
+        const enum target_list_result add_target_result =
+            target_list_add_target(targets, arch, TBD_PLATFORM_NONE);
+
+        if (add_target_result != E_TARGET_LIST_OK) {
+            return E_TBD_FILE_READ_ALLOC_FAIL;
+        }
+    }
+
+    if (next_result == E_NEXT_FLOW_ITEM_INVALID) {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    end_flow_seq(file, &seq);
+    return E_TBD_FILE_READ_OK;
+}
+
+static enum tbd_file_read_result
+read_targets(struct read_info *__notnull const read_info, char *__notnull value)
+{
+    struct tbd_file *const file = read_info->file;
+    if (read_info->targets_locked) {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    struct flow_seq seq = {};
+    const enum tbd_file_read_result begin_result = begin_flow_seq(value, &seq);
+
+    if (begin_result != E_TBD_FILE_READ_OK) {
+        return begin_result;
+    }
+
+    struct target_list *const targets = &read_info->info->fields.targets;
+
+    char *string = NULL;
+    uint64_t length = 0;
+
+    enum next_flow_item_result next_result = E_NEXT_FLOW_ITEM_OK;
+    while ((next_result = next_flow_item(file, &seq, &string, &length)) ==
+           E_NEXT_FLOW_ITEM_OK)
+    {
+        const struct arch_info *arch = NULL;
+        enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+        const enum tbd_file_read_result parse_target_result =
+            parse_target(string, &arch, &platform);
+
+        if (parse_target_result != E_TBD_FILE_READ_OK) {
+            return parse_target_result;
+        }
+
+        if (target_list_has_target(targets, arch, platform)) {
+            continue;
+        }
+
+        const enum target_list_result add_target_result =
+            target_list_add_target(targets, arch, platform);
+
+        if (add_target_result != E_TARGET_LIST_OK) {
+            return E_TBD_FILE_READ_ALLOC_FAIL;
+        }
+    }
+
+    if (next_result == E_NEXT_FLOW_ITEM_INVALID) {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    end_flow_seq(file, &seq);
+    return E_TBD_FILE_READ_OK;
+}
+
+/*
+ * When the targets are replaced, the platform of the document's targets still
+ * replaces the platform of the provided targets, unless also ignored.
+ */
+
+static enum tbd_file_read_result
+read_platform_of_targets(struct read_info *__notnull const read_info,
+                         char *__notnull value)
+{
+    struct tbd_file *const file = read_info->file;
+
+    struct flow_seq seq = {};
+    const enum tbd_file_read_result begin_result = begin_flow_seq(value, &seq);
+
+    if (begin_result != E_TBD_FILE_READ_OK) {
+        return begin_result;
+    }
+
+    char *string = NULL;
+    uint64_t length = 0;
+
+    enum next_flow_item_result next_result = E_NEXT_FLOW_ITEM_OK;
+    while ((next_result = next_flow_item(file, &seq, &string, &length)) ==
+           E_NEXT_FLOW_ITEM_OK)
+    {
+        if (read_info->platform != TBD_PLATFORM_NONE) {
+            continue;
+        }
+
+        const struct arch_info *arch = NULL;
+        enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+        const enum tbd_file_read_result parse_target_result =
+            parse_target(string, &arch, &platform);
+
+        if (parse_target_result != E_TBD_FILE_READ_OK) {
+            return parse_target_result;
+        }
+
+        read_info->platform = platform;
+    }
+
+    if (next_result == E_NEXT_FLOW_ITEM_INVALID) {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    end_flow_seq(file, &seq);
+    return E_TBD_FILE_READ_OK;
+}
+
+static enum tbd_file_read_result
+add_uuid(struct read_info *__notnull const read_info,
+         const struct arch_info *__notnull const arch,
+         const enum tbd_platform platform,
+         const uint8_t uuid[const 16])
+{
+    const enum tbd_ci_add_uuid_result add_uuid_result =
+        tbd_ci_add_uuid(read_info->info, arch, platform, uuid);
+
+    switch (add_uuid_result) {
+        case E_TBD_CI_ADD_UUID_OK:
+            break;
+
+        case E_TBD_CI_ADD_UUID_ARRAY_FAIL:
+            return E_TBD_FILE_READ_ARRAY_FAIL;
+
+        case E_TBD_CI_ADD_UUID_NON_UNIQUE_UUID:
+            if (read_info->options.ignore_non_unique_uuids) {
+                break;
+            }
+
+            return E_TBD_FILE_READ_NON_UNIQUE_UUID;
+    }
+
+    return E_TBD_FILE_READ_OK;
+}
+
+/*
+ * Up to tbd-version v3, uuids are written as a flow-sequence of
+ * '<arch>: <uuid>' pairs.
+ */
+
+static enum tbd_file_read_result
+read_uuids_for_archs(struct read_info *__notnull const read_info,
+                     char *__notnull const value)
+{
+    struct tbd_file *const file = read_info->file;
+
+    struct flow_seq seq = {};
+    begin_flow_seq(value, &seq);
+
+    char *string = NULL;
+    uint64_t length = 0;
+
+    enum next_flow_item_result next_result = E_NEXT_FLOW_ITEM_OK;
+    while ((next_result = next_flow_item(file, &seq, &string, &length)) ==
+           E_NEXT_FLOW_ITEM_OK)
+    {
+        char *const colon = strchr(string, ':');
+        if (colon == NULL) {
+            return E_TBD_FILE_READ_INVALID_UUID;
+        }
+
+        *colon = '\0';
+
+        const struct arch_info *const arch = arch_info_for_name(string);
+        if (arch == NULL) {
+            return E_TBD_FILE_READ_INVALID_ARCH;
+        }
+
+        const char *uuid_str = colon + 1;
+        while (is_space(*uuid_str)) {
+            uuid_str++;
+        }
+
+        uint8_t uuid[16] = {};
+        const enum tbd_file_read_result parse_uuid_result =
+            parse_uuid(uuid_str, uuid);
+
+        if (parse_uuid_result != E_TBD_FILE_READ_OK) {
+            return parse_uuid_result;
+        }
+
+        const enum tbd_file_read_result add_uuid_result =
+            add_uuid(read_info, arch, TBD_PLATFORM_NONE, uuid);
+
+        if (add_uuid_result != E_TBD_FILE_READ_OK) {
+            return add_uuid_result;
+        }
+    }
+
+    if (next_result == E_NEXT_FLOW_ITEM_INVALID) {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    end_flow_seq(file, &seq);
+    return E_TBD_FILE_READ_OK;
+}
+
+/*
+ * Starting from tbd-version v4, uuids are written as a block-sequence of
+ * target and value pairs.
+ */
+
+static enum tbd_file_read_result
+read_uuids_for_targets(struct read_info *__notnull const read_info,
+                       char *__notnull const value)
+{
+    struct tbd_file *const file = read_info->file;
+    file->iter = skip_line(file, value);
+
+    struct block_item item = {};
+    while (next_block_item(file, &item)) {
+        const struct arch_info *arch = NULL;
+        enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+        uint8_t uuid[16] = {};
+        bool found_uuid = false;
+
+        char *line = NULL;
+        while ((line = next_item_line(file, &item)) != NULL) {
+            const char *key = NULL;
+            char *const item_value = parse_key(line, &key);
+
+            if (item_value == NULL) {
+                return E_TBD_FILE_READ_INVALID_SYNTAX;
+            }
+
+            const bool is_target = (strcmp(key, "target") == 0);
+            if (!is_target && strcmp(key, "value") != 0) {
+                const enum tbd_file_read_result skip_result =
+                    skip_value(file, item_value, item.indent);
+
+                if (skip_result != E_TBD_FILE_READ_OK) {
+                    return skip_result;
+                }
+
+                continue;
+            }
+
+            char *string = NULL;
+            uint64_t length = 0;
+
+            const enum tbd_file_read_result read_result =
+                read_scalar(file, item_value, &string, &length);
+
+            if (read_result != E_TBD_FILE_READ_OK) {
+                return read_result;
+            }
+
+            enum tbd_file_read_result parse_result = E_TBD_FILE_READ_OK;
+            if (is_target) {
+                parse_result = parse_target(string, &arch, &platform);
+            } else {
+                parse_result = parse_uuid(string, uuid);
+                found_uuid = true;
+            }
+
+            if (parse_result != E_TBD_FILE_READ_OK) {
+                return parse_result;
+            }
+        }
+
+        if (arch == NULL || !found_uuid) {
+            return E_TBD_FILE_READ_INVALID_UUID;
+        }
+
+        const enum tbd_file_read_result add_uuid_result =
+            add_uuid(read_info, arch, platform, uuid);
+
+        if (add_uuid_result != E_TBD_FILE_READ_OK) {
+            return add_uuid_result;
+        }
+    }
+
+    return E_TBD_FILE_READ_OK;
+}
+
+static enum tbd_file_read_result
+read_flags(struct read_info *__notnull const read_info, char *__notnull value) {
+    struct tbd_file *const file = read_info->file;
+
+    struct flow_seq seq = {};
+    const enum tbd_file_read_result begin_result = begin_flow_seq(value, &seq);
+
+    if (begin_result != E_TBD_FILE_READ_OK) {
+        return begin_result;
+    }
+
+    struct tbd_flags *const flags = &read_info->info->fields.flags;
+
+    char *string = NULL;
+    uint64_t length = 0;
+
+    enum next_flow_item_result next_result = E_NEXT_FLOW_ITEM_OK;
+    while ((next_result = next_flow_item(file, &seq, &string, &length)) ==
+           E_NEXT_FLOW_ITEM_OK)
+    {
+        if (strcmp(string, "flat_namespace") == 0) {
+            flags->flat_namespace = true;
+        } else if (strcmp(string, "not_app_extension_safe") == 0) {
+            flags->not_app_extension_safe = true;
+        }
+    }
+
+    if (next_result == E_NEXT_FLOW_ITEM_INVALID) {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    end_flow_seq(file, &seq);
+    return E_TBD_FILE_READ_OK;
+}
+
+static enum tbd_file_read_result
+read_install_name(struct read_info *__notnull const read_info,
+                  char *__notnull const value)
+{
+    char *string = NULL;
+    uint64_t length = 0;
+
+    const enum tbd_file_read_result read_result =
+        read_scalar(read_info->file, value, &string, &length);
+
+    if (read_result != E_TBD_FILE_READ_OK) {
+        return read_result;
+    }
+
+    struct tbd_create_info *const info = read_info->info;
+    if (info->flags.install_name_was_allocated) {
+        free((char *)info->fields.install_name);
+        info->flags.install_name_was_allocated = false;
+    }
+
+    if (read_info->file->copy_strings) {
+        string = alloc_and_copy(string, length);
+        if (string == NULL) {
+            return E_TBD_FILE_READ_ALLOC_FAIL;
+        }
+
+        info->flags.install_name_was_allocated = true;
+    }
+
+    info->fields.install_name = string;
+    info->fields.install_name_length = length;
+    info->flags.install_name_needs_quotes =
+        yaml_c_str_needs_quotes(string, length);
+
+    return E_TBD_FILE_READ_OK;
+}
+
+/*
+ * Strings created by the reader are kept alive for as long as the file, just
+ * like the strings borrowed from the mapping.
+ */
+
+static enum tbd_file_read_result
+create_prefixed_string(struct tbd_file *__notnull const file,
+                       const char *__notnull const prefix,
+                       const uint64_t prefix_length,
+                       const char *__notnull const string,
+                       const uint64_t length,
+                       const char **__notnull const string_out)
+{
+    char *const result = malloc(prefix_length + length + 1);
+    if (result == NULL) {
+        return E_TBD_FILE_READ_ALLOC_FAIL;
+    }
+
+    memcpy(result, prefix, prefix_length);
+    memcpy(result + prefix_length, string, length);
+
+    result[prefix_length + length] = '\0';
+
+    const enum array_result add_string_result =
+        array_add_item(&file->strings, sizeof(result), &result, NULL);
+
+    if (add_string_result != E_ARRAY_OK) {
+        free(result);
+        return E_TBD_FILE_READ_ARRAY_FAIL;
+    }
+
+    *string_out = result;
+    return E_TBD_FILE_READ_OK;
+}
+
+static enum tbd_file_read_result
+add_symbol(struct read_info *__notnull const read_info,
+           const char *__notnull const string,
+           const uint64_t length,
+           const enum tbd_symbol_type type,
+           const enum tbd_symbol_meta_type meta_type)
+{
+    /*
+     * Symbols without a type are filtered when added below, but symbols with a
+     * type skip that path, and so are filtered here.
+     */
+
+    const struct symbol_filter *const filter = read_info->info->symbol_filter;
+    if (filter != NULL) {
+        switch (type) {
+            case TBD_SYMBOL_TYPE_NONE:
+            case TBD_SYMBOL_TYPE_CLIENT:
+            case TBD_SYMBOL_TYPE_REEXPORT:
+                break;
+
+            default:
+                if (!symbol_filter_matches(filter, string, length)) {
+                    return E_TBD_FILE_READ_OK;
+                }
+
+                break;
+        }
+    }
+
+    const struct array *const item_targets = &read_info->file->item_targets;
+
+    const uint64_t *index = item_targets->data;
+    const uint64_t *const end = item_targets->data_end;
+
+    for (; index != end; index++) {
+        enum tbd_ci_add_data_result add_symbol_result = E_TBD_CI_ADD_DATA_OK;
+        if (type == TBD_SYMBOL_TYPE_NONE) {
+            add_symbol_result =
+                tbd_ci_add_symbol_with_info_and_len(read_info->info,
+                                                    string,
+                                                    length,
+                                                    *index,
+                                                    TBD_SYMBOL_TYPE_NONE,
+                                                    meta_type,
+                                                    true,
+                                                    read_info->options);
+        } else {
+            add_symbol_result =
+                tbd_ci_add_symbol_with_type(read_info->info,
+                                            string,
+                                            length,
+                                            *index,
+                                            type,
+                                            meta_type,
+                                            read_info->options);
+        }
+
+        if (add_symbol_result != E_TBD_CI_ADD_DATA_OK) {
+            return translate_add_data_result(add_symbol_result);
+        }
+    }
+
+    return E_TBD_FILE_READ_OK;
+}
+
+/*
+ * Objc class and ivar names are prefixed with an underscore up to tbd-version
+ * v2, and objc eh-types are only separated from the other symbols starting
+ * from tbd-version v3, so the names may have to be converted between the
+ * document's version and the create-info's version.
+ */
+
+static enum tbd_file_read_result
+add_objc_symbol(struct read_info *__notnull const read_info,
+                const char *__notnull string,
+                uint64_t length,
+                enum tbd_symbol_type type,
+                const enum tbd_symbol_meta_type meta_type)
+{
+    const bool from_v3_names = (read_info->version > TBD_VERSION_V2);
+    const bool to_v3_names = (read_info->info->version > TBD_VERSION_V2);
+
+    if (type == TBD_SYMBOL_TYPE_OBJC_EHTYPE) {
+        if (!to_v3_names) {
+            const enum tbd_file_read_result create_result =
+                create_prefixed_string(read_info->file,
+                                       "_OBJC_EHTYPE_$_",
+                                       15,
+                                       string,
+                                       length,
+                                       &string);
+
+            if (create_result != E_TBD_FILE_READ_OK) {
+                return create_result;
+            }
+
+            length += 15;
+            type = TBD_SYMBOL_TYPE_NORMAL;
+        }
+    } else if (from_v3_names != to_v3_names) {
+        if (to_v3_names) {
+            if (string[0] == '_') {
+                string += 1;
+                length -= 1;
+            }
+        } else {
+            const enum tbd_file_read_result create_result =
+                create_prefixed_string(read_info->file,
+                                       "_",
+                                       1,
+                                       string,
+                                       length,
+                                       &string);
+
+            if (create_result != E_TBD_FILE_READ_OK) {
+                return create_result;
+            }
+
+            length += 1;
+        }
+    }
+
+    if (length == 0) {
+        return E_TBD_FILE_READ_OK;
+    }
+
+    return add_symbol(read_info, string, length, type, meta_type);
+}
+
+static enum tbd_file_read_result
+read_symbol_list(struct read_info *__notnull const read_info,
+                 char *__notnull const value,
+                 const enum tbd_symbol_type type,
+                 const enum tbd_symbol_meta_type meta_type)
+{
+    struct tbd_file *const file = read_info->file;
+
+    struct flow_seq seq = {};
+    const enum tbd_file_read_result begin_result = begin_flow_seq(value, &seq);
+
+    if (begin_result != E_TBD_FILE_READ_OK) {
+        return begin_result;
+    }
+
+    char *string = NULL;
+    uint64_t length = 0;
+
+    enum next_flow_item_result next_result = E_NEXT_FLOW_ITEM_OK;
+    while ((next_result = next_flow_item(file, &seq, &string, &length)) ==
+           E_NEXT_FLOW_ITEM_OK)
+    {
+        if (length == 0) {
+            continue;
+        }
+
+        enum tbd_file_read_result add_result = E_TBD_FILE_READ_OK;
+        switch (type) {
+            case TBD_SYMBOL_TYPE_OBJC_CLASS:
+            case TBD_SYMBOL_TYPE_OBJC_EHTYPE:
+            case TBD_SYMBOL_TYPE_OBJC_IVAR:
+                add_result =
+                    add_objc_symbol(read_info, string, length, type, meta_type);
+
+                break;
+
+            default:
+                add_result =
+                    add_symbol(read_info, string, length, type, meta_type);
+
+                break;
+        }
+
+        if (add_result != E_TBD_FILE_READ_OK) {
+            return add_result;
+        }
+    }
+
+    if (next_result == E_NEXT_FLOW_ITEM_INVALID) {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    end_flow_seq(file, &seq);
+    return E_TBD_FILE_READ_OK;
+}
+
+/*
+ * Read the archs (up to tbd-version v3) or targets of an export-group or
+ * metadata-group into file->item_targets, as indices into the create-info's
+ * target-list.
+ */
+
+static enum tbd_file_read_result
+read_item_targets(struct read_info *__notnull const read_info,
+                  char *__notnull const value,
+                  const bool is_archs)
+{
+    struct tbd_file *const file = read_info->file;
+    struct array *const item_targets = &file->item_targets;
+
+    array_clear(item_targets);
+
+    /*
+     * When targets are ignored, every symbol is added once, for all targets.
+     */
+
+    if (read_info->options.ignore_targets) {
+        const uint64_t index = 0;
+        const enum array_result add_index_result =
+            array_add_item(item_targets, sizeof(index), &index, NULL);
+
+        if (add_index_result != E_ARRAY_OK) {
+            return E_TBD_FILE_READ_ARRAY_FAIL;
+        }
+
+        return skip_value(file, value, 0);
+    }
+
+    struct flow_seq seq = {};
+    const enum tbd_file_read_result begin_result = begin_flow_seq(value, &seq);
+
+    if (begin_result != E_TBD_FILE_READ_OK) {
+        return begin_result;
+    }
+
+    const struct target_list *const targets =
+        &read_info->info->fields.targets;
+
+    char *string = NULL;
+    uint64_t length = 0;
+
+    enum next_flow_item_result next_result = E_NEXT_FLOW_ITEM_OK;
+    while ((next_result = next_flow_item(file, &seq, &string, &length)) ==
+           E_NEXT_FLOW_ITEM_OK)
+    {
+        const struct arch_info *arch = NULL;
+        enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+        if (is_archs) {
+            arch = arch_info_for_name(string);
+            if (arch == NULL) {
+                return E_TBD_FILE_READ_INVALID_ARCH;
+            }
+        } else {
+            const enum tbd_file_read_result parse_target_result =
+                parse_target(string, &arch, &platform);
+
+            if (parse_target_result != E_TBD_FILE_READ_OK) {
+                return parse_target_result;
+            }
+        }
+
+        const uint64_t index =
+            find_target_index(targets, arch, platform, !is_archs);
+
+        if (index == UINT64_MAX) {
+            return E_TBD_FILE_READ_INVALID_TARGET;
+        }
+
+        const enum array_result add_index_result =
+            array_add_item(item_targets, sizeof(index), &index, NULL);
+
+        if (add_index_result != E_ARRAY_OK) {
+            return E_TBD_FILE_READ_ARRAY_FAIL;
+        }
+    }
+
+    if (next_result == E_NEXT_FLOW_ITEM_INVALID) {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    if (item_targets->item_count == 0) {
+        return E_TBD_FILE_READ_MISSING_TARGETS;
+    }
+
+    end_flow_seq(file, &seq);
+    return E_TBD_FILE_READ_OK;
+}
+
+static bool
+symbol_type_for_key(const char *__notnull const key,
+                    enum tbd_symbol_type *__notnull const type_out)
+{
+    enum tbd_symbol_type type = TBD_SYMBOL_TYPE_NONE;
+    if (strcmp(key, "symbols") == 0) {
+        type = TBD_SYMBOL_TYPE_NONE;
+    } else if (strcmp(key, "objc-classes") == 0) {
+        type = TBD_SYMBOL_TYPE_OBJC_CLASS;
+    } else if (strcmp(key, "objc-eh-types") == 0) {
+        type = TBD_SYMBOL_TYPE_OBJC_EHTYPE;
+    } else if (strcmp(key, "objc-ivars") == 0) {
+        type = TBD_SYMBOL_TYPE_OBJC_IVAR;
+    } else if (strcmp(key, "weak-def-symbols") == 0 ||
+               strcmp(key, "weak-ref-symbols") == 0 ||
+               strcmp(key, "weak-symbols") == 0)
+    {
+        type = TBD_SYMBOL_TYPE_WEAK_DEF;
+    } else if (strcmp(key, "thread-local-symbols") == 0) {
+        type = TBD_SYMBOL_TYPE_THREAD_LOCAL;
+    } else if (strcmp(key, "re-exports") == 0) {
+        type = TBD_SYMBOL_TYPE_REEXPORT;
+    } else if (strcmp(key, "allowable-clients") == 0 ||
+               strcmp(key, "allowed-clients") == 0)
+    {
+        type = TBD_SYMBOL_TYPE_CLIENT;
+    } else {
+        return false;
+    }
+
+    *type_out = type;
+    return true;
+}
+
+/*
+ * Read a block-sequence of export-groups (exports, reexports, or undefineds),
+ * each of which starts with its archs or targets.
+ */
+
+static enum tbd_file_read_result
+read_symbol_groups(struct read_info *__notnull const read_info,
+                   char *__notnull const value,
+                   const enum tbd_symbol_meta_type meta_type)
+{
+    struct tbd_file *const file = read_info->file;
+    if (!is_block_value(value)) {
+        return E_TBD_FILE_READ_INVALID_SYNTAX;
+    }
+
+    const enum tbd_file_read_result lock_result = lock_targets(read_info);
+    if (lock_result != E_TBD_FILE_READ_OK) {
+        return lock_result;
+    }
+
+    file->iter = skip_line(file, value);
+
+    struct block_item item = {};
+    while (next_block_item(file, &item)) {
+        bool found_targets = false;
+        char *line = NULL;
+
+        while ((line = next_item_line(file, &item)) != NULL) {
+            const char *key = NULL;
+            char *const item_value = parse_key(line, &key);
+
+            if (item_value == NULL) {
+                return E_TBD_FILE_READ_INVALID_SYNTAX;
+            }
+
+            enum tbd_file_read_result result = E_TBD_FILE_READ_OK;
+            enum tbd_symbol_type type = TBD_SYMBOL_TYPE_NONE;
+
+            const bool is_archs = (strcmp(key, "archs") == 0);
+            if (is_archs || strcmp(key, "targets") == 0) {
+                result = read_item_targets(read_info, item_value, is_archs);
+                found_targets = true;
+            } else if (symbol_type_for_key(key, &type)) {
+                if (!found_targets) {
+                    return E_TBD_FILE_READ_MISSING_TARGETS;
+                }
+
+                result =
+                    read_symbol_list(read_info, item_value, type, meta_type);
+
+            } else {
+                result = skip_value(file, item_value, item.indent);
+            }
+
+            if (result != E_TBD_FILE_READ_OK) {
+                return result;
+            }
+        }
+    }
+
+    return E_TBD_FILE_READ_OK;
+}
+
+static enum tbd_file_read_result
+add_parent_umbrella(struct read_info *__notnull const read_info,
+                    const char *__notnull const string,
+                    const uint64_t length,
+                    const uint64_t index)
+{
+    const enum tbd_ci_add_parent_umbrella_result add_umbrella_result =
+        tbd_ci_add_parent_umbrella(read_info->info,
+                                   string,
+                                   length,
+                                   index,
+                                   read_info->options);
+
+    switch (add_umbrella_result) {
+        case E_TBD_CI_ADD_PARENT_UMBRELLA_OK:
+            break;
+
+        case E_TBD_CI_ADD_PARENT_UMBRELLA_ALLOC_FAIL:
+            return E_TBD_FILE_READ_ALLOC_FAIL;
+
+        case E_TBD_CI_ADD_PARENT_UMBRELLA_ARRAY_FAIL:
+            return E_TBD_FILE_READ_ARRAY_FAIL;
+
+        case E_TBD_CI_ADD_PARENT_UMBRELLA_INFO_CONFLICT:
+            return E_TBD_FILE_READ_PARENT_UMBRELLA_CONFLICT;
+    }
+
+    return E_TBD_FILE_READ_OK;
+}
+
+/*
+ * Up to tbd-version v3, the parent-umbrella is a single scalar for all archs.
+ */
+
+static enum tbd_file_read_result
+read_parent_umbrella_for_archs(struct read_info *__notnull const read_info,
+                               char *__notnull const value)
+{
+    char *string = NULL;
+    uint64_t length = 0;
+
+    const enum tbd_file_read_result read_result =
+        read_scalar(read_info->file, value, &string, &length);
+
+    if (read_result != E_TBD_FILE_READ_OK) {
+        return read_result;
+    }
+
+    uint64_t count = read_info->info->fields.targets.set_count;
+    if (read_info->options.ignore_targets) {
+        count = 1;
+    }
+
+    for (uint64_t i = 0; i != count; i++) {
+        const enum tbd_file_read_result add_result =
+            add_parent_umbrella(read_info, string, length, i);
+
+        if (add_result != E_TBD_FILE_READ_OK) {
+            return add_result;
+        }
+    }
+
+    return E_TBD_FILE_READ_OK;
+}
+
+static enum tbd_file_read_result
+read_metadata_list(struct read_info *__notnull const read_info,
+                   char *__notnull const value,
+                   const enum tbd_metadata_type type)
+{
+    if (type == TBD_METADATA_TYPE_PARENT_UMBRELLA) {
+        char *string = NULL;
+        uint64_t length = 0;
+
+        const enum tbd_file_read_result read_result =
+            read_scalar(read_info->file, value, &string, &length);
+
+        if (read_result != E_TBD_FILE_READ_OK) {
+            return read_result;
+        }
+
+        const struct array *const item_targets =
+            &read_info->file->item_targets;
+
+        const uint64_t *index = item_targets->data;
+        const uint64_t *const end = item_targets->data_end;
+
+        for (; index != end; index++) {
+            const enum tbd_file_read_result add_result =
+                add_parent_umbrella(read_info, string, length, *index);
+
+            if (add_result != E_TBD_FILE_READ_OK) {
+                return add_result;
+            }
+        }
+
+        return E_TBD_FILE_READ_OK;
+    }
+
+    enum tbd_symbol_type symbol_type = TBD_SYMBOL_TYPE_CLIENT;
+    if (type == TBD_METADATA_TYPE_REEXPORTED_LIBRARY) {
+        symbol_type = TBD_SYMBOL_TYPE_REEXPORT;
+    }
+
+    return read_symbol_list(read_info,
+                            value,
+                            symbol_type,
+                            TBD_SYMBOL_META_TYPE_EXPORT);
+}
+
+/*
+ * Starting from tbd-version v4, the parent-umbrellas, allowable-clients and
+ * reexported-libraries are each a block-sequence of groups starting with their
+ * targets.
+ *
+ * tbd_write.c writes the clients of a group under the key "libraries", while
+ * Apple writes them under "clients", so both keys are accepted.
+ */
+
+static enum tbd_file_read_result
+read_metadata_groups(struct read_info *__notnull const read_info,
+                     char *__notnull const value,
+                     const enum tbd_metadata_type type)
+{
+    struct tbd_file *const file = read_info->file;
+
+    const enum tbd_file_read_result lock_result = lock_targets(read_info);
+    if (lock_result != E_TBD_FILE_READ_OK) {
+        return lock_result;
+    }
+
+    file->iter = skip_line(file, value);
+
+    struct block_item item = {};
+    while (next_block_item(file, &item)) {
+        bool found_targets = false;
+        char *line = NULL;
+
+        while ((line = next_item_line(file, &item)) != NULL) {
+            const char *key = NULL;
+            char *const item_value = parse_key(line, &key);
+
+            if (item_value == NULL) {
+                return E_TBD_FILE_READ_INVALID_SYNTAX;
+            }
+
+            enum tbd_file_read_result result = E_TBD_FILE_READ_OK;
+            if (strcmp(key, "targets") == 0) {
+                result = read_item_targets(read_info, item_value, false);
+                found_targets = true;
+            } else if (strcmp(key, "umbrella") == 0 ||
+                       strcmp(key, "clients") == 0 ||
+                       strcmp(key, "libraries") == 0)
+            {
+                if (!found_targets) {
+                    return E_TBD_FILE_READ_MISSING_TARGETS;
+                }
+
+                result = read_metadata_list(read_info, item_value, type);
+            } else {
+                result = skip_value(file, item_value, item.indent);
+            }
+
+            if (result != E_TBD_FILE_READ_OK) {
+                return result;
+            }
+        }
+    }
+
+    return E_TBD_FILE_READ_OK;
+}
+
+static enum tbd_file_read_result
+read_scalar_key(struct read_info *__notnull const read_info,
+                const char *__notnull const key,
+                char *__notnull const value)
+{
+    char *string = NULL;
+    uint64_t length = 0;
+
+    const enum tbd_file_read_result read_result =
+        read_scalar(read_info->file, value, &string, &length);
+
+    if (read_result != E_TBD_FILE_READ_OK) {
+        return read_result;
+    }
+
+    struct tbd_create_info_fields *const fields = &read_info->info->fields;
+    if (strcmp(key, "current-version") == 0) {
+        return parse_packed_version(string, &fields->current_version);
+    } else if (strcmp(key, "compatibility-version") == 0) {
+        return parse_packed_version(string, &fields->compatibility_version);
+    } else if (strcmp(key, "objc-constraint") == 0) {
+        const enum tbd_objc_constraint constraint =
+            parse_objc_constraint(string);
+
+        if (constraint == TBD_OBJC_CONSTRAINT_NO_VALUE) {
+            return E_TBD_FILE_READ_INVALID_SYNTAX;
+        }
+
+        fields->archs.objc_constraint = constraint;
+    } else if (strcmp(key, "platform") == 0) {
+        const enum tbd_platform platform = parse_platform(string);
+        if (platform == TBD_PLATFORM_NONE) {
+            return E_TBD_FILE_READ_INVALID_PLATFORM;
+        }
+
+        read_info->platform = platform;
+    } else if (strcmp(key, "tbd-version") == 0) {
+        if (read_info->version != TBD_VERSION_V4 || strcmp(string, "4") != 0) {
+            return E_TBD_FILE_READ_UNSUPPORTED_VERSION;
+        }
+    } else {
+        return parse_swift_version(string, &fields->swift_version);
+    }
+
+    return E_TBD_FILE_READ_OK;
+}
+
+static enum tbd_file_read_result
+read_key(struct read_info *__notnull const read_info,
+         const char *__notnull const key,
+         char *__notnull const value)
+{
+    const struct tbd_parse_options options = read_info->options;
+    const enum tbd_version version = read_info->version;
+
+    bool ignore = false;
+    if (strcmp(key, "archs") == 0) {
+        if (options.ignore_targets || version == TBD_VERSION_V4) {
+            ignore = true;
+        } else {
+            return read_archs(read_info, value);
+        }
+    } else if (strcmp(key, "targets") == 0) {
+        if (version != TBD_VERSION_V4) {
+            ignore = true;
+        } else if (options.ignore_targets) {
+            if (options.ignore_platform) {
+                ignore = true;
+            } else {
+                return read_platform_of_targets(read_info, value);
+            }
+        } else {
+            return read_targets(read_info, value);
+        }
+    } else if (strcmp(key, "uuids") == 0) {
+        if (options.ignore_uuids) {
+            ignore = true;
+        } else if (*value == '[') {
+            return read_uuids_for_archs(read_info, value);
+        } else if (is_block_value(value)) {
+            return read_uuids_for_targets(read_info, value);
+        } else {
+            return E_TBD_FILE_READ_INVALID_SYNTAX;
+        }
+    } else if (strcmp(key, "flags") == 0) {
+        if (options.ignore_flags) {
+            ignore = true;
+        } else {
+            return read_flags(read_info, value);
+        }
+    } else if (strcmp(key, "install-name") == 0) {
+        if (options.ignore_install_name) {
+            ignore = true;
+        } else {
+            return read_install_name(read_info, value);
+        }
+    } else if (strcmp(key, "current-version") == 0) {
+        ignore = options.ignore_current_version;
+    } else if (strcmp(key, "compatibility-version") == 0) {
+        ignore = options.ignore_compat_version;
+    } else if (strcmp(key, "swift-version") == 0 ||
+               strcmp(key, "swift-abi-version") == 0)
+    {
+        ignore = options.ignore_swift_version;
+    } else if (strcmp(key, "objc-constraint") == 0) {
+        ignore = options.ignore_objc_constraint;
+    } else if (strcmp(key, "platform") == 0) {
+        ignore = (options.ignore_platform || version == TBD_VERSION_V4);
+    } else if (strcmp(key, "tbd-version") == 0) {
+        ignore = false;
+    } else if (strcmp(key, "parent-umbrella") == 0) {
+        if (options.ignore_parent_umbrellas) {
+            ignore = true;
+        } else if (is_block_value(value)) {
+            return read_metadata_groups(read_info,
+                                        value,
+                                        TBD_METADATA_TYPE_PARENT_UMBRELLA);
+        } else {
+            const enum tbd_file_read_result lock_result =
+                lock_targets(read_info);
+
+            if (lock_result != E_TBD_FILE_READ_OK) {
+                return lock_result;
+            }
+
+            return read_parent_umbrella_for_archs(read_info, value);
+        }
+    } else if (strcmp(key, "allowable-clients") == 0) {
+        if (options.ignore_clients) {
+            ignore = true;
+        } else {
+            return read_metadata_groups(read_info,
+                                        value,
+                                        TBD_METADATA_TYPE_CLIENT);
+        }
+    } else if (strcmp(key, "reexported-libraries") == 0) {
+        if (options.ignore_reexports) {
+            ignore = true;
+        } else {
+            return read_metadata_groups(read_info,
+                                        value,
+                                        TBD_METADATA_TYPE_REEXPORTED_LIBRARY);
+        }
+    } else if (strcmp(key, "exports") == 0) {
+        return read_symbol_groups(read_info,
+                                  value,
+                                  TBD_SYMBOL_META_TYPE_EXPORT);
+    } else if (strcmp(key, "reexports") == 0) {
+        return read_symbol_groups(read_info,
+                                  value,
+                                  TBD_SYMBOL_META_TYPE_REEXPORT);
+    } else if (strcmp(key, "undefineds") == 0) {
+        /*
+         * Undefined symbols aren't written out on tbd-version v1.
+         */
+
+        if (options.ignore_undefineds ||
+            read_info->info->version == TBD_VERSION_V1)
+        {
+            ignore = true;
+        } else {
+            return read_symbol_groups(read_info,
+                                      value,
+                                      TBD_SYMBOL_META_TYPE_UNDEFINED);
+        }
+    } else {
+        ignore = true;
+    }
+
+    if (ignore) {
+        return skip_value(read_info->file, value, 0);
+    }
+
+    return read_scalar_key(read_info, key, value);
+}
+
+static enum tbd_version
+parse_document_tag(const char *__notnull iter) {
+    while (is_space(*iter)) {
+        iter++;
+    }
+
+    const char *const tag = iter;
+    while (!is_token_end(*iter)) {
+        iter++;
+    }
+
+    const uint64_t length = (uint64_t)(iter - tag);
+    switch (length) {
+        case 0:
+            return TBD_VERSION_V1;
+
+        case 9:
+            if (memcmp(tag, "!tapi-tbd", 9) == 0) {
+                return TBD_VERSION_V4;
+            }
+
+            break;
+
+        case 12:
+            if (memcmp(tag, "!tapi-tbd-v2", 12) == 0) {
+                return TBD_VERSION_V2;
+            } else if (memcmp(tag, "!tapi-tbd-v3", 12) == 0) {
+                return TBD_VERSION_V3;
+            }
+
+            break;
+
+        default:
+            break;
+    }
+
+    return TBD_VERSION_NONE;
+}
+
+enum tbd_file_read_result
+tbd_file_read_next(struct tbd_file *__notnull const file,
+                   struct tbd_create_info *__notnull const info_in,
+                   const struct tbd_parse_options options)
+{
+    uint64_t indent = 0;
+    char *line = NULL;
+
+    do {
+        line = peek_line(file, &indent);
+        if (*line == '\0') {
+            return E_TBD_FILE_READ_NO_MORE_DOCUMENTS;
+        }
+
+        if (indent == 0 && is_document_start(line)) {
+            break;
+        }
+
+        file->iter = skip_line(file, line);
+    } while (true);
+
+    const enum tbd_version version = parse_document_tag(line + 3);
+    if (version == TBD_VERSION_NONE) {
+        return E_TBD_FILE_READ_UNSUPPORTED_VERSION;
+    }
+
+    file->iter = skip_line(file, line);
+    if (info_in->version == TBD_VERSION_NONE) {
+        info_in->version = version;
+    }
+
+    if (!file->copy_strings) {
+        info_in->flags.borrows_strings = true;
+    }
+
+    struct read_info read_info = {
+        .file = file,
+        .info = info_in,
+        .options = options,
+        .version = version
+    };
+
+    do {
+        line = peek_line(file, &indent);
+        if (*line == '\0' || is_document_start(line)) {
+            break;
+        }
+
+        if (is_document_end(line)) {
+            file->iter = skip_line(file, line);
+            break;
+        }
+
+        if (indent != 0) {
+            return E_TBD_FILE_READ_INVALID_SYNTAX;
+        }
+
+        const char *key = NULL;
+        char *const value = parse_key(line, &key);
+
+        if (value == NULL) {
+            return E_TBD_FILE_READ_INVALID_SYNTAX;
+        }
+
+        const enum tbd_file_read_result read_key_result =
+            read_key(&read_info, key, value);
+
+        if (read_key_result != E_TBD_FILE_READ_OK) {
+            return read_key_result;
+        }
+    } while (true);
+
+    /*
+     * Up to tbd-version v3, the platform applies to every arch, and can only be
+     * set once all archs (and their uuids) have been found.
+     *
+     * The platform found also applies to any provided targets.
+     */
+
+    if (version != TBD_VERSION_V4 || options.ignore_targets) {
+        if (read_info.platform != TBD_PLATFORM_NONE) {
+            tbd_ci_set_single_platform(info_in, read_info.platform);
+        }
+    }
+
+    /*
+     * A document without an install-name, or (up to tbd-version v3) without a
+     * platform for its archs, can't be written back out.
+     */
+
+    if (!options.ignore_install_name) {
+        if (info_in->fields.install_name == NULL) {
+            return E_TBD_FILE_READ_MISSING_INSTALL_NAME;
+        }
+    }
+
+    if (version != TBD_VERSION_V4) {
+        if (!options.ignore_targets && !options.ignore_platform) {
+            if (read_info.platform == TBD_PLATFORM_NONE) {
+                return E_TBD_FILE_READ_MISSING_PLATFORM;
+            }
+        }
+    }
+
+    tbd_ci_sort_info(info_in);
+    return E_TBD_FILE_READ_OK;
+}
+
+void tbd_file_close(struct tbd_file *__notnull const file) {
+    if (file->was_alloced) {
+        free(file->map);
+    } else {
+        munmap(file->map, file->size);
+    }
+
+    char **string = file->strings.data;
+    char *const *const end = file->strings.data_end;
+
+    for (; string != end; string++) {
+        free(*string);
+    }
+
+    array_destroy(&file->strings);
+    array_destroy(&file->item_targets);
+
+    file->map = NULL;
+    file->iter = NULL;
+    file->size = 0;
+}
@@ -7,6 +7,11 @@
 //
 
 #include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
 #include "tbd.h"
 #include "tbd_write.h"
 
@@ -389,7 +394,29 @@ write_yaml_string(FILE *__notnull const file,
                   const bool needs_quotes)
 {
     if (needs_quotes) {
-        if (fprintf(file, "\"%s\"", string) < 0) {
+        if (fputc('"', file) == EOF) {
+            return 1;
+        }
+
+        /*
+         * Escape the characters that would otherwise end the quoted scalar.
+         */
+
+        const char *const end = string + length;
+        for (const char *iter = string; iter != end; iter++) {
+            const char ch = *iter;
+            if (ch == '"' || ch == '\\') {
+                if (fputc('\\', file) == EOF) {
+                    return 1;
+                }
+            }
+
+            if (fputc(ch, file) == EOF) {
+                return 1;
+            }
+        }
+
+        if (fputc('"', file) == EOF) {
             return 1;
         }
     } else {
@@ -478,7 +505,13 @@ tbd_write_objc_constraint(FILE *__notnull const file,
 int
 tbd_write_magic(FILE *__notnull const file, const enum tbd_version version) {
     switch (version) {
+        /*
+         * tbd-version v5 is json-based, and is written out by tbd_write_json()
+         * instead.
+         */
+
         case TBD_VERSION_NONE:
+        case TBD_VERSION_V5:
             return 1;
 
         case TBD_VERSION_V1:
@@ -581,6 +614,7 @@ tbd_write_swift_version(FILE *__notnull const file,
 
     switch (tbd_version) {
         case TBD_VERSION_NONE:
+        case TBD_VERSION_V5:
             return 1;
 
         case TBD_VERSION_V1:
@@ -821,8 +855,8 @@ tbd_write_uuids_for_targets(FILE *__notnull const file,
 }
 
 
-static uint32_t line_length_initial = 28;
-static uint32_t line_length_max = 80;
+static const uint32_t line_length_initial = 28;
+static const uint32_t line_length_max = 80;
 
 /*
  * Write either a comma or a newline depending on either the current or new
@@ -842,11 +876,13 @@ enum write_comma_result {
     E_WRITE_COMMA_RESET_LINE_LENGTH,
 };
 
-static enum write_comma_result
-write_comma_or_newline(FILE *__notnull const file,
-                       const uint64_t line_length,
-                       const uint64_t string_length)
-{
+/*
+ * Return whether a string of string_length has to be written on the next line,
+ * instead of after a comma on the current line.
+ */
+
+static bool
+string_needs_newline(const uint64_t line_length, const uint64_t string_length) {
     /*
      * If the string is as long, or longer than the max-line limit, bend the
      * rules slightly to allow the string to fit, albeit on a seperate line.
@@ -854,11 +890,7 @@ write_comma_or_newline(FILE *__notnull const file,
 
     const uint64_t max_string_length = line_length_max - line_length_initial;
     if (string_length >= max_string_length) {
-        if (fprintf(file, ",\n%-28s", "") < 0) {
-            return E_WRITE_COMMA_WRITE_FAIL;
-        }
-
-        return E_WRITE_COMMA_RESET_LINE_LENGTH;
+        return true;
     }
 
     /*
@@ -868,7 +900,15 @@ write_comma_or_newline(FILE *__notnull const file,
      */
 
     const uint64_t new_line_length = line_length + string_length + 2;
-    if (new_line_length > line_length_max) {
+    return (new_line_length > line_length_max);
+}
+
+static enum write_comma_result
+write_comma_or_newline(FILE *__notnull const file,
+                       const uint64_t line_length,
+                       const uint64_t string_length)
+{
+    if (string_needs_newline(line_length, string_length)) {
         if (fprintf(file, ",\n%-28s", "") < 0) {
             return E_WRITE_COMMA_WRITE_FAIL;
         }
@@ -1784,6 +1824,451 @@ tbd_write_symbols_for_archs(FILE *__notnull const file,
     return 0;
 }
 
+/*
+ * Symbol-lists with at least this many symbols are formatted on several
+ * threads, each formatting its own chunks of symbols into its own buffers,
+ * with the buffers then written out in order.
+ */
+
+#define PARALLEL_WRITE_MIN_SYMBOLS 100000
+#define PARALLEL_WRITE_MAX_THREADS 64
+
+/*
+ * Split the symbol-list into at least this many chunks for every thread, so
+ * that threads finishing early have more chunks left to take.
+ */
+
+#define PARALLEL_WRITE_CHUNKS_PER_THREAD 4
+
+/*
+ * What changes between a symbol and the symbol before it, which decides the
+ * keys written before the symbol.
+ */
+
+enum symbol_group_change {
+    SYMBOL_GROUP_CHANGE_NONE,
+    SYMBOL_GROUP_CHANGE_TYPE,
+    SYMBOL_GROUP_CHANGE_TARGETS,
+    SYMBOL_GROUP_CHANGE_META_TYPE
+};
+
+static enum symbol_group_change
+get_symbol_group_change(const struct tbd_symbol_info *__notnull const first,
+                        const struct tbd_symbol_info *__notnull const sym,
+                        const bool with_full_targets)
+{
+    if (sym == first) {
+        return SYMBOL_GROUP_CHANGE_META_TYPE;
+    }
+
+    const struct tbd_symbol_info *const prev = sym - 1;
+    if (sym->meta_type != prev->meta_type) {
+        return SYMBOL_GROUP_CHANGE_META_TYPE;
+    }
+
+    if (!with_full_targets) {
+        const struct bit_list bits = sym->targets;
+        const struct bit_list prev_bits = prev->targets;
+
+        if (bits.set_count != prev_bits.set_count) {
+            return SYMBOL_GROUP_CHANGE_TARGETS;
+        }
+
+        if (!bit_list_equal_counts_is_equal(bits, prev_bits)) {
+            return SYMBOL_GROUP_CHANGE_TARGETS;
+        }
+    }
+
+    if (sym->type != prev->type) {
+        return SYMBOL_GROUP_CHANGE_TYPE;
+    }
+
+    return SYMBOL_GROUP_CHANGE_NONE;
+}
+
+/*
+ * Write a single symbol of the symbol-list, along with the keys that come
+ * before it, given only the line-length left by the symbols before it.
+ *
+ * This writes the same bytes tbd_write_symbols_for_targets() and
+ * tbd_write_symbols_with_full_targets() do for the symbol, as long as no
+ * symbols are ignored.
+ */
+
+static int
+write_symbol_in_list(FILE *__notnull const file,
+                     const struct tbd_create_info *__notnull const info,
+                     const struct tbd_symbol_info *__notnull const sym,
+                     const bool with_full_targets,
+                     uint64_t *__notnull const line_length_in)
+{
+    const struct tbd_symbol_info *const first = info->fields.symbols.data;
+    const enum symbol_group_change change =
+        get_symbol_group_change(first, sym, with_full_targets);
+
+    const uint64_t length = sym->length;
+    if (change == SYMBOL_GROUP_CHANGE_NONE) {
+        uint64_t line_length = *line_length_in;
+        const enum write_comma_result write_comma_result =
+            write_comma_or_newline(file, line_length, length);
+
+        switch (write_comma_result) {
+            case E_WRITE_COMMA_OK:
+                break;
+
+            case E_WRITE_COMMA_WRITE_FAIL:
+                return 1;
+
+            case E_WRITE_COMMA_RESET_LINE_LENGTH:
+                line_length = line_length_initial;
+                break;
+        }
+
+        if (write_symbol_info(file, sym)) {
+            return 1;
+        }
+
+        *line_length_in = line_length + length;
+        return 0;
+    }
+
+    if (sym != first) {
+        if (end_written_sequence(file)) {
+            return 1;
+        }
+    }
+
+    const struct target_list targets = info->fields.targets;
+    const enum tbd_version version = info->version;
+
+    if (change == SYMBOL_GROUP_CHANGE_META_TYPE) {
+        if (write_symbol_meta_type(file, sym->meta_type)) {
+            return 1;
+        }
+
+        if (with_full_targets) {
+            if (write_full_targets(file, version, targets)) {
+                return 1;
+            }
+        }
+    }
+
+    if (!with_full_targets && change != SYMBOL_GROUP_CHANGE_TYPE) {
+        const struct bit_list bits = sym->targets;
+        if (write_targets_as_dict_key(file, targets, bits, version)) {
+            return 1;
+        }
+    }
+
+    if (write_symbol_type_key(file, sym->type, version, true)) {
+        return 1;
+    }
+
+    if (write_symbol_info(file, sym)) {
+        return 1;
+    }
+
+    *line_length_in = line_length_initial + length;
+    return 0;
+}
+
+/*
+ * A symbol-chunk is formatted into its own buffer, starting with the
+ * line-length left by the symbols before it.
+ */
+
+struct symbol_chunk {
+    const struct tbd_symbol_info *begin;
+    const struct tbd_symbol_info *end;
+
+    uint64_t line_length;
+
+    char *buffer;
+    size_t size;
+
+    bool failed : 1;
+};
+
+struct symbol_write_job {
+    const struct tbd_create_info *info;
+
+    struct symbol_chunk *chunks;
+    uint64_t chunk_count;
+
+    bool with_full_targets : 1;
+
+    /*
+     * The index of the next chunk no thread has taken yet.
+     */
+
+    atomic_uint_fast64_t next_chunk;
+};
+
+static void
+write_symbol_chunk(const struct symbol_write_job *__notnull const job,
+                   struct symbol_chunk *__notnull const chunk)
+{
+    FILE *const file = open_memstream(&chunk->buffer, &chunk->size);
+    if (file == NULL) {
+        chunk->failed = true;
+        return;
+    }
+
+    const struct tbd_create_info *const info = job->info;
+    const bool with_full_targets = job->with_full_targets;
+
+    uint64_t line_length = chunk->line_length;
+    for (const struct tbd_symbol_info *sym = chunk->begin;
+         sym != chunk->end;
+         sym++)
+    {
+        if (write_symbol_in_list(file,
+                                 info,
+                                 sym,
+                                 with_full_targets,
+                                 &line_length))
+        {
+            chunk->failed = true;
+            break;
+        }
+    }
+
+    if (fclose(file) != 0) {
+        chunk->failed = true;
+    }
+}
+
+static void *write_symbol_chunks_on_thread(void *__notnull const arg) {
+    struct symbol_write_job *const job = (struct symbol_write_job *)arg;
+    do {
+        const uint64_t index = atomic_fetch_add(&job->next_chunk, 1);
+        if (index >= job->chunk_count) {
+            break;
+        }
+
+        write_symbol_chunk(job, job->chunks + index);
+    } while (true);
+
+    return NULL;
+}
+
+static uint64_t get_write_thread_count(void) {
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1) {
+        return 1;
+    }
+
+    if (count > PARALLEL_WRITE_MAX_THREADS) {
+        return PARALLEL_WRITE_MAX_THREADS;
+    }
+
+    return (uint64_t)count;
+}
+
+/*
+ * Write-options that ignore symbols have the serial writers skip symbols in
+ * ways write_symbol_in_list() doesn't, so they're always written serially.
+ */
+
+static bool options_ignore_symbols(const struct tbd_create_options options) {
+    return (options.ignore_exports ||
+            options.ignore_reexports ||
+            options.ignore_undefineds ||
+            options.ignore_clients ||
+            options.ignore_normal_syms ||
+            options.ignore_objc_class_syms ||
+            options.ignore_objc_ehtype_syms ||
+            options.ignore_objc_ivar_syms ||
+            options.ignore_weak_defs_syms ||
+            options.ignore_thread_local_syms);
+}
+
+/*
+ * Split the symbol-list into chunks, storing in every chunk the line-length
+ * left by the symbols before it. Only lengths are looked at here, so this is
+ * much quicker than formatting the symbols.
+ *
+ * Returns false if a symbol has no meta-type or type, which the serial writers
+ * stop writing at.
+ */
+
+static bool
+split_symbol_chunks(const struct tbd_symbol_info *__notnull const first,
+                    const uint64_t count,
+                    struct symbol_chunk *__notnull const chunks,
+                    const uint64_t chunk_count,
+                    const bool with_full_targets)
+{
+    const uint64_t chunk_size = count / chunk_count;
+
+    uint64_t line_length = 0;
+    uint64_t index = 0;
+
+    for (uint64_t i = 0; i != count; i++) {
+        const struct tbd_symbol_info *const sym = first + i;
+        if (sym->meta_type == TBD_SYMBOL_META_TYPE_NONE) {
+            return false;
+        }
+
+        if (sym->type == TBD_SYMBOL_TYPE_NONE) {
+            return false;
+        }
+
+        if (i == index * chunk_size && index != chunk_count) {
+            struct symbol_chunk *const chunk = chunks + index;
+
+            chunk->begin = sym;
+            chunk->line_length = line_length;
+
+            if (index != 0) {
+                chunks[index - 1].end = sym;
+            }
+
+            index++;
+        }
+
+        const enum symbol_group_change change =
+            get_symbol_group_change(first, sym, with_full_targets);
+
+        const uint64_t length = sym->length;
+        if (change != SYMBOL_GROUP_CHANGE_NONE) {
+            line_length = line_length_initial + length;
+            continue;
+        }
+
+        if (string_needs_newline(line_length, length)) {
+            line_length = line_length_initial;
+        }
+
+        line_length += length;
+    }
+
+    chunks[chunk_count - 1].end = first + count;
+    return true;
+}
+
+enum write_symbols_in_parallel_result {
+    E_WRITE_SYMBOLS_IN_PARALLEL_OK,
+    E_WRITE_SYMBOLS_IN_PARALLEL_WRITE_FAIL,
+
+    /*
+     * The symbol-list should be written serially instead.
+     */
+
+    E_WRITE_SYMBOLS_IN_PARALLEL_NOT_DONE
+};
+
+static enum write_symbols_in_parallel_result
+write_symbols_in_parallel(FILE *__notnull const file,
+                          const struct tbd_create_info *__notnull const info,
+                          const struct tbd_create_options options,
+                          const bool with_full_targets)
+{
+    const struct array *const symbol_list = &info->fields.symbols;
+    const uint64_t count = symbol_list->item_count;
+
+    if (count < PARALLEL_WRITE_MIN_SYMBOLS) {
+        return E_WRITE_SYMBOLS_IN_PARALLEL_NOT_DONE;
+    }
+
+    if (options_ignore_symbols(options)) {
+        return E_WRITE_SYMBOLS_IN_PARALLEL_NOT_DONE;
+    }
+
+    const uint64_t thread_count = get_write_thread_count();
+    if (thread_count == 1) {
+        return E_WRITE_SYMBOLS_IN_PARALLEL_NOT_DONE;
+    }
+
+    uint64_t chunk_count = thread_count * PARALLEL_WRITE_CHUNKS_PER_THREAD;
+    if (chunk_count > count) {
+        chunk_count = count;
+    }
+
+    struct symbol_chunk *const chunks =
+        calloc(chunk_count, sizeof(struct symbol_chunk));
+
+    if (chunks == NULL) {
+        return E_WRITE_SYMBOLS_IN_PARALLEL_NOT_DONE;
+    }
+
+    const struct tbd_symbol_info *const first = symbol_list->data;
+    if (!split_symbol_chunks(first,
+                             count,
+                             chunks,
+                             chunk_count,
+                             with_full_targets))
+    {
+        free(chunks);
+        return E_WRITE_SYMBOLS_IN_PARALLEL_NOT_DONE;
+    }
+
+    struct symbol_write_job job = {
+        .info = info,
+        .chunks = chunks,
+        .chunk_count = chunk_count,
+        .with_full_targets = with_full_targets
+    };
+
+    atomic_init(&job.next_chunk, 0);
+
+    pthread_t threads[PARALLEL_WRITE_MAX_THREADS];
+    uint64_t created_count = 0;
+
+    for (; created_count != thread_count - 1; created_count++) {
+        pthread_t *const thread = threads + created_count;
+        if (pthread_create(thread,
+                           NULL,
+                           write_symbol_chunks_on_thread,
+                           &job) != 0)
+        {
+            break;
+        }
+    }
+
+    write_symbol_chunks_on_thread(&job);
+    for (uint64_t i = 0; i != created_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    /*
+     * Chunks only fail to be formatted if their buffers couldn't be allocated,
+     * in which case the symbol-list is written serially instead.
+     */
+
+    enum write_symbols_in_parallel_result result =
+        E_WRITE_SYMBOLS_IN_PARALLEL_OK;
+
+    for (uint64_t i = 0; i != chunk_count; i++) {
+        if (chunks[i].failed) {
+            result = E_WRITE_SYMBOLS_IN_PARALLEL_NOT_DONE;
+            break;
+        }
+    }
+
+    for (uint64_t i = 0; i != chunk_count; i++) {
+        struct symbol_chunk *const chunk = chunks + i;
+        if (result == E_WRITE_SYMBOLS_IN_PARALLEL_OK) {
+            if (fwrite(chunk->buffer, chunk->size, 1, file) != 1) {
+                result = E_WRITE_SYMBOLS_IN_PARALLEL_WRITE_FAIL;
+            }
+        }
+
+        free(chunk->buffer);
+    }
+
+    free(chunks);
+    if (result != E_WRITE_SYMBOLS_IN_PARALLEL_OK) {
+        return result;
+    }
+
+    if (end_written_sequence(file)) {
+        return E_WRITE_SYMBOLS_IN_PARALLEL_WRITE_FAIL;
+    }
+
+    return E_WRITE_SYMBOLS_IN_PARALLEL_OK;
+}
+
 int
 tbd_write_symbols_for_targets(
     FILE *__notnull const file,
@@ -1799,6 +2284,20 @@ tbd_write_symbols_for_targets(
         return 0;
     }
 
+    const enum write_symbols_in_parallel_result parallel_result =
+        write_symbols_in_parallel(file, info, options, false);
+
+    switch (parallel_result) {
+        case E_WRITE_SYMBOLS_IN_PARALLEL_OK:
+            return 0;
+
+        case E_WRITE_SYMBOLS_IN_PARALLEL_WRITE_FAIL:
+            return 1;
+
+        case E_WRITE_SYMBOLS_IN_PARALLEL_NOT_DONE:
+            break;
+    }
+
     const struct target_list targets = info->fields.targets;
     const enum tbd_version version = info->version;
 
@@ -2163,6 +2662,20 @@ tbd_write_symbols_with_full_targets(
         return 0;
     }
 
+    const enum write_symbols_in_parallel_result parallel_result =
+        write_symbols_in_parallel(file, info, options, true);
+
+    switch (parallel_result) {
+        case E_WRITE_SYMBOLS_IN_PARALLEL_OK:
+            return 0;
+
+        case E_WRITE_SYMBOLS_IN_PARALLEL_WRITE_FAIL:
+            return 1;
+
+        case E_WRITE_SYMBOLS_IN_PARALLEL_NOT_DONE:
+            break;
+    }
+
     enum tbd_symbol_meta_type m_type = sym->meta_type;
 
     do {
@@ -0,0 +1,846 @@
+//
+//  src/tbd_write_json.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <string.h>
+
+#include "json_writer.h"
+#include "tbd.h"
+#include "tbd_write_json.h"
+
+static inline int
+write_key(struct json_writer *__notnull const writer,
+          const char *__notnull const key)
+{
+    return json_writer_write_key(writer, key, strlen(key));
+}
+
+static int
+write_target(struct json_writer *__notnull const writer,
+             const struct target_list *__notnull const list,
+             const uint64_t index,
+             const enum tbd_version version)
+{
+    const struct arch_info *arch = NULL;
+    enum tbd_platform platform = TBD_PLATFORM_NONE;
+
+    target_list_get_target(list, index, &arch, &platform);
+
+    const char *const platform_str = tbd_platform_to_string(platform, version);
+    if (platform_str == NULL) {
+        return 1;
+    }
+
+    /*
+     * Build the "<arch>-<platform>" string on the stack, so the target can be
+     * written out as a single json-string.
+     */
+
+    char buffer[64];
+
+    const uint64_t arch_length = arch->name_length;
+    const uint64_t platform_length = strlen(platform_str);
+
+    if (arch_length + 1 + platform_length > sizeof(buffer)) {
+        return 1;
+    }
+
+    memcpy(buffer, arch->name, arch_length);
+    buffer[arch_length] = '-';
+    memcpy(buffer + arch_length + 1, platform_str, platform_length);
+
+    const uint64_t length = arch_length + 1 + platform_length;
+    return json_writer_write_string(writer, buffer, length);
+}
+
+static int
+write_target_info(struct json_writer *__notnull const writer,
+                  const struct target_list *__notnull const list,
+                  const enum tbd_version version)
+{
+    if (list->set_count == 0) {
+        return 1;
+    }
+
+    if (write_key(writer, "target_info")) {
+        return 1;
+    }
+
+    if (json_writer_begin_array(writer)) {
+        return 1;
+    }
+
+    for (uint64_t i = 0; i != list->set_count; i++) {
+        if (json_writer_begin_object(writer)) {
+            return 1;
+        }
+
+        if (write_key(writer, "target")) {
+            return 1;
+        }
+
+        if (write_target(writer, list, i, version)) {
+            return 1;
+        }
+
+        if (json_writer_end_object(writer)) {
+            return 1;
+        }
+    }
+
+    return json_writer_end_array(writer);
+}
+
+/*
+ * Write the "targets" key of a metadata or symbol group, which is left out
+ * when the group is for every target.
+ */
+
+static int
+write_group_targets(struct json_writer *__notnull const writer,
+                    const struct tbd_create_info *__notnull const info,
+                    const struct bit_list bits)
+{
+    const struct target_list *const list = &info->fields.targets;
+    if (info->flags.uses_full_targets || bits.set_count == list->set_count) {
+        return 0;
+    }
+
+    if (bits.set_count == 0) {
+        return 1;
+    }
+
+    if (write_key(writer, "targets")) {
+        return 1;
+    }
+
+    if (json_writer_begin_array(writer)) {
+        return 1;
+    }
+
+    const enum tbd_version version = info->version;
+    uint64_t index = bit_list_find_first_bit(bits);
+
+    for (uint64_t i = 0; i != bits.set_count; i++) {
+        if (i != 0) {
+            index = bit_list_find_bit_after_last(bits, index);
+        }
+
+        if (write_target(writer, list, index, version)) {
+            return 1;
+        }
+    }
+
+    return json_writer_end_array(writer);
+}
+
+/*
+ * Write a single-item section, in the form of:
+ *     "<section>": [ { "<key>": <value> } ]
+ */
+
+static int
+begin_single_item_section(struct json_writer *__notnull const writer,
+                          const char *__notnull const section,
+                          const char *__notnull const key)
+{
+    if (write_key(writer, section)) {
+        return 1;
+    }
+
+    if (json_writer_begin_array(writer)) {
+        return 1;
+    }
+
+    if (json_writer_begin_object(writer)) {
+        return 1;
+    }
+
+    return write_key(writer, key);
+}
+
+static int end_single_item_section(struct json_writer *__notnull const writer) {
+    if (json_writer_end_object(writer)) {
+        return 1;
+    }
+
+    return json_writer_end_array(writer);
+}
+
+static int
+write_flags(struct json_writer *__notnull const writer,
+            const struct tbd_flags flags)
+{
+    if (!flags.flat_namespace && !flags.not_app_extension_safe) {
+        return 0;
+    }
+
+    if (begin_single_item_section(writer, "flags", "attributes")) {
+        return 1;
+    }
+
+    if (json_writer_begin_array(writer)) {
+        return 1;
+    }
+
+    if (flags.flat_namespace) {
+        if (json_writer_write_string(writer, "flat_namespace", 14)) {
+            return 1;
+        }
+    }
+
+    if (flags.not_app_extension_safe) {
+        const char *const str = "not_app_extension_safe";
+        if (json_writer_write_string(writer, str, 22)) {
+            return 1;
+        }
+    }
+
+    if (json_writer_end_array(writer)) {
+        return 1;
+    }
+
+    return end_single_item_section(writer);
+}
+
+/*
+ * Write the digits of value into buffer, returning the number written.
+ */
+
+static uint64_t write_digits(char *__notnull const buffer, uint32_t value) {
+    char digits[10];
+    uint64_t count = 0;
+
+    do {
+        digits[count] = (char)('0' + (value % 10));
+        count++;
+
+        value /= 10;
+    } while (value != 0);
+
+    for (uint64_t i = 0; i != count; i++) {
+        buffer[i] = digits[count - i - 1];
+    }
+
+    return count;
+}
+
+/*
+ * Write out a packed-version the same way tbd-version v4 does, leaving out a
+ * zero minor and revision.
+ */
+
+static int
+write_packed_version(struct json_writer *__notnull const writer,
+                     const char *__notnull const section,
+                     const uint32_t version)
+{
+    const uint32_t revision = (version & 0xff);
+    const uint32_t minor = ((version & 0xff00) >> 8);
+    const uint32_t major = ((version & 0xffff0000) >> 16);
+
+    char buffer[16];
+    uint64_t length = write_digits(buffer, major);
+
+    if (minor != 0 || revision != 0) {
+        buffer[length] = '.';
+        length += 1;
+        length += write_digits(buffer + length, minor);
+    }
+
+    if (revision != 0) {
+        buffer[length] = '.';
+        length += 1;
+        length += write_digits(buffer + length, revision);
+    }
+
+    if (begin_single_item_section(writer, section, "version")) {
+        return 1;
+    }
+
+    if (json_writer_write_string(writer, buffer, length)) {
+        return 1;
+    }
+
+    return end_single_item_section(writer);
+}
+
+static bool
+should_write_metadata_type(const enum tbd_metadata_type type,
+                           const struct tbd_create_options options)
+{
+    switch (type) {
+        case TBD_METADATA_TYPE_NONE:
+            return false;
+
+        case TBD_METADATA_TYPE_PARENT_UMBRELLA:
+            return !options.ignore_parent_umbrellas;
+
+        case TBD_METADATA_TYPE_CLIENT:
+            return !options.ignore_clients;
+
+        case TBD_METADATA_TYPE_REEXPORTED_LIBRARY:
+            return !options.ignore_reexports;
+    }
+
+    return false;
+}
+
+static bool
+has_same_targets(const struct tbd_create_info *__notnull const info,
+                 const struct bit_list left,
+                 const struct bit_list right)
+{
+    if (info->flags.uses_full_targets) {
+        return true;
+    }
+
+    if (left.set_count != right.set_count) {
+        return false;
+    }
+
+    return bit_list_equal_counts_is_equal(left, right);
+}
+
+/*
+ * Write out every umbrella as its own item, as only one umbrella is allowed
+ * for each target.
+ */
+
+static int
+write_umbrellas(struct json_writer *__notnull const writer,
+                const struct tbd_create_info *__notnull const info,
+                const struct tbd_metadata_info *__notnull meta,
+                const struct tbd_metadata_info *__notnull const end)
+{
+    for (; meta != end; meta++) {
+        if (json_writer_begin_object(writer)) {
+            return 1;
+        }
+
+        if (write_group_targets(writer, info, meta->targets)) {
+            return 1;
+        }
+
+        if (write_key(writer, "umbrella")) {
+            return 1;
+        }
+
+        if (json_writer_write_string(writer, meta->string, meta->length)) {
+            return 1;
+        }
+
+        if (json_writer_end_object(writer)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+write_metadata_groups(struct json_writer *__notnull const writer,
+                      const struct tbd_create_info *__notnull const info,
+                      const struct tbd_metadata_info *__notnull meta,
+                      const struct tbd_metadata_info *__notnull const end,
+                      const char *__notnull const key)
+{
+    while (meta != end) {
+        if (json_writer_begin_object(writer)) {
+            return 1;
+        }
+
+        const struct bit_list bits = meta->targets;
+        if (write_group_targets(writer, info, bits)) {
+            return 1;
+        }
+
+        if (write_key(writer, key)) {
+            return 1;
+        }
+
+        if (json_writer_begin_array(writer)) {
+            return 1;
+        }
+
+        do {
+            if (json_writer_write_string(writer, meta->string, meta->length)) {
+                return 1;
+            }
+
+            meta++;
+        } while (meta != end && has_same_targets(info, bits, meta->targets));
+
+        if (json_writer_end_array(writer)) {
+            return 1;
+        }
+
+        if (json_writer_end_object(writer)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+write_metadata(struct json_writer *__notnull const writer,
+               const struct tbd_create_info *__notnull const info,
+               const struct tbd_create_options options)
+{
+    const struct array *const metadata = &info->fields.metadata;
+
+    const struct tbd_metadata_info *meta = metadata->data;
+    const struct tbd_metadata_info *const end = metadata->data_end;
+
+    /*
+     * The metadata is sorted by type, so each type's section can be written
+     * out from a single run of metadata.
+     */
+
+    while (meta != end) {
+        const enum tbd_metadata_type type = meta->type;
+        const struct tbd_metadata_info *type_end = meta + 1;
+
+        while (type_end != end && type_end->type == type) {
+            type_end++;
+        }
+
+        if (!should_write_metadata_type(type, options)) {
+            meta = type_end;
+            continue;
+        }
+
+        const char *section = NULL;
+        const char *key = NULL;
+
+        switch (type) {
+            case TBD_METADATA_TYPE_NONE:
+                return 1;
+
+            case TBD_METADATA_TYPE_PARENT_UMBRELLA:
+                section = "parent_umbrellas";
+                break;
+
+            case TBD_METADATA_TYPE_CLIENT:
+                section = "allowable_clients";
+                key = "clients";
+
+                break;
+
+            case TBD_METADATA_TYPE_REEXPORTED_LIBRARY:
+                section = "reexported_libraries";
+                key = "names";
+
+                break;
+        }
+
+        if (write_key(writer, section)) {
+            return 1;
+        }
+
+        if (json_writer_begin_array(writer)) {
+            return 1;
+        }
+
+        if (key == NULL) {
+            if (write_umbrellas(writer, info, meta, type_end)) {
+                return 1;
+            }
+        } else {
+            if (write_metadata_groups(writer, info, meta, type_end, key)) {
+                return 1;
+            }
+        }
+
+        if (json_writer_end_array(writer)) {
+            return 1;
+        }
+
+        meta = type_end;
+    }
+
+    return 0;
+}
+
+static bool
+should_write_symbol(const struct tbd_symbol_info *__notnull const sym,
+                    const struct tbd_create_options options)
+{
+    switch (sym->meta_type) {
+        case TBD_SYMBOL_META_TYPE_NONE:
+            return false;
+
+        case TBD_SYMBOL_META_TYPE_EXPORT:
+            if (options.ignore_exports) {
+                return false;
+            }
+
+            break;
+
+        case TBD_SYMBOL_META_TYPE_REEXPORT:
+            if (options.ignore_reexports) {
+                return false;
+            }
+
+            break;
+
+        case TBD_SYMBOL_META_TYPE_UNDEFINED:
+            if (options.ignore_undefineds) {
+                return false;
+            }
+
+            break;
+    }
+
+    /*
+     * Clients and re-exports are only stored as symbols before tbd-version v4.
+     */
+
+    switch (sym->type) {
+        case TBD_SYMBOL_TYPE_NONE:
+        case TBD_SYMBOL_TYPE_CLIENT:
+        case TBD_SYMBOL_TYPE_REEXPORT:
+            return false;
+
+        case TBD_SYMBOL_TYPE_NORMAL:
+            return !options.ignore_normal_syms;
+
+        case TBD_SYMBOL_TYPE_OBJC_CLASS:
+            return !options.ignore_objc_class_syms;
+
+        case TBD_SYMBOL_TYPE_OBJC_EHTYPE:
+            return !options.ignore_objc_ehtype_syms;
+
+        case TBD_SYMBOL_TYPE_OBJC_IVAR:
+            return !options.ignore_objc_ivar_syms;
+
+        case TBD_SYMBOL_TYPE_WEAK_DEF:
+            return !options.ignore_weak_defs_syms;
+
+        case TBD_SYMBOL_TYPE_THREAD_LOCAL:
+            return !options.ignore_thread_local_syms;
+    }
+
+    return false;
+}
+
+static bool
+has_symbol_to_write(const struct tbd_symbol_info *__notnull sym,
+                    const struct tbd_symbol_info *__notnull const end,
+                    const struct tbd_create_options options)
+{
+    for (; sym != end; sym++) {
+        if (should_write_symbol(sym, options)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static const char *get_symbol_type_key(const enum tbd_symbol_type type) {
+    switch (type) {
+        case TBD_SYMBOL_TYPE_NONE:
+        case TBD_SYMBOL_TYPE_CLIENT:
+        case TBD_SYMBOL_TYPE_REEXPORT:
+            return NULL;
+
+        case TBD_SYMBOL_TYPE_NORMAL:
+            return "global";
+
+        case TBD_SYMBOL_TYPE_OBJC_CLASS:
+            return "objc_class";
+
+        case TBD_SYMBOL_TYPE_OBJC_EHTYPE:
+            return "objc_eh_type";
+
+        case TBD_SYMBOL_TYPE_OBJC_IVAR:
+            return "objc_ivar";
+
+        case TBD_SYMBOL_TYPE_WEAK_DEF:
+            return "weak";
+
+        case TBD_SYMBOL_TYPE_THREAD_LOCAL:
+            return "thread_local";
+    }
+
+    return NULL;
+}
+
+/*
+ * Write out a group of symbols that share the same targets, with a list for
+ * each symbol-type.
+ *
+ * Whether a symbol is code or data isn't stored, so every symbol is written
+ * under the "text" key.
+ */
+
+static int
+write_symbol_group(struct json_writer *__notnull const writer,
+                   const struct tbd_create_info *__notnull const info,
+                   const struct tbd_symbol_info *__notnull sym,
+                   const struct tbd_symbol_info *__notnull const end,
+                   const struct tbd_create_options options)
+{
+    if (json_writer_begin_object(writer)) {
+        return 1;
+    }
+
+    if (write_group_targets(writer, info, sym->targets)) {
+        return 1;
+    }
+
+    if (write_key(writer, "text")) {
+        return 1;
+    }
+
+    if (json_writer_begin_object(writer)) {
+        return 1;
+    }
+
+    /*
+     * The symbols of a group are sorted by type, so each type's list can be
+     * written out from a single run of symbols.
+     */
+
+    while (sym != end) {
+        const enum tbd_symbol_type type = sym->type;
+        const struct tbd_symbol_info *type_end = sym + 1;
+
+        while (type_end != end && type_end->type == type) {
+            type_end++;
+        }
+
+        if (!has_symbol_to_write(sym, type_end, options)) {
+            sym = type_end;
+            continue;
+        }
+
+        if (write_key(writer, get_symbol_type_key(type))) {
+            return 1;
+        }
+
+        if (json_writer_begin_array(writer)) {
+            return 1;
+        }
+
+        for (; sym != type_end; sym++) {
+            if (!should_write_symbol(sym, options)) {
+                continue;
+            }
+
+            if (json_writer_write_string(writer, sym->string, sym->length)) {
+                return 1;
+            }
+        }
+
+        if (json_writer_end_array(writer)) {
+            return 1;
+        }
+    }
+
+    if (json_writer_end_object(writer)) {
+        return 1;
+    }
+
+    return json_writer_end_object(writer);
+}
+
+static const char *
+get_symbol_section(const enum tbd_symbol_meta_type meta_type) {
+    switch (meta_type) {
+        case TBD_SYMBOL_META_TYPE_NONE:
+            return NULL;
+
+        case TBD_SYMBOL_META_TYPE_EXPORT:
+            return "exported_symbols";
+
+        case TBD_SYMBOL_META_TYPE_REEXPORT:
+            return "reexported_symbols";
+
+        case TBD_SYMBOL_META_TYPE_UNDEFINED:
+            return "undefined_symbols";
+    }
+
+    return NULL;
+}
+
+/*
+ * The symbols are sorted by meta-type, then by targets, then by type, and are
+ * grouped the same way tbd_write_symbols_for_targets() groups them, with a
+ * section for each meta-type, and an item for each set of targets.
+ */
+
+static int
+write_symbols(struct json_writer *__notnull const writer,
+              const struct tbd_create_info *__notnull const info,
+              const struct tbd_create_options options)
+{
+    const struct array *const symbol_list = &info->fields.symbols;
+
+    const struct tbd_symbol_info *sym = symbol_list->data;
+    const struct tbd_symbol_info *const end = symbol_list->data_end;
+
+    while (sym != end) {
+        const enum tbd_symbol_meta_type meta_type = sym->meta_type;
+        const struct tbd_symbol_info *meta_end = sym + 1;
+
+        while (meta_end != end && meta_end->meta_type == meta_type) {
+            meta_end++;
+        }
+
+        if (!has_symbol_to_write(sym, meta_end, options)) {
+            sym = meta_end;
+            continue;
+        }
+
+        if (write_key(writer, get_symbol_section(meta_type))) {
+            return 1;
+        }
+
+        if (json_writer_begin_array(writer)) {
+            return 1;
+        }
+
+        while (sym != meta_end) {
+            const struct bit_list bits = sym->targets;
+            const struct tbd_symbol_info *group_end = sym + 1;
+
+            while (group_end != meta_end &&
+                   has_same_targets(info, bits, group_end->targets))
+            {
+                group_end++;
+            }
+
+            if (has_symbol_to_write(sym, group_end, options)) {
+                if (write_symbol_group(writer, info, sym, group_end, options)) {
+                    return 1;
+                }
+            }
+
+            sym = group_end;
+        }
+
+        if (json_writer_end_array(writer)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+write_main_library(struct json_writer *__notnull const writer,
+                   const struct tbd_create_info *__notnull const info,
+                   const struct tbd_create_options options)
+{
+    if (json_writer_begin_object(writer)) {
+        return 1;
+    }
+
+    const enum tbd_version version = info->version;
+    if (write_target_info(writer, &info->fields.targets, version)) {
+        return 1;
+    }
+
+    if (!options.ignore_flags) {
+        if (write_flags(writer, info->fields.flags)) {
+            return 1;
+        }
+    }
+
+    if (begin_single_item_section(writer, "install_names", "name")) {
+        return 1;
+    }
+
+    const char *const install_name = info->fields.install_name;
+    const uint64_t install_name_length = info->fields.install_name_length;
+
+    if (json_writer_write_string(writer, install_name, install_name_length)) {
+        return 1;
+    }
+
+    if (end_single_item_section(writer)) {
+        return 1;
+    }
+
+    if (!options.ignore_current_version) {
+        const uint32_t current_version = info->fields.current_version;
+        if (write_packed_version(writer, "current_versions", current_version)) {
+            return 1;
+        }
+    }
+
+    if (!options.ignore_compat_version) {
+        const uint32_t compat_version = info->fields.compatibility_version;
+        if (write_packed_version(writer,
+                                 "compatibility_versions",
+                                 compat_version))
+        {
+            return 1;
+        }
+    }
+
+    const uint32_t swift_version = info->fields.swift_version;
+    if (!options.ignore_swift_version && swift_version != 0) {
+        if (begin_single_item_section(writer, "swift_abi", "abi")) {
+            return 1;
+        }
+
+        if (json_writer_write_uint(writer, swift_version)) {
+            return 1;
+        }
+
+        if (end_single_item_section(writer)) {
+            return 1;
+        }
+    }
+
+    if (write_metadata(writer, info, options)) {
+        return 1;
+    }
+
+    if (write_symbols(writer, info, options)) {
+        return 1;
+    }
+
+    return json_writer_end_object(writer);
+}
+
+int
+tbd_write_json(FILE *__notnull const file,
+               const struct tbd_create_info *__notnull const info,
+               const struct tbd_create_options options)
+{
+    struct json_writer writer = { .file = file };
+    if (json_writer_begin_object(&writer)) {
+        return 1;
+    }
+
+    if (write_key(&writer, "tapi_tbd_version")) {
+        return 1;
+    }
+
+    if (json_writer_write_uint(&writer, 5)) {
+        return 1;
+    }
+
+    if (write_key(&writer, "main_library")) {
+        return 1;
+    }
+
+    if (write_main_library(&writer, info, options)) {
+        return 1;
+    }
+
+    if (json_writer_end_object(&writer)) {
+        return 1;
+    }
+
+    return json_writer_end(&writer);
+}
@@ -25,10 +25,14 @@ void print_usage(void) {
     fputs("        --preserve-subdirs,       Preserve the sub-directories of where files were found\n", stdout);
     fputs("                                  when recursing in relation to the actual provided recurse-path\n", stdout);
     fputs("        --no-overwrite,           Prevent overwriting of files when writing out\n", stdout);
+    fputs("        --write-if-changed,       Only write out files whose contents have changed, leaving unchanged files\n", stdout);
+    fputs("                                  (and their modification times) untouched\n", stdout);
     fputs("        --replace-path-extension, Replace the path-extension(s) of provided file(s) when\n", stdout);
     fputs("                                  writing out (Instead of simply appending .tbd)\n", stdout);
     fputs("        --combine-tbds,           Combine all tbds created (when recursing or with a dyld-shared-cache) into a\n", stdout);
-    fputs("                                  single .tbd file\n", stdout);
+    fputs("                                  single .tbd file (not supported for tbd-version v5, or with multiple tbd-versions)\n", stdout);
+    fputs("        --archive,                Write all tbds created (when recursing or with a dyld-shared-cache) into a\n", stdout);
+    fputs("                                  single uncompressed tar archive, each named after the path it would have been written to\n", stdout);
 
     fputc('\n', stdout);
     fputs("Path options:\n", stdout);
@@ -43,27 +47,43 @@ void print_usage(void) {
     fputs("                                         while recursing\n", stdout);
     fputs("        --dsc,                           Specify that the file(s) provided should only be parsed\n", stdout);
     fputs("                                         if it is a dyld-shared-cache file.\n", stdout);
-    fputs("                                         Providing --macho or --dsc limits filetypes parsed when recursing\n", stdout);
+    fputs("        --tbd,                           Specify that the file(s) provided should only be parsed\n", stdout);
+    fputs("                                         if it is a .tbd file, which is then converted to the\n", stdout);
+    fputs("                                         provided tbd-version (or kept in its own version).\n", stdout);
+    fputs("                                         Only the first document of a .tbd file is read.\n", stdout);
+    fputs("                                         .tbd files are only parsed when recursing if --tbd is provided\n", stdout);
+    fputs("                                         Providing --macho, --dsc, or --tbd limits filetypes parsed when recursing\n", stdout);
+    fputs("        --zip,                           Specify that the file(s) provided should only be parsed\n", stdout);
+    fputs("                                         if it is a zip file (such as an .ipa file). Every mach-o\n", stdout);
+    fputs("                                         member is parsed in place without extracting the archive,\n", stdout);
+    fputs("                                         and written to the member's path under the output directory\n", stdout);
     fputs("               --filter-image-directory, Specify a directory to filter dyld_shared_cache images from\n", stdout);
     fputs("               --filter-image-filename,  Specify a filename to filter dyld_shared_cache images from\n", stdout);
     fputs("               --filter-image-number,    Specify the number of an dyld_shared_cache image to parse out.\n", stdout);
     fputs("                                         To get the numbers of all available images, use the option --list-dsc-images\n", stdout);
     fputs("               --image-path,             Specify the path of an image to parse out.\n", stdout);
     fputs("                                         To get the paths of all available images, use the option --list-dsc-images\n", stdout);
+    fputs("               --with-dependencies,      Also parse out every image the provided images load or re-export, directly or indirectly.\n", stdout);
+    fputs("                                         Dependencies are found from the load-commands of each image, and are written out like the image they were found from\n", stdout);
     fputs("        -v, --version,                   Specify version of .tbd files to convert to (default is v2).\n", stdout);
     fputs("                                         This applies to all files where tbd-version was not explicitly set.\n", stdout);
     fputs("                                         To get a list of all available versions, look at the options below, or use\n", stdout);
     fputs("                                         the option --list-tbd-versions\n", stdout);
+    fputs("                                         A comma-separated list of versions (such as -v2,v3,v4) writes out a .tbd of\n", stdout);
+    fputs("                                         every version from a single parse, each to the write-path with \"-<version>\"\n", stdout);
+    fputs("                                         appended, one after the other to stdout, or under a \"<version>/\" directory of an archive\n", stdout);
     fputs("        -v1,                             Set version of .tbd files to version v1.\n", stdout);
     fputs("        -v2,                             Set version of .tbd files to version v2. (This is the default .tbd version)\n", stdout);
     fputs("        -v3,                             Set version of .tbd files to version v3.\n", stdout);
     fputs("        -v4,                             Set version of .tbd files to version v4.\n", stdout);
+    fputs("        -v5,                             Set version of .tbd files to version v5 (json).\n", stdout);
 
     fputc('\n', stdout);
     fputs("Ignore options: (Subset of path options)\n", stdout);
     fputs("        --ignore-clients,          Ignore clients field\n", stdout);
     fputs("        --ignore-compat-version,   Ignore compatibility-version field\n", stdout);
     fputs("        --ignore-current-version,  Ignore current-version field\n", stdout);
+    fputs("        --ignore-exports,          Ignore exports field\n", stdout);
     fputs("        --ignore-flags,            Ignore flags field\n", stdout);
     fputs("        --ignore-objc-constraint,  Ignore objc-constraint field\n", stdout);
     fputs("        --ignore-parent-umbrellas, Ignore parent-umbrella field\n", stdout);
@@ -95,6 +115,15 @@ void print_usage(void) {
     fputs("        --allow-private-objc-ehtypes,   Allow all non-external objc-ehtypes.\n", stdout);
     fputs("                                        objc-ehtype symbols are only recognized for .tbd version v3 and above\n", stdout);
     fputs("        --allow-private-objc-ivars,     Allow all non-external objc-ivars\n", stdout);
+    fputs("        --include-symbols,              Only add symbols whose names match a pattern in the provided comma-separated list.\n", stdout);
+    fputs("                                        Patterns are globs, where '*' matches any run of characters, and '?' any single character\n", stdout);
+    fputs("        --exclude-symbols,              Don't add symbols whose names match a pattern in the provided comma-separated list.\n", stdout);
+    fputs("                                        Symbols are matched by their names in the mach-o file, before being added\n", stdout);
+    fputs("        --max-image-bytes,              Skip any image that stores more than the provided number of bytes of symbols\n", stdout);
+    fputs("        --max-image-time,               Skip any image that takes longer than the provided number of milliseconds to parse\n", stdout);
+    fputs("        --max-symbols,                  Skip any image with more than the provided number of symbols\n", stdout);
+    fputs("        --max-trie-nodes,               Skip any image whose export-trie has more than the provided number of nodes to visit\n", stdout);
+    fputs("        --parallel-export-trie,         Parse large export-tries on several threads, splitting them into sub-trees\n", stdout);
     fputs("        --use-export-trie,              Use only the export-trie and not the symbol-table\n", stdout);
     fputs("        --use-symbol-table,             Use the symbol-table over the export-trie\n", stdout);
 
@@ -120,7 +149,7 @@ void print_usage(void) {
     fputs("                                   A target is in the form of arch-platform pair (ex. arm64-ios).\n", stdout);
     fputs("                                   A list of architectures can be found by using option --list-architectures.\n", stdout);
     fputs("                                   A list of platforms can be found by using option --list-platforms.\n", stdout);
-    fputs("                                   --replace-targets is only supported tbd-version v4\n", stdout);
+    fputs("                                   --replace-targets is only supported tbd-versions v4 and v5\n", stdout);
 
     fputc('\n', stdout);
     fputs("Ignore field warning options: (Subset of path options)\n", stdout);
@@ -143,4 +172,63 @@ void print_usage(void) {
     fputs("        --list-platforms,        List all valid platforms\n", stdout);
     fputs("        --list-tbd-flags,        List all valid flags for .tbd files\n", stdout);
     fputs("        --list-tbd-versions,     List all valid versions for .tbd files\n", stdout);
+
+    fputc('\n', stdout);
+    fputs("Manifest options:\n", stdout);
+    fputs("        --manifest,              Run every conversion listed in a manifest file (or \"stdin\") in a single process.\n", stdout);
+    fputs("                                 Each line of the manifest is in the form of:\n", stdout);
+    fputs("                                     [path-options] <input-path> [output-options] <output-path>\n", stdout);
+    fputs("                                 with fields separated by tabs (or spaces). Empty lines and lines starting with '#' are skipped.\n", stdout);
+    fputs("                                 dyld_shared_cache files are kept mapped between lines that parse them.\n", stdout);
+
+    fputc('\n', stdout);
+    fputs("Diff options:\n", stdout);
+    fputs("        --diff,                  Print the differences in exported symbols and metadata between two mach-o or dyld_shared_cache files.\n", stdout);
+    fputs("                                 Run in the form of:\n", stdout);
+    fputs("                                     --diff <old-path> <new-path>\n", stdout);
+    fputs("                                 Images are paired by their install-names, and symbols that were added (+), removed (-),\n", stdout);
+    fputs("                                 or whose targets changed (~) are printed under each image.\n", stdout);
+
+    fputc('\n', stdout);
+    fputs("Dump options:\n", stdout);
+    fputs("        --dump-exports,          Write a record of every export of every image of the provided mach-o or dyld_shared_cache files to stdout.\n", stdout);
+    fputs("                                 Run in the form of:\n", stdout);
+    fputs("                                     --dump-exports <ndjson|tsv> <path>...\n", stdout);
+    fputs("                                 Each record holds the image, symbol, kind, and target of the export. Records are written as\n", stdout);
+    fputs("                                 the exports are found, and so are neither sorted nor deduplicated.\n", stdout);
+
+    fputc('\n', stdout);
+    fputs("Symbol-index options:\n", stdout);
+    fputs("        --build-symbol-index,    Write a symbol-index of every symbol exported by the images of the provided dyld_shared_cache files.\n", stdout);
+    fputs("                                 Run in the form of:\n", stdout);
+    fputs("                                     --build-symbol-index <index-path> <dsc-path>...\n", stdout);
+    fputs("        --lookup-symbol,         Print the image-path, type, and targets of every image exporting each provided symbol,\n", stdout);
+    fputs("                                 searching a symbol-index in place, without parsing the dyld_shared_cache files again.\n", stdout);
+    fputs("                                 Run in the form of:\n", stdout);
+    fputs("                                     --lookup-symbol <index-path> <symbol>...\n", stdout);
+    fputs("        --query-symbol,          Print the image-path, flags, and targets of every image exporting each provided symbol,\n", stdout);
+    fputs("                                 descending each image's export-trie along the symbol, without parsing any image's symbols.\n", stdout);
+    fputs("                                 Run in the form of:\n", stdout);
+    fputs("                                     --query-symbol <dsc-path> <symbol>...\n", stdout);
+
+    fputc('\n', stdout);
+    fputs("Merge options:\n", stdout);
+    fputs("        --merge-dsc,             Write a single tbd-version v4 .tbd for each install-name found in the provided dyld_shared_cache files,\n", stdout);
+    fputs("                                 with the targets of every dyld_shared_cache file the image was found in.\n", stdout);
+    fputs("                                 Run in the form of:\n", stdout);
+    fputs("                                     --merge-dsc <write-dir> <dsc-path> <dsc-path>...\n", stdout);
+    fputs("                                 Each .tbd is written to <write-dir>/<install-name>.tbd, and every image is parsed only once.\n", stdout);
+    fputc('\n', stdout);
+    fputs("Server options:\n", stdout);
+    fputs("        --serve,                 Keep running and answer requests from stdin, or from a unix domain socket\n", stdout);
+    fputs("                                 at a provided path. Recently used dyld_shared_cache files stay mapped between requests.\n", stdout);
+    fputs("                                 Requests are one per line, with fields separated by tabs (or spaces):\n", stdout);
+    fputs("                                     extract <dsc-path> <image-path> [version] [output-path]\n", stdout);
+    fputs("                                     evict <dsc-path>\n", stdout);
+    fputs("                                     quit\n", stdout);
+    fputs("                                 Each request is answered with a line of either \"ok\" or \"error <description>\".\n", stdout);
+    fputs("                                 Without an output-path, \"ok\" is followed by the length of the .tbd, which follows the line\n", stdout);
+    fputs("                                 One option exists for --serve:\n", stdout);
+    fputs("                                     --max-caches <count>\n", stdout);
+    fputs("                                         Maximum number of dyld_shared_cache files to keep mapped (default is 4)\n", stdout);
 }
@@ -33,6 +33,8 @@ static inline bool char_needs_quotes(const char ch) {
         case '@':
         case '`':
         case ' ':
+        case '"':
+        case '\'':
             return true;
 
         default:
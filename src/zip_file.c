@@ -0,0 +1,611 @@
+//
+//  src/zip_file.c
+//  tbd
+//
+//  Created by inoahdev on 2/10/20.
+//  Copyright © 2020 inoahdev. All rights reserved.
+//
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "guard_overflow.h"
+#include "zip_file.h"
+
+#define ZIP_EOCD_SIGNATURE 0x06054b50
+#define ZIP_EOCD_SIZE 22
+#define ZIP_EOCD_MAX_COMMENT_SIZE 0xffff
+
+#define ZIP64_EOCD_LOCATOR_SIGNATURE 0x07064b50
+#define ZIP64_EOCD_LOCATOR_SIZE 20
+
+#define ZIP64_EOCD_SIGNATURE 0x06064b50
+#define ZIP64_EOCD_SIZE 56
+
+#define ZIP_CENTRAL_ENTRY_SIGNATURE 0x02014b50
+#define ZIP_CENTRAL_ENTRY_SIZE 46
+
+#define ZIP_LOCAL_HEADER_SIGNATURE 0x04034b50
+#define ZIP_LOCAL_HEADER_SIZE 30
+
+#define ZIP64_EXTRA_FIELD_ID 0x0001
+#define ZIP_FLAG_ENCRYPTED 0x1
+
+/*
+ * Deflated data is inflated in chunks no larger than this, as zlib only takes
+ * 32-bit sizes.
+ */
+
+#define ZIP_INFLATE_CHUNK_SIZE (1ull << 30)
+
+/*
+ * All fields of a zip-file are little-endian, and not necessarily aligned.
+ */
+
+static inline uint16_t read_u16(const uint8_t *__notnull const ptr) {
+    return (uint16_t)(ptr[0] | (ptr[1] << 8));
+}
+
+static inline uint32_t read_u32(const uint8_t *__notnull const ptr) {
+    return ((uint32_t)ptr[0] |
+            ((uint32_t)ptr[1] << 8) |
+            ((uint32_t)ptr[2] << 16) |
+            ((uint32_t)ptr[3] << 24));
+}
+
+static inline uint64_t read_u64(const uint8_t *__notnull const ptr) {
+    return ((uint64_t)read_u32(ptr) | ((uint64_t)read_u32(ptr + 4) << 32));
+}
+
+/*
+ * The end-of-central-directory record is at the very end of the zip-file,
+ * followed only by a variable-length comment, so search backwards for it.
+ */
+
+static const uint8_t *
+find_eocd(const uint8_t *__notnull const map, const uint64_t size) {
+    if (size < ZIP_EOCD_SIZE) {
+        return NULL;
+    }
+
+    uint64_t min_offset = 0;
+    if (size - ZIP_EOCD_SIZE > ZIP_EOCD_MAX_COMMENT_SIZE) {
+        min_offset = size - ZIP_EOCD_SIZE - ZIP_EOCD_MAX_COMMENT_SIZE;
+    }
+
+    uint64_t offset = size - ZIP_EOCD_SIZE;
+    do {
+        const uint8_t *const eocd = map + offset;
+        if (read_u32(eocd) == ZIP_EOCD_SIGNATURE) {
+            const uint16_t comment_size = read_u16(eocd + 20);
+            if (offset + ZIP_EOCD_SIZE + comment_size == size) {
+                return eocd;
+            }
+        }
+
+        if (offset == min_offset) {
+            break;
+        }
+
+        offset--;
+    } while (true);
+
+    return NULL;
+}
+
+/*
+ * Zip64 files store the central-directory's info in a zip64 record, found
+ * through a locator right before the end-of-central-directory record.
+ */
+
+static enum zip_file_open_result
+read_zip64_eocd(struct zip_file *__notnull const zip,
+                const uint64_t eocd_offset)
+{
+    if (eocd_offset < ZIP64_EOCD_LOCATOR_SIZE) {
+        return E_ZIP_FILE_OPEN_INVALID_CENTRAL_DIRECTORY;
+    }
+
+    const uint8_t *const locator =
+        zip->map + eocd_offset - ZIP64_EOCD_LOCATOR_SIZE;
+
+    if (read_u32(locator) != ZIP64_EOCD_LOCATOR_SIGNATURE) {
+        return E_ZIP_FILE_OPEN_INVALID_CENTRAL_DIRECTORY;
+    }
+
+    if (read_u32(locator + 4) != 0 || read_u32(locator + 16) > 1) {
+        return E_ZIP_FILE_OPEN_MULTIPLE_DISKS;
+    }
+
+    const uint64_t zip64_eocd_offset = read_u64(locator + 8);
+    if (zip64_eocd_offset > eocd_offset - ZIP64_EOCD_LOCATOR_SIZE ||
+        eocd_offset - ZIP64_EOCD_LOCATOR_SIZE - zip64_eocd_offset <
+            ZIP64_EOCD_SIZE)
+    {
+        return E_ZIP_FILE_OPEN_INVALID_CENTRAL_DIRECTORY;
+    }
+
+    const uint8_t *const zip64_eocd = zip->map + zip64_eocd_offset;
+    if (read_u32(zip64_eocd) != ZIP64_EOCD_SIGNATURE) {
+        return E_ZIP_FILE_OPEN_INVALID_CENTRAL_DIRECTORY;
+    }
+
+    if (read_u32(zip64_eocd + 16) != 0 || read_u32(zip64_eocd + 20) != 0) {
+        return E_ZIP_FILE_OPEN_MULTIPLE_DISKS;
+    }
+
+    zip->member_count = read_u64(zip64_eocd + 32);
+    zip->central_directory_size = read_u64(zip64_eocd + 40);
+    zip->central_directory_offset = read_u64(zip64_eocd + 48);
+
+    return E_ZIP_FILE_OPEN_OK;
+}
+
+static enum zip_file_open_result read_eocd(struct zip_file *__notnull zip) {
+    const uint8_t *const eocd = find_eocd(zip->map, zip->size);
+    if (eocd == NULL) {
+        return E_ZIP_FILE_OPEN_NOT_A_ZIP;
+    }
+
+    if (read_u16(eocd + 4) != 0 || read_u16(eocd + 6) != 0) {
+        return E_ZIP_FILE_OPEN_MULTIPLE_DISKS;
+    }
+
+    const uint16_t member_count = read_u16(eocd + 10);
+    const uint32_t cd_size = read_u32(eocd + 12);
+    const uint32_t cd_offset = read_u32(eocd + 16);
+
+    const uint64_t eocd_offset = (uint64_t)(eocd - zip->map);
+    if (member_count == UINT16_MAX ||
+        cd_size == UINT32_MAX ||
+        cd_offset == UINT32_MAX)
+    {
+        const enum zip_file_open_result read_zip64_result =
+            read_zip64_eocd(zip, eocd_offset);
+
+        if (read_zip64_result != E_ZIP_FILE_OPEN_OK) {
+            return read_zip64_result;
+        }
+    } else {
+        zip->member_count = member_count;
+        zip->central_directory_size = cd_size;
+        zip->central_directory_offset = cd_offset;
+    }
+
+    uint64_t cd_end = zip->central_directory_offset;
+    if (guard_overflow_add(&cd_end, zip->central_directory_size)) {
+        return E_ZIP_FILE_OPEN_INVALID_CENTRAL_DIRECTORY;
+    }
+
+    if (cd_end > eocd_offset) {
+        return E_ZIP_FILE_OPEN_INVALID_CENTRAL_DIRECTORY;
+    }
+
+    return E_ZIP_FILE_OPEN_OK;
+}
+
+enum zip_file_open_result
+zip_file_open(struct zip_file *__notnull const zip, const int fd) {
+    struct stat sbuf = {};
+    if (fstat(fd, &sbuf) != 0) {
+        return E_ZIP_FILE_OPEN_FSTAT_FAIL;
+    }
+
+    const uint64_t size = (uint64_t)sbuf.st_size;
+    if (size < ZIP_EOCD_SIZE) {
+        return E_ZIP_FILE_OPEN_NOT_A_ZIP;
+    }
+
+    const uint8_t *const map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return E_ZIP_FILE_OPEN_MMAP_FAIL;
+    }
+
+    zip->map = map;
+    zip->size = size;
+
+    const enum zip_file_open_result read_eocd_result = read_eocd(zip);
+    if (read_eocd_result != E_ZIP_FILE_OPEN_OK) {
+        zip_file_close(zip);
+        return read_eocd_result;
+    }
+
+    return E_ZIP_FILE_OPEN_OK;
+}
+
+/*
+ * A zip64 extra-field holds the sizes and offset of a member too large for the
+ * central-directory entry, but only those whose entry-field is saturated.
+ */
+
+static bool
+read_zip64_extra_field(const uint8_t *__notnull const extra,
+                       const uint16_t extra_size,
+                       struct zip_file_member *__notnull const member)
+{
+    uint16_t offset = 0;
+    while (extra_size - offset >= 4) {
+        const uint16_t id = read_u16(extra + offset);
+        const uint16_t size = read_u16(extra + offset + 2);
+
+        offset += 4;
+        if (size > extra_size - offset) {
+            return false;
+        }
+
+        if (id != ZIP64_EXTRA_FIELD_ID) {
+            offset += size;
+            continue;
+        }
+
+        const uint8_t *iter = extra + offset;
+        const uint8_t *const end = iter + size;
+
+        if (member->size == UINT32_MAX) {
+            if (end - iter < 8) {
+                return false;
+            }
+
+            member->size = read_u64(iter);
+            iter += 8;
+        }
+
+        if (member->compressed_size == UINT32_MAX) {
+            if (end - iter < 8) {
+                return false;
+            }
+
+            member->compressed_size = read_u64(iter);
+            iter += 8;
+        }
+
+        if (member->local_header_offset == UINT32_MAX) {
+            if (end - iter < 8) {
+                return false;
+            }
+
+            member->local_header_offset = read_u64(iter);
+        }
+
+        return true;
+    }
+
+    return true;
+}
+
+enum zip_file_member_result
+zip_file_get_next_member(const struct zip_file *__notnull const zip,
+                         uint64_t *__notnull const offset_in,
+                         struct zip_file_member *__notnull const member_out)
+{
+    const uint64_t offset = *offset_in;
+    const uint64_t cd_size = zip->central_directory_size;
+
+    if (offset >= cd_size) {
+        return E_ZIP_FILE_MEMBER_NO_MORE_MEMBERS;
+    }
+
+    if (cd_size - offset < ZIP_CENTRAL_ENTRY_SIZE) {
+        return E_ZIP_FILE_MEMBER_INVALID_ENTRY;
+    }
+
+    const uint8_t *const entry =
+        zip->map + zip->central_directory_offset + offset;
+
+    if (read_u32(entry) != ZIP_CENTRAL_ENTRY_SIGNATURE) {
+        return E_ZIP_FILE_MEMBER_INVALID_ENTRY;
+    }
+
+    const uint16_t name_length = read_u16(entry + 28);
+    const uint16_t extra_size = read_u16(entry + 30);
+    const uint16_t comment_size = read_u16(entry + 32);
+
+    const uint64_t entry_size =
+        ZIP_CENTRAL_ENTRY_SIZE +
+        (uint64_t)name_length +
+        extra_size +
+        comment_size;
+
+    if (cd_size - offset < entry_size) {
+        return E_ZIP_FILE_MEMBER_INVALID_ENTRY;
+    }
+
+    struct zip_file_member member = {
+        .name = (const char *)(entry + ZIP_CENTRAL_ENTRY_SIZE),
+        .name_length = name_length,
+
+        .flags = read_u16(entry + 8),
+        .compression = read_u16(entry + 10),
+        .crc32 = read_u32(entry + 16),
+
+        .compressed_size = read_u32(entry + 20),
+        .size = read_u32(entry + 24),
+
+        .local_header_offset = read_u32(entry + 42)
+    };
+
+    const uint8_t *const extra =
+        entry + ZIP_CENTRAL_ENTRY_SIZE + name_length;
+
+    if (!read_zip64_extra_field(extra, extra_size, &member)) {
+        return E_ZIP_FILE_MEMBER_INVALID_ENTRY;
+    }
+
+    *member_out = member;
+    *offset_in = offset + entry_size;
+
+    return E_ZIP_FILE_MEMBER_OK;
+}
+
+/*
+ * Find the compressed data of a member, which follows its local-header. The
+ * local-header has its own name and extra-field, which may differ in size from
+ * those of the central-directory entry.
+ */
+
+static enum zip_file_read_result
+get_member_data(const struct zip_file *__notnull const zip,
+                const struct zip_file_member *__notnull const member,
+                const uint8_t **__notnull const data_out)
+{
+    if (member->flags & ZIP_FLAG_ENCRYPTED) {
+        return E_ZIP_FILE_READ_ENCRYPTED;
+    }
+
+    switch (member->compression) {
+        case ZIP_FILE_COMPRESSION_STORED:
+            if (member->compressed_size != member->size) {
+                return E_ZIP_FILE_READ_INVALID_DATA;
+            }
+
+            break;
+
+        case ZIP_FILE_COMPRESSION_DEFLATED:
+            break;
+
+        default:
+            return E_ZIP_FILE_READ_UNSUPPORTED_COMPRESSION;
+    }
+
+    const uint64_t header_offset = member->local_header_offset;
+    if (header_offset > zip->central_directory_offset ||
+        zip->central_directory_offset - header_offset < ZIP_LOCAL_HEADER_SIZE)
+    {
+        return E_ZIP_FILE_READ_INVALID_LOCAL_HEADER;
+    }
+
+    const uint8_t *const header = zip->map + header_offset;
+    if (read_u32(header) != ZIP_LOCAL_HEADER_SIGNATURE) {
+        return E_ZIP_FILE_READ_INVALID_LOCAL_HEADER;
+    }
+
+    uint64_t data_offset = header_offset + ZIP_LOCAL_HEADER_SIZE;
+
+    data_offset += read_u16(header + 26);
+    data_offset += read_u16(header + 28);
+
+    uint64_t data_end = data_offset;
+    if (guard_overflow_add(&data_end, member->compressed_size)) {
+        return E_ZIP_FILE_READ_INVALID_DATA;
+    }
+
+    if (data_end > zip->central_directory_offset) {
+        return E_ZIP_FILE_READ_INVALID_DATA;
+    }
+
+    *data_out = zip->map + data_offset;
+    return E_ZIP_FILE_READ_OK;
+}
+
+/*
+ * Inflate the raw deflate-stream of a member into buffer, stopping once buffer
+ * is full, or the stream has ended.
+ */
+
+static enum zip_file_read_result
+inflate_member(const struct zip_file_member *__notnull const member,
+               const uint8_t *__notnull const data,
+               uint8_t *__notnull const buffer,
+               const uint64_t size,
+               uint64_t *__notnull const size_out)
+{
+    z_stream stream = {};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return E_ZIP_FILE_READ_ALLOC_FAIL;
+    }
+
+    uint64_t in_left = member->compressed_size;
+    uint64_t out_left = size;
+
+    stream.next_in = (Bytef *)data;
+    stream.next_out = buffer;
+
+    int ret = Z_OK;
+    while (out_left != 0) {
+        if (stream.avail_in == 0) {
+            uint64_t chunk = in_left;
+            if (chunk > ZIP_INFLATE_CHUNK_SIZE) {
+                chunk = ZIP_INFLATE_CHUNK_SIZE;
+            }
+
+            stream.avail_in = (uInt)chunk;
+            in_left -= chunk;
+        }
+
+        if (stream.avail_out == 0) {
+            uint64_t chunk = out_left;
+            if (chunk > ZIP_INFLATE_CHUNK_SIZE) {
+                chunk = ZIP_INFLATE_CHUNK_SIZE;
+            }
+
+            stream.avail_out = (uInt)chunk;
+        }
+
+        const uInt avail_out = stream.avail_out;
+        ret = inflate(&stream, Z_NO_FLUSH);
+
+        out_left -= avail_out - stream.avail_out;
+        if (ret == Z_STREAM_END) {
+            break;
+        }
+
+        if (ret != Z_OK) {
+            inflateEnd(&stream);
+            if (ret == Z_MEM_ERROR) {
+                return E_ZIP_FILE_READ_ALLOC_FAIL;
+            }
+
+            return E_ZIP_FILE_READ_INVALID_DATA;
+        }
+
+        if (stream.avail_in == 0 && in_left == 0) {
+            break;
+        }
+    }
+
+    inflateEnd(&stream);
+
+    *size_out = size - out_left;
+    return E_ZIP_FILE_READ_OK;
+}
+
+enum zip_file_read_result
+zip_file_read_member_front(const struct zip_file *__notnull const zip,
+                           const struct zip_file_member *__notnull const member,
+                           void *__notnull const buffer,
+                           const uint64_t size)
+{
+    if (member->size < size) {
+        return E_ZIP_FILE_READ_INVALID_DATA;
+    }
+
+    const uint8_t *data = NULL;
+    const enum zip_file_read_result get_data_result =
+        get_member_data(zip, member, &data);
+
+    if (get_data_result != E_ZIP_FILE_READ_OK) {
+        return get_data_result;
+    }
+
+    if (member->compression == ZIP_FILE_COMPRESSION_STORED) {
+        memcpy(buffer, data, size);
+        return E_ZIP_FILE_READ_OK;
+    }
+
+    uint64_t inflated_size = 0;
+    const enum zip_file_read_result inflate_result =
+        inflate_member(member, data, buffer, size, &inflated_size);
+
+    if (inflate_result != E_ZIP_FILE_READ_OK) {
+        return inflate_result;
+    }
+
+    if (inflated_size != size) {
+        return E_ZIP_FILE_READ_INVALID_DATA;
+    }
+
+    return E_ZIP_FILE_READ_OK;
+}
+
+static bool
+crc32_matches(const uint8_t *__notnull const data,
+              const uint64_t size,
+              const uint32_t expected)
+{
+    uLong crc = crc32(0, Z_NULL, 0);
+
+    const uint8_t *iter = data;
+    uint64_t left = size;
+
+    while (left != 0) {
+        uint64_t chunk = left;
+        if (chunk > ZIP_INFLATE_CHUNK_SIZE) {
+            chunk = ZIP_INFLATE_CHUNK_SIZE;
+        }
+
+        crc = crc32(crc, iter, (uInt)chunk);
+
+        iter += chunk;
+        left -= chunk;
+    }
+
+    return (crc == expected);
+}
+
+enum zip_file_read_result
+zip_file_read_member(const struct zip_file *__notnull const zip,
+                     const struct zip_file_member *__notnull const member,
+                     struct zip_file_data *__notnull const data_out)
+{
+    const uint8_t *data = NULL;
+    const enum zip_file_read_result get_data_result =
+        get_member_data(zip, member, &data);
+
+    if (get_data_result != E_ZIP_FILE_READ_OK) {
+        return get_data_result;
+    }
+
+    /*
+     * Stored members are used in place, without being copied.
+     */
+
+    if (member->compression == ZIP_FILE_COMPRESSION_STORED) {
+        data_out->data = data;
+        data_out->size = member->size;
+        data_out->is_allocated = false;
+
+        return E_ZIP_FILE_READ_OK;
+    }
+
+    if (member->size == 0) {
+        return E_ZIP_FILE_READ_INVALID_DATA;
+    }
+
+    uint8_t *const buffer = malloc(member->size);
+    if (buffer == NULL) {
+        return E_ZIP_FILE_READ_ALLOC_FAIL;
+    }
+
+    uint64_t inflated_size = 0;
+    const enum zip_file_read_result inflate_result =
+        inflate_member(member, data, buffer, member->size, &inflated_size);
+
+    if (inflate_result != E_ZIP_FILE_READ_OK) {
+        free(buffer);
+        return inflate_result;
+    }
+
+    if (inflated_size != member->size ||
+        !crc32_matches(buffer, inflated_size, member->crc32))
+    {
+        free(buffer);
+        return E_ZIP_FILE_READ_INVALID_DATA;
+    }
+
+    data_out->data = buffer;
+    data_out->size = inflated_size;
+    data_out->is_allocated = true;
+
+    return E_ZIP_FILE_READ_OK;
+}
+
+void zip_file_data_destroy(struct zip_file_data *__notnull const data) {
+    if (data->is_allocated) {
+        free((void *)data->data);
+    }
+
+    data->data = NULL;
+    data->size = 0;
+    data->is_allocated = false;
+}
+
+void zip_file_close(struct zip_file *__notnull const zip) {
+    munmap((void *)zip->map, zip->size);
+
+    zip->map = NULL;
+    zip->size = 0;
+}
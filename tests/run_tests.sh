@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+#  tests/run_tests.sh
+#  tbd
+#
+#  Created by inoahdev on 2/10/20.
+#  Copyright © 2020 inoahdev. All rights reserved.
+#
+#  Run every tests/test_*.sh script against the tbd binary at the provided
+#  path, and exit with a failure if any of them fail.
+#
+
+if [ $# -ne 1 ]; then
+    echo "Usage: $0 <path-to-tbd>" >&2
+    exit 1
+fi
+
+TBD=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+TESTS_DIR=$(cd "$(dirname "$0")" && pwd)
+
+export TBD TESTS_DIR
+
+failed=0
+for test in "$TESTS_DIR"/test_*.sh; do
+    name=$(basename "$test" .sh)
+
+    TEST_TMPDIR=$(mktemp -d)
+    export TEST_TMPDIR
+
+    # Run each test from its temporary directory, so that any relative paths
+    # written to are cleaned up with it.
+
+    if (cd "$TEST_TMPDIR" && sh "$test"); then
+        echo "PASS: $name"
+    else
+        echo "FAIL: $name"
+        failed=1
+    fi
+
+    rm -rf "$TEST_TMPDIR"
+done
+
+exit $failed
@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+#  tests/test_manifest.sh
+#  tbd
+#
+#  Created by inoahdev on 2/10/20.
+#  Copyright © 2020 inoahdev. All rights reserved.
+#
+#  Lines of a manifest with CRLF line-endings should be parsed the same as
+#  lines ending with just a newline, and each line should be able to write to
+#  stdout.
+#
+
+input="$TESTS_DIR/tbd/libfoo.tbd"
+manifest="$TEST_TMPDIR/manifest"
+
+printf '%s stdout\r\n%s stdout\r\n' "$input" "$input" > "$manifest"
+
+"$TBD" --manifest "$manifest" > "$TEST_TMPDIR/out" 2> "$TEST_TMPDIR/err"
+status=$?
+
+if [ $status -ne 0 ]; then
+    echo "Manifest run failed with status $status:" >&2
+    cat "$TEST_TMPDIR/err" >&2
+    exit 1
+fi
+
+count=$(grep -c "install-name: .*/usr/lib/libfoo.dylib" "$TEST_TMPDIR/out")
+if [ "$count" -ne 2 ]; then
+    echo "Expected 2 .tbd documents on stdout, got $count:" >&2
+    cat "$TEST_TMPDIR/out" "$TEST_TMPDIR/err" >&2
+    exit 1
+fi
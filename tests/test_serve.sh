@@ -0,0 +1,90 @@
+#!/bin/sh
+#
+#  tests/test_serve.sh
+#  tbd
+#
+#  Created by inoahdev on 2/10/20.
+#  Copyright © 2020 inoahdev. All rights reserved.
+#
+#  A quit request sent over the socket of --serve should stop the server, and
+#  not just end the session of the client that sent it.
+#
+
+if ! command -v python3 > /dev/null 2>&1; then
+    echo "python3 is needed to connect to the socket, skipping" >&2
+    exit 0
+fi
+
+socket_path="$TEST_TMPDIR/serve.sock"
+
+"$TBD" --serve "$socket_path" 2> "$TEST_TMPDIR/err" &
+server_pid=$!
+
+# Send each request in its own session, printing every reply.
+send_requests() {
+    python3 - "$socket_path" "$@" <<'PY'
+import socket, sys, time
+
+path = sys.argv[1]
+for request in sys.argv[2:]:
+    for _ in range(100):
+        try:
+            client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            client.connect(path)
+            break
+        except OSError:
+            client.close()
+            time.sleep(0.05)
+    else:
+        sys.exit("Failed to connect to " + path)
+
+    client.sendall((request + "\n").encode())
+    client.shutdown(socket.SHUT_WR)
+
+    reply = b""
+    while True:
+        data = client.recv(4096)
+        if not data:
+            break
+        reply += data
+
+    client.close()
+    sys.stdout.write(reply.decode())
+PY
+}
+
+fail() {
+    echo "$1" >&2
+    cat "$TEST_TMPDIR/err" >&2
+    kill "$server_pid" 2> /dev/null
+    exit 1
+}
+
+replies=$(send_requests "evict /does/not/exist" "quit") ||
+    fail "Failed to send requests"
+
+if [ "$replies" != "$(printf 'ok\nok')" ]; then
+    fail "Unexpected replies: $replies"
+fi
+
+# The server should exit on its own, shortly after the quit request.
+tries=0
+while kill -0 "$server_pid" 2> /dev/null; do
+    tries=$((tries + 1))
+    if [ $tries -gt 50 ]; then
+        fail "Server is still running after a quit request"
+    fi
+
+    sleep 0.1
+done
+
+wait "$server_pid"
+status=$?
+
+if [ $status -ne 0 ]; then
+    fail "Server exited with status $status after a quit request"
+fi
+
+if [ -e "$socket_path" ]; then
+    fail "Socket was not removed after a quit request"
+fi
@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+#  tests/test_tbd_read.sh
+#  tbd
+#
+#  Created by inoahdev on 2/10/20.
+#  Copyright © 2020 inoahdev. All rights reserved.
+#
+#  .tbd documents missing a key needed to write them back out should be
+#  rejected with an error, instead of producing a broken .tbd file.
+#
+#  Quoted scalars should be unescaped when read, and escaped again when written
+#  back out, while text after a closing quote should be rejected.
+#
+
+expect_read_error() {
+    input="$TESTS_DIR/tbd/$1"
+    expected="$2"
+
+    "$TBD" -p "$input" -o stdout > "$TEST_TMPDIR/out" 2> "$TEST_TMPDIR/err"
+
+    if ! grep -q "$expected" "$TEST_TMPDIR/err"; then
+        echo "$1: expected error \"$expected\", got:" >&2
+        cat "$TEST_TMPDIR/err" >&2
+        return 1
+    fi
+
+    if [ -s "$TEST_TMPDIR/out" ]; then
+        echo "$1: expected no output, got:" >&2
+        cat "$TEST_TMPDIR/out" >&2
+        return 1
+    fi
+}
+
+expect_read_error missing_install_name.tbd "is missing its install-name" ||
+    exit 1
+
+expect_read_error missing_platform.tbd "is missing its platform" || exit 1
+
+expect_read_error quoted_trailing_text.tbd "has invalid syntax" || exit 1
+
+input="$TESTS_DIR/tbd/quoted_symbols.tbd"
+expected='[ "_a: b", _plain, "_q\"x\\y", "it'"'"'s" ]'
+
+"$TBD" -p "$input" -o stdout > "$TEST_TMPDIR/out" 2> "$TEST_TMPDIR/err"
+if ! grep -qF "symbols:              $expected" "$TEST_TMPDIR/out"; then
+    echo "quoted_symbols.tbd: expected symbols $expected, got:" >&2
+    cat "$TEST_TMPDIR/out" "$TEST_TMPDIR/err" >&2
+    exit 1
+fi
+
+"$TBD" -p "$TEST_TMPDIR/out" -o "$TEST_TMPDIR/rewritten" 2> "$TEST_TMPDIR/err"
+if ! cmp -s "$TEST_TMPDIR/out" "$TEST_TMPDIR/rewritten"; then
+    echo "quoted_symbols.tbd: re-reading the written .tbd changed it:" >&2
+    diff "$TEST_TMPDIR/out" "$TEST_TMPDIR/rewritten" >&2
+    cat "$TEST_TMPDIR/err" >&2
+    exit 1
+fi